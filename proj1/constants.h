@@ -2,3 +2,5 @@
 #define STATE_ACCESS_DELAY_MS 10
 #define CMD_BUF_SIZE 16
 #define BUF_SIZE 1024
+#define EVENT_LIST_SHARDS 16
+#define SHARED_REGION_SIZE (1UL << 30)  // Only the pages that are used are backed by memory
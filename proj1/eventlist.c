@@ -1,67 +1,217 @@
 #include "eventlist.h"
 
-#include <stdlib.h>
+#include <string.h>
 
-struct EventList* create_list() {
-  struct EventList* list = (struct EventList*)malloc(sizeof(struct EventList));
+#include "region.h"
+
+// Tile every seat of a never written tile reads from. Each process has its own copy, which is never written.
+static const unsigned int free_tile[EVENT_TILE_SEATS];
+
+/// Calculates the number of seats of each tile of an event.
+/// @param event Event.
+/// @return Seats per tile, at least 1.
+static size_t tile_seats(const struct Event* event) {
+  size_t num_seats = event->rows * event->cols;
+  if (num_seats == 0) return 1;
+  return num_seats < EVENT_TILE_SEATS ? num_seats : EVENT_TILE_SEATS;
+}
+
+struct EventList* create_list(size_t num_shards) {
+  if (num_shards == 0) return NULL;
+
+  struct EventList* list = region_ptr(region_alloc(sizeof(struct EventList)));
   if (!list) return NULL;
-  list->head = NULL;
-  list->tail = NULL;
+
+  struct EventShard* shards = region_ptr(region_alloc(sizeof(struct EventShard) * num_shards));
+  if (!shards) return NULL;
+
+  for (size_t i = 0; i < num_shards; i++) {
+    shards[i].head = 0;
+    shards[i].tail = 0;
+    if (region_mutex_init(&shards[i].mutex) != 0) return NULL;
+    shards[i].pending = 0;
+    shards[i].num_pending = 0;
+    shards[i].pending_capacity = 0;
+  }
+  list->shards = region_offset(shards);
+  list->num_shards = num_shards;
+  list->next_seq = 0;
+  if (region_mutex_init(&list->seq_mutex) != 0) return NULL;
   return list;
 }
 
+struct EventShard* get_shard(struct EventList* list, unsigned int event_id) {
+  struct EventShard* shards = region_ptr(list->shards);
+  return &shards[event_id % list->num_shards];
+}
+
+struct Event* create_event(unsigned int event_id, size_t num_rows, size_t num_cols, size_t num_stripes) {
+  struct Event* event = region_ptr(region_alloc_local(sizeof(struct Event)));
+  if (!event) return NULL;
+
+  // Region memory starts zeroed, so every tile starts free and nothing is allocated for the seats themselves
+  size_t num_tiles = num_rows * num_cols == 0 ? 1 : (num_rows * num_cols + EVENT_TILE_SEATS - 1) / EVENT_TILE_SEATS;
+  event->data = region_alloc_local(num_tiles * sizeof(size_t));
+  if (event->data == 0) return NULL;
+
+  if (num_stripes == 0) num_stripes = (num_rows + EVENT_ROWS_PER_STRIPE - 1) / EVENT_ROWS_PER_STRIPE;
+  if (num_stripes > EVENT_MAX_STRIPES) num_stripes = EVENT_MAX_STRIPES;
+  if (num_stripes > num_rows) num_stripes = num_rows;
+  if (num_stripes == 0) num_stripes = 1;
+  event->stripe_rows = num_rows == 0 ? 1 : (num_rows + num_stripes - 1) / num_stripes;
+  event->num_stripes = num_rows == 0 ? 1 : (num_rows + event->stripe_rows - 1) / event->stripe_rows;
+
+  pthread_rwlock_t* stripes = region_ptr(region_alloc_local(sizeof(pthread_rwlock_t) * event->num_stripes));
+  if (!stripes) return NULL;
+  for (size_t i = 0; i < event->num_stripes; i++) {
+    if (region_rwlock_init(&stripes[i]) != 0) return NULL;
+  }
+  event->stripes = region_offset(stripes);
+  event->id = event_id;
+  event->rows = num_rows;
+  event->cols = num_cols;
+  event->reservations = 0;
+  return event;
+}
+
+const unsigned int* event_seat(struct Event* event, size_t index) {
+  size_t* tiles = region_ptr(event->data);
+  // Writers of other stripes may install tiles at any time
+  size_t tile = __atomic_load_n(&tiles[index / EVENT_TILE_SEATS], __ATOMIC_ACQUIRE);
+  if (tile == 0) return &free_tile[index % EVENT_TILE_SEATS];
+  return (const unsigned int*)region_ptr(tile) + index % EVENT_TILE_SEATS;
+}
+
+unsigned int* event_seat_for_write(struct Event* event, size_t index) {
+  size_t* tiles = region_ptr(event->data);
+  size_t* slot = &tiles[index / EVENT_TILE_SEATS];
+  size_t tile = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+  if (tile == 0) {
+    size_t fresh = region_alloc_local(tile_seats(event) * sizeof(unsigned int));
+    if (fresh == 0) return NULL;
+    // Region memory is never released, so a tile that lost the race is simply abandoned
+    tile = __atomic_compare_exchange_n(slot, &tile, fresh, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) ? fresh : tile;
+  }
+  return (unsigned int*)region_ptr(tile) + index % EVENT_TILE_SEATS;
+}
+
+uint64_t row_stripes(const struct Event* event, const size_t* rows, size_t count) {
+  uint64_t mask = 0;
+  for (size_t i = 0; i < count; i++) {
+    mask |= 1ull << ((rows[i] - 1) / event->stripe_rows);
+  }
+  return mask;
+}
+
+uint64_t all_stripes(const struct Event* event) {
+  return event->num_stripes == EVENT_MAX_STRIPES ? UINT64_MAX : (1ull << event->num_stripes) - 1;
+}
+
+void wrlock_stripes(struct Event* event, uint64_t mask) {
+  pthread_rwlock_t* stripes = region_ptr(event->stripes);
+  // Lowest bit first, so stripes are always taken in row order
+  for (; mask != 0; mask &= mask - 1) {
+    pthread_rwlock_wrlock(&stripes[__builtin_ctzll(mask)]);
+  }
+}
+
+void rdlock_stripes(struct Event* event, uint64_t mask) {
+  pthread_rwlock_t* stripes = region_ptr(event->stripes);
+  for (; mask != 0; mask &= mask - 1) {
+    pthread_rwlock_rdlock(&stripes[__builtin_ctzll(mask)]);
+  }
+}
+
+void unlock_stripes(struct Event* event, uint64_t mask) {
+  pthread_rwlock_t* stripes = region_ptr(event->stripes);
+  for (; mask != 0; mask &= mask - 1) {
+    pthread_rwlock_unlock(&stripes[__builtin_ctzll(mask)]);
+  }
+}
+
 int append_to_list(struct EventList* list, struct Event* event) {
   if (!list) return 1;
 
-  struct ListNode* new_node = (struct ListNode*)malloc(sizeof(struct ListNode));
+  struct ListNode* new_node = region_ptr(region_alloc_local(sizeof(struct ListNode)));
   if (!new_node) return 1;
 
-  new_node->event = event;
-  new_node->next = NULL;
+  new_node->event = region_offset(event);
+  new_node->next = 0;
+
+  pthread_mutex_lock(&list->seq_mutex);
+  event->seq = list->next_seq++;
+  pthread_mutex_unlock(&list->seq_mutex);
 
-  if (list->head == NULL) {
-    list->head = new_node;
-    list->tail = new_node;
+  struct EventShard* shard = get_shard(list, event->id);
+  size_t node = region_offset(new_node);
+  if (shard->head == 0) {
+    shard->head = node;
+    shard->tail = node;
   } else {
-    list->tail->next = new_node;
-    list->tail = new_node;
+    ((struct ListNode*)region_ptr(shard->tail))->next = node;
+    shard->tail = node;
   }
 
   return 0;
 }
 
-static void free_event(struct Event* event) {
-  if (!event) return;
-
-  free(event->data);
-  free(event);
-}
-
 void free_list(struct EventList* list) {
   if (!list) return;
 
-  struct ListNode* current = list->head;
-  while (current) {
-    struct ListNode* temp = current;
-    current = current->next;
-
-    free_event(temp->event);
-    free(temp);
+  struct EventShard* shards = region_ptr(list->shards);
+  for (size_t i = 0; i < list->num_shards; i++) {
+    for (struct ListNode* current = region_ptr(shards[i].head); current; current = region_ptr(current->next)) {
+      struct Event* event = region_ptr(current->event);
+      pthread_rwlock_t* stripes = region_ptr(event->stripes);
+      for (size_t j = 0; j < event->num_stripes; j++) pthread_rwlock_destroy(&stripes[j]);
+    }
+    pthread_mutex_destroy(&shards[i].mutex);
   }
-  free(list);
+  pthread_mutex_destroy(&list->seq_mutex);
 }
 
 struct Event* get_event(struct EventList* list, unsigned int event_id) {
   if (!list) return NULL;
 
-  struct ListNode* current = list->head;
+  struct ListNode* current = region_ptr(get_shard(list, event_id)->head);
   while (current) {
-    struct Event* event = current->event;
+    struct Event* event = region_ptr(current->event);
     if (event->id == event_id) {
       return event;
     }
-    current = current->next;
+    current = region_ptr(current->next);
   }
 
   return NULL;
 }
+
+int add_pending(struct EventShard* shard, unsigned int event_id) {
+  unsigned int* pending = region_ptr(shard->pending);
+  for (size_t i = 0; i < shard->num_pending; i++) {
+    if (pending[i] == event_id) return 1;
+  }
+
+  if (shard->num_pending == shard->pending_capacity) {
+    // Region memory is never released, so the old array is simply abandoned
+    size_t capacity = shard->pending_capacity == 0 ? 4 : shard->pending_capacity * 2;
+    unsigned int* grown = region_ptr(region_alloc(sizeof(unsigned int) * capacity));
+    if (!grown) return 1;
+    if (shard->num_pending > 0) memcpy(grown, pending, sizeof(unsigned int) * shard->num_pending);
+    pending = grown;
+    shard->pending = region_offset(grown);
+    shard->pending_capacity = capacity;
+  }
+
+  pending[shard->num_pending++] = event_id;
+  return 0;
+}
+
+void remove_pending(struct EventShard* shard, unsigned int event_id) {
+  unsigned int* pending = region_ptr(shard->pending);
+  for (size_t i = 0; i < shard->num_pending; i++) {
+    if (pending[i] == event_id) {
+      pending[i] = pending[--shard->num_pending];
+      return;
+    }
+  }
+}
@@ -2,49 +2,145 @@
 #define EVENT_LIST_H
 
 #include <stddef.h>
+#include <stdint.h>
 #include <pthread.h>
 
+#define EVENT_MAX_STRIPES 64      // Most row stripes an event can be split into (one bit each in a stripe mask)
+#define EVENT_ROWS_PER_STRIPE 16  // Rows per stripe when the number of stripes is left to create_event
+#define EVENT_TILE_SEATS 4096     // Seats per tile of a seat grid, grids with fewer seats have a single tile
+
+// Every structure below lives in the shared region (see region.h), so links between them are region
+// offsets instead of pointers. An offset of 0 means NULL.
+
+// The rows of an event are split into stripes, each with its own lock, so reservations of rows in
+// different stripes run in parallel. The seats of a row are guarded by the stripe of the row.
+// The seats are split into tiles of EVENT_TILE_SEATS consecutive seats, which are only allocated when one of
+// their seats is first reserved, so creating an event costs the same whatever its size.
 struct Event {
-  unsigned int id;            /// Event id
-  unsigned int reservations;  /// Number of reservations for the event.
+  unsigned int id;                    /// Event id
+  _Atomic unsigned int reservations;  /// Number of reservations for the event.
   size_t cols;  /// Number of columns.
   size_t rows;  /// Number of rows.
-  pthread_rwlock_t rw_lock;  /// Monitor for the event.
-  unsigned int* data;  /// Array of size rows * cols with the reservations for each seat.
+  size_t stripes;      /// Offset of the locks of the stripes, in row order, shared between processes.
+  size_t num_stripes;  /// Number of stripes, at most EVENT_MAX_STRIPES.
+  size_t stripe_rows;  /// Rows of each stripe, the last one may have fewer.
+  size_t data;  /// Offset of the tile directory: the offset of each tile of reservations, 0 while it is all free.
+  unsigned long seq;  /// Order in which the event was added to the list.
 };
 
 struct ListNode {
-  struct Event* event;
-  struct ListNode* next;
+  size_t event;  // Offset of the event
+  size_t next;   // Offset of the next node
 };
 
-// Linked list structure
+// Part of the list holding the events whose id maps to it
+struct EventShard {
+  size_t head;            // Offset of the head of the shard
+  size_t tail;            // Offset of the tail of the shard
+  pthread_mutex_t mutex;  // Mutex for the shard, shared between processes
+  size_t pending;         // Offset of the ids of the events of this shard being created at the moment
+  size_t num_pending;     // Number of ids in pending
+  size_t pending_capacity;  // Capacity of pending
+};
+
+// Linked list structure, split into shards by event id
 struct EventList {
-  struct ListNode* head;  // Head of the list
-  pthread_mutex_t mutex;  // Mutex for the list
-  long id_being_processed;  // Id of the event being processed at the moment
-  struct ListNode* tail;  // Tail of the list
+  size_t shards;              // Offset of the array of shards
+  size_t num_shards;          // Number of shards
+  unsigned long next_seq;     // Sequence number of the next appended event (protected by seq_mutex)
+  pthread_mutex_t seq_mutex;  // Mutex for next_seq
 };
 
-/// Creates a new event list.
+/// Creates a new event list in the shared region.
+/// @param num_shards Number of shards to split the list into.
 /// @return Newly created event list, NULL on failure
-struct EventList* create_list();
+struct EventList* create_list(size_t num_shards);
+
+/// Gets the shard responsible for an event id.
+/// @param list Event list.
+/// @param event_id Event id.
+/// @return Shard where the event is (or would be) stored.
+struct EventShard* get_shard(struct EventList* list, unsigned int event_id);
+
+/// Allocates a new event in the shared region.
+/// @param event_id Event id.
+/// @param num_rows Number of rows.
+/// @param num_cols Number of columns.
+/// @param num_stripes Number of row stripes, 0 for one per EVENT_ROWS_PER_STRIPE rows.
+/// @return Newly created event with every seat free, NULL on failure.
+struct Event* create_event(unsigned int event_id, size_t num_rows, size_t num_cols, size_t num_stripes);
+
+/// Gets a seat of an event for reading.
+/// @param event Event.
+/// @param index Index of the seat.
+/// @return Pointer to the reservation of the seat, into a shared tile of free seats if its tile was never written.
+const unsigned int* event_seat(struct Event* event, size_t index);
+
+/// Gets a seat of an event for writing, allocating its tile if needed.
+/// @note The caller must hold the stripe of the seat for writing. Tiles span several rows, so writers of
+/// different stripes may allocate the same tile: the first one to install it wins.
+/// @param event Event.
+/// @param index Index of the seat.
+/// @return Pointer to the reservation of the seat, NULL on allocation failure.
+unsigned int* event_seat_for_write(struct Event* event, size_t index);
+
+/// Finds the stripes holding a set of rows.
+/// @param event Event.
+/// @param rows Rows, starting at 1, which must exist.
+/// @param count Number of rows.
+/// @return Mask with the bit of each stripe set.
+uint64_t row_stripes(const struct Event* event, const size_t* rows, size_t count);
+
+/// Finds every stripe of an event.
+/// @param event Event.
+/// @return Mask with the bit of every stripe set.
+uint64_t all_stripes(const struct Event* event);
+
+/// Locks a set of stripes of an event for writing. Stripes are always taken in row order, so this cannot
+/// deadlock.
+/// @param event Event to be locked.
+/// @param mask Stripes to be locked.
+void wrlock_stripes(struct Event* event, uint64_t mask);
+
+/// Locks a set of stripes of an event for reading, in row order.
+/// @param event Event to be locked.
+/// @param mask Stripes to be locked.
+void rdlock_stripes(struct Event* event, uint64_t mask);
+
+/// Unlocks a set of stripes of an event.
+/// @param event Event to be unlocked.
+/// @param mask Stripes to be unlocked.
+void unlock_stripes(struct Event* event, uint64_t mask);
 
 /// Appends a new node to the list.
+/// @note The caller must hold the mutex of the event's shard.
 /// @param list Event list to be modified.
 /// @param data Event to be stored in the new node.
 /// @return 0 if the node was appended successfully, 1 otherwise.
 int append_to_list(struct EventList* list, struct Event* data);
 
-/// Removes a node from the list.
-/// @param list Event list to be modified.
-/// @return 0 if the node was removed successfully, 1 otherwise.
+/// Destroys the locks of the list. The memory itself is released with the region.
+/// @param list Event list to be destroyed.
 void free_list(struct EventList* list);
 
 /// Retrieves an event in the list.
+/// @note The caller must hold the mutex of the event's shard.
 /// @param list Event list to be searched
 /// @param event_id Event id.
 /// @return Pointer to the event if found, NULL otherwise.
 struct Event* get_event(struct EventList* list, unsigned int event_id);
 
+/// Marks an event id as being created, so concurrent creates of the same id fail.
+/// @note The caller must hold the mutex of the shard.
+/// @param shard Shard of the event.
+/// @param event_id Event id.
+/// @return 0 if the id was marked, 1 if it was already pending or on allocation failure.
+int add_pending(struct EventShard* shard, unsigned int event_id);
+
+/// Removes the creation mark of an event id.
+/// @note The caller must hold the mutex of the shard.
+/// @param shard Shard of the event.
+/// @param event_id Event id.
+void remove_pending(struct EventShard* shard, unsigned int event_id);
+
 #endif  // EVENT_LIST_H
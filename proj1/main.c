@@ -44,7 +44,20 @@ int main(int argc, char *argv[]) {
     state_access_delay_ms = (unsigned int)delay;
   }
 
-  if (ems_init(state_access_delay_ms)) {
+  size_t num_shards = EVENT_LIST_SHARDS;
+  if (argc > 5) {
+    char *endptr;
+    unsigned long int shards = strtoul(argv[5], &endptr, 10);
+
+    if (*endptr != '\0' || shards == 0) {
+      fprintf(stderr, "Invalid number of shards\n");
+      return 1;
+    }
+
+    num_shards = (size_t)shards;
+  }
+
+  if (ems_init(state_access_delay_ms, num_shards)) {
     fprintf(stderr, "Failed to initialize EMS\n");
     return 1;
   }
@@ -245,7 +258,7 @@ void* thread_function(void* _args){
   int fdW = data->fdW;
 
   unsigned int event_id, delay, thread_id;
-  size_t num_rows, num_columns, num_coords;
+  size_t num_rows, num_columns, num_stripes, num_coords;
   Coordinate coords[MAX_RESERVATION_SIZE];
 
   while (1){
@@ -276,14 +289,14 @@ void* thread_function(void* _args){
     switch (get_next(fdR)) {
       case CMD_CREATE:
    
-        if (parse_create(fdR, &event_id, &num_rows, &num_columns) != 0) {
+        if (parse_create(fdR, &event_id, &num_rows, &num_columns, &num_stripes) != 0) {
           pthread_mutex_unlock(&mutex);
           fprintf(stderr, "Invalid command. See HELP for usage\n");
           continue;
         }
         pthread_mutex_unlock(&mutex);
         
-        if (ems_create(event_id, num_rows, num_columns)) {
+        if (ems_create(event_id, num_rows, num_columns, num_stripes)) {
           fprintf(stderr, "Failed to create event\n"); 
         }
         break;
@@ -369,7 +382,7 @@ void* thread_function(void* _args){
         pthread_mutex_unlock(&mutex);
         printf(
             "Available commands:\n"
-            "  CREATE <event_id> <num_rows> <num_columns>\n"
+            "  CREATE <event_id> <num_rows> <num_columns> [<num_stripes>]\n"
             "  RESERVE <event_id> [(<x1>,<y1>) (<x2>,<y2>) ...]\n"
             "  SHOW <event_id>\n"
             "  LIST\n"
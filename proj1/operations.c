@@ -6,8 +6,10 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include <pthread.h>
+#include <stdatomic.h>
 
 #include "eventlist.h"
+#include "region.h"
 #include "constants.h"
 #include "operations.h"
 #include "parser.h"
@@ -40,11 +42,31 @@ static struct Event* get_event_with_delay(unsigned int event_id) {
 /// @param event Event to get the seat from.
 /// @param index Index of the seat to get.
 /// @return Pointer to the seat.
-static unsigned int* get_seat_with_delay(struct Event* event, size_t index) {
+static const unsigned int* get_seat_with_delay(struct Event* event, size_t index) {
   struct timespec delay = delay_to_timespec(state_access_delay_ms);
   nanosleep(&delay, NULL);  // Should not be removed
 
-  return &event->data[index];
+  return event_seat(event, index);
+}
+
+/// Gets a set of seats from the state to write them, allocating their tiles if needed.
+/// @note Will wait once for the whole set, to simulate a real system accessing a costly memory resource in a
+/// single batch.
+/// @param event Event to get the seats from.
+/// @param indexes Indexes of the seats to get.
+/// @param count Number of seats to get.
+/// @param seats Where to store the pointers to the seats, count of them.
+/// @return 0 if every seat was found, 1 on allocation failure.
+static int get_seats_for_write_with_delay(struct Event* event, const size_t* indexes, size_t count,
+                                          unsigned int** seats) {
+  struct timespec delay = delay_to_timespec(state_access_delay_ms);
+  nanosleep(&delay, NULL);  // Should not be removed
+
+  for (size_t i = 0; i < count; i++) {
+    seats[i] = event_seat_for_write(event, indexes[i]);
+    if (seats[i] == NULL) return 1;
+  }
+  return 0;
 }
 
 /// Gets the index of a seat.
@@ -55,15 +77,19 @@ static unsigned int* get_seat_with_delay(struct Event* event, size_t index) {
 /// @return Index of the seat.
 static size_t seat_index(struct Event* event, size_t row, size_t col) { return (row - 1) * event->cols + col - 1; }
 
-int ems_init(unsigned int delay_ms) {
+int ems_init(unsigned int delay_ms, size_t num_shards) {
   if (event_list != NULL) {
     fprintf(stderr, "EMS state has already been initialized\n");
     return 1;
   }
 
-  event_list = create_list();
-  event_list->mutex = (pthread_mutex_t)PTHREAD_MUTEX_INITIALIZER;
-  event_list->id_being_processed = -1;
+  // The state is mapped before the worker processes are forked, so they all share it
+  if (region_create(SHARED_REGION_SIZE) != 0) {
+    fprintf(stderr, "Error creating shared memory region\n");
+    return 1;
+  }
+
+  event_list = create_list(num_shards);
   state_access_delay_ms = delay_ms;
 
   return event_list == NULL;
@@ -75,62 +101,50 @@ int ems_terminate() {
     return 1;
   }
 
-  free_list(event_list);
+  // Only the process that created the state tears it down, the others just unmap it
+  if (region_is_owner()) {
+    free_list(event_list);
+  }
+  region_destroy();
+  event_list = NULL;
   return 0;
 }
 
-int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
+int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols, size_t num_stripes) {
 
   if (event_list == NULL) {
     fprintf(stderr, "EMS state must be initialized\n");
     
     return 1;
   }
-  pthread_mutex_lock(&event_list->mutex);
-  if (get_event_with_delay(event_id) != NULL || event_list->id_being_processed == event_id) {
+  // Only creates and lookups of events in the same shard contend with this one
+  struct EventShard* shard = get_shard(event_list, event_id);
+  pthread_mutex_lock(&shard->mutex);
+  if (get_event_with_delay(event_id) != NULL || add_pending(shard, event_id) != 0) {
     fprintf(stderr, "Event already exists\n");
-    pthread_mutex_unlock(&event_list->mutex);
+    pthread_mutex_unlock(&shard->mutex);
     return 1;
   }
-  event_list->id_being_processed = event_id;
-  pthread_mutex_unlock(&event_list->mutex);
+  pthread_mutex_unlock(&shard->mutex);
 
-  struct Event* event = malloc(sizeof(struct Event));
+  struct Event* event = create_event(event_id, num_rows, num_cols, num_stripes);
 
   if (event == NULL) {
     fprintf(stderr, "Error allocating memory for event\n");
-    
+    pthread_mutex_lock(&shard->mutex);
+    remove_pending(shard, event_id);
+    pthread_mutex_unlock(&shard->mutex);
     return 1;
   }
 
-  event->id = event_id;
-  event->rows = num_rows;
-  event->cols = num_cols;
-  event->reservations = 0;
-  event->data = malloc(num_rows * num_cols * sizeof(unsigned int));
-  event->rw_lock = (pthread_rwlock_t)PTHREAD_RWLOCK_INITIALIZER;
-  
-  if (event->data == NULL) {
-    fprintf(stderr, "Error allocating memory for event data\n");
-    free(event);
-    
-    return 1;
-  }
-  
-  for (size_t i = 0; i < num_rows * num_cols; i++) {
-    event->data[i] = 0;
-  }
-  pthread_mutex_lock(&event_list->mutex);
+  pthread_mutex_lock(&shard->mutex);
+  remove_pending(shard, event_id);
   if (append_to_list(event_list, event) != 0) {
     fprintf(stderr, "Error appending event to list\n");
-    free(event->data);
-    free(event);
-    event_list->id_being_processed = -1;
-    pthread_mutex_unlock(&event_list->mutex);
+    pthread_mutex_unlock(&shard->mutex);
     return 1;
   }
-  event_list->id_being_processed = -1;
-  pthread_mutex_unlock(&event_list->mutex);
+  pthread_mutex_unlock(&shard->mutex);
 
   return 0;
 }
@@ -141,46 +155,54 @@ int ems_reserve(unsigned int event_id, size_t num_seats, Coordinate* coords) {
     return 1;
   }
   
-  pthread_mutex_lock(&event_list->mutex);
+  struct EventShard* shard = get_shard(event_list, event_id);
+  pthread_mutex_lock(&shard->mutex);
   struct Event* event = get_event_with_delay(event_id);
-  pthread_mutex_unlock(&event_list->mutex);
+  pthread_mutex_unlock(&shard->mutex);
 
   if (event == NULL) {
     fprintf(stderr, "Event not found\n");
     return 1;
   }
 
-  pthread_rwlock_wrlock(&event->rw_lock);
-  unsigned int reservation_id = ++event->reservations;
-  pthread_rwlock_unlock(&event->rw_lock);
-  size_t i = 0;
-  for (; i < num_seats; i++) {
-    size_t row = coords[i].x;
-    size_t col = coords[i].y;
-    if (row <= 0 || row > event->rows || col <= 0 || col > event->cols) {
+  // Rows and columns never change, so the seats are checked before taking any lock
+  size_t rows[MAX_RESERVATION_SIZE];
+  for (size_t i = 0; i < num_seats; i++) {
+    if (coords[i].x <= 0 || coords[i].x > event->rows || coords[i].y <= 0 || coords[i].y > event->cols) {
       fprintf(stderr, "Invalid seat\n");
-      break;
+      return 0;
     }
+    rows[i] = coords[i].x;
+  }
 
-    pthread_rwlock_wrlock(&event->rw_lock);
-  
-    if (*get_seat_with_delay(event, seat_index(event, row, col)) != 0) {
-      fprintf(stderr, "Seat already reserved\n");
-      pthread_rwlock_unlock(&event->rw_lock);
-      break;
-    }
-    *get_seat_with_delay(event, seat_index(event, row, col)) = reservation_id;
-    pthread_rwlock_unlock(&event->rw_lock);  
+  // Only the stripes of the requested rows are locked, so reservations elsewhere in the event carry on
+  uint64_t stripes = row_stripes(event, rows, num_seats);
+  wrlock_stripes(event, stripes);
+
+  // The whole set is fetched in one access, then checked and written under the same locks. Tiles are allocated
+  // before the id is taken, so a failed allocation leaves no gap in the ids
+  size_t indexes[MAX_RESERVATION_SIZE];
+  unsigned int* seats[MAX_RESERVATION_SIZE];
+  for (size_t i = 0; i < num_seats; i++) indexes[i] = seat_index(event, coords[i].x, coords[i].y);
+  if (get_seats_for_write_with_delay(event, indexes, num_seats, seats) != 0) {
+    fprintf(stderr, "Error allocating memory for seats\n");
+    unlock_stripes(event, stripes);
+    return 1;
   }
 
-  if (i < num_seats) {
-    pthread_rwlock_wrlock(&event->rw_lock);
-    event->reservations--; 
-    for (size_t j = 0; j < i; j++) {
-      *get_seat_with_delay(event, seat_index(event, coords[j].x, coords[j].y)) = 0;
+  // The coordinates are sorted, so a seat requested twice shows up next to itself
+  for (size_t i = 0; i < num_seats; i++) {
+    if ((i > 0 && indexes[i] == indexes[i - 1]) || *seats[i] != 0) {
+      fprintf(stderr, "Seat already reserved\n");
+      unlock_stripes(event, stripes);
+      return 0;
     }
-    pthread_rwlock_unlock(&event->rw_lock);
   }
+
+  // Reservations in other stripes take ids too, so the id is only taken once the seats are known to be free
+  unsigned int reservation_id = atomic_fetch_add(&event->reservations, 1) + 1;
+  for (size_t i = 0; i < num_seats; i++) *seats[i] = reservation_id;
+  unlock_stripes(event, stripes);
   return 0;
 }
 
@@ -190,9 +212,10 @@ int ems_show(unsigned int event_id, int fd) {
     
     return 1;
   }
-  pthread_mutex_lock(&event_list->mutex);
+  struct EventShard* shard = get_shard(event_list, event_id);
+  pthread_mutex_lock(&shard->mutex);
   struct Event* event = get_event_with_delay(event_id);
-  pthread_mutex_unlock(&event_list->mutex);
+  pthread_mutex_unlock(&shard->mutex);
 
   if (event == NULL) {
     fprintf(stderr, "Event not found\n");
@@ -209,13 +232,13 @@ int ems_show(unsigned int event_id, int fd) {
   
   size_t buf_iX = 0;
 
-  pthread_rwlock_wrlock(&event->rw_lock);
+  rdlock_stripes(event, all_stripes(event));
   for (size_t i = 1; i <= event->rows; i++) {
     for (size_t j = 1; j <= event->cols; j++) {
-      unsigned int* seat = get_seat_with_delay(event, seat_index(event, i, j));
+      const unsigned int* seat = get_seat_with_delay(event, seat_index(event, i, j));
       if (seat==NULL) {
         fprintf(stderr, "Error getting seat\n");
-        pthread_rwlock_unlock(&event->rw_lock);
+        unlock_stripes(event, all_stripes(event));
         free(buffer);
         return 1;
       }
@@ -229,7 +252,7 @@ int ems_show(unsigned int event_id, int fd) {
         if(temp == NULL){
           fprintf(stderr, "Error allocating memory for buffer\n");
           free(buffer);
-          pthread_rwlock_unlock(&event->rw_lock);
+          unlock_stripes(event, all_stripes(event));
           return 1;
         }
         buffer = temp;
@@ -249,7 +272,7 @@ int ems_show(unsigned int event_id, int fd) {
     buffer[buf_iX] = '\n';
     buf_iX++;
   }
-  pthread_rwlock_unlock(&event->rw_lock);
+  unlock_stripes(event, all_stripes(event));
 
   pthread_mutex_lock(&OutFileWritemutex);
   if(buf_iX > 0){
@@ -268,48 +291,75 @@ int ems_show(unsigned int event_id, int fd) {
 
 
 
+/// Orders events by the sequence in which they were added to the list.
+static int compare_event_seq(const void* a, const void* b) {
+  unsigned long seq_a = (*(struct Event* const*)a)->seq;
+  unsigned long seq_b = (*(struct Event* const*)b)->seq;
+  return (seq_a > seq_b) - (seq_a < seq_b);
+}
+
 int ems_list_events(int fd) {
   if (event_list == NULL) {
     fprintf(stderr, "EMS state must be initialized\n");
     return 1;
   }
 
-  pthread_mutex_lock(&event_list->mutex);
-  struct ListNode* current = event_list->head;
-  if (current == NULL) {
+  // Collects the events of every shard, one shard lock at a time
+  size_t num_events = 0;
+  size_t capacity = 0;
+  struct Event** events = NULL;
+  struct EventShard* shards = region_ptr(event_list->shards);
+  for (size_t s = 0; s < event_list->num_shards; s++) {
+    struct EventShard* shard = &shards[s];
+    pthread_mutex_lock(&shard->mutex);
+    for (struct ListNode* current = region_ptr(shard->head); current != NULL; current = region_ptr(current->next)) {
+      if (num_events == capacity) {
+        capacity = capacity == 0 ? BUF_SIZE / CMD_BUF_SIZE : capacity * 2;
+        struct Event** temp = realloc(events, sizeof(struct Event*) * capacity);
+        if (temp == NULL) {
+          fprintf(stderr, "Error allocating memory for buffer\n");
+          pthread_mutex_unlock(&shard->mutex);
+          free(events);
+          return 1;
+        }
+        events = temp;
+      }
+      events[num_events++] = region_ptr(current->event);
+    }
+    pthread_mutex_unlock(&shard->mutex);
+  }
+
+  if (num_events == 0) {
     char buffer[11]= "No events\n";
     pthread_mutex_lock(&OutFileWritemutex);
     if(safe_write(fd, buffer, strlen(buffer)) == -1){
       fprintf(stderr, "Error writing to file\n");
       pthread_mutex_unlock(&OutFileWritemutex);
-      pthread_mutex_unlock(&event_list->mutex);
       return 1;
     } 
 
     pthread_mutex_unlock(&OutFileWritemutex);
-    pthread_mutex_unlock(&event_list->mutex);
     
     return 0;
   }
-  
-  
-  pthread_mutex_unlock(&event_list->mutex);
-  unsigned int buf_size = BUF_SIZE;
+
+  // Keeps the insertion order of the unsharded list
+  qsort(events, num_events, sizeof(struct Event*), compare_event_seq);
+
+  size_t buf_size = BUF_SIZE;
   char *buffer = malloc(sizeof(char)*buf_size);
  
   if(buffer == NULL){
     fprintf(stderr, "Error allocating memory for buffer\n");
-    
+    free(events);
     return 1;
   }
   
   size_t buf_iX = 0;
-  while (current != NULL) {
+  for (size_t e = 0; e < num_events; e++) {
     char stringToAdd[CMD_BUF_SIZE] = "";
 
-    pthread_mutex_lock(&event_list->mutex);
-    char* eventIdStr = intToString((current->event)->id);    
-    pthread_mutex_unlock(&event_list->mutex);
+    char* eventIdStr = intToString(events[e]->id);
 
     strcpy(stringToAdd, "Event: ");
     strcat(stringToAdd, eventIdStr);
@@ -321,7 +371,8 @@ int ems_list_events(int fd) {
       char* temp = realloc(buffer, buf_size);
       if(temp == NULL){
         fprintf(stderr, "Error allocating memory for buffer\n");
-        free(temp);
+        free(buffer);
+        free(events);
         return 1;
       }
       buffer = temp;
@@ -336,10 +387,8 @@ int ems_list_events(int fd) {
 
     buffer[buf_iX] = '\n';
     buf_iX++;
-    pthread_mutex_lock(&event_list->mutex);
-    current = current->next;
-    pthread_mutex_unlock(&event_list->mutex);
   }
+  free(events);
 
   pthread_mutex_lock(&OutFileWritemutex);
   if(buf_iX > 0){
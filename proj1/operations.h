@@ -31,8 +31,9 @@ void should_thread_wait(unsigned int thread_id);*/
 
 /// Initializes the EMS state.
 /// @param delay_ms State access delay in milliseconds.
+/// @param num_shards Number of shards the event list is split into.
 /// @return 0 if the EMS state was initialized successfully, 1 otherwise.
-int ems_init(unsigned int delay_ms);
+int ems_init(unsigned int delay_ms, size_t num_shards);
 
 /// Destroys the EMS state.
 int ems_terminate();
@@ -41,8 +42,10 @@ int ems_terminate();
 /// @param event_id Id of the event to be created.
 /// @param num_rows Number of rows of the event to be created.
 /// @param num_cols Number of columns of the event to be created.
+/// @param num_stripes Number of row stripes, which reservations of different stripes run in parallel, 0 for the
+/// default (see create_event).
 /// @return 0 if the event was created successfully, 1 otherwise.
-int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols);
+int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols, size_t num_stripes);
 
 /// Creates a new reservation for the given event.
 /// @param event_id Id of the event to create a reservation for.
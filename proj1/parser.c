@@ -134,7 +134,7 @@ enum Command get_next(int fd) {
   }
 }
 
-int parse_create(int fd, unsigned int *event_id, size_t *num_rows, size_t *num_cols) {
+int parse_create(int fd, unsigned int *event_id, size_t *num_rows, size_t *num_cols, size_t *num_stripes) {
   char ch;
 
   if (read_uint(fd, event_id, &ch) != 0 || ch != ' ') {
@@ -150,12 +150,20 @@ int parse_create(int fd, unsigned int *event_id, size_t *num_rows, size_t *num_c
   *num_rows = (size_t)u_num_rows;
 
   unsigned int u_num_cols;
-  if (read_uint(fd, &u_num_cols, &ch) != 0 || (ch != '\n' && ch != '\0')) {
+  if (read_uint(fd, &u_num_cols, &ch) != 0 || (ch != '\n' && ch != '\0' && ch != ' ')) {
     cleanup(fd);
     return 1;
   }
   *num_cols = (size_t)u_num_cols;
 
+  // The number of stripes is optional
+  unsigned int u_num_stripes = 0;
+  if (ch == ' ' && (read_uint(fd, &u_num_stripes, &ch) != 0 || (ch != '\n' && ch != '\0'))) {
+    cleanup(fd);
+    return 1;
+  }
+  *num_stripes = (size_t)u_num_stripes;
+
   return 0;
 }
 
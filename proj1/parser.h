@@ -34,8 +34,9 @@ enum Command get_next(int fd);
 /// @param event_id Pointer to the variable to store the event ID in.
 /// @param num_rows Pointer to the variable to store the number of rows in.
 /// @param num_cols Pointer to the variable to store the number of columns in.
+/// @param num_stripes Pointer to the variable to store the number of row stripes in, 0 if the command has none.
 /// @return 0 if the command was parsed successfully, 1 otherwise.
-int parse_create(int fd, unsigned int *event_id, size_t *num_rows, size_t *num_cols);
+int parse_create(int fd, unsigned int *event_id, size_t *num_rows, size_t *num_cols, size_t *num_stripes);
 
 /// Parses a RESERVE command.
 /// @param fd File descriptor to read from.
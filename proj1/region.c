@@ -0,0 +1,143 @@
+#define _DEFAULT_SOURCE  // MAP_ANONYMOUS and MAP_NORESERVE
+
+#include "region.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define REGION_ALIGNMENT 16
+#define ARENA_CHUNK_SIZE (64UL << 10)  // Size of the chunks thread arenas take from the region
+
+// Header at the start of the region
+struct RegionHeader {
+  pthread_mutex_t mutex;  // Protects used
+  size_t size;            // Size of the region
+  size_t used;            // Bytes already handed out, including the header
+  pid_t owner;            // Process that created the region
+};
+
+static struct RegionHeader* region = NULL;
+
+// Arena of the calling thread, as offsets into the region
+static _Thread_local size_t arena_bump = 0;
+static _Thread_local size_t arena_end = 0;
+
+static _Atomic unsigned long local_allocs = 0;
+static _Atomic unsigned long region_allocs = 0;
+static _Atomic size_t local_bytes = 0;
+
+static size_t align_up(size_t value) { return (value + REGION_ALIGNMENT - 1) & ~(size_t)(REGION_ALIGNMENT - 1); }
+
+int region_create(size_t size) {
+  if (region != NULL || size < sizeof(struct RegionHeader)) return 1;
+
+  void* base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (base == MAP_FAILED) return 1;
+
+  region = base;
+  if (region_mutex_init(&region->mutex) != 0) {
+    munmap(base, size);
+    region = NULL;
+    return 1;
+  }
+  region->size = size;
+  region->used = align_up(sizeof(struct RegionHeader));
+  region->owner = getpid();
+  return 0;
+}
+
+void region_destroy() {
+  if (region == NULL) return;
+
+  if (region_is_owner()) {
+    pthread_mutex_destroy(&region->mutex);
+  }
+  munmap(region, region->size);
+  region = NULL;
+  arena_bump = 0;
+  arena_end = 0;
+}
+
+int region_is_owner() { return region != NULL && region->owner == getpid(); }
+
+size_t region_alloc(size_t size) {
+  if (region == NULL) return 0;
+
+  size = align_up(size);
+
+  pthread_mutex_lock(&region->mutex);
+  if (size > region->size - region->used) {
+    pthread_mutex_unlock(&region->mutex);
+    return 0;
+  }
+  size_t offset = region->used;
+  region->used += size;
+  pthread_mutex_unlock(&region->mutex);
+
+  atomic_fetch_add_explicit(&region_allocs, 1, memory_order_relaxed);
+
+  // Anonymous mappings start zeroed and memory is never reused, so there is nothing to clear
+  return offset;
+}
+
+size_t region_alloc_local(size_t size) {
+  size = align_up(size);
+  if (size == 0) size = REGION_ALIGNMENT;
+
+  size_t offset;
+  if (size > ARENA_CHUNK_SIZE / 4) {
+    // Large seat arrays go straight to the region so they do not waste the rest of the chunk
+    offset = region_alloc(size);
+    if (offset == 0) return 0;
+  } else {
+    if (arena_end - arena_bump < size) {
+      size_t chunk = region_alloc(ARENA_CHUNK_SIZE);
+      if (chunk == 0) return 0;
+      arena_bump = chunk;
+      arena_end = chunk + ARENA_CHUNK_SIZE;
+    }
+    offset = arena_bump;
+    arena_bump += size;
+  }
+
+  atomic_fetch_add_explicit(&local_allocs, 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&local_bytes, size, memory_order_relaxed);
+  return offset;
+}
+
+void region_get_stats(struct RegionStats* stats) {
+  stats->local_allocs = atomic_load_explicit(&local_allocs, memory_order_relaxed);
+  stats->region_allocs = atomic_load_explicit(&region_allocs, memory_order_relaxed);
+  stats->bytes = atomic_load_explicit(&local_bytes, memory_order_relaxed);
+}
+
+void* region_ptr(size_t offset) {
+  if (offset == 0) return NULL;
+  return (char*)region + offset;
+}
+
+size_t region_offset(const void* ptr) {
+  if (ptr == NULL) return 0;
+  return (size_t)((const char*)ptr - (const char*)region);
+}
+
+int region_mutex_init(pthread_mutex_t* mutex) {
+  pthread_mutexattr_t attr;
+  if (pthread_mutexattr_init(&attr) != 0) return 1;
+
+  int ret = pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED) != 0 || pthread_mutex_init(mutex, &attr) != 0;
+  pthread_mutexattr_destroy(&attr);
+  return ret;
+}
+
+int region_rwlock_init(pthread_rwlock_t* rwlock) {
+  pthread_rwlockattr_t attr;
+  if (pthread_rwlockattr_init(&attr) != 0) return 1;
+
+  int ret =
+      pthread_rwlockattr_setpshared(&attr, PTHREAD_PROCESS_SHARED) != 0 || pthread_rwlock_init(rwlock, &attr) != 0;
+  pthread_rwlockattr_destroy(&attr);
+  return ret;
+}
@@ -0,0 +1,66 @@
+#ifndef REGION_H
+#define REGION_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+/// Shared memory region where the EMS state lives.
+/// The region is mapped with MAP_SHARED before the worker processes are forked, so every process
+/// works on the same state. Structures inside the region point to each other through offsets from
+/// the start of the region (0 meaning NULL), so they do not depend on where the region is mapped.
+
+/// Creates the shared region. Must be called before forking.
+/// @param size Size of the region in bytes. Pages are only backed by memory when first used.
+/// @return 0 if the region was created successfully, 1 otherwise.
+int region_create(size_t size);
+
+/// Unmaps the region. The state is only really released once every process has unmapped it.
+void region_destroy();
+
+/// Checks if the calling process created the region.
+/// @return 1 if it did, 0 otherwise.
+int region_is_owner();
+
+/// Allocates memory from the region. The memory is zeroed and is never released individually.
+/// @param size Number of bytes to allocate.
+/// @return Offset of the allocated memory, 0 on failure.
+size_t region_alloc(size_t size);
+
+/// Allocates memory from the arena of the calling thread, which is refilled from the region in chunks.
+/// @note Used for events, list nodes and seat arrays so creates do not contend on the region lock.
+/// @param size Number of bytes to allocate.
+/// @return Offset of the allocated (zeroed) memory, 0 on failure.
+size_t region_alloc_local(size_t size);
+
+// Allocation counters of the calling process
+struct RegionStats {
+  unsigned long local_allocs;  // Allocations served by thread arenas
+  unsigned long region_allocs; // Allocations that took the region lock (including arena refills)
+  size_t bytes;                // Bytes handed out by thread arenas
+};
+
+/// Gets the allocation counters of the calling process.
+/// @param stats Where to store the counters.
+void region_get_stats(struct RegionStats* stats);
+
+/// Converts an offset into a pointer.
+/// @param offset Offset in the region.
+/// @return Pointer to the memory at the given offset, NULL if the offset is 0.
+void* region_ptr(size_t offset);
+
+/// Converts a pointer into the region into an offset.
+/// @param ptr Pointer into the region, may be NULL.
+/// @return Offset of the pointer, 0 if it is NULL.
+size_t region_offset(const void* ptr);
+
+/// Initializes a mutex that can be shared between processes.
+/// @param mutex Mutex inside the region.
+/// @return 0 on success, 1 otherwise.
+int region_mutex_init(pthread_mutex_t* mutex);
+
+/// Initializes a read-write lock that can be shared between processes.
+/// @param rwlock Lock inside the region.
+/// @return 0 on success, 1 otherwise.
+int region_rwlock_init(pthread_rwlock_t* rwlock);
+
+#endif  // REGION_H
@@ -0,0 +1,27 @@
+#ifndef BENCH_BENCH_H
+#define BENCH_BENCH_H
+
+#include <stdint.h>
+#include <time.h>
+
+/// Helpers shared by the benchmarks.
+
+/// Reads a monotonic clock.
+/// @return Current time in seconds.
+static inline double now_s() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/// Advances a xorshift generator, cheap enough not to show up in the timings.
+/// @param state State of the generator, not 0.
+/// @return Next pseudo-random number.
+static inline uint64_t next_random(uint64_t* state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+#endif  // BENCH_BENCH_H
@@ -0,0 +1,124 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "bench/bench.h"
+#include "server/operations.h"
+
+#define ROWS 2000
+#define COLS 500
+#define SEATS_PER_RESERVATION 4  // Divides COLS, so the event fills up completely
+#define SCAN_RESERVATIONS 200    // Reservations placed by copying and scanning the whole grid, which is slow
+#define THREADS 16
+
+static unsigned int event_id;
+
+/// Reserves by copying the grid with SHOW and taking the first run of free seats, as a client would without
+/// RESERVE_BEST.
+static int reserve_by_scan(unsigned int id) {
+  void* show = ems_show(id);
+  if (show == NULL) return 1;
+  int error = *(int*)show;
+  const unsigned int* seats = (const unsigned int*)((char*)show + sizeof(int) + 2 * sizeof(size_t) + sizeof(uint64_t));
+
+  size_t xs[SEATS_PER_RESERVATION], ys[SEATS_PER_RESERVATION];
+  size_t run = 0;
+  for (size_t seat = 0; seat < (size_t)ROWS * COLS && !error; seat++) {
+    run = seat % COLS == 0 || seats[seat] != 0 ? 0 : run;
+    if (seats[seat] != 0) continue;
+    if (++run < SEATS_PER_RESERVATION) continue;
+    for (size_t i = 0; i < SEATS_PER_RESERVATION; i++) {
+      xs[i] = seat / COLS + 1;
+      ys[i] = seat % COLS + 2 - SEATS_PER_RESERVATION + i;
+    }
+    break;
+  }
+  free(show);
+  return error || ems_reserve(id, SEATS_PER_RESERVATION, xs, ys);
+}
+
+static void* best_reserver(void* arg) {
+  size_t* reserved = arg;
+  size_t xs[SEATS_PER_RESERVATION], ys[SEATS_PER_RESERVATION];
+  while (ems_reserve_best(event_id, SEATS_PER_RESERVATION, xs, ys) == 0) {
+    // Every reservation must be a run of adjacent seats of one row
+    for (size_t i = 1; i < SEATS_PER_RESERVATION; i++) {
+      if (xs[i] != xs[0] || ys[i] != ys[0] + i) exit(1);
+    }
+    (*reserved)++;
+  }
+  return NULL;
+}
+
+/// Fills a new event with RESERVE_BEST from several threads, and checks that no seat was given twice.
+/// @return Thousands of reservations per second.
+static double fill(enum ReserveMode mode, size_t* reserved) {
+  ems_set_reserve_mode(mode);
+  event_id++;
+  if (ems_create(event_id, ROWS, COLS, 0) != 0) exit(1);
+
+  pthread_t threads[THREADS];
+  size_t counts[THREADS] = {0};
+  double start = now_s();
+  for (int i = 0; i < THREADS; i++) pthread_create(&threads[i], NULL, best_reserver, &counts[i]);
+  *reserved = 0;
+  for (int i = 0; i < THREADS; i++) {
+    pthread_join(threads[i], NULL);
+    *reserved += counts[i];
+  }
+  double elapsed = now_s() - start;
+
+  // Each reservation has its own id, so the event is full and holds every id exactly SEATS_PER_RESERVATION times
+  void* show = ems_show(event_id);
+  if (show == NULL || *(int*)show != 0) exit(1);
+  const unsigned int* seats = (const unsigned int*)((char*)show + sizeof(int) + 2 * sizeof(size_t) + sizeof(uint64_t));
+  unsigned int* uses = calloc(*reserved + 1, sizeof(unsigned int));
+  if (uses == NULL) exit(1);
+  for (size_t seat = 0; seat < (size_t)ROWS * COLS; seat++) {
+    if (seats[seat] == 0 || seats[seat] > *reserved || ++uses[seats[seat]] > SEATS_PER_RESERVATION) exit(1);
+  }
+  free(uses);
+  free(show);
+
+  ems_delete(event_id);
+  return (double)*reserved / elapsed / 1e3;
+}
+
+int main() {
+  // Full rows and the full event report to stderr, which would dominate the runs
+  if (freopen("/dev/null", "w", stderr) == NULL) return 1;
+  if (ems_init(0, NULL, NULL) != 0) return 1;
+
+  // Front rows fill up first, so later requests skip more and more full rows
+  event_id++;
+  if (ems_create(event_id, ROWS, COLS, 0) != 0) return 1;
+  size_t xs[SEATS_PER_RESERVATION], ys[SEATS_PER_RESERVATION];
+  size_t total = (size_t)ROWS * COLS / SEATS_PER_RESERVATION;
+  double start = now_s();
+  for (size_t r = 0; r < total / 2; r++) {
+    if (ems_reserve_best(event_id, SEATS_PER_RESERVATION, xs, ys) != 0) return 1;
+  }
+  double best = (now_s() - start) / (double)(total / 2);
+
+  start = now_s();
+  for (size_t r = 0; r < SCAN_RESERVATIONS; r++) {
+    if (reserve_by_scan(event_id) != 0) return 1;
+  }
+  double scan = (now_s() - start) / SCAN_RESERVATIONS;
+  ems_delete(event_id);
+
+  printf("%dx%d event, %d adjacent seats per reservation, half full\n", ROWS, COLS, SEATS_PER_RESERVATION);
+  printf("RESERVE_BEST:        %8.2f us/reservation\n", best * 1e6);
+  printf("SHOW, scan, RESERVE: %8.2f us/reservation\n", scan * 1e6);
+
+  printf("filling with %d threads, kreservations/s\n", THREADS);
+  size_t locked_reserved, cas_reserved;
+  double locked = fill(RESERVE_LOCKED, &locked_reserved);
+  double cas = fill(RESERVE_CAS, &cas_reserved);
+  printf("locked %8.1f (%zu/%zu)\ncas    %8.1f (%zu/%zu)\n", locked, locked_reserved, total, cas, cas_reserved, total);
+
+  ems_terminate();
+  return 0;
+}
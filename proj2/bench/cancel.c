@@ -0,0 +1,107 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "bench/bench.h"
+#include "server/operations.h"
+
+#define ROWS 1000
+#define COLS 1000
+#define SEATS_PER_RESERVATION 4  // Divides COLS, so the event fills up completely
+#define RESERVATIONS (ROWS * COLS / SEATS_PER_RESERVATION)
+#define SCAN_CANCELS 200  // Cancels made by copying and scanning the whole grid, which is slow
+#define THREADS 16
+
+static unsigned int event_id = 1;
+
+/// Fills the event with reservations of adjacent seats, numbered in seat order.
+static void fill_event() {
+  size_t xs[SEATS_PER_RESERVATION], ys[SEATS_PER_RESERVATION];
+  for (size_t r = 0; r < RESERVATIONS; r++) {
+    for (size_t i = 0; i < SEATS_PER_RESERVATION; i++) {
+      size_t seat = r * SEATS_PER_RESERVATION + i;
+      xs[i] = seat / COLS + 1;
+      ys[i] = seat % COLS + 1;
+    }
+    if (ems_reserve(event_id, SEATS_PER_RESERVATION, xs, ys) != 0) exit(1);
+  }
+}
+
+/// Finds the seats of a reservation by copying the grid with SHOW and scanning it, as a cancel without the
+/// index would, then frees them with the index.
+static void cancel_by_scan(unsigned int reservation_id) {
+  void* show = ems_show(event_id);
+  if (show == NULL || *(int*)show != 0) exit(1);
+  const unsigned int* seats = (const unsigned int*)((char*)show + sizeof(int) + 2 * sizeof(size_t) + sizeof(uint64_t));
+  size_t found = 0;
+  for (size_t seat = 0; seat < (size_t)ROWS * COLS; seat++) found += seats[seat] == reservation_id;
+  free(show);
+  if (found != SEATS_PER_RESERVATION || ems_cancel(event_id, reservation_id) != 0) exit(1);
+}
+
+static void* canceller(void* arg) {
+  size_t first = (size_t)arg;
+  for (size_t id = first; id <= RESERVATIONS; id += THREADS) {
+    if (ems_cancel(event_id, (unsigned int)id) != 0) exit(1);
+  }
+  return NULL;
+}
+
+/// Counts the taken seats of the event with SHOW.
+static size_t taken_seats() {
+  void* show = ems_show(event_id);
+  if (show == NULL || *(int*)show != 0) exit(1);
+  const unsigned int* seats = (const unsigned int*)((char*)show + sizeof(int) + 2 * sizeof(size_t) + sizeof(uint64_t));
+  size_t taken = 0;
+  for (size_t seat = 0; seat < (size_t)ROWS * COLS; seat++) taken += seats[seat] != 0;
+  free(show);
+  return taken;
+}
+
+int main() {
+  if (freopen("/dev/null", "w", stderr) == NULL) return 1;
+  if (ems_init(0, NULL, NULL) != 0) return 1;
+  if (ems_create(event_id, ROWS, COLS, 0) != 0) return 1;
+  fill_event();
+
+  // The first cancel builds the index from the seats, the others only read the seats of their reservation
+  double start = now_s();
+  if (ems_cancel(event_id, 1) != 0) return 1;
+  double build = now_s() - start;
+
+  start = now_s();
+  for (unsigned int id = 2; id < 2 + SCAN_CANCELS; id++) cancel_by_scan(id);
+  double scan = (now_s() - start) / SCAN_CANCELS;
+
+  // Reservations made after the index was built are added to it, so they can be cancelled too
+  size_t xs[SEATS_PER_RESERVATION], ys[SEATS_PER_RESERVATION];
+  for (size_t i = 0; i < SEATS_PER_RESERVATION; i++) {
+    xs[i] = 1;
+    ys[i] = i + 1;
+  }
+  if (ems_reserve(event_id, SEATS_PER_RESERVATION, xs, ys) != 0 || ems_cancel(event_id, RESERVATIONS + 1) != 0) {
+    return 1;
+  }
+
+  // The rest, from several threads
+  pthread_t threads[THREADS];
+  start = now_s();
+  for (size_t i = 0; i < THREADS; i++) {
+    pthread_create(&threads[i], NULL, canceller, (void*)(2 + SCAN_CANCELS + i));
+  }
+  for (size_t i = 0; i < THREADS; i++) pthread_join(threads[i], NULL);
+  double indexed = now_s() - start;
+  size_t cancelled = RESERVATIONS - 1 - SCAN_CANCELS;
+  if (taken_seats() != 0) return 1;
+
+  printf("%dx%d event, %d reservations of %d seats\n", ROWS, COLS, RESERVATIONS, SEATS_PER_RESERVATION);
+  printf("first cancel, building the index: %.1f ms\n", build * 1e3);
+  printf("cancel by scanning a SHOW copy: %.1f us per cancel\n", scan * 1e6);
+  printf("cancel with the index: %zu from %d threads, %.0f kcancels/s (%.1f us per cancel per thread)\n", cancelled,
+         THREADS, (double)cancelled / indexed / 1e3, indexed / (double)cancelled * THREADS * 1e6);
+
+  ems_terminate();
+  return 0;
+}
@@ -0,0 +1,99 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bench/bench.h"
+#include "server/operations.h"
+
+#define ROWS 4  // Few rows, so every reservation wants the same stripes
+#define COLS 4096
+#define THREADS 64
+#define RESERVES_PER_THREAD 400
+#define MAX_SEATS 4  // Seats of a reservation, 1 to MAX_SEATS of them
+
+/// Counts the taken seats of an event with SHOW.
+static size_t taken_seats(unsigned int event_id, size_t num_seats) {
+  void* show = ems_show(event_id);
+  if (show == NULL || *(int*)show != 0) exit(1);
+  const unsigned int* seats = (const unsigned int*)((char*)show + sizeof(int) + 2 * sizeof(size_t) + sizeof(uint64_t));
+  size_t taken = 0;
+  for (size_t seat = 0; seat < num_seats; seat++) taken += seats[seat] != 0;
+  free(show);
+  return taken;
+}
+
+static int compare_doubles(const void* a, const void* b) {
+  double x = *(const double*)a, y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+static unsigned int event_id;
+static double latencies[THREADS * RESERVES_PER_THREAD];
+static unsigned long booked_seats[THREADS];
+
+// Reserves 1 to MAX_SEATS random seats of the event at a time, some of them already taken by other threads
+static void* reserver(void* arg) {
+  size_t thread = (size_t)arg;
+  uint64_t state = 88172645463325252ull + thread * 7919;
+  size_t xs[MAX_SEATS], ys[MAX_SEATS];
+
+  for (size_t r = 0; r < RESERVES_PER_THREAD; r++) {
+    size_t num_seats = 1 + next_random(&state) % MAX_SEATS;
+    for (size_t i = 0; i < num_seats; i++) {
+      int repeated = 1;
+      while (repeated) {
+        uint64_t seat = next_random(&state);
+        xs[i] = seat % ROWS + 1;
+        ys[i] = (seat >> 32) % COLS + 1;
+        repeated = 0;
+        for (size_t j = 0; j < i && !repeated; j++) repeated = xs[j] == xs[i] && ys[j] == ys[i];
+      }
+    }
+    double start = now_s();
+    int error = ems_reserve(event_id, num_seats, xs, ys);
+    latencies[thread * RESERVES_PER_THREAD + r] = now_s() - start;
+    if (!error) booked_seats[thread] += num_seats;
+  }
+  return NULL;
+}
+
+/// Runs the reservers on a fresh event, with or without flat combining.
+/// @return Whether the taken seats of the event are those the threads booked.
+static int run(int combining) {
+  ems_set_combining(combining);
+  event_id++;
+  if (ems_create(event_id, ROWS, COLS, 0) != 0) exit(1);
+  memset(booked_seats, 0, sizeof(booked_seats));
+
+  pthread_t threads[THREADS];
+  double start = now_s();
+  for (size_t i = 0; i < THREADS; i++) pthread_create(&threads[i], NULL, reserver, (void*)i);
+  for (size_t i = 0; i < THREADS; i++) pthread_join(threads[i], NULL);
+  double elapsed = now_s() - start;
+
+  unsigned long booked = 0;
+  for (size_t i = 0; i < THREADS; i++) booked += booked_seats[i];
+  size_t taken = taken_seats(event_id, ROWS * COLS);
+  size_t count = THREADS * RESERVES_PER_THREAD;
+  qsort(latencies, count, sizeof(double), compare_doubles);
+  printf("%-10s %14.1f %12.1f %12.1f %10zu%s\n", combining ? "combining" : "stripes", (double)count / elapsed / 1e3,
+         latencies[count / 2] * 1e6, latencies[count * 99 / 100] * 1e6, taken,
+         taken == booked ? "" : " (taken seats differ from the booked ones)");
+  return taken == booked;
+}
+
+int main() {
+  if (freopen("/dev/null", "w", stderr) == NULL) return 1;
+  if (ems_init(0, NULL, NULL) != 0) return 1;
+
+  printf("%d threads reserving 1-%d random seats of one %dx%d event, %d reservations each\n", THREADS, MAX_SEATS, ROWS,
+         COLS, RESERVES_PER_THREAD);
+  printf("%-10s %14s %12s %12s %10s\n", "", "kreserves/s", "p50 (us)", "p99 (us)", "taken");
+  int consistent = run(0) & run(1);
+
+  ems_terminate();
+  return consistent ? 0 : 1;
+}
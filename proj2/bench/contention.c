@@ -0,0 +1,83 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "bench/bench.h"
+#include "server/alloc.h"
+#include "server/epoch.h"
+#include "server/eventlist.h"
+
+#define NUM_EVENTS 1000
+#define LOOKUPS_PER_THREAD 2000000
+
+static struct EventList* list;
+static int use_epoch;
+
+static void* reader(void* arg) {
+  uint64_t state = (uint64_t)(uintptr_t)arg * 2654435761u + 1;
+  size_t found = 0;
+
+  for (size_t i = 0; i < LOOKUPS_PER_THREAD; i++) {
+    unsigned int id = (unsigned int)(next_random(&state) % NUM_EVENTS) + 1;
+
+    // Same pattern as ems_reserve/ems_show before and after the epoch read path
+    if (use_epoch) {
+      if (epoch_enter() != 0) continue;
+      found += get_event(list, id) != NULL;
+      epoch_exit();
+    } else {
+      pthread_rwlock_rdlock(&list->rwl);
+      found += get_event(list, id) != NULL;
+      pthread_rwlock_unlock(&list->rwl);
+    }
+  }
+
+  return (void*)found;
+}
+
+/// Runs the lookup loop on the given number of threads.
+/// @return Millions of lookups per second.
+static double run(int num_threads) {
+  pthread_t threads[num_threads];
+  double start = now_s();
+  for (int i = 0; i < num_threads; i++) {
+    pthread_create(&threads[i], NULL, reader, (void*)(uintptr_t)(i + 1));
+  }
+  for (int i = 0; i < num_threads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  double elapsed = now_s() - start;
+  return (double)num_threads * LOOKUPS_PER_THREAD / elapsed / 1e6;
+}
+
+int main() {
+  list = create_list();
+  if (!list) return 1;
+
+  for (unsigned int id = 1; id <= NUM_EVENTS; id++) {
+    struct Event* event = create_event(id, 1, 1, 0);
+    if (!event) return 1;
+    pthread_rwlock_wrlock(&list->rwl);
+    append_to_list(list, event);
+    list->num_events++;
+    pthread_rwlock_unlock(&list->rwl);
+  }
+
+  int thread_counts[] = {1, 4, 16, 64};
+  printf("%8s %16s %16s\n", "threads", "rwlock Mops/s", "epoch Mops/s");
+  for (size_t i = 0; i < sizeof(thread_counts) / sizeof(int); i++) {
+    use_epoch = 0;
+    double rwlock = run(thread_counts[i]);
+    use_epoch = 1;
+    double epoch = run(thread_counts[i]);
+    printf("%8d %16.1f %16.1f\n", thread_counts[i], rwlock, epoch);
+  }
+
+  free_list(list);
+  free(list);
+  epoch_drain();
+  alloc_release_all();
+  return 0;
+}
@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "bench/bench.h"
+#include "server/alloc.h"
+#include "server/epoch.h"
+#include "server/eventlist.h"
+#include "server/seatgrid.h"
+
+#define NUM_EVENTS 200000
+#define ROWS 10
+#define COLS 20
+#define VENUES 20           // Very large events, created after the small ones
+#define VENUE_ROWS 100000
+#define VENUE_COLS 1000
+#define VENUE_RESERVATIONS 1000  // Seats reserved in each venue, spread over its rows
+
+int main() {
+  struct EventList* list = create_list();
+  if (!list) return 1;
+
+  double start = now_s();
+  for (unsigned int id = 1; id <= NUM_EVENTS; id++) {
+    struct Event* event = create_event(id, ROWS, COLS, 0);
+    if (!event || append_to_list(list, event) != 0) return 1;
+    list->num_events++;
+  }
+  double elapsed = now_s() - start;
+
+  struct AllocStats stats;
+  alloc_get_stats(&stats);
+  printf("%d creates of %dx%d events in %.3f s (%.0f ns/create)\n", NUM_EVENTS, ROWS, COLS, elapsed,
+         elapsed * 1e9 / NUM_EVENTS);
+  printf("slab allocs %lu from %lu blocks, arena allocs %lu from %lu chunks (%zu bytes)\n", stats.slab_allocs,
+         stats.slab_blocks, stats.arena_allocs, stats.arena_chunks, stats.arena_bytes);
+  printf("mallocs per create: %.4f\n", (double)(stats.slab_blocks + stats.arena_chunks) / NUM_EVENTS);
+
+  // Venues only get the tiles of the seats that are reserved
+  size_t bytes_before = stats.arena_bytes;
+  start = now_s();
+  for (unsigned int id = NUM_EVENTS + 1; id <= NUM_EVENTS + VENUES; id++) {
+    struct Event* event = create_event(id, VENUE_ROWS, VENUE_COLS, 0);
+    if (!event || append_to_list(list, event) != 0) return 1;
+    list->num_events++;
+  }
+  elapsed = now_s() - start;
+  alloc_get_stats(&stats);
+  size_t created_bytes = stats.arena_bytes - bytes_before;
+
+  size_t used_tiles = 0;
+  for (unsigned int id = NUM_EVENTS + 1; id <= NUM_EVENTS + VENUES; id++) {
+    struct Event* event = get_event(list, id);
+    for (size_t r = 0; r < VENUE_RESERVATIONS; r++) {
+      size_t seat = r * (VENUE_ROWS / VENUE_RESERVATIONS) * VENUE_COLS + r % VENUE_COLS;
+      if (seatgrid_materialize(event->data, event->width, VENUE_ROWS * VENUE_COLS, &seat, 1) != 0) return 1;
+      seatgrid_set(event->data, event->width, seat, (unsigned int)r % 255 + 1);
+    }
+    used_tiles += seatgrid_used_tiles(event->data, VENUE_ROWS * VENUE_COLS);
+  }
+  alloc_get_stats(&stats);
+  printf("%d creates of %dx%d events in %.3f ms (%.1f us/create), %.1f MB each\n", VENUES, VENUE_ROWS, VENUE_COLS,
+         elapsed * 1e3, elapsed * 1e6 / VENUES, (double)created_bytes / VENUES / 1e6);
+  printf("after %d reservations each: %zu of %zu tiles allocated, %.1f MB each\n", VENUE_RESERVATIONS,
+         used_tiles / VENUES, seatgrid_tiles(VENUE_ROWS * VENUE_COLS),
+         (double)(stats.arena_bytes - bytes_before) / VENUES / 1e6);
+
+  free_list(list);
+  free(list);
+  epoch_drain();
+  alloc_release_all();
+  return 0;
+}
@@ -0,0 +1,109 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "bench/bench.h"
+#include "server/holds.h"
+#include "server/operations.h"
+#include "server/timerwheel.h"
+
+#define ROWS 1000
+#define COLS 1000         // One hold per seat, ROWS * COLS of them
+#define THREADS 16
+#define HOLD_SECONDS 8    // Longer than it takes to make the holds, so they are all outstanding at once
+#define WHEEL_TICKS 6000  // Ten minutes of HOLDS_TICK_MS ticks, the spread of the timers in the wheel runs
+
+static unsigned int event_id = 1;
+
+static void* holder(void* arg) {
+  size_t first_row = (size_t)arg;
+  unsigned int hold_id;
+  for (size_t row = first_row; row <= ROWS; row += THREADS) {
+    for (size_t col = 1; col <= COLS; col++) {
+      if (ems_hold(event_id, HOLD_SECONDS, 1, &row, &col, &hold_id) != 0) exit(1);
+    }
+  }
+  return NULL;
+}
+
+/// Counts the taken seats of the event with SHOW.
+static size_t taken_seats() {
+  void* show = ems_show(event_id);
+  if (show == NULL || *(int*)show != 0) exit(1);
+  const unsigned int* seats = (const unsigned int*)((char*)show + sizeof(int) + 2 * sizeof(size_t) + sizeof(uint64_t));
+  size_t taken = 0;
+  for (size_t seat = 0; seat < (size_t)ROWS * COLS; seat++) taken += seats[seat] != 0;
+  free(show);
+  return taken;
+}
+
+/// Runs a wheel with timers spread evenly over WHEEL_TICKS ticks until they all expire.
+/// @param count Number of timers.
+/// @param idle_ns Where to store the cost of a tick with nothing due, in nanoseconds.
+/// @return Nanoseconds per expired timer.
+static double run_wheel(size_t count, double* idle_ns) {
+  struct TimerEntry* entries = calloc(count, sizeof(struct TimerEntry));
+  if (entries == NULL) exit(1);
+  struct TimerWheel* wheel = malloc(sizeof(struct TimerWheel));
+  if (wheel == NULL) exit(1);
+  timerwheel_init(wheel, 0);
+  // Far enough that they all go to the top levels and cascade down on the way
+  for (size_t i = 0; i < count; i++) timerwheel_add(wheel, &entries[i], WHEEL_TICKS + i % WHEEL_TICKS);
+
+  // Ticks that neither cascade nor expire anything, whatever the number of timers waiting
+  double start = now_s();
+  for (uint64_t tick = 1; tick < 64; tick++) {
+    if (timerwheel_advance(wheel, tick) != NULL) exit(1);
+  }
+  *idle_ns = (now_s() - start) / 63 * 1e9;
+
+  size_t expired = 0;
+  start = now_s();
+  for (uint64_t tick = 64; tick < 2 * WHEEL_TICKS; tick++) {
+    for (struct TimerEntry* entry = timerwheel_advance(wheel, tick); entry != NULL; entry = entry->next) expired++;
+  }
+  double elapsed = now_s() - start;
+  if (expired != count) exit(1);
+
+  free(wheel);
+  free(entries);
+  return elapsed / (double)count * 1e9;
+}
+
+int main() {
+  if (freopen("/dev/null", "w", stderr) == NULL) return 1;
+  if (ems_init(0, NULL, NULL) != 0) return 1;
+  if (ems_create(event_id, ROWS, COLS, 0) != 0) return 1;
+
+  // Every seat is held by its own hold
+  pthread_t threads[THREADS];
+  double start = now_s();
+  for (size_t i = 0; i < THREADS; i++) pthread_create(&threads[i], NULL, holder, (void*)(i + 1));
+  for (size_t i = 0; i < THREADS; i++) pthread_join(threads[i], NULL);
+  double held = now_s() - start;
+  size_t outstanding = holds_count();
+  size_t taken = taken_seats();
+
+  // The expiry thread frees them all once their time is up, the last ones HOLD_SECONDS after the holds were made
+  while (holds_count() > 0 || taken_seats() != 0) {
+    struct timespec delay = {0, 1000000};
+    nanosleep(&delay, NULL);
+  }
+  double late = now_s() - start - held - HOLD_SECONDS;
+
+  printf("%d holds from %d threads: %.0f kholds/s, %zu outstanding, %zu seats taken\n", ROWS * COLS, THREADS,
+         (double)ROWS * COLS / held / 1e3, outstanding, taken);
+  printf("last hold freed %.0f ms after it was due (%d ms ticks)\n", late * 1e3, HOLDS_TICK_MS);
+
+  printf("timer wheel, timers spread over %d ticks: ns per idle tick, ns per expired timer\n", WHEEL_TICKS);
+  for (size_t count = 1000; count <= 10000000; count *= 100) {
+    double idle;
+    double per_timer = run_wheel(count, &idle);
+    printf("%8zu timers %8.1f %8.1f\n", count, idle, per_timer);
+  }
+
+  ems_terminate();
+  return 0;
+}
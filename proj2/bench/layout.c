@@ -0,0 +1,195 @@
+#define _DEFAULT_SOURCE  // syscall
+
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench/bench.h"
+#include "server/alloc.h"
+#include "server/epoch.h"
+#include "server/eventlist.h"
+#include "server/seatgrid.h"
+#include "server/seatmap.h"
+
+#define ROWS 4096
+#define COLS 64
+#define STRIPES 64
+#define RESERVATIONS 400000  // Single seats, split between the threads
+#define LARGE_ROWS 4096      // Event whose grid is large enough for huge pages, 64 MiB of 4-byte ids
+#define LARGE_COLS 4096
+#define LARGE_READS 20000000  // Seats read at random from the large grid
+
+static struct Event* event;
+static size_t per_thread;
+static size_t rows_per_thread;
+
+// Counters of the whole process, -1 if the kernel or the machine does not have them
+static int cache_misses_fd = -1;
+static int page_faults_fd = -1;
+
+/// Opens a counter of the calling process and the threads it creates afterwards.
+/// @return File descriptor of the counter, -1 if it is not available.
+static int open_counter(uint32_t type, uint64_t config) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.inherit = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/// Reads a counter.
+/// @return Value of the counter, 0 if it is not available.
+static uint64_t read_counter(int fd) {
+  uint64_t value = 0;
+  if (fd < 0 || read(fd, &value, sizeof(value)) != sizeof(value)) return 0;
+  return value;
+}
+
+// Hot path of a lock-free reservation, each thread in the rows of its own stripes: every write touches the
+// stripe counters and the counters of the event, and reads the read-mostly fields next to them
+static void* reserver(void* arg) {
+  size_t first_row = (size_t)(uintptr_t)arg * rows_per_thread;
+
+  for (size_t r = 0; r < per_thread; r++) {
+    size_t row = first_row + r / COLS % rows_per_thread + 1;
+    size_t seat = (row - 1) * COLS + r % COLS;
+    uint64_t stripes = row_stripes(event, &row, 1);
+
+    begin_seat_writes(event, stripes);
+    if (!seatmap_any_set(event->occupied, &seat, 1)) {
+      unsigned int reservation_id = atomic_fetch_add(&event->reservations, 1) + 1;
+      seatgrid_set(event->data, event->width, seat, reservation_id);
+    }
+    atomic_fetch_add_explicit(&event->version, 1, memory_order_relaxed);
+    end_seat_writes(event, stripes);
+  }
+  return NULL;
+}
+
+/// Runs the reservers on a fresh event.
+/// @param num_threads Number of threads.
+/// @param misses Where to store the cache misses per reservation, negative if they cannot be counted.
+/// @return Millions of reservations per second.
+static double run_reservers(int num_threads, double* misses) {
+  event = create_event(1, ROWS, COLS, STRIPES);
+  if (!event || widen_seats(event, UINT32_MAX) != 0) exit(1);
+  size_t seats[ROWS];
+  for (size_t first = 0; first < ROWS * COLS; first += ROWS) {
+    for (size_t row = 0; row < ROWS; row++) seats[row] = first + row;
+    if (seatgrid_materialize(event->data, event->width, ROWS * COLS, seats, ROWS) != 0) exit(1);
+  }
+  per_thread = RESERVATIONS / (size_t)num_threads;
+  rows_per_thread = ROWS / (size_t)num_threads;
+
+  pthread_t threads[num_threads];
+  uint64_t misses_before = read_counter(cache_misses_fd);
+  double start = now_s();
+  for (int i = 0; i < num_threads; i++) pthread_create(&threads[i], NULL, reserver, (void*)(uintptr_t)i);
+  for (int i = 0; i < num_threads; i++) pthread_join(threads[i], NULL);
+  double elapsed = now_s() - start;
+  uint64_t misses_after = read_counter(cache_misses_fd);
+
+  size_t reserved = per_thread * (size_t)num_threads;
+  *misses = cache_misses_fd < 0 ? -1 : (double)(misses_after - misses_before) / (double)reserved;
+  free_event(event);
+  return (double)reserved / elapsed / 1e6;
+}
+
+/// Reads the anonymous memory of the process backed by huge pages.
+/// @return Kilobytes in huge pages, 0 if the kernel does not report them.
+static size_t huge_page_kb() {
+  FILE* file = fopen("/proc/self/smaps_rollup", "r");
+  if (file == NULL) return 0;
+  char line[256];
+  size_t kb = 0;
+  while (fgets(line, sizeof(line), file) != NULL) {
+    if (sscanf(line, "AnonHugePages: %zu kB", &kb) == 1) break;
+  }
+  fclose(file);
+  return kb;
+}
+
+/// Fills a large grid and reads its seats at random, with or without huge pages.
+/// @param huge Whether arena chunks use huge pages.
+static void run_large(int huge) {
+  alloc_set_huge_pages(huge);
+  size_t huge_before = huge_page_kb();
+  uint64_t faults_before = read_counter(page_faults_fd);
+  double start = now_s();
+
+  struct Event* large = create_event(1, LARGE_ROWS, LARGE_COLS, 0);
+  if (!large || widen_seats(large, UINT32_MAX) != 0) exit(1);
+  size_t num_seats = (size_t)LARGE_ROWS * LARGE_COLS;
+  for (size_t seat = 0; seat < num_seats; seat++) {
+    if (seatgrid_materialize(large->data, large->width, num_seats, &seat, 1) != 0) exit(1);
+    seatgrid_set(large->data, large->width, seat, (unsigned int)seat + 1);
+  }
+  double fill = now_s() - start;
+  uint64_t faults = read_counter(page_faults_fd) - faults_before;
+  size_t huge_kb = huge_page_kb() - huge_before;
+
+  // Random reads miss the TLB on almost every seat unless the grid sits in huge pages
+  uint64_t state = 88172645463325252ull;
+  unsigned long sum = 0;
+  start = now_s();
+  for (size_t i = 0; i < LARGE_READS; i++) {
+    sum += seatgrid_get(large->data, large->width, next_random(&state) % num_seats);
+  }
+  double read = (now_s() - start) / LARGE_READS * 1e9;
+  if (sum == 0) exit(1);
+
+  printf("%-12s %10.1f %12lu %14zu %14.1f\n", huge ? "huge pages" : "small pages", fill * 1e3,
+         (unsigned long)faults, huge_kb, read);
+  retire_event(large);
+  epoch_drain();
+  alloc_release_all();
+}
+
+int main() {
+  // The list is only created for the allocators of the events
+  struct EventList* list = create_list();
+  if (!list) return 1;
+  seatmap_select(SEATMAP_AUTO);
+  cache_misses_fd = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+  page_faults_fd = open_counter(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS);
+
+  printf("sizeof(struct Event) %zu, sizeof(struct EventStripe) %zu, %ld CPUs\n", sizeof(struct Event),
+         sizeof(struct EventStripe), sysconf(_SC_NPROCESSORS_ONLN));
+  if (cache_misses_fd < 0) printf("no hardware cache miss counter on this machine\n");
+
+  printf("%dx%d event, %d stripes, lock-free writes of single seats\n", ROWS, COLS, STRIPES);
+  printf("%8s %14s %20s\n", "threads", "Mwrites/s", "cache misses/write");
+  int thread_counts[] = {1, 4, 16};
+  for (size_t t = 0; t < sizeof(thread_counts) / sizeof(int); t++) {
+    double misses;
+    double rate = run_reservers(thread_counts[t], &misses);
+    if (misses < 0) {
+      printf("%8d %14.1f %20s\n", thread_counts[t], rate, "n/a");
+    } else {
+      printf("%8d %14.1f %20.2f\n", thread_counts[t], rate, misses);
+    }
+  }
+
+  printf("%dx%d event with 4-byte ids, filled seat by seat, then %d random reads\n", LARGE_ROWS, LARGE_COLS,
+         LARGE_READS);
+  printf("%-12s %10s %12s %14s %14s\n", "", "fill ms", "page faults", "huge page kB", "ns per read");
+  run_large(0);
+  run_large(1);
+
+  epoch_drain();
+  free_list(list);
+  free(list);
+  alloc_release_all();
+  return 0;
+}
@@ -0,0 +1,62 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "bench/bench.h"
+#include "server/alloc.h"
+#include "server/epoch.h"
+#include "server/eventlist.h"
+
+#define NUM_LOOKUPS 1000000
+
+static double now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/// Builds a list with num_events events and measures the average get_event latency.
+/// @param num_events Number of events in the list.
+/// @param sparse If set, ids are random instead of 1..num_events.
+/// @return Average nanoseconds per lookup, negative on failure.
+static double bench(size_t num_events, int sparse) {
+  struct EventList* list = create_list();
+  unsigned int* ids = malloc(num_events * sizeof(unsigned int));
+  if (!list || !ids) return -1;
+
+  uint64_t state = 88172645463325252ull;
+  for (size_t i = 0; i < num_events; i++) {
+    unsigned int id = sparse ? (unsigned int)(next_random(&state) >> 16) : (unsigned int)i + 1;
+    while (sparse && get_event(list, id) != NULL) id = (unsigned int)(next_random(&state) >> 16);
+    struct Event* event = create_event(id, 1, 1, 0);
+    if (!event) return -1;
+    ids[i] = id;
+    if (append_to_list(list, event) != 0) return -1;
+    list->num_events++;
+  }
+
+  size_t found = 0;
+  double start = now_ns();
+  for (size_t i = 0; i < NUM_LOOKUPS; i++) {
+    found += get_event(list, ids[(unsigned int)(next_random(&state) >> 16) % num_events]) != NULL;
+  }
+  double elapsed = now_ns() - start;
+
+  if (found != NUM_LOOKUPS) fprintf(stderr, "lookup missed %zu events\n", NUM_LOOKUPS - found);
+
+  free_list(list);
+  free(list);
+  free(ids);
+  epoch_drain();
+  alloc_release_all();
+  return elapsed / NUM_LOOKUPS;
+}
+
+int main() {
+  printf("%10s %14s %14s\n", "events", "dense ns/op", "sparse ns/op");
+  for (size_t n = 10; n <= 1000000; n *= 10) {
+    printf("%10zu %14.1f %14.1f\n", n, bench(n, 0), bench(n, 1));
+  }
+  return 0;
+}
@@ -0,0 +1,159 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bench/bench.h"
+#include "common/constants.h"
+#include "server/operations.h"
+
+#define ROWS 1000
+#define COLS 1000
+#define BUNDLES 2000  // Bundles timed per size, each cancelled before the next one
+
+#define SMALL_EVENTS 6   // Events the threads book bundles of, small so bundles often collide
+#define SMALL_ROWS 40
+#define SMALL_COLS 40
+#define THREADS 16
+#define BUNDLES_PER_THREAD 4000
+
+/// Picks distinct seats of a row-major grid, the same ones for every event of a bundle.
+static void pick_seats(uint64_t* state, size_t rows, size_t cols, size_t num_events, size_t num_seats, size_t* xs,
+                       size_t* ys) {
+  for (size_t i = 0; i < num_seats; i++) {
+    int repeated = 1;
+    while (repeated) {
+      uint64_t r = next_random(state);
+      xs[i] = r % rows + 1;
+      ys[i] = (r >> 32) % cols + 1;
+      repeated = 0;
+      for (size_t j = 0; j < i && !repeated; j++) repeated = xs[j] == xs[i] && ys[j] == ys[i];
+    }
+  }
+  for (size_t e = 1; e < num_events; e++) {
+    memcpy(xs + e * num_seats, xs, num_seats * sizeof(size_t));
+    memcpy(ys + e * num_seats, ys, num_seats * sizeof(size_t));
+  }
+}
+
+/// Counts the taken seats of an event with SHOW.
+static size_t taken_seats(unsigned int event_id, size_t num_seats) {
+  void* show = ems_show(event_id);
+  if (show == NULL || *(int*)show != 0) exit(1);
+  const unsigned int* seats = (const unsigned int*)((char*)show + sizeof(int) + 2 * sizeof(size_t) + sizeof(uint64_t));
+  size_t taken = 0;
+  for (size_t seat = 0; seat < num_seats; seat++) taken += seats[seat] != 0;
+  free(show);
+  return taken;
+}
+
+static unsigned long booked_seats[THREADS];
+static unsigned long booked_bundles[THREADS];
+
+// Books bundles of 2 to 4 of the small events, in random order, each with the same 1 to 4 random seats
+static void* booker(void* arg) {
+  size_t thread = (size_t)arg;
+  uint64_t state = 88172645463325252ull + thread * 7919;
+  unsigned int event_ids[SMALL_EVENTS];
+  size_t num_seats[SMALL_EVENTS];
+  size_t xs[SMALL_EVENTS * 4], ys[SMALL_EVENTS * 4];
+
+  for (int b = 0; b < BUNDLES_PER_THREAD; b++) {
+    size_t num_events = 2 + next_random(&state) % 3;
+    size_t seats = 1 + next_random(&state) % 4;
+    unsigned int first = (unsigned int)(next_random(&state) % SMALL_EVENTS);
+    for (size_t e = 0; e < num_events; e++) {
+      event_ids[e] = 100 + (first + (unsigned int)e * 5) % SMALL_EVENTS;
+      num_seats[e] = seats;
+    }
+    pick_seats(&state, SMALL_ROWS, SMALL_COLS, num_events, seats, xs, ys);
+    if (ems_reserve_multi(num_events, event_ids, num_seats, xs, ys) == 0) {
+      booked_seats[thread] += num_events * seats;
+      booked_bundles[thread]++;
+    }
+  }
+  return NULL;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc > 1 && strcmp(argv[1], "cas") == 0) ems_set_reserve_mode(RESERVE_CAS);
+  if (freopen("/dev/null", "w", stderr) == NULL) return 1;
+  if (ems_init(0, NULL, NULL) != 0) return 1;
+  for (unsigned int id = 1; id <= MAX_MULTI_EVENTS; id++) {
+    if (ems_create(id, ROWS, COLS, 0) != 0) return 1;
+  }
+
+  printf("%s mode, %dx%d events, RESERVE_MULTI against one RESERVE per event (not atomic)\n",
+         argc > 1 && strcmp(argv[1], "cas") == 0 ? "cas" : "lock", ROWS, COLS);
+  printf("%8s %8s %14s %14s %16s\n", "events", "seats", "multi (us)", "reserves (us)", "multi ns/seat");
+
+  size_t event_counts[] = {2, MAX_MULTI_EVENTS};
+  size_t seat_counts[] = {1, 16, 64, 255};
+  unsigned int reservations[MAX_MULTI_EVENTS + 1] = {0};  // Reservations of each event so far
+  unsigned int event_ids[MAX_MULTI_EVENTS];
+  size_t num_seats[MAX_MULTI_EVENTS];
+  static size_t xs[MAX_MULTI_EVENTS * MAX_RESERVATION_SIZE], ys[MAX_MULTI_EVENTS * MAX_RESERVATION_SIZE];
+  for (size_t e = 0; e < sizeof(event_counts) / sizeof(size_t); e++) {
+    for (size_t s = 0; s < sizeof(seat_counts) / sizeof(size_t); s++) {
+      size_t num_events = event_counts[e];
+      size_t seats = seat_counts[s];
+      // Ids in descending order, so every bundle is sorted before its events are locked
+      for (size_t i = 0; i < num_events; i++) {
+        event_ids[i] = (unsigned int)(num_events - i);
+        num_seats[i] = seats;
+      }
+
+      // Both pick the same seats, and cancel them before the next bundle so every one is written in full
+      double multi = 0, single = 0;
+      for (int pass = 0; pass < 2; pass++) {
+        uint64_t state = 88172645463325252ull;
+        for (int b = 0; b < BUNDLES; b++) {
+          pick_seats(&state, ROWS, COLS, num_events, seats, xs, ys);
+          double start = now_s();
+          if (pass == 0) {
+            if (ems_reserve_multi(num_events, event_ids, num_seats, xs, ys) != 0) return 1;
+            multi += now_s() - start;
+          } else {
+            for (size_t i = 0; i < num_events; i++) {
+              if (ems_reserve(event_ids[i], seats, xs + i * seats, ys + i * seats) != 0) return 1;
+            }
+            single += now_s() - start;
+          }
+          for (unsigned int id = 1; id <= num_events; id++) {
+            if (ems_cancel(id, ++reservations[id]) != 0) return 1;
+          }
+        }
+      }
+      printf("%8zu %8zu %14.2f %14.2f %16.1f\n", num_events, seats, multi / BUNDLES * 1e6, single / BUNDLES * 1e6,
+             multi / BUNDLES / (double)(num_events * seats) * 1e9);
+    }
+  }
+
+  // Overlapping bundles from many threads: none may deadlock, and none may leave seats behind when it fails
+  for (unsigned int id = 100; id < 100 + SMALL_EVENTS; id++) {
+    if (ems_create(id, SMALL_ROWS, SMALL_COLS, 0) != 0) return 1;
+  }
+  pthread_t threads[THREADS];
+  double start = now_s();
+  for (size_t i = 0; i < THREADS; i++) pthread_create(&threads[i], NULL, booker, (void*)i);
+  for (size_t i = 0; i < THREADS; i++) pthread_join(threads[i], NULL);
+  double elapsed = now_s() - start;
+
+  unsigned long booked = 0, bundles = 0;
+  for (size_t i = 0; i < THREADS; i++) {
+    booked += booked_seats[i];
+    bundles += booked_bundles[i];
+  }
+  size_t taken = 0;
+  for (unsigned int id = 100; id < 100 + SMALL_EVENTS; id++) taken += taken_seats(id, SMALL_ROWS * SMALL_COLS);
+
+  printf("%d threads, bundles of 2-4 of %d %dx%d events: %.0f kbundles/s, %lu of %d booked\n", THREADS, SMALL_EVENTS,
+         SMALL_ROWS, SMALL_COLS, THREADS * BUNDLES_PER_THREAD / elapsed / 1e3, bundles, THREADS * BUNDLES_PER_THREAD);
+  printf("seats taken %zu, seats of the booked bundles %lu%s\n", taken, booked,
+         taken == booked ? "" : " (a failed bundle left seats behind)");
+
+  ems_terminate();
+  return taken == booked ? 0 : 1;
+}
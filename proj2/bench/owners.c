@@ -0,0 +1,111 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench/bench.h"
+#include "server/operations.h"
+
+#define EVENTS 16  // Events of each run, spread over the owners by their ids
+#define ROWS 32
+#define COLS 128
+#define REQUESTS_PER_THREAD 4000
+#define SHOW_EVERY 16  // One request in SHOW_EVERY is a SHOW
+#define CANCEL_EVERY 4  // One request in CANCEL_EVERY cancels the last reservation of the thread, the others reserve
+
+// Session thread: reserves random seats of random events, cancels some of them and shows an event now and then,
+// through the owners if they are running
+static void* session(void* arg) {
+  uint64_t state = 88172645463325252ull + (uintptr_t)arg * 7919;
+  size_t xs[4], ys[4];
+  unsigned int reserved_event = 0;  // Event of the last reservation of the thread, 0 if it was cancelled
+
+  for (int r = 0; r < REQUESTS_PER_THREAD; r++) {
+    unsigned int event_id = 1 + (unsigned int)(next_random(&state) % EVENTS);
+    if (r % SHOW_EVERY == 0) {
+      void* show = ems_show(event_id);
+      if (show == NULL) exit(1);
+      free(show);
+      continue;
+    }
+    if (r % CANCEL_EVERY == 0 && reserved_event != 0) {
+      // Reservation ids are not known to the caller, so the newest one of the event goes, whoever made it
+      void* show = ems_show(reserved_event);
+      if (show == NULL) exit(1);
+      unsigned int newest = 0;
+      const unsigned int* seats =
+          (const unsigned int*)((char*)show + sizeof(int) + 2 * sizeof(size_t) + sizeof(uint64_t));
+      for (size_t seat = 0; seat < ROWS * COLS; seat++) newest = seats[seat] > newest ? seats[seat] : newest;
+      free(show);
+      if (newest != 0) ems_cancel(reserved_event, newest);
+      reserved_event = 0;
+      continue;
+    }
+    size_t num_seats = 1 + next_random(&state) % 4;
+    uint64_t row = next_random(&state) % ROWS + 1;
+    uint64_t col = next_random(&state) % (COLS - 3) + 1;
+    for (size_t i = 0; i < num_seats; i++) {
+      xs[i] = row;
+      ys[i] = col + i;
+    }
+    if (ems_reserve(event_id, num_seats, xs, ys) == 0) reserved_event = event_id;
+  }
+  return NULL;
+}
+
+/// Runs the sessions in a process of their own, so each run starts from fresh events and threads.
+/// @param num_threads Number of session threads.
+/// @param num_owners Number of owner threads, 0 for the lock-based path.
+/// @return Thousands of requests per second.
+static double run(int num_threads, size_t num_owners) {
+  int fds[2];
+  if (pipe(fds) != 0) exit(1);
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid < 0) exit(1);
+  if (pid == 0) {
+    close(fds[0]);
+    if (ems_set_owners(num_owners) != 0 || ems_init(0, NULL, NULL) != 0) exit(1);
+    ems_set_combining(0);  // Only the stripes against the owners
+    for (unsigned int id = 1; id <= EVENTS; id++) {
+      if (ems_create(id, ROWS, COLS, 0) != 0) exit(1);
+    }
+
+    pthread_t threads[num_threads];
+    double start = now_s();
+    for (int i = 0; i < num_threads; i++) pthread_create(&threads[i], NULL, session, (void*)(uintptr_t)i);
+    for (int i = 0; i < num_threads; i++) pthread_join(threads[i], NULL);
+    double rate = (double)num_threads * REQUESTS_PER_THREAD / (now_s() - start) / 1e3;
+
+    ems_terminate();
+    if (write(fds[1], &rate, sizeof(rate)) != sizeof(rate)) exit(1);
+    exit(0);
+  }
+
+  close(fds[1]);
+  double rate = 0;
+  int status;
+  if (read(fds[0], &rate, sizeof(rate)) != sizeof(rate) || waitpid(pid, &status, 0) != pid || status != 0) exit(1);
+  close(fds[0]);
+  return rate;
+}
+
+int main() {
+  if (freopen("/dev/null", "w", stderr) == NULL) return 1;
+
+  printf("%d events of %dx%d, 1 SHOW in %d requests, 1 CANCEL in %d, the others reserve 1-4 seats, %ld CPUs\n",
+         EVENTS, ROWS, COLS, SHOW_EVERY, CANCEL_EVERY, sysconf(_SC_NPROCESSORS_ONLN));
+  printf("%8s %16s %16s\n", "threads", "locks (kreq/s)", "owners (kreq/s)");
+  int thread_counts[] = {1, 2, 4, 8, 16};
+  for (size_t t = 0; t < sizeof(thread_counts) / sizeof(int); t++) {
+    int threads = thread_counts[t];
+    // As many owners as sessions, so both sides run the requests on the same number of threads
+    double locks = run(threads, 0);
+    double owners = run(threads, (size_t)threads);
+    printf("%8d %16.1f %16.1f\n", threads, locks, owners);
+  }
+  return 0;
+}
@@ -0,0 +1,99 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "bench/bench.h"
+#include "server/operations.h"
+
+#define HOT_ROWS 16          // A single stripe, so every reservation of the locked mode takes the same lock
+#define HOT_COLS 16384
+#define WIDE_ROWS 1024
+#define WIDE_COLS 64
+#define SEATS_PER_RESERVATION 2
+#define RESERVATIONS 100000  // Split between the threads, the hot rows fit all of them
+
+static unsigned int event_id;
+static int random_seats;
+static size_t per_thread;
+static int num_threads;
+
+static void* reserver(void* arg) {
+  size_t thread = (size_t)(uintptr_t)arg;
+  uint64_t state = thread * 2654435761u + 1;
+  size_t xs[SEATS_PER_RESERVATION];
+  size_t ys[SEATS_PER_RESERVATION];
+  size_t reserved = 0;
+
+  for (size_t r = 0; r < per_thread; r++) {
+    for (size_t i = 0; i < SEATS_PER_RESERVATION; i++) {
+      if (random_seats) {
+        // Seats anywhere in the event, so reservations of different threads collide as it fills up
+        uint64_t random = next_random(&state);
+        xs[i] = random % WIDE_ROWS + 1;
+        ys[i] = (random >> 32) % WIDE_COLS + 1;
+      } else {
+        // Neighbouring seats of the same rows, each thread in its own columns
+        size_t seat = (r * SEATS_PER_RESERVATION + i) * (size_t)num_threads + thread;
+        xs[i] = seat / HOT_COLS % HOT_ROWS + 1;
+        ys[i] = seat % HOT_COLS + 1;
+      }
+    }
+    reserved += ems_reserve(event_id, SEATS_PER_RESERVATION, xs, ys) == 0;
+  }
+
+  return (void*)(uintptr_t)reserved;
+}
+
+/// Reserves on a new event with the given mode.
+/// @param reserved Where to store the number of reservations that succeeded.
+/// @return Thousands of reservations (successful or not) per second.
+static double run(enum ReserveMode mode, int threads, int random, size_t* reserved) {
+  // Nothing is reserved between runs, so the mode can change
+  ems_set_reserve_mode(mode);
+  event_id++;
+  if (ems_create(event_id, random ? WIDE_ROWS : HOT_ROWS, random ? WIDE_COLS : HOT_COLS, 0) != 0) exit(1);
+  random_seats = random;
+  num_threads = threads;
+  per_thread = RESERVATIONS / (size_t)threads;
+
+  pthread_t ids[threads];
+  double start = now_s();
+  for (int i = 0; i < threads; i++) {
+    pthread_create(&ids[i], NULL, reserver, (void*)(uintptr_t)i);
+  }
+  *reserved = 0;
+  for (int i = 0; i < threads; i++) {
+    void* count;
+    pthread_join(ids[i], &count);
+    *reserved += (size_t)(uintptr_t)count;
+  }
+  double elapsed = now_s() - start;
+
+  ems_delete(event_id);
+  return (double)(per_thread * (size_t)threads) / elapsed / 1e3;
+}
+
+int main() {
+  // Conflicting reservations report to stderr, which would dominate the runs
+  if (freopen("/dev/null", "w", stderr) == NULL) return 1;
+  if (ems_init(0, NULL, NULL) != 0) return 1;
+
+  int thread_counts[] = {1, 4, 16};
+  const char* titles[] = {"hot rows", "random"};
+  printf("%d reservations of %d seats, kreservations/s\n", RESERVATIONS, SEATS_PER_RESERVATION);
+  for (int random = 0; random <= 1; random++) {
+    printf("%-10s %8s %12s %12s %12s\n", titles[random], "threads", "locked", "cas", "reserved");
+    for (size_t t = 0; t < sizeof(thread_counts) / sizeof(int); t++) {
+      size_t locked_reserved, cas_reserved;
+      double locked = run(RESERVE_LOCKED, thread_counts[t], random, &locked_reserved);
+      double cas = run(RESERVE_CAS, thread_counts[t], random, &cas_reserved);
+      printf("%-10s %8d %12.1f %12.1f %5zu/%-6zu\n", "", thread_counts[t], locked, cas, locked_reserved,
+             cas_reserved);
+    }
+  }
+
+  ems_terminate();
+  return 0;
+}
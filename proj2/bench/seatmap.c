@@ -0,0 +1,157 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bench/bench.h"
+#include "server/alloc.h"
+#include "server/epoch.h"
+#include "server/eventlist.h"
+#include "server/seatmap.h"
+
+#define ROWS 10000
+#define COLS 10000
+#define SEATS_PER_RESERVATION 8
+#define LOOP_RESERVATIONS 3      // The per-seat loop walks the whole grid, so it only runs a few times
+#define BITMAP_RESERVATIONS 1000000
+#define ROW_CHECKS 10000
+#define GRID_SCANS 20
+
+// The conflict check of ems_reserve before the bitmap: every seat of the grid against every requested seat
+static int loop_any_taken(const unsigned int* data, size_t* xs, size_t* ys, size_t num_seats) {
+  for (size_t i = 0; i < (size_t)ROWS * COLS; i++) {
+    for (size_t j = 0; j < num_seats; j++) {
+      if ((xs[j] - 1) * COLS + ys[j] - 1 != i) continue;
+      if (data[i] != 0) return 1;
+      break;
+    }
+  }
+  return 0;
+}
+
+static int loop_range_free(const unsigned int* data, size_t first, size_t count) {
+  for (size_t i = first; i < first + count; i++) {
+    if (data[i] != 0) return 0;
+  }
+  return 1;
+}
+
+static size_t loop_count(const unsigned int* data, size_t num_seats) {
+  size_t taken = 0;
+  for (size_t i = 0; i < num_seats; i++) taken += data[i] != 0;
+  return taken;
+}
+
+static int loop_full(const unsigned int* data, size_t num_seats) {
+  for (size_t i = 0; i < num_seats; i++) {
+    if (data[i] == 0) return 0;
+  }
+  return 1;
+}
+
+int main() {
+  struct EventList* list = create_list();
+  struct Event* event = create_event(1, ROWS, COLS, 0);
+  if (!list || !event) return 1;
+  size_t num_seats = (size_t)ROWS * COLS;
+  // Grid of the event as it was stored before the bitmap, one unsigned int per seat
+  unsigned int* grid = calloc(num_seats, sizeof(unsigned int));
+  if (!grid) return 1;
+
+  // Half of the seats of the first half of the rows are taken, the other rows are free
+  srand(1);
+  for (size_t seat = 0; seat < num_seats / 2; seat++) {
+    if (rand() % 2) {
+      grid[seat] = 1;
+      seatmap_set(event->occupied, seat);
+    }
+  }
+
+  // Requests in the free rows, so every check has to look at all of their seats
+  size_t* xs = malloc(sizeof(size_t) * SEATS_PER_RESERVATION * BITMAP_RESERVATIONS);
+  size_t* ys = malloc(sizeof(size_t) * SEATS_PER_RESERVATION * BITMAP_RESERVATIONS);
+  size_t* seats = malloc(sizeof(size_t) * SEATS_PER_RESERVATION * BITMAP_RESERVATIONS);
+  if (!xs || !ys || !seats) return 1;
+  for (size_t i = 0; i < SEATS_PER_RESERVATION * BITMAP_RESERVATIONS; i++) {
+    xs[i] = ROWS / 2 + 1 + (size_t)rand() % (ROWS / 2);
+    ys[i] = 1 + (size_t)rand() % COLS;
+    seats[i] = (xs[i] - 1) * COLS + ys[i] - 1;
+  }
+
+  printf("%dx%d grid, %d seats per reservation\n", ROWS, COLS, SEATS_PER_RESERVATION);
+  printf("%-10s %14s %14s %14s %14s\n", "", "reserve check", "row free", "count", "full");
+
+  volatile size_t sink = 0;
+  double start = now_s();
+  for (size_t r = 0; r < LOOP_RESERVATIONS; r++) {
+    sink += (size_t)loop_any_taken(grid, xs + r * SEATS_PER_RESERVATION, ys + r * SEATS_PER_RESERVATION,
+                                   SEATS_PER_RESERVATION);
+  }
+  double check_ns = (now_s() - start) * 1e9 / LOOP_RESERVATIONS;
+  start = now_s();
+  for (size_t r = 0; r < ROW_CHECKS; r++) {
+    sink += (size_t)loop_range_free(grid, (xs[r] - 1) * COLS, COLS);
+  }
+  double row_ns = (now_s() - start) * 1e9 / ROW_CHECKS;
+  start = now_s();
+  for (size_t r = 0; r < GRID_SCANS; r++) sink += loop_count(grid, num_seats);
+  double count_ns = (now_s() - start) * 1e9 / GRID_SCANS;
+  printf("%-10s %11.0f ns %11.0f ns %11.0f ns %14s\n", "seat loop", check_ns, row_ns, count_ns, "");
+
+  const char* names[] = {"scalar", "sse", "avx2"};
+  enum SeatmapKernel kernels[] = {SEATMAP_SCALAR, SEATMAP_SSE, SEATMAP_AVX2};
+  for (size_t k = 0; k < 3; k++) {
+    if (seatmap_select(kernels[k]) != 0) {
+      printf("%-10s not supported\n", names[k]);
+      continue;
+    }
+    start = now_s();
+    for (size_t r = 0; r < BITMAP_RESERVATIONS; r++) {
+      sink += (size_t)seatmap_any_set(event->occupied, seats + r * SEATS_PER_RESERVATION, SEATS_PER_RESERVATION);
+    }
+    check_ns = (now_s() - start) * 1e9 / BITMAP_RESERVATIONS;
+    start = now_s();
+    for (size_t r = 0; r < ROW_CHECKS; r++) {
+      sink += (size_t)seatmap_range_free(event->occupied, (xs[r] - 1) * COLS, COLS);
+    }
+    row_ns = (now_s() - start) * 1e9 / ROW_CHECKS;
+    start = now_s();
+    for (size_t r = 0; r < GRID_SCANS; r++) sink += seatmap_count(event->occupied, num_seats);
+    count_ns = (now_s() - start) * 1e9 / GRID_SCANS;
+    printf("%-10s %11.1f ns %11.1f ns %11.0f ns %14s\n", names[k], check_ns, row_ns, count_ns, "");
+  }
+
+  // Full except for the last seat, so the full test has to read the whole grid
+  for (size_t seat = 0; seat + 1 < num_seats; seat++) {
+    grid[seat] = 1;
+    seatmap_set(event->occupied, seat);
+  }
+  start = now_s();
+  for (size_t r = 0; r < GRID_SCANS; r++) sink += (size_t)loop_full(grid, num_seats);
+  printf("%-10s %14s %14s %14s %11.0f ns\n", "seat loop", "", "", "", (now_s() - start) * 1e9 / GRID_SCANS);
+  for (size_t k = 0; k < 3; k++) {
+    if (seatmap_select(kernels[k]) != 0) continue;
+    start = now_s();
+    for (size_t r = 0; r < GRID_SCANS; r++) sink += (size_t)seatmap_full(event->occupied, num_seats);
+    printf("%-10s %14s %14s %14s %11.0f ns\n", names[k], "", "", "", (now_s() - start) * 1e9 / GRID_SCANS);
+  }
+
+  // Sanity check of the kernels against the grid
+  seatmap_select(SEATMAP_AUTO);
+  if (seatmap_count(event->occupied, num_seats) != loop_count(grid, num_seats) ||
+      seatmap_full(event->occupied, num_seats) || sink == 0) {
+    fprintf(stderr, "kernels disagree with the grid\n");
+    return 1;
+  }
+
+  free(grid);
+  free(xs);
+  free(ys);
+  free(seats);
+  free_event(event);
+  free_list(list);
+  free(list);
+  epoch_drain();
+  alloc_release_all();
+  return 0;
+}
@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench/bench.h"
+#include "server/alloc.h"
+#include "server/epoch.h"
+#include "server/eventlist.h"
+#include "server/seatgrid.h"
+#include "server/seatmap.h"
+#include "server/snapshot.h"
+
+#define NUM_EVENTS 100000
+#define ROWS 10
+#define COLS 20
+#define SNAPSHOT_PATH "/tmp/ems_bench.snapshot"
+
+int main(int argc, char* argv[]) {
+  const char* path = argc > 1 ? argv[1] : SNAPSHOT_PATH;
+
+  // Rebuilding the state, as replaying the creates and reservations would (without the access delay)
+  double start = now_s();
+  struct EventList* list = create_list();
+  if (!list) return 1;
+  for (unsigned int id = 1; id <= NUM_EVENTS; id++) {
+    struct Event* event = create_event(id, ROWS, COLS, 0);
+    if (!event || append_to_list(list, event) != 0) return 1;
+    list->num_events++;
+    for (size_t seat = 0; seat < ROWS * COLS; seat += 3) {
+      if (seatgrid_materialize(event->data, event->width, ROWS * COLS, &seat, 1) != 0) return 1;
+      seatgrid_set(event->data, event->width, seat, ++event->reservations);
+      seatmap_set(event->occupied, seat);
+    }
+  }
+  double rebuild = now_s() - start;
+
+  start = now_s();
+  if (snapshot_write(list, path, 0, 1) != 0) return 1;
+  double write = now_s() - start;
+
+  free_list(list);
+  free(list);
+  epoch_drain();
+  alloc_release_all();
+
+  // Restart from the snapshot
+  struct SnapshotImage image;
+  start = now_s();
+  list = create_list();
+  if (!list || snapshot_load(list, path, &image) != 0) return 1;
+  double load = now_s() - start;
+
+  // First touch of every seat, which is when the mapped pages are actually read
+  start = now_s();
+  unsigned long checksum = 0;
+  for (unsigned int id = 1; id <= NUM_EVENTS; id++) {
+    struct Event* event = get_event(list, id);
+    if (!event) return 1;
+    for (size_t seat = 0; seat < ROWS * COLS; seat++) checksum += seatgrid_get(event->data, event->width, seat);
+  }
+  double touch = now_s() - start;
+
+  printf("%d events of %dx%d seats, snapshot of %zu bytes\n", NUM_EVENTS, ROWS, COLS, image.size);
+  printf("rebuild:          %8.3f ms\n", rebuild * 1e3);
+  printf("snapshot write:   %8.3f ms\n", write * 1e3);
+  printf("snapshot startup: %8.3f ms\n", load * 1e3);
+  printf("first seat touch: %8.3f ms (checksum %lu)\n", touch * 1e3, checksum);
+
+  free_list(list);
+  free(list);
+  epoch_drain();
+  alloc_release_all();
+  snapshot_unmap(&image);
+  unlink(path);
+  return 0;
+}
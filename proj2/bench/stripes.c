@@ -0,0 +1,123 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "bench/bench.h"
+#include "server/alloc.h"
+#include "server/epoch.h"
+#include "server/eventlist.h"
+#include "server/seatgrid.h"
+#include "server/seatmap.h"
+
+#define ROWS 4096
+#define COLS 64
+#define SEATS_PER_RESERVATION 4
+#define RESERVATIONS 60000       // Split between the threads, the grid fits all of them
+#define HOLD_RESERVATIONS 2000   // Reservations of the runs that hold the stripes for a while
+#define HOLD_NS 20000            // Time the stripes are held, like a reservation waiting on its log record
+
+static struct Event* event;
+static size_t per_thread;
+static size_t rows_per_thread;
+static long hold_ns;
+
+// Same locking as ems_reserve, each thread in its own rows
+static void* reserver(void* arg) {
+  size_t first_row = (size_t)(uintptr_t)arg * rows_per_thread;
+  size_t reserved = 0;
+
+  for (size_t r = 0; r < per_thread; r++) {
+    size_t seat = r * SEATS_PER_RESERVATION;
+    size_t xs[SEATS_PER_RESERVATION];
+    size_t seats[SEATS_PER_RESERVATION];
+    for (size_t i = 0; i < SEATS_PER_RESERVATION; i++) {
+      xs[i] = first_row + (seat + i) / COLS % rows_per_thread + 1;
+      seats[i] = (xs[i] - 1) * COLS + (seat + i) % COLS;
+    }
+
+    uint64_t stripes = row_stripes(event, xs, SEATS_PER_RESERVATION);
+    lock_stripes(event, stripes);
+    if (!seatmap_any_set(event->occupied, seats, SEATS_PER_RESERVATION)) {
+      if (seatgrid_materialize(event->data, event->width, ROWS * COLS, seats, SEATS_PER_RESERVATION) != 0) exit(1);
+      unsigned int reservation_id = atomic_fetch_add(&event->reservations, 1) + 1;
+      for (size_t i = 0; i < SEATS_PER_RESERVATION; i++) {
+        seatgrid_set(event->data, event->width, seats[i], reservation_id);
+        seatmap_set(event->occupied, seats[i]);
+        mark_row_dirty(event, xs[i] - 1);
+      }
+      reserved++;
+    }
+    if (hold_ns > 0) {
+      struct timespec delay = {0, hold_ns};
+      nanosleep(&delay, NULL);
+    }
+    unlock_stripes(event, stripes);
+  }
+
+  return (void*)reserved;
+}
+
+/// Reserves on a fresh event with the given number of stripes.
+/// @return Thousands of reservations per second.
+static double run(size_t num_stripes, int num_threads, size_t reservations, long hold) {
+  event = create_event(1, ROWS, COLS, num_stripes);
+  // The grid starts wide enough for every id, so no reservation has to widen it
+  if (!event || widen_seats(event, RESERVATIONS) != 0) exit(1);
+  per_thread = reservations / (size_t)num_threads;
+  rows_per_thread = ROWS / (size_t)num_threads;
+  hold_ns = hold;
+
+  pthread_t threads[num_threads];
+  double start = now_s();
+  for (int i = 0; i < num_threads; i++) {
+    pthread_create(&threads[i], NULL, reserver, (void*)(uintptr_t)i);
+  }
+  size_t reserved = 0;
+  for (int i = 0; i < num_threads; i++) {
+    void* count;
+    pthread_join(threads[i], &count);
+    reserved += (size_t)(uintptr_t)count;
+  }
+  double elapsed = now_s() - start;
+
+  if (reserved != per_thread * (size_t)num_threads) {
+    fprintf(stderr, "lost reservations: %zu of %zu\n", reserved, per_thread * (size_t)num_threads);
+    exit(1);
+  }
+  free_event(event);
+  return (double)reserved / elapsed / 1e3;
+}
+
+int main() {
+  // The list is only created for the allocators of the events
+  struct EventList* list = create_list();
+  if (!list) return 1;
+  seatmap_select(SEATMAP_AUTO);
+
+  size_t stripe_counts[] = {1, 8, 64};
+  int thread_counts[] = {1, 4, 16};
+  const char* titles[] = {"no hold", "20 us hold"};
+  size_t reservations[] = {RESERVATIONS, HOLD_RESERVATIONS};
+  long holds[] = {0, HOLD_NS};
+
+  printf("%dx%d event, %d seats per reservation, kreservations/s\n", ROWS, COLS, SEATS_PER_RESERVATION);
+  for (size_t h = 0; h < 2; h++) {
+    printf("%-12s %8s %12s %12s %12s\n", titles[h], "threads", "1 stripe", "8 stripes", "64 stripes");
+    for (size_t t = 0; t < sizeof(thread_counts) / sizeof(int); t++) {
+      printf("%-12s %8d", "", thread_counts[t]);
+      for (size_t s = 0; s < sizeof(stripe_counts) / sizeof(size_t); s++) {
+        printf(" %12.1f", run(stripe_counts[s], thread_counts[t], reservations[h], holds[h]));
+      }
+      printf("\n");
+    }
+  }
+
+  epoch_drain();
+  free_list(list);
+  free(list);
+  alloc_release_all();
+  return 0;
+}
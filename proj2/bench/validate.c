@@ -0,0 +1,105 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "bench/bench.h"
+#include "common/constants.h"
+#include "server/operations.h"
+
+#define REQUESTS 2000             // Requests of MAX_RESERVATION_SIZE scattered seats per event
+#define NESTED_MAX_SEATS 1000000  // Largest grid the nested loop of the original check is timed on
+
+/// Picks distinct seats anywhere in an event.
+static void random_seats(uint64_t* state, size_t rows, size_t cols, size_t* xs, size_t* ys) {
+  for (size_t i = 0; i < MAX_RESERVATION_SIZE; i++) {
+    int repeated = 1;
+    while (repeated) {
+      uint64_t r = next_random(state);
+      xs[i] = r % rows + 1;
+      ys[i] = (r >> 32) % cols + 1;
+      repeated = 0;
+      for (size_t j = 0; j < i && !repeated; j++) repeated = xs[j] == xs[i] && ys[j] == ys[i];
+    }
+  }
+}
+
+/// Checks the seats of a request as the original ems_reserve did: every seat of the grid against every
+/// requested seat.
+/// @return Whether a requested seat is taken.
+static int nested_check(const unsigned int* data, size_t rows, size_t cols, const size_t* xs, const size_t* ys) {
+  int taken = 0;
+  for (size_t i = 0; i < rows * cols; i++) {
+    for (size_t j = 0; j < MAX_RESERVATION_SIZE; j++) {
+      if ((xs[j] - 1) * cols + ys[j] - 1 != i) continue;
+      taken |= data[i] != 0;
+      break;
+    }
+  }
+  return taken;
+}
+
+int main() {
+  if (freopen("/dev/null", "w", stderr) == NULL) return 1;
+  if (ems_init(0, NULL, NULL) != 0) return 1;
+
+  // Every request pays the simulated state access once, whatever the size of the grid
+  double start = now_s();
+  for (int i = 0; i < REQUESTS; i++) {
+    struct timespec delay = {0, 0};
+    nanosleep(&delay, NULL);
+  }
+  double access = (now_s() - start) / REQUESTS;
+
+  printf("%d seats per request, state access delay alone %.1f us\n", MAX_RESERVATION_SIZE, access * 1e6);
+  printf("%12s %14s %16s %18s\n", "grid", "us/request", "repeated (us)", "nested loop (ms)");
+
+  size_t sizes[][2] = {{100, 100}, {1000, 1000}, {4000, 4000}};
+  size_t xs[MAX_RESERVATION_SIZE], ys[MAX_RESERVATION_SIZE];
+  for (unsigned int e = 0; e < sizeof(sizes) / sizeof(sizes[0]); e++) {
+    size_t rows = sizes[e][0];
+    size_t cols = sizes[e][1];
+    unsigned int event_id = e + 1;
+    if (ems_create(event_id, rows, cols, 0) != 0) return 1;
+
+    // Each reservation is cancelled before the next one, so every request is checked and written in full
+    // however small the grid. The first pass allocates the tiles the seats fall in, the second one is timed.
+    unsigned int reservation_id = 0;
+    double elapsed = 0;
+    for (int pass = 0; pass < 2; pass++) {
+      uint64_t state = 88172645463325252ull;
+      elapsed = 0;
+      for (int r = 0; r < REQUESTS; r++) {
+        random_seats(&state, rows, cols, xs, ys);
+        start = now_s();
+        int error = ems_reserve(event_id, MAX_RESERVATION_SIZE, xs, ys);
+        elapsed += now_s() - start;
+        if (error || ems_cancel(event_id, ++reservation_id) != 0) return 1;
+      }
+    }
+
+    // A repeated seat is found before any lock is taken
+    ys[MAX_RESERVATION_SIZE - 1] = ys[0];
+    xs[MAX_RESERVATION_SIZE - 1] = xs[0];
+    start = now_s();
+    if (ems_reserve(event_id, MAX_RESERVATION_SIZE, xs, ys) == 0) return 1;
+    double repeated = now_s() - start;
+
+    char grid[32];
+    snprintf(grid, sizeof(grid), "%zux%zu", rows, cols);
+    printf("%12s %14.1f %16.1f", grid, elapsed / REQUESTS * 1e6, repeated * 1e6);
+    if (rows * cols <= NESTED_MAX_SEATS) {
+      unsigned int* data = calloc(rows * cols, sizeof(unsigned int));
+      if (data == NULL) return 1;
+      start = now_s();
+      int taken = nested_check(data, rows, cols, xs, ys);
+      printf(" %18.1f\n", (now_s() - start) * 1e3 + taken);
+      free(data);
+    } else {
+      printf(" %18s\n", "skipped");
+    }
+  }
+
+  ems_terminate();
+  return 0;
+}
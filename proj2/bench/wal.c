@@ -0,0 +1,74 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench/bench.h"
+#include "server/wal.h"
+
+#define NUM_THREADS 64
+#define RECORDS_PER_THREAD 200
+#define SEATS_PER_RECORD 4
+#define WAL_PATH "/tmp/ems_bench.wal"
+
+static void ignore_record(uint32_t type, const void* payload, size_t size, void* arg) {
+  (void)type;
+  (void)payload;
+  (void)size;
+  (void)arg;
+}
+
+// Appends reservation records and waits for each one, like a worker thread answering a client
+static void* committer(void* arg) {
+  unsigned int event_id = (unsigned int)(size_t)arg;
+  char payload[sizeof(struct WalReserve) + 2 * sizeof(uint64_t) * SEATS_PER_RECORD];
+  memset(payload, 0, sizeof(payload));
+
+  for (unsigned int i = 0; i < RECORDS_PER_THREAD; i++) {
+    struct WalReserve record = {event_id, i + 1, SEATS_PER_RECORD};
+    memcpy(payload, &record, sizeof(record));
+    if (wal_wait(wal_append(WAL_RESERVE, payload, sizeof(payload))) != 0) {
+      fprintf(stderr, "log write failed\n");
+      exit(1);
+    }
+  }
+  return NULL;
+}
+
+int main(int argc, char* argv[]) {
+  const char* path = argc > 1 ? argv[1] : WAL_PATH;
+  size_t batch_sizes[] = {1, 8, 64};
+
+  printf("%d threads, %d durable records each\n", NUM_THREADS, RECORDS_PER_THREAD);
+  for (size_t b = 0; b < sizeof(batch_sizes) / sizeof(batch_sizes[0]); b++) {
+    unlink(path);
+    if (wal_open(path, batch_sizes[b], 0, ignore_record, NULL) != 0) return 1;
+
+    struct WalStats before;
+    wal_get_stats(&before);
+
+    pthread_t threads[NUM_THREADS];
+    double start = now_s();
+    for (size_t t = 0; t < NUM_THREADS; t++) {
+      if (pthread_create(&threads[t], NULL, committer, (void*)t) != 0) return 1;
+    }
+    for (size_t t = 0; t < NUM_THREADS; t++) {
+      pthread_join(threads[t], NULL);
+    }
+    double elapsed = now_s() - start;
+
+    struct WalStats after;
+    wal_get_stats(&after);
+    wal_close();
+
+    unsigned long records = after.records - before.records;
+    unsigned long flushes = after.flushes - before.flushes;
+    printf("max batch %2zu: %8.0f records/s, %6lu fdatasyncs, %5.1f records per batch\n", batch_sizes[b],
+           (double)records / elapsed, flushes, (double)records / (double)flushes);
+  }
+
+  unlink(path);
+  return 0;
+}
@@ -128,9 +128,9 @@ int ems_quit(void) {
   return 0;
 }
 
-int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
+int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols, size_t num_stripes) {
   char OP_CODE = '3';
-  size_t buf_size = sizeof(char) + sizeof(int) + sizeof(unsigned int) + 2*sizeof(size_t);
+  size_t buf_size = sizeof(char) + sizeof(int) + sizeof(unsigned int) + 3*sizeof(size_t);
   char buf[buf_size];
 
 
@@ -142,6 +142,9 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
   store_data(buf + sizeof(OP_CODE) + sizeof(session_id) + sizeof(event_id), &num_rows, sizeof(size_t));
 
   store_data(buf + sizeof(OP_CODE) + sizeof(session_id) + sizeof(event_id) + sizeof(num_rows), &num_cols, sizeof(size_t));
+
+  store_data(buf + sizeof(OP_CODE) + sizeof(session_id) + sizeof(event_id) + sizeof(num_rows) + sizeof(num_cols),
+             &num_stripes, sizeof(size_t));
  
 
   if(safe_write(req_fd, buf, buf_size) == -1){
@@ -189,7 +192,207 @@ int ems_reserve(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys)
   return ret;
 }
 
-int ems_show(int out_fd, unsigned int event_id) {
+int ems_reserve_multi(size_t num_events, unsigned int* event_ids, size_t* num_seats, size_t* xs, size_t* ys) {
+  char OP_CODE = 'D';
+
+  if (num_events == 0 || num_events > MAX_MULTI_EVENTS) {
+    fprintf(stderr, "[ERR]: invalid number of events\n");
+    return 1;
+  }
+  for (size_t i = 0; i < num_events; i++) {
+    if (num_seats[i] == 0 || num_seats[i] > MAX_RESERVATION_SIZE) {
+      fprintf(stderr, "[ERR]: invalid number of seats\n");
+      return 1;
+    }
+  }
+
+  // Each event is sent with its own seats only, so the request is as long as the seats it has
+  char buf[sizeof(char) + sizeof(int) + sizeof(size_t) +
+           MAX_MULTI_EVENTS*(sizeof(unsigned int) + sizeof(size_t) + 2*sizeof(size_t)*MAX_RESERVATION_SIZE)];
+  store_data(buf, &OP_CODE, sizeof(char));
+  store_data(buf + sizeof(char), &session_id, sizeof(int));
+  store_data(buf + sizeof(char) + sizeof(int), &num_events, sizeof(size_t));
+  size_t buf_size = sizeof(char) + sizeof(int) + sizeof(size_t);
+  size_t first_seat = 0;
+  for (size_t i = 0; i < num_events; i++) {
+    store_data(buf + buf_size, &event_ids[i], sizeof(unsigned int));
+    store_data(buf + buf_size + sizeof(unsigned int), &num_seats[i], sizeof(size_t));
+    buf_size += sizeof(unsigned int) + sizeof(size_t);
+    store_data(buf + buf_size, xs + first_seat, sizeof(size_t)*num_seats[i]);
+    store_data(buf + buf_size + sizeof(size_t)*num_seats[i], ys + first_seat, sizeof(size_t)*num_seats[i]);
+    buf_size += 2*sizeof(size_t)*num_seats[i];
+    first_seat += num_seats[i];
+  }
+
+  if(safe_write(req_fd, buf, buf_size) == -1){
+    fprintf(stderr, "[ERR]: write to request pipe failed: %s\n", strerror(errno));
+    return 1;
+  }
+
+  int ret;
+  if(safe_read(resp_fd, &ret, sizeof(int)) == -1){
+    fprintf(stderr, "[ERR]: read from request pipe failed: %s\n", strerror(errno));
+    return 1;
+  }
+
+  return ret;
+}
+
+int ems_reserve_best(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys) {
+  char OP_CODE = '9';
+  size_t buf_size = sizeof(char) + sizeof(int) + sizeof(unsigned int) + sizeof(size_t);
+  char buf[buf_size];
+
+  if (num_seats == 0 || num_seats > MAX_RESERVATION_SIZE) {
+    fprintf(stderr, "[ERR]: invalid number of seats\n");
+    return 1;
+  }
+
+  store_data(buf, &OP_CODE, sizeof(char));
+  store_data(buf + sizeof(char), &session_id, sizeof(int));
+  store_data(buf + sizeof(char) + sizeof(int), &event_id, sizeof(unsigned int));
+  store_data(buf + sizeof(char) + sizeof(int) + sizeof(unsigned int), &num_seats, sizeof(size_t));
+
+  if(safe_write(req_fd, buf, buf_size) == -1){
+    fprintf(stderr, "[ERR]: write to request pipe failed: %s\n", strerror(errno));
+    return 1;
+  }
+
+  int ret;
+  if(safe_read(resp_fd, &ret, sizeof(int)) == -1){
+    fprintf(stderr, "[ERR]: read from request pipe failed: %s\n", strerror(errno));
+    return 1;
+  }
+
+  if(ret){
+    return ret;
+  }
+
+  if(safe_read(resp_fd, xs, sizeof(size_t)*num_seats) == -1 || safe_read(resp_fd, ys, sizeof(size_t)*num_seats) == -1){
+    fprintf(stderr, "[ERR]: read from request pipe failed: %s\n", strerror(errno));
+    return 1;
+  }
+
+  return 0;
+}
+
+int ems_hold(unsigned int event_id, unsigned int seconds, size_t num_seats, size_t* xs, size_t* ys,
+             unsigned int* hold_id) {
+  char OP_CODE = 'A';
+  size_t buf_size = sizeof(char) + sizeof(int) + 2*sizeof(unsigned int) + sizeof(size_t) + 2*sizeof(size_t)*MAX_RESERVATION_SIZE;
+  char buf[buf_size];
+  memset(buf, 0, buf_size);
+
+  if (num_seats > MAX_RESERVATION_SIZE) {
+    fprintf(stderr, "[ERR]: invalid number of seats\n");
+    return 1;
+  }
+
+  store_data(buf, &OP_CODE, sizeof(char));
+  store_data(buf + sizeof(char), &session_id, sizeof(int));
+  store_data(buf + sizeof(char) + sizeof(int), &event_id, sizeof(unsigned int));
+  store_data(buf + sizeof(char) + sizeof(int) + sizeof(unsigned int), &seconds, sizeof(unsigned int));
+  store_data(buf + sizeof(char) + sizeof(int) + 2*sizeof(unsigned int), &num_seats, sizeof(size_t));
+  store_data(buf + sizeof(char) + sizeof(int) + 2*sizeof(unsigned int) + sizeof(size_t), xs, sizeof(size_t)*num_seats);
+  store_data(buf + sizeof(char) + sizeof(int) + 2*sizeof(unsigned int) + sizeof(size_t) + sizeof(size_t)*num_seats, ys, sizeof(size_t)*num_seats);
+
+  if(safe_write(req_fd, buf, buf_size) == -1){
+    fprintf(stderr, "[ERR]: write to request pipe failed: %s\n", strerror(errno));
+    return 1;
+  }
+
+  int ret;
+  if(safe_read(resp_fd, &ret, sizeof(int)) == -1){
+    fprintf(stderr, "[ERR]: read from request pipe failed: %s\n", strerror(errno));
+    return 1;
+  }
+
+  if(ret){
+    return ret;
+  }
+
+  if(safe_read(resp_fd, hold_id, sizeof(unsigned int)) == -1){
+    fprintf(stderr, "[ERR]: read from request pipe failed: %s\n", strerror(errno));
+    return 1;
+  }
+
+  return 0;
+}
+
+int ems_confirm(unsigned int event_id, unsigned int hold_id) {
+  char OP_CODE = 'B';
+  size_t buf_size = sizeof(char) + sizeof(int) + 2*sizeof(unsigned int);
+  char buf[buf_size];
+
+  store_data(buf, &OP_CODE, sizeof(char));
+  store_data(buf + sizeof(char), &session_id, sizeof(int));
+  store_data(buf + sizeof(char) + sizeof(int), &event_id, sizeof(unsigned int));
+  store_data(buf + sizeof(char) + sizeof(int) + sizeof(unsigned int), &hold_id, sizeof(unsigned int));
+
+  if(safe_write(req_fd, buf, buf_size) == -1){
+    fprintf(stderr, "[ERR]: write to request pipe failed: %s\n", strerror(errno));
+    return 1;
+  }
+
+  int ret;
+  if(safe_read(resp_fd, &ret, sizeof(int)) == -1){
+    fprintf(stderr, "[ERR]: read from request pipe failed: %s\n", strerror(errno));
+    return 1;
+  }
+
+  return ret;
+}
+
+int ems_cancel(unsigned int event_id, unsigned int reservation_id) {
+  char OP_CODE = 'C';
+  size_t buf_size = sizeof(char) + sizeof(int) + 2*sizeof(unsigned int);
+  char buf[buf_size];
+
+  store_data(buf, &OP_CODE, sizeof(char));
+  store_data(buf + sizeof(char), &session_id, sizeof(int));
+  store_data(buf + sizeof(char) + sizeof(int), &event_id, sizeof(unsigned int));
+  store_data(buf + sizeof(char) + sizeof(int) + sizeof(unsigned int), &reservation_id, sizeof(unsigned int));
+
+  if(safe_write(req_fd, buf, buf_size) == -1){
+    fprintf(stderr, "[ERR]: write to request pipe failed: %s\n", strerror(errno));
+    return 1;
+  }
+
+  int ret;
+  if(safe_read(resp_fd, &ret, sizeof(int)) == -1){
+    fprintf(stderr, "[ERR]: read from request pipe failed: %s\n", strerror(errno));
+    return 1;
+  }
+
+  return ret;
+}
+
+int ems_delete(unsigned int event_id) {
+  char OP_CODE = '7';
+  size_t buf_size = sizeof(char) + sizeof(int) + sizeof(unsigned int);
+  char buf[buf_size];
+
+  store_data(buf, &OP_CODE, sizeof(char));
+  store_data(buf + sizeof(char), &session_id, sizeof(int));
+  store_data(buf + sizeof(char) + sizeof(int), &event_id, sizeof(unsigned int));
+
+  if(safe_write(req_fd, buf, buf_size) == -1){
+    fprintf(stderr, "[ERR]: write to request pipe failed: %s\n", strerror(errno));
+    return 1;
+  }
+
+  int ret;
+  if(safe_read(resp_fd, &ret, sizeof(int)) == -1){
+    fprintf(stderr, "[ERR]: read from request pipe failed: %s\n", strerror(errno));
+    return 1;
+  }
+
+  return ret;
+}
+
+int ems_show(int out_fd, unsigned int event_id) { return ems_show_version(out_fd, event_id, NULL); }
+
+int ems_show_version(int out_fd, unsigned int event_id, uint64_t* version) {
   char OP_CODE = '5';
   size_t buf_size = sizeof(char) + sizeof(int) + sizeof(unsigned int);
   char buf[buf_size];
@@ -230,6 +433,13 @@ int ems_show(int out_fd, unsigned int event_id) {
     return 1;
   }
 
+  uint64_t event_version;
+
+  if(safe_read(resp_fd, &event_version, sizeof(uint64_t)) == -1){
+    fprintf(stderr, "[ERR]: read from request pipe failed: %s\n", strerror(errno));
+    return 1;
+  }
+
   unsigned int* event_data = (unsigned int*) malloc(sizeof(unsigned int) * (event_rows)*(event_cols));
   if (event_data == NULL) {
     fprintf(stderr, "Error allocating memory for buffer\n");
@@ -274,75 +484,92 @@ int ems_show(int out_fd, unsigned int event_id) {
   }
   free(event_data);  
 
+  if (version != NULL) *version = event_version;
   return 0;
 
 }
 
 int ems_list_events(int out_fd) {
-  int OP_CODE = '6';
-  size_t buf_size = sizeof(char) + sizeof(int);
+  char OP_CODE = '8';
+  size_t buf_size = sizeof(char) + sizeof(int) + sizeof(unsigned int) + sizeof(size_t);
   char buf[buf_size];
+  size_t limit = MAX_LIST_PAGE_SIZE;
+
+  // Only one page of ids is held at a time, however many events the server has
+  unsigned int ids[MAX_LIST_PAGE_SIZE];
+  unsigned int cursor = 0;
+  int more = 1;
+  int listed_any = 0;
+
+  while (more) {
+    store_data(buf, &OP_CODE, sizeof(char));
+    store_data(buf + sizeof(char), &session_id, sizeof(int));
+    store_data(buf + sizeof(char) + sizeof(int), &cursor, sizeof(unsigned int));
+    store_data(buf + sizeof(char) + sizeof(int) + sizeof(unsigned int), &limit, sizeof(size_t));
+
+    if(safe_write(req_fd, buf, buf_size) == -1){
+      fprintf(stderr, "[ERR]: write to request pipe failed: %s\n", strerror(errno));
+      return 1;
+    }
 
-  store_data(buf, &OP_CODE, sizeof(char));
-  store_data(buf + sizeof(char), &session_id, sizeof(int));
-
-  if(safe_write(req_fd, buf, buf_size) == -1){
-    fprintf(stderr, "[ERR]: write to request pipe failed: %s\n", strerror(errno));
-    return 1;
-  }
-
-  int ret;
-  if(safe_read(resp_fd, &ret, sizeof(int)) == -1){
-    fprintf(stderr, "[ERR]: read from request pipe failed: %s\n", strerror(errno)); 
-    return 1;
-  }
-
-
-  if(ret){
-    return 1;
-  }
+    int ret;
+    if(safe_read(resp_fd, &ret, sizeof(int)) == -1){
+      fprintf(stderr, "[ERR]: read from request pipe failed: %s\n", strerror(errno));
+      return 1;
+    }
 
-  size_t num_events;
+    if(ret){
+      return 1;
+    }
 
-  if(safe_read(resp_fd, &num_events, sizeof(size_t)) == -1){
-    fprintf(stderr, "[ERR]: read from request pipe failed: %s\n", strerror(errno));
-    return 1;
-  }
-  if(num_events == 0){
-    char buff[] = "No events\n";
-    if (print_str(out_fd, buff)) {
-      perror("Error writing to file descriptor");
+    size_t num_events;
+    if(safe_read(resp_fd, &num_events, sizeof(size_t)) == -1){
+      fprintf(stderr, "[ERR]: read from request pipe failed: %s\n", strerror(errno));
+      return 1;
+    }
+    if(safe_read(resp_fd, &more, sizeof(int)) == -1){
+      fprintf(stderr, "[ERR]: read from request pipe failed: %s\n", strerror(errno));
+      return 1;
+    }
+    if(num_events > MAX_LIST_PAGE_SIZE){
+      fprintf(stderr, "[ERR]: list page larger than requested\n");
+      return 1;
+    }
+    if(num_events > 0 && safe_read(resp_fd, ids, sizeof(unsigned int)*num_events) == -1){
+      fprintf(stderr, "[ERR]: read from request pipe failed: %s\n", strerror(errno));
       return 1;
     }
-    return 0;
-  }
-  unsigned int* ids = (unsigned int*) malloc(sizeof(unsigned int)*num_events);
-  if (ids == NULL) {
-    fprintf(stderr, "Error allocating memory for buffer\n");
-    return 1;
-  }
 
-  if(safe_read(resp_fd, ids, sizeof(unsigned int)*num_events) == -1){
-    fprintf(stderr, "[ERR]: read from request pipe failed: %s\n", strerror(errno));
-    free(ids);
-    return 1;
+    for(size_t i = 0; i < num_events; i++){
+      char buff[] = "Event: ";
+      if (print_str(out_fd, buff)) {
+        perror("Error writing to file descriptor");
+        return 1;
+      }
+      char id[16];
+      sprintf(id, "%u\n", ids[i]);
+      if (print_str(out_fd, id)) {
+        perror("Error writing to file descriptor");
+        return 1;
+      }
+    }
+
+    if(num_events > 0){
+      listed_any = 1;
+      // The next page starts right after the last id of this one
+      cursor = ids[num_events - 1] + 1;
+    }
+    if(num_events == 0 || cursor == 0){
+      more = 0;
+    }
   }
 
-  for(size_t i = 0; i < num_events; i++){
-    char buff[] = "Event: ";
+  if(!listed_any){
+    char buff[] = "No events\n";
     if (print_str(out_fd, buff)) {
       perror("Error writing to file descriptor");
-      free(ids);
-      return 1;
-    }
-    char id[16];
-    sprintf(id, "%u\n", ids[i]);
-    if (print_str(out_fd, id)) {
-      perror("Error writing to file descriptor");
-      free(ids);
       return 1;
     }
   }
-  free(ids);
   return 0;
 }
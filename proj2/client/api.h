@@ -2,6 +2,7 @@
 #define CLIENT_API_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 /// Connects to an EMS server.
 /// @param req_pipe_path Path to the name pipe to be created for requests.
@@ -18,8 +19,9 @@ int ems_quit(void);
 /// @param event_id Id of the event to be created.
 /// @param num_rows Number of rows of the event to be created.
 /// @param num_cols Number of columns of the event to be created.
+/// @param num_stripes Number of row stripes of the event, 0 for the server's default.
 /// @return 0 if the event was created successfully, 1 otherwise.
-int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols);
+int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols, size_t num_stripes);
 
 /// Creates a new reservation for the given event.
 /// @param event_id Id of the event to create a reservation for.
@@ -29,13 +31,68 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols);
 /// @return 0 if the reservation was created successfully, 1 otherwise.
 int ems_reserve(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys);
 
+/// Creates a reservation in each of several events, all of them or none.
+/// @param num_events Number of events, at most MAX_MULTI_EVENTS, none repeated.
+/// @param event_ids Array of ids of the events.
+/// @param num_seats Array of numbers of seats to reserve in each event.
+/// @param xs Array of rows of the seats to reserve, those of each event after those of the event before it.
+/// @param ys Array of columns of the seats to reserve, in the same order as xs.
+/// @return 0 if every reservation was created successfully, 1 otherwise.
+int ems_reserve_multi(size_t num_events, unsigned int* event_ids, size_t* num_seats, size_t* xs, size_t* ys);
+
+/// Reserves adjacent seats of the given event wherever they are free, preferring front rows.
+/// @param event_id Id of the event to create a reservation for.
+/// @param num_seats Number of adjacent seats to reserve, at most MAX_RESERVATION_SIZE.
+/// @param xs Where to store the rows of the reserved seats.
+/// @param ys Where to store the columns of the reserved seats.
+/// @return 0 if the reservation was created successfully, 1 otherwise.
+int ems_reserve_best(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys);
+
+/// Holds seats of the given event until they are confirmed or the time runs out.
+/// @param event_id Id of the event to hold seats of.
+/// @param seconds Seconds until the hold expires, at most MAX_HOLD_SECONDS.
+/// @param num_seats Number of seats to hold.
+/// @param xs Array of rows of the seats to hold.
+/// @param ys Array of columns of the seats to hold.
+/// @param hold_id Where to store the id of the hold.
+/// @return 0 if the seats were held successfully, 1 otherwise.
+int ems_hold(unsigned int event_id, unsigned int seconds, size_t num_seats, size_t* xs, size_t* ys,
+             unsigned int* hold_id);
+
+/// Turns a hold into a reservation before it expires.
+/// @param event_id Id of the event of the hold.
+/// @param hold_id Id of the hold.
+/// @return 0 if the hold was confirmed successfully, 1 otherwise.
+int ems_confirm(unsigned int event_id, unsigned int hold_id);
+
+/// Cancels a reservation, or a hold before it expires, freeing its seats.
+/// @param event_id Id of the event of the reservation.
+/// @param reservation_id Id of the reservation, as shown by SHOW (or of the hold).
+/// @return 0 if the reservation was cancelled successfully, 1 otherwise.
+int ems_cancel(unsigned int event_id, unsigned int reservation_id);
+
+/// Deletes the given event.
+/// @param event_id Id of the event to delete.
+/// @return 0 if the event was deleted successfully, 1 otherwise.
+int ems_delete(unsigned int event_id);
+
 /// Prints the given event to the given file.
 /// @param out_fd File descriptor to print the event to.
 /// @param event_id Id of the event to print.
 /// @return 0 if the event was printed successfully, 1 otherwise.
 int ems_show(int out_fd, unsigned int event_id);
 
-/// Prints all the events to the given file.
+/// Prints the given event to the given file, like ems_show, and gets the version of what was printed.
+/// @note The version counts the reservations committed to the event, so two shows that return the same
+/// version printed the same seats. It only grows while the event exists.
+/// @param out_fd File descriptor to print the event to.
+/// @param event_id Id of the event to print.
+/// @param version Where to store the version of the seats, may be NULL.
+/// @return 0 if the event was printed successfully, 1 otherwise.
+int ems_show_version(int out_fd, unsigned int event_id, uint64_t* version);
+
+/// Prints all the events to the given file, in ascending order of id.
+/// @note The ids are requested one page at a time, so memory use does not grow with the number of events.
 /// @param out_fd File descriptor to print the events to.
 /// @return 0 if the events were printed successfully, 1 otherwise.
 int ems_list_events(int out_fd);
@@ -6,6 +6,7 @@
 #include <errno.h>
 #include "api.h"
 #include "common/constants.h"
+#include "common/io.h"
 #include "parser.h"
 
 
@@ -49,18 +50,22 @@ int main(int argc, char* argv[]) {
 
   while (1) {
     unsigned int event_id;
-    size_t num_rows, num_columns, num_coords;
+    size_t num_rows, num_columns, num_stripes, num_coords;
     unsigned int delay = 0;
+    unsigned int seconds, hold_id, reservation_id;
     size_t xs[MAX_RESERVATION_SIZE], ys[MAX_RESERVATION_SIZE];
+    unsigned int event_ids[MAX_MULTI_EVENTS];
+    size_t num_events, num_seats[MAX_MULTI_EVENTS];
+    size_t multi_xs[MAX_MULTI_EVENTS * MAX_RESERVATION_SIZE], multi_ys[MAX_MULTI_EVENTS * MAX_RESERVATION_SIZE];
 
     switch (get_next(in_fd)) {
       case CMD_CREATE:
-        if (parse_create(in_fd, &event_id, &num_rows, &num_columns) != 0) {
+        if (parse_create(in_fd, &event_id, &num_rows, &num_columns, &num_stripes) != 0) {
           fprintf(stderr, "Invalid command. See HELP for usage\n");
           continue;
         }
 
-        if (ems_create(event_id, num_rows, num_columns)) fprintf(stderr, "Failed to create event\n");
+        if (ems_create(event_id, num_rows, num_columns, num_stripes)) fprintf(stderr, "Failed to create event\n");
         break;
 
       case CMD_RESERVE:
@@ -74,6 +79,79 @@ int main(int argc, char* argv[]) {
         if (ems_reserve(event_id, num_coords, xs, ys)) fprintf(stderr, "Failed to reserve seats\n");
         break;
 
+      case CMD_RESERVE_MULTI:
+        num_events = parse_reserve_multi(in_fd, MAX_MULTI_EVENTS, MAX_RESERVATION_SIZE, event_ids, num_seats, multi_xs,
+                                         multi_ys);
+
+        if (num_events == 0) {
+          fprintf(stderr, "Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        if (ems_reserve_multi(num_events, event_ids, num_seats, multi_xs, multi_ys)) {
+          fprintf(stderr, "Failed to reserve seats\n");
+        }
+        break;
+
+      case CMD_RESERVE_BEST:
+        if (parse_reserve_best(in_fd, &event_id, &num_coords) != 0 || num_coords == 0 ||
+            num_coords > MAX_RESERVATION_SIZE) {
+          fprintf(stderr, "Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        if (ems_reserve_best(event_id, num_coords, xs, ys)) {
+          fprintf(stderr, "Failed to reserve seats\n");
+          break;
+        }
+
+        // The seats are printed the way RESERVE takes them
+        char seats[MAX_RESERVATION_SIZE * 48 + 4];
+        size_t length = 0;
+        for (size_t i = 0; i < num_coords; i++) {
+          length += (size_t)sprintf(seats + length, "%c(%zu,%zu)", i > 0 ? ' ' : '[', xs[i], ys[i]);
+        }
+        strcpy(seats + length, "]\n");
+        if (print_str(out_fd, seats)) perror("Error writing to file descriptor");
+        break;
+
+      case CMD_HOLD:
+        num_coords = parse_hold(in_fd, MAX_RESERVATION_SIZE, &event_id, &seconds, xs, ys);
+
+        if (num_coords == 0) {
+          fprintf(stderr, "Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        if (ems_hold(event_id, seconds, num_coords, xs, ys, &hold_id)) {
+          fprintf(stderr, "Failed to hold seats\n");
+          break;
+        }
+
+        // The id is what CONFIRM takes
+        char hold[32];
+        sprintf(hold, "Hold %u\n", hold_id);
+        if (print_str(out_fd, hold)) perror("Error writing to file descriptor");
+        break;
+
+      case CMD_CONFIRM:
+        if (parse_confirm(in_fd, &event_id, &hold_id) != 0) {
+          fprintf(stderr, "Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        if (ems_confirm(event_id, hold_id)) fprintf(stderr, "Failed to confirm hold\n");
+        break;
+
+      case CMD_CANCEL:
+        if (parse_cancel(in_fd, &event_id, &reservation_id) != 0) {
+          fprintf(stderr, "Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        if (ems_cancel(event_id, reservation_id)) fprintf(stderr, "Failed to cancel reservation\n");
+        break;
+
       case CMD_SHOW:
         if (parse_show(in_fd, &event_id) != 0) {
           fprintf(stderr, "Invalid command. See HELP for usage\n");
@@ -83,6 +161,15 @@ int main(int argc, char* argv[]) {
         if (ems_show(out_fd, event_id)) fprintf(stderr, "Failed to show event\n");
         break;
 
+      case CMD_DELETE:
+        if (parse_delete(in_fd, &event_id) != 0) {
+          fprintf(stderr, "Invalid command. See HELP for usage\n");
+          continue;
+        }
+
+        if (ems_delete(event_id)) fprintf(stderr, "Failed to delete event\n");
+        break;
+
       case CMD_LIST_EVENTS:
         if (ems_list_events(out_fd)) fprintf(stderr, "Failed to list events\n");
         break;
@@ -106,9 +193,15 @@ int main(int argc, char* argv[]) {
       case CMD_HELP:
         printf(
             "Available commands:\n"
-            "  CREATE <event_id> <num_rows> <num_columns>\n"
+            "  CREATE <event_id> <num_rows> <num_columns> [<num_stripes>]\n"
             "  RESERVE <event_id> [(<x1>,<y1>) (<x2>,<y2>) ...]\n"
+            "  RESERVE_MULTI <event_id> [(<x1>,<y1>) ...] <event_id> [(<x1>,<y1>) ...] ...\n"
+            "  RESERVE_BEST <event_id> <num_seats>\n"
+            "  HOLD <event_id> <seconds> [(<x1>,<y1>) (<x2>,<y2>) ...]\n"
+            "  CONFIRM <event_id> <hold_id>\n"
+            "  CANCEL <event_id> <reservation_id>\n"
             "  SHOW <event_id>\n"
+            "  DELETE <event_id>\n"
             "  LIST\n"
             "  WAIT <delay_ms>\n"
             "  HELP\n");
@@ -22,20 +22,52 @@ enum Command get_next(int fd) {
 
   switch (buf[0]) {
     case 'C':
-      if (read(fd, buf + 1, 6) != 6 || strncmp(buf, "CREATE ", 7) != 0) {
+      if (read(fd, buf + 1, 6) != 6 ||
+          (strncmp(buf, "CREATE ", 7) != 0 && strncmp(buf, "CONFIRM", 7) != 0 && strncmp(buf, "CANCEL ", 7) != 0)) {
         cleanup(fd);
         return CMD_INVALID;
       }
 
-      return CMD_CREATE;
+      if (buf[1] == 'R') {
+        return CMD_CREATE;
+      }
+
+      if (buf[1] == 'A') {
+        return CMD_CANCEL;
+      }
+
+      if (read(fd, buf + 7, 1) != 1 || buf[7] != ' ') {
+        cleanup(fd);
+        return CMD_INVALID;
+      }
+
+      return CMD_CONFIRM;
 
     case 'R':
-      if (read(fd, buf + 1, 7) != 7 || strncmp(buf, "RESERVE ", 8) != 0) {
+      if (read(fd, buf + 1, 7) != 7 || strncmp(buf, "RESERVE", 7) != 0 || (buf[7] != ' ' && buf[7] != '_')) {
         cleanup(fd);
         return CMD_INVALID;
       }
 
-      return CMD_RESERVE;
+      if (buf[7] == ' ') {
+        return CMD_RESERVE;
+      }
+
+      if (read(fd, buf + 8, 5) != 5 || (strncmp(buf, "RESERVE_BEST ", 13) != 0 && strncmp(buf, "RESERVE_MULTI", 13) != 0)) {
+        cleanup(fd);
+        return CMD_INVALID;
+      }
+
+      if (buf[8] == 'B') {
+        return CMD_RESERVE_BEST;
+      }
+
+      if (read(fd, buf + 13, 1) != 1 || buf[13] != ' ') {
+        cleanup(fd);
+        return CMD_INVALID;
+      }
+
+      return CMD_RESERVE_MULTI;
 
     case 'S':
       if (read(fd, buf + 1, 4) != 4 || strncmp(buf, "SHOW ", 5) != 0) {
@@ -45,6 +77,14 @@ enum Command get_next(int fd) {
 
       return CMD_SHOW;
 
+    case 'D':
+      if (read(fd, buf + 1, 6) != 6 || strncmp(buf, "DELETE ", 7) != 0) {
+        cleanup(fd);
+        return CMD_INVALID;
+      }
+
+      return CMD_DELETE;
+
     case 'L':
       if (read(fd, buf + 1, 3) != 3 || strncmp(buf, "LIST", 4) != 0) {
         cleanup(fd);
@@ -67,11 +107,20 @@ enum Command get_next(int fd) {
       return CMD_WAIT;
 
     case 'H':
-      if (read(fd, buf + 1, 3) != 3 || strncmp(buf, "HELP", 4) != 0) {
+      if (read(fd, buf + 1, 3) != 3 || (strncmp(buf, "HELP", 4) != 0 && strncmp(buf, "HOLD", 4) != 0)) {
         cleanup(fd);
         return CMD_INVALID;
       }
 
+      if (buf[1] == 'O') {
+        if (read(fd, buf + 4, 1) != 1 || buf[4] != ' ') {
+          cleanup(fd);
+          return CMD_INVALID;
+        }
+
+        return CMD_HOLD;
+      }
+
       if (read(fd, buf + 4, 1) != 0 && buf[4] != '\n') {
         cleanup(fd);
         return CMD_INVALID;
@@ -92,7 +141,7 @@ enum Command get_next(int fd) {
   }
 }
 
-int parse_create(int fd, unsigned int *event_id, size_t *num_rows, size_t *num_cols) {
+int parse_create(int fd, unsigned int *event_id, size_t *num_rows, size_t *num_cols, size_t *num_stripes) {
   char ch;
 
   if (parse_uint(fd, event_id, &ch) != 0 || ch != ' ') {
@@ -108,23 +157,33 @@ int parse_create(int fd, unsigned int *event_id, size_t *num_rows, size_t *num_c
   *num_rows = (size_t)u_num_rows;
 
   unsigned int u_num_cols;
-  if (parse_uint(fd, &u_num_cols, &ch) != 0 || (ch != '\n' && ch != '\0')) {
+  if (parse_uint(fd, &u_num_cols, &ch) != 0 || (ch != '\n' && ch != '\0' && ch != ' ')) {
     cleanup(fd);
     return 1;
   }
   *num_cols = (size_t)u_num_cols;
 
+  // The number of stripes is optional
+  unsigned int u_num_stripes = 0;
+  if (ch == ' ' && (parse_uint(fd, &u_num_stripes, &ch) != 0 || (ch != '\n' && ch != '\0'))) {
+    cleanup(fd);
+    return 1;
+  }
+  *num_stripes = (size_t)u_num_stripes;
+
   return 0;
 }
 
-size_t parse_reserve(int fd, size_t max, unsigned int *event_id, size_t *xs, size_t *ys) {
+/// Parses a list of seats, and the character that follows it.
+/// @param fd File descriptor to read from.
+/// @param max Maximum number of coordinates to read.
+/// @param xs Pointer to the array to store the X coordinates in.
+/// @param ys Pointer to the array to store the Y coordinates in.
+/// @param next Pointer to the variable to store the character after the list in.
+/// @return Number of coordinates read. 0 on failure, with the rest of the line skipped.
+static size_t parse_seat_list(int fd, size_t max, size_t *xs, size_t *ys, char *next) {
   char ch;
 
-  if (parse_uint(fd, event_id, &ch) != 0 || ch != ' ') {
-    cleanup(fd);
-    return 0;
-  }
-
   if (read(fd, &ch, 1) != 1 || ch != '[') {
     cleanup(fd);
     return 0;
@@ -168,7 +227,28 @@ size_t parse_reserve(int fd, size_t max, unsigned int *event_id, size_t *xs, siz
     return 0;
   }
 
-  if (read(fd, &ch, 1) != 1 || (ch != '\n' && ch != '\0')) {
+  if (read(fd, next, 1) != 1) {
+    return 0;
+  }
+
+  return num_coords;
+}
+
+/// Parses the list of seats that ends a RESERVE or HOLD command, up to the end of the line.
+/// @param fd File descriptor to read from.
+/// @param max Maximum number of coordinates to read.
+/// @param xs Pointer to the array to store the X coordinates in.
+/// @param ys Pointer to the array to store the Y coordinates in.
+/// @return Number of coordinates read. 0 on failure.
+static size_t parse_seats(int fd, size_t max, size_t *xs, size_t *ys) {
+  char ch;
+  size_t num_coords = parse_seat_list(fd, max, xs, ys, &ch);
+
+  if (num_coords == 0) {
+    return 0;
+  }
+
+  if (ch != '\n' && ch != '\0') {
     cleanup(fd);
     return 0;
   }
@@ -176,6 +256,111 @@ size_t parse_reserve(int fd, size_t max, unsigned int *event_id, size_t *xs, siz
   return num_coords;
 }
 
+size_t parse_reserve(int fd, size_t max, unsigned int *event_id, size_t *xs, size_t *ys) {
+  char ch;
+
+  if (parse_uint(fd, event_id, &ch) != 0 || ch != ' ') {
+    cleanup(fd);
+    return 0;
+  }
+
+  return parse_seats(fd, max, xs, ys);
+}
+
+size_t parse_reserve_multi(int fd, size_t max_events, size_t max_seats, unsigned int *event_ids, size_t *num_seats,
+                           size_t *xs, size_t *ys) {
+  char ch = ' ';
+  size_t num_events = 0;
+  size_t first_seat = 0;
+
+  while (ch == ' ') {
+    if (num_events == max_events) {
+      cleanup(fd);
+      return 0;
+    }
+
+    if (parse_uint(fd, &event_ids[num_events], &ch) != 0 || ch != ' ') {
+      cleanup(fd);
+      return 0;
+    }
+
+    num_seats[num_events] = parse_seat_list(fd, max_seats, xs + first_seat, ys + first_seat, &ch);
+    if (num_seats[num_events] == 0) {
+      return 0;
+    }
+    first_seat += num_seats[num_events];
+    num_events++;
+  }
+
+  if (ch != '\n' && ch != '\0') {
+    cleanup(fd);
+    return 0;
+  }
+
+  return num_events;
+}
+
+size_t parse_hold(int fd, size_t max, unsigned int *event_id, unsigned int *seconds, size_t *xs, size_t *ys) {
+  char ch;
+
+  if (parse_uint(fd, event_id, &ch) != 0 || ch != ' ') {
+    cleanup(fd);
+    return 0;
+  }
+
+  if (parse_uint(fd, seconds, &ch) != 0 || ch != ' ') {
+    cleanup(fd);
+    return 0;
+  }
+
+  return parse_seats(fd, max, xs, ys);
+}
+
+/// Parses the two ids of a CONFIRM or CANCEL command, up to the end of the line.
+/// @param fd File descriptor to read from.
+/// @param event_id Pointer to the variable to store the event ID in.
+/// @param id Pointer to the variable to store the second ID in.
+/// @return 0 if the ids were parsed successfully, 1 otherwise.
+static int parse_ids(int fd, unsigned int *event_id, unsigned int *id) {
+  char ch;
+
+  if (parse_uint(fd, event_id, &ch) != 0 || ch != ' ') {
+    cleanup(fd);
+    return 1;
+  }
+
+  if (parse_uint(fd, id, &ch) != 0 || (ch != '\n' && ch != '\0')) {
+    cleanup(fd);
+    return 1;
+  }
+
+  return 0;
+}
+
+int parse_confirm(int fd, unsigned int *event_id, unsigned int *hold_id) { return parse_ids(fd, event_id, hold_id); }
+
+int parse_cancel(int fd, unsigned int *event_id, unsigned int *reservation_id) {
+  return parse_ids(fd, event_id, reservation_id);
+}
+
+int parse_reserve_best(int fd, unsigned int *event_id, size_t *num_seats) {
+  char ch;
+
+  if (parse_uint(fd, event_id, &ch) != 0 || ch != ' ') {
+    cleanup(fd);
+    return 1;
+  }
+
+  unsigned int u_num_seats;
+  if (parse_uint(fd, &u_num_seats, &ch) != 0 || (ch != '\n' && ch != '\0')) {
+    cleanup(fd);
+    return 1;
+  }
+  *num_seats = (size_t)u_num_seats;
+
+  return 0;
+}
+
 int parse_show(int fd, unsigned int *event_id) {
   char ch;
 
@@ -187,6 +372,17 @@ int parse_show(int fd, unsigned int *event_id) {
   return 0;
 }
 
+int parse_delete(int fd, unsigned int *event_id) {
+  char ch;
+
+  if (parse_uint(fd, event_id, &ch) != 0 || (ch != '\n' && ch != '\0')) {
+    cleanup(fd);
+    return 1;
+  }
+
+  return 0;
+}
+
 int parse_wait(int fd, unsigned int *delay, unsigned int *thread_id) {
   char ch;
 
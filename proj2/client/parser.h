@@ -6,7 +6,13 @@
 enum Command {
   CMD_CREATE,
   CMD_RESERVE,
+  CMD_RESERVE_BEST,
+  CMD_RESERVE_MULTI,
+  CMD_HOLD,
+  CMD_CONFIRM,
+  CMD_CANCEL,
   CMD_SHOW,
+  CMD_DELETE,
   CMD_LIST_EVENTS,
   CMD_WAIT,
   CMD_HELP,
@@ -25,8 +31,9 @@ enum Command get_next(int fd);
 /// @param event_id Pointer to the variable to store the event ID in.
 /// @param num_rows Pointer to the variable to store the number of rows in.
 /// @param num_cols Pointer to the variable to store the number of columns in.
+/// @param num_stripes Pointer to the variable to store the number of row stripes in, 0 if the command has none.
 /// @return 0 if the command was parsed successfully, 1 otherwise.
-int parse_create(int fd, unsigned int *event_id, size_t *num_rows, size_t *num_cols);
+int parse_create(int fd, unsigned int *event_id, size_t *num_rows, size_t *num_cols, size_t *num_stripes);
 
 /// Parses a RESERVE command.
 /// @param fd File descriptor to read from.
@@ -37,12 +44,61 @@ int parse_create(int fd, unsigned int *event_id, size_t *num_rows, size_t *num_c
 /// @return Number of coordinates read. 0 on failure.
 size_t parse_reserve(int fd, size_t max, unsigned int *event_id, size_t *xs, size_t *ys);
 
+/// Parses a RESERVE_BEST command.
+/// @param fd File descriptor to read from.
+/// @param event_id Pointer to the variable to store the event ID in.
+/// @param num_seats Pointer to the variable to store the number of seats in.
+/// @return 0 if the command was parsed successfully, 1 otherwise.
+int parse_reserve_best(int fd, unsigned int *event_id, size_t *num_seats);
+
+/// Parses a RESERVE_MULTI command: event ids, each followed by its list of seats.
+/// @param fd File descriptor to read from.
+/// @param max_events Maximum number of events to read.
+/// @param max_seats Maximum number of coordinates to read per event.
+/// @param event_ids Pointer to the array to store the event IDs in.
+/// @param num_seats Pointer to the array to store the number of coordinates of each event in.
+/// @param xs Pointer to the array to store the X coordinates in, those of each event after those of the event before.
+/// @param ys Pointer to the array to store the Y coordinates in, in the same order.
+/// @return Number of events read. 0 on failure.
+size_t parse_reserve_multi(int fd, size_t max_events, size_t max_seats, unsigned int *event_ids, size_t *num_seats,
+                           size_t *xs, size_t *ys);
+
+/// Parses a HOLD command.
+/// @param fd File descriptor to read from.
+/// @param max Maximum number of coordinates to read.
+/// @param event_id Pointer to the variable to store the event ID in.
+/// @param seconds Pointer to the variable to store the hold time in.
+/// @param xs Pointer to the array to store the X coordinates in.
+/// @param ys Pointer to the array to store the Y coordinates in.
+/// @return Number of coordinates read. 0 on failure.
+size_t parse_hold(int fd, size_t max, unsigned int *event_id, unsigned int *seconds, size_t *xs, size_t *ys);
+
+/// Parses a CONFIRM command.
+/// @param fd File descriptor to read from.
+/// @param event_id Pointer to the variable to store the event ID in.
+/// @param hold_id Pointer to the variable to store the hold ID in.
+/// @return 0 if the command was parsed successfully, 1 otherwise.
+int parse_confirm(int fd, unsigned int *event_id, unsigned int *hold_id);
+
+/// Parses a CANCEL command.
+/// @param fd File descriptor to read from.
+/// @param event_id Pointer to the variable to store the event ID in.
+/// @param reservation_id Pointer to the variable to store the reservation ID in.
+/// @return 0 if the command was parsed successfully, 1 otherwise.
+int parse_cancel(int fd, unsigned int *event_id, unsigned int *reservation_id);
+
 /// Parses a SHOW command.
 /// @param fd File descriptor to read from.
 /// @param event_id Pointer to the variable to store the event ID in.
 /// @return 0 if the command was parsed successfully, 1 otherwise.
 int parse_show(int fd, unsigned int *event_id);
 
+/// Parses a DELETE command.
+/// @param fd File descriptor to read from.
+/// @param event_id Pointer to the variable to store the event ID in.
+/// @return 0 if the command was parsed successfully, 1 otherwise.
+int parse_delete(int fd, unsigned int *event_id);
+
 /// Parses a WAIT command.
 /// @param fd File descriptor to read from.
 /// @param delay Pointer to the variable to store the wait delay in.
@@ -3,4 +3,7 @@
 #define MAX_JOB_FILE_NAME_SIZE 256
 #define MAX_SESSION_COUNT 5
 #define MAX_PIPE_NAME_SIZE 40
-#define MAX_CLIENTS_WAITING 4
\ No newline at end of file
+#define MAX_CLIENTS_WAITING 4
+#define MAX_LIST_PAGE_SIZE 1024  // Maximum number of event ids in a page of LIST_PAGE
+#define MAX_HOLD_SECONDS 86400   // Longest a HOLD can keep its seats
+#define MAX_MULTI_EVENTS 8       // Most events a RESERVE_MULTI can book together
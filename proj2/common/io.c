@@ -5,6 +5,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <signal.h>
 
 pthread_mutex_t print_mutex = PTHREAD_MUTEX_INITIALIZER;
 
@@ -127,4 +128,11 @@ ssize_t safe_read(int fd, void * buffer, size_t bytesToRead){
     bytesRead += n;
   }
   return bytesRead;
-}
\ No newline at end of file
+}
+
+void block_sigusr1() {
+  sigset_t mask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &mask, NULL);
+}
@@ -34,5 +34,9 @@ int lock_printf();
 
 int unlock_printf();
 
+/// Blocks SIGUSR1 in the calling thread, leaving it to the main thread (which dumps the events on it) like
+/// the worker threads do.
+void block_sigusr1();
+
 
 #endif  // COMMON_IO_H
@@ -0,0 +1,314 @@
+#define _DEFAULT_SOURCE  // MAP_ANONYMOUS and MADV_HUGEPAGE
+
+#include "alloc.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#define SLAB_BLOCK_OBJECTS 256           // Objects carved from each slab block
+#define ARENA_CHUNK_SIZE (1UL << 20)     // Size of each arena chunk
+#define HUGE_PAGE_SIZE (2UL << 20)       // Size and alignment of the chunks with huge pages
+#define ARENA_ALIGNMENT 16
+#define RECYCLE_BUCKETS 64               // Buckets of the recycled memory map
+
+// Per-thread bump arena
+struct Arena {
+  char* bump;           // Next free byte of the current chunk
+  char* end;            // End of the current chunk
+  void* chunks;         // Chunks mapped with mmap, linked through their first word
+  struct Arena* next;   // Next arena in the global list
+};
+
+// Chunk header, placed at the start of every chunk
+struct ChunkHeader {
+  void* next;
+  size_t size;  // Size of the mapping, header included
+  char padding[CACHE_LINE_SIZE - sizeof(void*) - sizeof(size_t)];
+};
+
+// Recycled memory of a single size
+struct RecycleClass {
+  size_t size;                 // Size of the memory in this class
+  void* free_list;             // Recycled memory, linked through its first word
+  struct RecycleClass* next;   // Next class in the same bucket
+};
+
+// Recycled memory, keyed by size
+static pthread_mutex_t recycle_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct RecycleClass* recycle_buckets[RECYCLE_BUCKETS];
+static _Atomic size_t recycled_count = 0;  // Lets arena_alloc skip the lock when nothing was recycled
+
+static pthread_mutex_t arenas_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct Arena* arenas = NULL;
+static _Thread_local struct Arena* local_arena = NULL;
+
+static _Atomic int huge_pages = 0;  // Set by alloc_set_huge_pages
+
+static _Atomic unsigned long slab_allocs = 0;
+static _Atomic unsigned long slab_blocks = 0;
+static _Atomic unsigned long arena_allocs = 0;
+static _Atomic unsigned long arena_chunks = 0;
+static _Atomic size_t arena_bytes = 0;
+static _Atomic unsigned long arena_reused = 0;
+
+int slab_init(struct Slab* slab, size_t object_size) {
+  if (object_size < sizeof(void*)) object_size = sizeof(void*);
+  // Keep every object aligned for any member type, and objects of a cache line or more on lines of their own
+  size_t alignment = object_size >= CACHE_LINE_SIZE ? CACHE_LINE_SIZE : ARENA_ALIGNMENT;
+  slab->object_size = (object_size + alignment - 1) & ~(alignment - 1);
+  slab->free_list = NULL;
+  slab->blocks = NULL;
+  slab->bump = NULL;
+  slab->bump_end = NULL;
+  return pthread_mutex_init(&slab->mutex, NULL) != 0;
+}
+
+void* slab_alloc(struct Slab* slab) {
+  pthread_mutex_lock(&slab->mutex);
+
+  void* object = slab->free_list;
+  if (object != NULL) {
+    slab->free_list = *(void**)object;
+  } else {
+    if (slab->bump == slab->bump_end) {
+      // The link to the next block takes a whole line, so the objects after it start on one
+      char* block = aligned_alloc(CACHE_LINE_SIZE, CACHE_LINE_SIZE + SLAB_BLOCK_OBJECTS * slab->object_size);
+      if (block == NULL) {
+        pthread_mutex_unlock(&slab->mutex);
+        return NULL;
+      }
+      *(void**)block = slab->blocks;
+      slab->blocks = block;
+      slab->bump = block + CACHE_LINE_SIZE;
+      slab->bump_end = slab->bump + SLAB_BLOCK_OBJECTS * slab->object_size;
+      atomic_fetch_add_explicit(&slab_blocks, 1, memory_order_relaxed);
+    }
+    object = slab->bump;
+    slab->bump += slab->object_size;
+  }
+
+  pthread_mutex_unlock(&slab->mutex);
+  atomic_fetch_add_explicit(&slab_allocs, 1, memory_order_relaxed);
+  return object;
+}
+
+void slab_free(struct Slab* slab, void* object) {
+  if (object == NULL) return;
+
+  pthread_mutex_lock(&slab->mutex);
+  *(void**)object = slab->free_list;
+  slab->free_list = object;
+  pthread_mutex_unlock(&slab->mutex);
+}
+
+void slab_release(struct Slab* slab) {
+  pthread_mutex_lock(&slab->mutex);
+  while (slab->blocks != NULL) {
+    void* block = slab->blocks;
+    slab->blocks = *(void**)block;
+    free(block);
+  }
+  slab->free_list = NULL;
+  slab->bump = NULL;
+  slab->bump_end = NULL;
+  pthread_mutex_unlock(&slab->mutex);
+}
+
+/// Gets the arena of the calling thread, creating it on first use.
+/// @return The arena, NULL on allocation failure.
+static struct Arena* get_arena() {
+  if (local_arena != NULL) return local_arena;
+
+  struct Arena* arena = calloc(1, sizeof(struct Arena));
+  if (arena == NULL) return NULL;
+
+  pthread_mutex_lock(&arenas_mutex);
+  arena->next = arenas;
+  arenas = arena;
+  pthread_mutex_unlock(&arenas_mutex);
+
+  local_arena = arena;
+  return arena;
+}
+
+/// Maps memory for a chunk, aligned to a huge page and advised as huge pages if they are enabled.
+/// @param size Size of the mapping.
+/// @return Zeroed memory that no thread touched yet, NULL on failure.
+static void* map_chunk(size_t size) {
+  if (!atomic_load_explicit(&huge_pages, memory_order_relaxed)) {
+    void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return memory == MAP_FAILED ? NULL : memory;
+  }
+
+  // The kernel only backs whole aligned huge pages, so a larger mapping is trimmed to an aligned one
+  char* memory = mmap(NULL, size + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED) return NULL;
+  size_t head = (HUGE_PAGE_SIZE - (uintptr_t)memory % HUGE_PAGE_SIZE) % HUGE_PAGE_SIZE;
+  if (head > 0) munmap(memory, head);
+  munmap(memory + head + size, HUGE_PAGE_SIZE - head);
+  madvise(memory + head, size, MADV_HUGEPAGE);  // Only a hint: without THP the chunk still works
+  return memory + head;
+}
+
+/// Adds a chunk to an arena.
+/// @param arena Arena to grow.
+/// @param size Usable size of the chunk.
+/// @return Start of the usable memory of the chunk, NULL on failure.
+static char* arena_add_chunk(struct Arena* arena, size_t size) {
+  size_t mapped = sizeof(struct ChunkHeader) + size;
+  if (atomic_load_explicit(&huge_pages, memory_order_relaxed)) {
+    mapped = (mapped + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+  }
+  struct ChunkHeader* chunk = map_chunk(mapped);
+  if (chunk == NULL) return NULL;
+  chunk->size = mapped;
+
+  // The list is only walked by alloc_release_all, but the arena may be read by it from another thread
+  pthread_mutex_lock(&arenas_mutex);
+  chunk->next = arena->chunks;
+  arena->chunks = chunk;
+  pthread_mutex_unlock(&arenas_mutex);
+
+  atomic_fetch_add_explicit(&arena_chunks, 1, memory_order_relaxed);
+  return (char*)(chunk + 1);
+}
+
+/// Finds the recycle class of a size.
+/// @note The caller must hold recycle_mutex.
+/// @param size Aligned size.
+/// @param create Whether to create the class if it does not exist.
+/// @return The class, NULL if it does not exist (or could not be created).
+static struct RecycleClass* recycle_class(size_t size, int create) {
+  struct RecycleClass** bucket = &recycle_buckets[(size / ARENA_ALIGNMENT) % RECYCLE_BUCKETS];
+  for (struct RecycleClass* class = *bucket; class != NULL; class = class->next) {
+    if (class->size == size) return class;
+  }
+  if (!create) return NULL;
+
+  struct RecycleClass* class = malloc(sizeof(struct RecycleClass));
+  if (class == NULL) return NULL;
+  class->size = size;
+  class->free_list = NULL;
+  class->next = *bucket;
+  *bucket = class;
+  return class;
+}
+
+/// Takes recycled memory of the given size, if there is any.
+/// @param size Aligned size.
+/// @return Zeroed memory, NULL if none was recycled.
+static void* recycle_take(size_t size) {
+  if (atomic_load_explicit(&recycled_count, memory_order_relaxed) == 0) return NULL;
+
+  pthread_mutex_lock(&recycle_mutex);
+  struct RecycleClass* class = recycle_class(size, 0);
+  void* memory = class == NULL ? NULL : class->free_list;
+  if (memory != NULL) {
+    class->free_list = *(void**)memory;
+    atomic_fetch_sub_explicit(&recycled_count, 1, memory_order_relaxed);
+  }
+  pthread_mutex_unlock(&recycle_mutex);
+
+  if (memory != NULL) {
+    memset(memory, 0, size);
+    atomic_fetch_add_explicit(&arena_reused, 1, memory_order_relaxed);
+  }
+  return memory;
+}
+
+void arena_recycle(void* ptr, size_t size) {
+  if (ptr == NULL) return;
+
+  size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+  if (size == 0) size = ARENA_ALIGNMENT;
+
+  pthread_mutex_lock(&recycle_mutex);
+  struct RecycleClass* class = recycle_class(size, 1);
+  if (class != NULL) {
+    *(void**)ptr = class->free_list;
+    class->free_list = ptr;
+    atomic_fetch_add_explicit(&recycled_count, 1, memory_order_relaxed);
+  }
+  pthread_mutex_unlock(&recycle_mutex);
+}
+
+void* arena_alloc(size_t size) {
+  size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+  if (size == 0) size = ARENA_ALIGNMENT;
+
+  void* recycled = recycle_take(size);
+  if (recycled != NULL) return recycled;
+
+  struct Arena* arena = get_arena();
+  if (arena == NULL) return NULL;
+
+  // Memory recycled at this size was aligned the same way when it was first handed out
+  size_t alignment = size >= CACHE_LINE_SIZE ? CACHE_LINE_SIZE : ARENA_ALIGNMENT;
+  char* memory;
+  if (size > ARENA_CHUNK_SIZE / 4) {
+    // Large grids get a chunk of their own so they do not waste the rest of the current one
+    memory = arena_add_chunk(arena, size);
+    if (memory == NULL) return NULL;
+  } else {
+    size_t padding = (alignment - (uintptr_t)arena->bump % alignment) % alignment;
+    if ((size_t)(arena->end - arena->bump) < padding + size) {
+      // With huge pages the chunk fills the rest of its huge page
+      size_t chunk_size = atomic_load_explicit(&huge_pages, memory_order_relaxed)
+                              ? HUGE_PAGE_SIZE - sizeof(struct ChunkHeader)
+                              : ARENA_CHUNK_SIZE;
+      char* chunk = arena_add_chunk(arena, chunk_size);
+      if (chunk == NULL) return NULL;
+      arena->bump = chunk;
+      arena->end = chunk + chunk_size;
+      padding = 0;
+    }
+    memory = arena->bump + padding;
+    arena->bump = memory + size;
+  }
+
+  atomic_fetch_add_explicit(&arena_allocs, 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&arena_bytes, size, memory_order_relaxed);
+  return memory;
+}
+
+void alloc_set_huge_pages(int enabled) { atomic_store_explicit(&huge_pages, enabled, memory_order_relaxed); }
+
+void alloc_release_all() {
+  // Recycled memory belongs to the chunks released below
+  pthread_mutex_lock(&recycle_mutex);
+  for (size_t i = 0; i < RECYCLE_BUCKETS; i++) {
+    while (recycle_buckets[i] != NULL) {
+      struct RecycleClass* class = recycle_buckets[i];
+      recycle_buckets[i] = class->next;
+      free(class);
+    }
+  }
+  atomic_store_explicit(&recycled_count, 0, memory_order_relaxed);
+  pthread_mutex_unlock(&recycle_mutex);
+
+  pthread_mutex_lock(&arenas_mutex);
+  for (struct Arena* arena = arenas; arena != NULL; arena = arena->next) {
+    while (arena->chunks != NULL) {
+      struct ChunkHeader* chunk = arena->chunks;
+      arena->chunks = chunk->next;
+      munmap(chunk, chunk->size);
+    }
+    // Threads keep their arena, which starts over with a new chunk
+    arena->bump = NULL;
+    arena->end = NULL;
+  }
+  pthread_mutex_unlock(&arenas_mutex);
+}
+
+void alloc_get_stats(struct AllocStats* stats) {
+  stats->slab_allocs = atomic_load_explicit(&slab_allocs, memory_order_relaxed);
+  stats->slab_blocks = atomic_load_explicit(&slab_blocks, memory_order_relaxed);
+  stats->arena_allocs = atomic_load_explicit(&arena_allocs, memory_order_relaxed);
+  stats->arena_chunks = atomic_load_explicit(&arena_chunks, memory_order_relaxed);
+  stats->arena_bytes = atomic_load_explicit(&arena_bytes, memory_order_relaxed);
+  stats->arena_reused = atomic_load_explicit(&arena_reused, memory_order_relaxed);
+}
@@ -0,0 +1,82 @@
+#ifndef SERVER_ALLOC_H
+#define SERVER_ALLOC_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+/// Allocators for the EMS state.
+/// Fixed-size objects (events, list nodes) come from slabs: blocks of objects carved from a single
+/// malloc, recycled through a free list. Seat grids come from a bump arena owned by the calling thread.
+/// Nothing is returned to the system until alloc_release_all, which frees everything in bulk.
+/// Objects and allocations of a cache line or more start on a cache line of their own, so their hot fields
+/// do not share a line with their neighbours. Arena chunks are mapped from the kernel and only touched by
+/// the thread that first writes them, so with the default NUMA policy a grid lands on the node of the
+/// worker that reserves its seats.
+
+#define CACHE_LINE_SIZE 64  // Alignment of objects whose fields are written by different threads
+
+// Allocator for objects of a single size
+struct Slab {
+  size_t object_size;  // Size of each object (at least the size of a pointer)
+  void* free_list;     // Objects that were freed and can be reused
+  void* blocks;        // Blocks allocated with malloc, linked through their first word
+  char* bump;          // Next never-used object of the newest block
+  char* bump_end;      // End of the newest block
+  pthread_mutex_t mutex;
+};
+
+// Allocation counters, used to check that the request path does not reach malloc
+struct AllocStats {
+  unsigned long slab_allocs;   // Objects handed out by slabs
+  unsigned long slab_blocks;   // Blocks slabs requested from malloc
+  unsigned long arena_allocs;  // Allocations handed out by arenas
+  unsigned long arena_chunks;  // Chunks arenas mapped from the kernel
+  size_t arena_bytes;          // Bytes handed out by arenas
+  unsigned long arena_reused;  // Allocations served from recycled memory
+};
+
+/// Initializes a slab.
+/// @param slab Slab to initialize.
+/// @param object_size Size of the objects it hands out.
+/// @return 0 if the slab was initialized successfully, 1 otherwise.
+int slab_init(struct Slab* slab, size_t object_size);
+
+/// Allocates an object from a slab.
+/// @param slab Slab to allocate from.
+/// @return Uninitialized object, NULL on failure.
+void* slab_alloc(struct Slab* slab);
+
+/// Gives an object back to its slab.
+/// @param slab Slab the object was allocated from.
+/// @param object Object to free, may be NULL.
+void slab_free(struct Slab* slab, void* object);
+
+/// Releases every block of a slab, including the objects still in use.
+/// @param slab Slab to release.
+void slab_release(struct Slab* slab);
+
+/// Allocates zeroed memory, reusing recycled memory of the same size or else the arena of the calling thread.
+/// @param size Number of bytes to allocate.
+/// @return Zeroed memory, NULL on failure. Only released by alloc_release_all.
+void* arena_alloc(size_t size);
+
+/// Gives memory from an arena back so a later arena_alloc of the same size can reuse it.
+/// @param ptr Memory returned by arena_alloc, may be NULL.
+/// @param size Size that was passed to arena_alloc.
+void arena_recycle(void* ptr, size_t size);
+
+/// Makes arena chunks from now on 2 MiB aligned and advised as transparent huge pages (MADV_HUGEPAGE), so
+/// large grids need fewer TLB entries and page faults. Off by default, since every chunk then takes at least
+/// a huge page once touched.
+/// @param enabled Whether to use huge pages.
+void alloc_set_huge_pages(int enabled);
+
+/// Releases the arenas of every thread.
+/// @note Must only be called when no other thread is using them.
+void alloc_release_all();
+
+/// Gets the allocation counters.
+/// @param stats Where to store the counters.
+void alloc_get_stats(struct AllocStats* stats);
+
+#endif  // SERVER_ALLOC_H
@@ -0,0 +1,356 @@
+#include "checkpoint.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "epoch.h"
+#include "seatgrid.h"
+#include "seatmap.h"
+
+#define CHECKPOINT_CHAIN_LENGTH 8     // Incremental checkpoints written before the chain is compacted
+#define CHECKPOINT_TMP_SUFFIX ".tmp"  // Suffix of the file a checkpoint is written to before being renamed
+
+static uint32_t generation = 0;     // Generation of the current snapshot, 0 if there is none
+static uint64_t next_sequence = 1;  // Position of the next incremental checkpoint in the chain
+static int needs_snapshot = 1;      // Set when the next checkpoint must be a full snapshot
+
+/// Builds the path of an incremental checkpoint.
+/// @param path Path of the snapshot.
+/// @param sequence Position of the checkpoint in the chain.
+/// @param suffix Suffix appended to the path.
+/// @return Newly allocated path, NULL on failure.
+static char* increment_path(const char* path, uint64_t sequence, const char* suffix) {
+  size_t size = strlen(path) + strlen(suffix) + 22;
+  char* result = malloc(size);
+  if (result == NULL) return NULL;
+  snprintf(result, size, "%s.%lu%s", path, (unsigned long)sequence, suffix);
+  return result;
+}
+
+/// Reads a whole file.
+/// @param path Path of the file.
+/// @param size Set to the size of the file.
+/// @return Newly allocated contents of the file, NULL if it does not exist or could not be read.
+static char* read_file(const char* path, size_t* size) {
+  int fd = open(path, O_RDONLY);
+  if (fd == -1) return NULL;
+
+  struct stat st;
+  char* data = NULL;
+  if (fstat(fd, &st) == 0 && (data = malloc(st.st_size == 0 ? 1 : (size_t)st.st_size)) != NULL) {
+    *size = (size_t)st.st_size;
+    for (size_t done = 0; done < *size;) {
+      ssize_t n = read(fd, data + done, *size - done);
+      if (n <= 0) {
+        free(data);
+        data = NULL;
+        break;
+      }
+      done += (size_t)n;
+    }
+  }
+  close(fd);
+  return data;
+}
+
+/// Applies the records of an incremental checkpoint.
+/// @note The caller must hold the list rwl for writing.
+/// @param list Event list to be modified.
+/// @param data Records of the checkpoint.
+/// @param size Size of the records.
+/// @param num_records Number of records.
+/// @return 0 if every record was applied, 1 if the checkpoint is corrupted.
+static int apply_increment(struct EventList* list, const char* data, size_t size, uint64_t num_records) {
+  size_t offset = 0;
+  for (uint64_t i = 0; i < num_records; i++) {
+    struct CheckpointRecord record;
+    if (size - offset < sizeof(record)) return 1;
+    memcpy(&record, data + offset, sizeof(record));
+    offset += sizeof(record);
+
+    struct Event* event = get_event(list, record.id);
+    if (record.type == CHECKPOINT_REMOVED) {
+      if (event == NULL) continue;
+      remove_from_list(list, event);
+      list->num_events--;
+      retire_event(event);
+      continue;
+    }
+
+    if (record.cols != 0 && record.rows > SIZE_MAX / sizeof(unsigned int) / record.cols) return 1;
+    size_t seats = record.type == CHECKPOINT_EVENT ? 0 : record.cols;
+    if (seats * sizeof(unsigned int) > size - offset) return 1;
+
+    // Seats are always saved as unsigned ints, and stored in the width of the event
+    const unsigned int* ids = (const unsigned int*)(data + offset);
+    if (record.type == CHECKPOINT_EVENT) {
+      // Removals come first in a checkpoint, so an event with the same id is never still there
+      if (event != NULL) return 1;
+      event = create_event(record.id, record.rows, record.cols, record.stripes);
+      if (event == NULL) return 1;
+      if (append_to_list(list, event) != 0) {
+        free_event(event);
+        return 1;
+      }
+      list->num_events++;
+      if (widen_seats(event, record.reservations) != 0) return 1;
+      event->checkpointed = 1;
+    } else if (record.type == CHECKPOINT_ROW) {
+      if (event == NULL || record.rows >= event->rows || record.cols != event->cols) return 1;
+      if (widen_seats(event, record.reservations) != 0) return 1;
+      if (seatgrid_write(event->data, event->width, event->rows * event->cols, record.rows * event->cols, seats,
+                         ids) != 0) {
+        return 1;
+      }
+      seatmap_fill(event->occupied, record.rows * event->cols, ids, seats);
+    } else {
+      return 1;
+    }
+    if (record.reservations > event->reservations) event->reservations = record.reservations;
+    event->version = event->reservations;
+    offset += seats * sizeof(unsigned int);
+  }
+  return 0;
+}
+
+int checkpoint_load(struct EventList* list, const char* path, struct SnapshotImage* image) {
+  if (snapshot_load(list, path, image) != 0) return 1;
+
+  generation = image->generation;
+  next_sequence = 1;
+  needs_snapshot = image->base == NULL;
+  if (image->base == NULL) return 0;
+
+  int failed = 0;
+  pthread_rwlock_wrlock(&list->rwl);
+  while (!failed) {
+    char* file_path = increment_path(path, next_sequence, "");
+    if (file_path == NULL) {
+      failed = 1;
+      break;
+    }
+    size_t size;
+    char* data = read_file(file_path, &size);
+    if (data == NULL) {
+      failed = errno != ENOENT;
+      free(file_path);
+      break;
+    }
+    free(file_path);
+
+    // Checkpoints left over from an older snapshot end the chain
+    struct CheckpointHeader header;
+    if (size < sizeof(header)) {
+      free(data);
+      failed = 1;
+      break;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0 || header.version != CHECKPOINT_VERSION) {
+      failed = 1;
+    } else if (header.generation == generation && header.sequence == next_sequence) {
+      failed = apply_increment(list, data + sizeof(header), size - sizeof(header), header.num_records);
+      image->wal_lsn = header.wal_lsn;
+      next_sequence++;
+      free(data);
+      continue;
+    }
+    free(data);
+    break;
+  }
+
+  // The removals in the chain are already saved
+  forget_removed(list, list->num_removed);
+  pthread_rwlock_unlock(&list->rwl);
+  epoch_reclaim();
+
+  return failed;
+}
+
+/// Appends a record, and the seats that follow it as unsigned ints, to a buffer.
+/// @note The caller must have the event locked (see with_event_locked).
+/// @param buffer Buffer to append to.
+/// @param record Record to append.
+/// @param event Event the seats belong to.
+/// @param first Index of the first seat that follows the record.
+/// @param num_seats Number of seats.
+/// @return Position of the buffer after the appended record.
+static char* append_record(char* buffer, struct CheckpointRecord record, struct Event* event, size_t first,
+                           size_t num_seats) {
+  memcpy(buffer, &record, sizeof(record));
+  unsigned int* ids = (unsigned int*)(buffer + sizeof(record));
+  seatgrid_read(event->data, event->width, first, num_seats, ids);
+  // Held seats are not reservations yet, so they are saved as free (see holds.h)
+  if (event->held != NULL) {
+    for (size_t i = seatmap_next_set(event->held, first, num_seats); i < num_seats;
+         i += 1 + seatmap_next_set(event->held, first + i + 1, num_seats - i - 1)) {
+      ids[i] = 0;
+    }
+  }
+  return buffer + sizeof(record) + num_seats * sizeof(unsigned int);
+}
+
+// Changes of an event copied by copy_changes, to be written to a checkpoint once the event is unlocked
+struct ChangeCopy {
+  char* end;             // End of the records copied so far, in a buffer that fits every row of the event
+  uint64_t num_records;  // Number of records copied
+};
+
+/// Copies the records of a new event and of the rows changed since the previous checkpoint, and clears them.
+/// @note Run with the event locked, see with_event_locked.
+/// @param event Event whose changes are copied.
+/// @param arg Copy (see struct ChangeCopy).
+static void copy_changes(struct Event* event, void* arg) {
+  struct ChangeCopy* copy = arg;
+  if (event->deleted) return;
+
+  // Every reserved row of an event is dirty until it is first checkpointed, so new events need no seats
+  if (!event->checkpointed) {
+    struct CheckpointRecord record = {CHECKPOINT_EVENT, event->id, event->reservations, (uint32_t)event->num_stripes,
+                                      event->rows, event->cols};
+    copy->end = append_record(copy->end, record, event, 0, 0);
+    copy->num_records++;
+    event->checkpointed = 1;
+  }
+  for (size_t row = 0; row < event->rows; row++) {
+    if (!row_is_dirty(event, row)) continue;
+    struct CheckpointRecord record = {CHECKPOINT_ROW, event->id, event->reservations, 0, row, event->cols};
+    copy->end = append_record(copy->end, record, event, row * event->cols, event->cols);
+    copy->num_records++;
+  }
+  clear_dirty_rows(event);
+}
+
+/// Writes an incremental checkpoint with the changes since the previous checkpoint.
+/// @param list Event list to be saved.
+/// @param path Path of the snapshot.
+/// @param wal_lsn Next log sequence number.
+/// @return 0 if the checkpoint was written successfully, 1 otherwise.
+static int write_increment(struct EventList* list, const char* path, uint64_t wal_lsn) {
+  char* final_path = increment_path(path, next_sequence, "");
+  char* tmp_path = increment_path(path, next_sequence, CHECKPOINT_TMP_SUFFIX);
+
+  // The epoch keeps events deleted while the checkpoint is written alive until it is done with them
+  if (epoch_enter() != 0) {
+    free(final_path);
+    free(tmp_path);
+    return 1;
+  }
+
+  pthread_rwlock_rdlock(&list->rwl);
+  size_t num_events = list->num_events;
+  size_t num_removed = list->num_removed;
+  int lost_removals = list->removed_lost > 0;
+  struct Event** events = malloc(sizeof(struct Event*) * (num_events == 0 ? 1 : num_events));
+  unsigned int* removed = malloc(sizeof(unsigned int) * (num_removed == 0 ? 1 : num_removed));
+  size_t collected = 0;
+  if (events != NULL && removed != NULL) {
+    for (struct ListNode* current = list->head; current != NULL; current = current->next) {
+      events[collected++] = current->event;
+    }
+    memcpy(removed, list->removed_ids, sizeof(unsigned int) * num_removed);
+  }
+  pthread_rwlock_unlock(&list->rwl);
+
+  FILE* file = NULL;
+  int failed = final_path == NULL || tmp_path == NULL || events == NULL || removed == NULL || lost_removals ||
+               (file = fopen(tmp_path, "w")) == NULL ||
+               fseek(file, (long)sizeof(struct CheckpointHeader), SEEK_SET) != 0;
+
+  uint64_t num_records = 0;
+  for (size_t i = 0; i < num_removed && !failed; i++) {
+    struct CheckpointRecord record = {CHECKPOINT_REMOVED, removed[i], 0, 0, 0, 0};
+    failed = fwrite(&record, sizeof(record), 1, file) != 1;
+    num_records++;
+  }
+
+  // Changes are copied with the event locked (by its owner, if it has one) and written after unlocking it
+  char* buffer = NULL;
+  size_t buffer_capacity = 0;
+  for (size_t i = 0; i < collected && !failed; i++) {
+    struct Event* event = events[i];
+    size_t needed = sizeof(struct CheckpointRecord) + event->rows * (sizeof(struct CheckpointRecord) + event->cols * sizeof(unsigned int));
+    if (needed > buffer_capacity) {
+      char* temp = realloc(buffer, needed);
+      if (temp == NULL) {
+        failed = 1;
+        break;
+      }
+      buffer = temp;
+      buffer_capacity = needed;
+    }
+
+    struct ChangeCopy copy = {.end = buffer};
+    with_event_locked(event, copy_changes, &copy);
+    num_records += copy.num_records;
+    char* end = copy.end;
+
+    if (end != buffer && fwrite(buffer, 1, (size_t)(end - buffer), file) != (size_t)(end - buffer)) {
+      failed = 1;
+    }
+  }
+  epoch_exit();
+  free(buffer);
+  free(events);
+  free(removed);
+
+  struct CheckpointHeader header = {CHECKPOINT_MAGIC, CHECKPOINT_VERSION, generation, next_sequence, wal_lsn, num_records};
+  if (!failed) {
+    failed = fseek(file, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, file) != 1;
+  }
+  // The checkpoint only joins the chain once it is complete on disk
+  if (!failed) {
+    failed = fflush(file) != 0 || fsync(fileno(file)) != 0;
+  }
+  if (file != NULL && fclose(file) != 0) failed = 1;
+  if (!failed) {
+    failed = rename(tmp_path, final_path) != 0;
+  } else if (file != NULL) {
+    unlink(tmp_path);
+  }
+
+  if (!failed) {
+    pthread_rwlock_wrlock(&list->rwl);
+    forget_removed(list, num_removed);
+    pthread_rwlock_unlock(&list->rwl);
+  }
+
+  free(final_path);
+  free(tmp_path);
+  return failed;
+}
+
+int checkpoint_write(struct EventList* list, const char* path, uint64_t wal_lsn) {
+  if (needs_snapshot || next_sequence > CHECKPOINT_CHAIN_LENGTH) {
+    // Compaction: the new snapshot replaces the previous one and its whole chain
+    if (snapshot_write(list, path, wal_lsn, generation + 1) != 0) {
+      needs_snapshot = 1;
+      return 1;
+    }
+    generation++;
+    next_sequence = 1;
+    needs_snapshot = 0;
+
+    // Checkpoints of older snapshots would be skipped anyway, this just reclaims their space
+    for (uint64_t sequence = 1; sequence <= CHECKPOINT_CHAIN_LENGTH; sequence++) {
+      char* old_path = increment_path(path, sequence, "");
+      if (old_path != NULL) unlink(old_path);
+      free(old_path);
+    }
+    return 0;
+  }
+
+  // Changes already taken from the events would be lost, so the next checkpoint must be a full one
+  if (write_increment(list, path, wal_lsn) != 0) {
+    needs_snapshot = 1;
+    return 1;
+  }
+  next_sequence++;
+  return 0;
+}
@@ -0,0 +1,61 @@
+#ifndef SERVER_CHECKPOINT_H
+#define SERVER_CHECKPOINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "eventlist.h"
+#include "snapshot.h"
+
+/// Checkpoint chain of the event list: a full snapshot followed by incremental checkpoints.
+/// An incremental checkpoint only holds what changed since the previous checkpoint: the ids of removed
+/// events, new events and the rows of events reserved since then. A new event is saved as its dimensions
+/// followed by its reserved rows, so a large event with few reservations stays small on disk. Incremental checkpoints
+/// of a snapshot are stored next to it as <path>.1, <path>.2, ... and every CHECKPOINT_CHAIN_LENGTH of
+/// them the chain is compacted into a new snapshot.
+
+#define CHECKPOINT_MAGIC "EMSCKPT"
+#define CHECKPOINT_VERSION 2
+
+#define CHECKPOINT_REMOVED 1  // Event removed, no data
+#define CHECKPOINT_EVENT 2    // New event, no data (its reserved rows follow as CHECKPOINT_ROW records)
+#define CHECKPOINT_ROW 3      // Changed row of an event, followed by its cols seats
+
+// Header at the start of an incremental checkpoint file
+struct CheckpointHeader {
+  char magic[8];         // CHECKPOINT_MAGIC, NUL-terminated
+  uint32_t version;      // CHECKPOINT_VERSION
+  uint32_t generation;   // Generation of the snapshot the checkpoint applies to
+  uint64_t sequence;     // Position of the checkpoint in the chain, starting at 1
+  uint64_t wal_lsn;      // First log record that may not be reflected in the checkpoint
+  uint64_t num_records;  // Number of records that follow the header
+};
+
+// Record of an incremental checkpoint
+struct CheckpointRecord {
+  uint32_t type;          // CHECKPOINT_REMOVED, CHECKPOINT_EVENT or CHECKPOINT_ROW
+  uint32_t id;            // Event id
+  uint32_t reservations;  // Number of reservations of the event
+  uint32_t stripes;       // Number of row stripes of a new event, 0 for other records (and older checkpoints)
+  uint64_t rows;          // Number of rows of a new event, index of the row of a changed row
+  uint64_t cols;          // Number of columns of the event
+};
+
+/// Loads a snapshot and the incremental checkpoints that follow it into an empty list.
+/// @note A missing snapshot is not an error, the list is just left empty.
+/// @param list Event list to be filled.
+/// @param path Path of the snapshot.
+/// @param image Set to the mapping of the snapshot, with the log position of the last applied checkpoint.
+/// @return 0 if the chain was loaded successfully, 1 otherwise.
+int checkpoint_load(struct EventList* list, const char* path, struct SnapshotImage* image);
+
+/// Writes the next checkpoint of the chain: an incremental one, or a new snapshot when the chain is long
+/// enough, when there is no snapshot yet or when the previous checkpoint failed.
+/// @note Reservations carry on while the checkpoint is written, see snapshot_write.
+/// @param list Event list to be saved.
+/// @param path Path of the snapshot.
+/// @param wal_lsn Next log sequence number, read before calling so every earlier record is reflected.
+/// @return 0 if the checkpoint was written successfully, 1 otherwise.
+int checkpoint_write(struct EventList* list, const char* path, uint64_t wal_lsn);
+
+#endif  // SERVER_CHECKPOINT_H
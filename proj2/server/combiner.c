@@ -0,0 +1,69 @@
+#include "combiner.h"
+
+#include <sched.h>
+
+int combiner_init(struct Combiner* combiner) {
+  atomic_init(&combiner->pending, NULL);
+  return pthread_mutex_init(&combiner->mutex, NULL) != 0;
+}
+
+void combiner_destroy(struct Combiner* combiner) { pthread_mutex_destroy(&combiner->mutex); }
+
+/// Applies the operations taken from the publication list, oldest first, and marks them as done.
+/// @param batch Operations taken from the list, newest first.
+/// @param apply Function that applies a batch of operations.
+/// @param ctx Argument of the apply function.
+/// @return Number of operations applied.
+static size_t apply_batch(struct CombinerNode* batch, combiner_apply_fn apply, void* ctx) {
+  struct CombinerNode* oldest = NULL;
+  while (batch != NULL) {
+    struct CombinerNode* next = batch->next;
+    batch->next = oldest;
+    oldest = batch;
+    batch = next;
+  }
+
+  size_t applied = 0;
+  while (oldest != NULL) {
+    struct CombinerNode* nodes[COMBINER_MAX_BATCH];
+    void* ops[COMBINER_MAX_BATCH];
+    size_t count = 0;
+    for (; oldest != NULL && count < COMBINER_MAX_BATCH; oldest = oldest->next) {
+      nodes[count] = oldest;
+      ops[count++] = oldest->op;
+    }
+    apply(ctx, ops, count);
+    // A node may be gone as soon as it is done, so its next was read before
+    for (size_t i = 0; i < count; i++) atomic_store_explicit(&nodes[i]->done, 1, memory_order_release);
+    applied += count;
+  }
+  return applied;
+}
+
+size_t combiner_run(struct Combiner* combiner, struct CombinerNode* node, void* op, combiner_apply_fn apply,
+                    void* ctx) {
+  node->op = op;
+  atomic_init(&node->done, 0);
+  struct CombinerNode* head = atomic_load_explicit(&combiner->pending, memory_order_relaxed);
+  do {
+    node->next = head;
+  } while (!atomic_compare_exchange_weak_explicit(&combiner->pending, &head, node, memory_order_release,
+                                                  memory_order_relaxed));
+
+  // A combiner may have taken the list just before the node was posted and be about to leave, so waiters keep
+  // trying the lock rather than waiting for the next combiner
+  size_t applied = 0;
+  while (!atomic_load_explicit(&node->done, memory_order_acquire)) {
+    if (pthread_mutex_trylock(&combiner->mutex) != 0) {
+      sched_yield();
+      continue;
+    }
+    for (int pass = 0; pass < COMBINER_MAX_PASSES; pass++) {
+      struct CombinerNode* batch = atomic_exchange_explicit(&combiner->pending, NULL, memory_order_acquire);
+      if (batch == NULL) break;
+      applied += apply_batch(batch, apply, ctx);
+    }
+    pthread_mutex_unlock(&combiner->mutex);
+  }
+  return applied;
+}
@@ -0,0 +1,54 @@
+#ifndef SERVER_COMBINER_H
+#define SERVER_COMBINER_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+/// Flat combining: instead of queueing on a contended lock, threads post their operations to a publication list
+/// and whichever thread gets the lock applies every posted operation in one batch, then hands back the results.
+/// The lock changes hands once per batch rather than once per operation, and the data it guards stays in the
+/// cache of the combining thread. Posting is a single CAS on the head of the list.
+
+#define COMBINER_MAX_BATCH 64   // Most operations handed to the apply function at once
+#define COMBINER_MAX_PASSES 4   // Batches a combiner applies before it returns to its own caller
+
+// Operation posted to a combiner, on the stack of the thread waiting for it
+struct CombinerNode {
+  struct CombinerNode* next;  // Operation posted before this one
+  _Atomic int done;           // Set by the combiner once the operation was applied
+  void* op;                   // Operation, handed to the apply function
+};
+
+struct Combiner {
+  pthread_mutex_t mutex;                 // Held by the combining thread
+  struct CombinerNode* _Atomic pending;  // Operations posted and not applied yet, newest first
+};
+
+/// Applies a batch of operations, called with the mutex of the combiner held.
+/// @param ctx Argument given to combiner_run.
+/// @param ops Operations, in the order they were posted.
+/// @param count Number of operations, at most COMBINER_MAX_BATCH.
+typedef void (*combiner_apply_fn)(void* ctx, void** ops, size_t count);
+
+/// Initializes a combiner with no operations posted.
+/// @param combiner Combiner to initialize.
+/// @return 0 if the combiner was initialized, 1 otherwise.
+int combiner_init(struct Combiner* combiner);
+
+/// Destroys a combiner with no operations posted.
+/// @param combiner Combiner to destroy.
+void combiner_destroy(struct Combiner* combiner);
+
+/// Posts an operation and waits until it was applied, by this thread if no other one is combining.
+/// @note Every thread posting to the same combiner must pass the same apply function and context.
+/// @param combiner Combiner to post to.
+/// @param node Node of the operation, which must stay valid until this returns.
+/// @param op Operation.
+/// @param apply Function that applies a batch of operations.
+/// @param ctx Argument of the apply function.
+/// @return Number of operations this thread applied, its own included, 0 if another thread applied it.
+size_t combiner_run(struct Combiner* combiner, struct CombinerNode* node, void* op, combiner_apply_fn apply,
+                    void* ctx);
+
+#endif  // SERVER_COMBINER_H
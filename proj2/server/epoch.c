@@ -0,0 +1,155 @@
+#include "epoch.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#define CACHE_LINE_SIZE 64
+
+// Per-thread epoch record. Each record sits in its own cache line so readers never share a written line.
+struct EpochRecord {
+  _Atomic uint64_t state;  // (epoch << 1) | 1 while inside a critical section, 0 otherwise
+  _Atomic int in_use;      // Whether the record is owned by a live thread
+  unsigned int depth;      // Nesting depth of the owner's critical sections
+  struct EpochRecord* next;  // Next record in the global record list
+  char padding[CACHE_LINE_SIZE - sizeof(uint64_t) - sizeof(int) - sizeof(unsigned int) - sizeof(void*)];
+};
+
+static _Atomic uint64_t global_epoch = 1;
+static struct EpochRecord* _Atomic records = NULL;
+
+static pthread_mutex_t retired_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct EpochEntry* retired = NULL;
+
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t record_key;
+static _Thread_local struct EpochRecord* local_record = NULL;
+
+/// Gives the record of an exiting thread back to the pool.
+static void release_record(void* arg) {
+  struct EpochRecord* record = arg;
+  atomic_store_explicit(&record->state, 0, memory_order_release);
+  atomic_store_explicit(&record->in_use, 0, memory_order_release);
+}
+
+static void create_key() { pthread_key_create(&record_key, release_record); }
+
+/// Gets the record of the calling thread, claiming or allocating one on first use.
+/// @return The record, NULL on allocation failure.
+static struct EpochRecord* get_record() {
+  if (local_record != NULL) return local_record;
+
+  pthread_once(&key_once, create_key);
+
+  struct EpochRecord* record = atomic_load_explicit(&records, memory_order_acquire);
+  for (; record != NULL; record = record->next) {
+    int expected = 0;
+    if (atomic_compare_exchange_strong(&record->in_use, &expected, 1)) break;
+  }
+
+  if (record == NULL) {
+    record = aligned_alloc(CACHE_LINE_SIZE, sizeof(struct EpochRecord));
+    if (record == NULL) return NULL;
+    atomic_init(&record->state, 0);
+    atomic_init(&record->in_use, 1);
+    record->next = atomic_load_explicit(&records, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak(&records, &record->next, record))
+      ;
+  }
+
+  record->depth = 0;
+  pthread_setspecific(record_key, record);
+  local_record = record;
+  return record;
+}
+
+int epoch_enter() {
+  struct EpochRecord* record = get_record();
+  if (record == NULL) return 1;
+
+  if (record->depth++ > 0) return 0;
+
+  uint64_t epoch = atomic_load_explicit(&global_epoch, memory_order_relaxed);
+  atomic_store_explicit(&record->state, (epoch << 1) | 1, memory_order_relaxed);
+  // The announcement must be visible before any shared pointer is read
+  atomic_thread_fence(memory_order_seq_cst);
+  return 0;
+}
+
+void epoch_exit() {
+  struct EpochRecord* record = local_record;
+  if (record == NULL || record->depth == 0) return;
+
+  if (--record->depth > 0) return;
+
+  atomic_store_explicit(&record->state, 0, memory_order_release);
+}
+
+void epoch_retire(struct EpochEntry* entry, void* ptr, void (*free_fn)(void*)) {
+  entry->ptr = ptr;
+  entry->free_fn = free_fn;
+
+  pthread_mutex_lock(&retired_mutex);
+  entry->epoch = atomic_load_explicit(&global_epoch, memory_order_relaxed);
+  entry->next = retired;
+  retired = entry;
+  pthread_mutex_unlock(&retired_mutex);
+}
+
+void epoch_reclaim() {
+  pthread_mutex_lock(&retired_mutex);
+  if (retired == NULL) {
+    pthread_mutex_unlock(&retired_mutex);
+    return;
+  }
+
+  uint64_t epoch = 0;
+
+  // Two advances in a row free what was just retired when no reader is in the way
+  for (int attempt = 0; attempt < 2; attempt++) {
+    atomic_thread_fence(memory_order_seq_cst);
+    epoch = atomic_load_explicit(&global_epoch, memory_order_relaxed);
+
+    // The epoch can only advance once every active reader has observed the current one
+    int can_advance = 1;
+    for (struct EpochRecord* record = atomic_load_explicit(&records, memory_order_acquire); record != NULL;
+         record = record->next) {
+      uint64_t state = atomic_load_explicit(&record->state, memory_order_acquire);
+      if ((state & 1) && (state >> 1) != epoch) {
+        can_advance = 0;
+        break;
+      }
+    }
+
+    if (!can_advance) break;
+
+    epoch++;
+    atomic_store_explicit(&global_epoch, epoch, memory_order_release);
+  }
+
+  // Memory retired two epochs ago can no longer be referenced by any reader
+  struct EpochEntry** current = &retired;
+  while (*current != NULL) {
+    struct EpochEntry* entry = *current;
+    if (entry->epoch + 2 <= epoch) {
+      // The entry goes with the memory, so it is unlinked first
+      *current = entry->next;
+      entry->free_fn(entry->ptr);
+    } else {
+      current = &entry->next;
+    }
+  }
+
+  pthread_mutex_unlock(&retired_mutex);
+}
+
+void epoch_drain() {
+  pthread_mutex_lock(&retired_mutex);
+  while (retired != NULL) {
+    struct EpochEntry* entry = retired;
+    retired = entry->next;
+    entry->free_fn(entry->ptr);
+  }
+  pthread_mutex_unlock(&retired_mutex);
+}
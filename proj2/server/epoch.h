@@ -0,0 +1,40 @@
+#ifndef SERVER_EPOCH_H
+#define SERVER_EPOCH_H
+
+#include <stdint.h>
+
+/// Epoch-based reclamation.
+/// Readers wrap their accesses to shared structures in epoch_enter/epoch_exit, which only write to a
+/// record owned by the calling thread. Writers unlink memory from the shared structures and hand it to
+/// epoch_retire; it is only freed once every reader that could still see it has left its epoch.
+
+// Memory waiting for its epoch to expire. The entry is embedded in the retired memory itself, so retiring
+// never allocates and cannot fail.
+struct EpochEntry {
+  void* ptr;
+  void (*free_fn)(void*);
+  uint64_t epoch;  // Global epoch at the time the memory was retired
+  struct EpochEntry* next;
+};
+
+/// Enters a read-side critical section. Critical sections may be nested.
+/// @return 0 if the section was entered, 1 if the record of the calling thread could not be allocated (in which
+/// case the caller must not read shared structures, nor call epoch_exit).
+int epoch_enter();
+
+/// Leaves a read-side critical section.
+void epoch_exit();
+
+/// Defers the release of memory until no reader can still hold a reference to it.
+/// @param entry Entry embedded in the memory, left alone by the caller until free_fn is called.
+/// @param ptr Memory that is no longer reachable from any shared structure.
+/// @param free_fn Function used to release the memory.
+void epoch_retire(struct EpochEntry* entry, void* ptr, void (*free_fn)(void*));
+
+/// Tries to advance the global epoch and releases the memory that is safe to free.
+void epoch_reclaim();
+
+/// Releases all retired memory. Must only be called when no reader is active.
+void epoch_drain();
+
+#endif  // SERVER_EPOCH_H
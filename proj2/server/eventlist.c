@@ -1,9 +1,215 @@
 #include "eventlist.h"
 
 #include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "epoch.h"
+#include "owners.h"
+#include "seatgrid.h"
+#include "seatmap.h"
+
+#define INDEX_INITIAL_CAPACITY 64  // Initial number of slots of the hash index
+#define DENSE_INITIAL_CAPACITY 64  // Initial number of entries of the dense table
+#define DENSE_MAX_SPARSITY 4       // Ids up to this many times the number of events stay in the dense table
+#define SORTED_INITIAL_CAPACITY 64 // Initial number of ids of the sorted id array
+#define REMOVED_INITIAL_CAPACITY 16  // Initial number of ids of the removed id array
+#define RESERVATIONS_INITIAL_CAPACITY 64  // Initial number of ids of the reverse index of an event
+
+static struct Slab event_slab;  // Slab of struct Event
+static struct Slab node_slab;   // Slab of struct ListNode
+static struct Slab grid_slab;   // Slab of struct RetiredGrid
+static _Atomic uint64_t generations = 0;  // Events created so far, the generation of the newest one
+static int stripes_owned = 0;             // Whether the stripes are left unlocked, see set_stripes_owned
+
+// Stripe counters keep the writes in progress in their low bits and the completed writes above them, so
+// several lock-free writers of the same stripe can overlap and readers still see when none is writing
+#define SEQ_ACTIVE_BITS 16
+#define SEQ_ACTIVE_MASK ((1ul << SEQ_ACTIVE_BITS) - 1)
+#define SEQ_WRITE_STARTED 1ul
+#define SEQ_WRITE_DONE ((1ul << SEQ_ACTIVE_BITS) - 1)  // Takes one writer off and counts one completed write
+#define READ_SEATS_MAX_SPINS 64  // Times read_seats_begin finds writes in progress before it gives up
+
+// Grid replaced by widen_seats, released once no lock-free reader can still be copying it
+struct RetiredGrid {
+  void** data;         // Tile directory of the grid
+  unsigned int width;  // Bytes per seat of the grid
+  size_t num_seats;    // Number of seats of the grid
+  struct EpochEntry entry;
+};
+
+// Marks index slots whose event was removed. Slots are never reused until the index is rebuilt,
+// so a lookup that already read a slot never sees it change to another id.
+static struct Event tombstone;
+#define TOMBSTONE (&tombstone)
+
+/// Hashes an event id into a slot of the index.
+/// @param event_id Event id.
+/// @param capacity Number of slots of the index (power of two).
+/// @return First slot to probe.
+static size_t index_slot(unsigned int event_id, size_t capacity) {
+  // Fibonacci hashing spreads consecutive ids over the whole table
+  return (size_t)(((uint64_t)event_id * 11400714819323198485ull) >> 32) & (capacity - 1);
+}
+
+/// Inserts an event in an index table without checking the load factor.
+/// @note The id is written before the event is published, so concurrent readers never see a half-filled slot.
+/// @param table Index table.
+/// @param event Event to be inserted.
+static void index_insert(struct IndexTable* table, struct Event* event) {
+  size_t i = index_slot(event->id, table->capacity);
+  while (atomic_load_explicit(&table->slots[i].event, memory_order_relaxed) != NULL) {
+    i = (i + 1) & (table->capacity - 1);
+  }
+  table->slots[i].id = event->id;
+  atomic_store_explicit(&table->slots[i].event, event, memory_order_release);
+}
+
+/// Makes sure the index has room for one more event, replacing it with a larger one if needed.
+/// @param list Event list whose index is grown.
+/// @return 0 if the index has room, 1 otherwise.
+static int index_reserve(struct EventList* list) {
+  struct IndexTable* old = atomic_load_explicit(&list->index, memory_order_relaxed);
+
+  // Keep the load factor (tombstones included) at most 1/2 so probe sequences stay short
+  if (old != NULL && (list->index_used + 1) * 2 <= old->capacity) return 0;
+
+  // Rebuilding drops the tombstones, so the table only grows if the live events need it
+  size_t capacity = INDEX_INITIAL_CAPACITY;
+  while ((list->index_size + 1) * 4 > capacity) capacity *= 2;
+  struct IndexTable* table = calloc(1, sizeof(struct IndexTable) + capacity * sizeof(struct IndexSlot));
+  if (!table) return 1;
+  table->capacity = capacity;
+
+  if (old != NULL) {
+    for (size_t i = 0; i < old->capacity; i++) {
+      struct Event* event = atomic_load_explicit(&old->slots[i].event, memory_order_relaxed);
+      if (event != NULL && event != TOMBSTONE) {
+        index_insert(table, event);
+      }
+    }
+  }
+
+  list->index_used = list->index_size;
+  atomic_store_explicit(&list->index, table, memory_order_release);
+  if (old != NULL) epoch_retire(&old->retired, old, free);
+  return 0;
+}
+
+/// Replaces the dense table with one that covers the given id, if the ids are contiguous enough.
+/// @param list Event list whose dense table is grown.
+/// @param event_id Id that should be covered by the dense table.
+/// @return 0 on success (even if the table was not grown), 1 on allocation failure.
+static int dense_reserve(struct EventList* list, unsigned int event_id) {
+  struct DenseTable* old = atomic_load_explicit(&list->dense, memory_order_relaxed);
+  size_t old_capacity = old == NULL ? 0 : old->capacity;
+
+  if (event_id < old_capacity) return 0;
+  if ((size_t)event_id >= DENSE_MAX_SPARSITY * (list->num_events + 1) + DENSE_INITIAL_CAPACITY) return 0;
+
+  size_t capacity = old_capacity == 0 ? DENSE_INITIAL_CAPACITY : old_capacity;
+  while (capacity <= event_id) capacity *= 2;
+
+  struct DenseTable* dense = calloc(1, sizeof(struct DenseTable) + capacity * sizeof(struct Event*));
+  if (!dense) return 1;
+  dense->capacity = capacity;
+
+  for (size_t i = 0; i < old_capacity; i++) {
+    atomic_init(&dense->entries[i], atomic_load_explicit(&old->entries[i], memory_order_relaxed));
+  }
+
+  // Events with ids in the new range may only be in the hash index
+  struct IndexTable* index = atomic_load_explicit(&list->index, memory_order_relaxed);
+  for (size_t i = 0; index != NULL && i < index->capacity; i++) {
+    struct IndexSlot* slot = &index->slots[i];
+    struct Event* event = atomic_load_explicit(&slot->event, memory_order_relaxed);
+    if (event != NULL && event != TOMBSTONE && slot->id >= old_capacity && slot->id < capacity) {
+      atomic_init(&dense->entries[slot->id], event);
+    }
+  }
+
+  atomic_store_explicit(&list->dense, dense, memory_order_release);
+  if (old != NULL) epoch_retire(&old->retired, old, free);
+  return 0;
+}
+
+/// Finds the position of the first sorted id that is not below the given id.
+/// @param list Event list to be searched.
+/// @param event_id Id to look for.
+/// @return Position in sorted_ids, index_size if every id is below event_id.
+static size_t sorted_lower_bound(struct EventList* list, unsigned int event_id) {
+  size_t low = 0;
+  size_t high = list->index_size;
+  while (low < high) {
+    size_t mid = low + (high - low) / 2;
+    if (list->sorted_ids[mid] < event_id) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return low;
+}
+
+/// Makes sure the sorted id array has room for one more id.
+/// @param list Event list whose array is grown.
+/// @return 0 if the array has room, 1 otherwise.
+static int sorted_reserve(struct EventList* list) {
+  if (list->index_size < list->sorted_capacity) return 0;
+
+  size_t capacity = list->sorted_capacity == 0 ? SORTED_INITIAL_CAPACITY : list->sorted_capacity * 2;
+  unsigned int* ids = realloc(list->sorted_ids, capacity * sizeof(unsigned int));
+  if (!ids) return 1;
+  list->sorted_ids = ids;
+  list->sorted_capacity = capacity;
+  return 0;
+}
+
+/// Calculates the size of the dirty row flags of an event.
+/// @note Flags are bytes rather than bits so rows of different stripes never share a memory location.
+/// @param num_rows Number of rows.
+/// @return Size of the flags in bytes.
+static size_t dirty_rows_size(size_t num_rows) { return num_rows == 0 ? 1 : num_rows; }
+
+/// Calculates the gcd of two sizes.
+/// @param a First size.
+/// @param b Second size.
+/// @return Greatest common divisor of a and b.
+static size_t gcd(size_t a, size_t b) {
+  while (b != 0) {
+    size_t rest = a % b;
+    a = b;
+    b = rest;
+  }
+  return a;
+}
+
+/// Splits the rows of an event into stripes.
+/// @param event Event whose rows and columns are set.
+/// @param num_stripes Requested number of stripes, 0 for the default.
+static void set_stripes(struct Event* event, size_t num_stripes) {
+  if (num_stripes == 0) num_stripes = (event->rows + EVENT_ROWS_PER_STRIPE - 1) / EVENT_ROWS_PER_STRIPE;
+  if (num_stripes > EVENT_MAX_STRIPES) num_stripes = EVENT_MAX_STRIPES;
+  if (num_stripes == 0 || event->rows == 0) num_stripes = 1;
+
+  // Stripes start at a word of the occupancy bitmap, so reservations in different stripes never write the same word
+  size_t word_rows = 64 / gcd(event->cols == 0 ? 64 : event->cols, 64);
+  size_t stripe_rows = (event->rows + num_stripes - 1) / num_stripes;
+  stripe_rows = (stripe_rows + word_rows - 1) / word_rows * word_rows;
+
+  event->stripe_rows = stripe_rows;
+  event->num_stripes = event->rows == 0 ? 1 : (event->rows + stripe_rows - 1) / stripe_rows;
+}
 
 struct EventList* create_list() {
+  if (slab_init(&event_slab, sizeof(struct Event)) != 0 || slab_init(&node_slab, sizeof(struct ListNode)) != 0 ||
+      slab_init(&grid_slab, sizeof(struct RetiredGrid)) != 0) {
+    return NULL;
+  }
+
   struct EventList* list = (struct EventList*)malloc(sizeof(struct EventList));
   if (!list) return NULL;
   if (pthread_rwlock_init(&list->rwl, NULL) != 0) {
@@ -13,17 +219,484 @@ struct EventList* create_list() {
   list->head = NULL;
   list->tail = NULL;
   list->num_events = 0;
+  atomic_init(&list->index, NULL);
+  list->index_size = 0;
+  list->index_used = 0;
+  atomic_init(&list->dense, NULL);
+  list->sorted_ids = NULL;
+  list->sorted_capacity = 0;
+  list->removed_ids = NULL;
+  list->num_removed = 0;
+  list->removed_capacity = 0;
+  list->removed_lost = 0;
   return list;
 }
 
+struct Event* create_event_at(unsigned int event_id, size_t num_rows, size_t num_cols, void** data,
+                              unsigned int width, uint64_t* occupied, size_t num_stripes) {
+  struct Event* event = slab_alloc(&event_slab);
+  if (!event) return NULL;
+
+  event->id = event_id;
+  event->rows = num_rows;
+  event->cols = num_cols;
+  event->reservations = 0;
+  event->version = 0;
+  event->contention = 0;
+  event->combining = 0;
+  event->lone_batches = 0;
+  event->deleted = 0;
+  atomic_init(&event->locked, 0);
+  event->node = NULL;
+  event->generation = atomic_fetch_add_explicit(&generations, 1, memory_order_relaxed) + 1;
+  event->data = data;
+  event->width = width;
+  event->occupied = occupied;
+  event->held = NULL;
+  atomic_init(&event->summaries, NULL);
+  atomic_init(&event->reservation_index, NULL);
+  event->checkpointed = 0;
+
+  event->dirty_rows = arena_alloc(dirty_rows_size(num_rows));
+  if (!event->dirty_rows) {
+    slab_free(&event_slab, event);
+    return NULL;
+  }
+
+  set_stripes(event, num_stripes);
+  event->stripes = event->num_stripes == 1 ? &event->single_stripe
+                                           : arena_alloc(event->num_stripes * sizeof(struct EventStripe));
+  size_t initialized = 0;
+  while (event->stripes != NULL && initialized < event->num_stripes &&
+         pthread_mutex_init(&event->stripes[initialized].mutex, NULL) == 0) {
+    atomic_init(&event->stripes[initialized].seq, 0);
+    initialized++;
+  }
+  if (initialized < event->num_stripes || combiner_init(&event->combiner) != 0) {
+    for (size_t i = 0; i < initialized; i++) pthread_mutex_destroy(&event->stripes[i].mutex);
+    if (event->num_stripes > 1) arena_recycle(event->stripes, event->num_stripes * sizeof(struct EventStripe));
+    arena_recycle(event->dirty_rows, dirty_rows_size(num_rows));
+    slab_free(&event_slab, event);
+    return NULL;
+  }
+
+  return event;
+}
+
+uint64_t row_stripes(const struct Event* event, const size_t* rows, size_t count) {
+  uint64_t mask = 0;
+  for (size_t i = 0; i < count; i++) {
+    mask |= 1ull << ((rows[i] - 1) / event->stripe_rows);
+  }
+  return mask;
+}
+
+void set_stripes_owned(int owned) { stripes_owned = owned; }
+
+void lock_stripes(struct Event* event, uint64_t mask) {
+  if (stripes_owned) return;
+  // Lowest bit first, so stripes are always taken in row order
+  for (; mask != 0; mask &= mask - 1) {
+    pthread_mutex_lock(&event->stripes[__builtin_ctzll(mask)].mutex);
+  }
+}
+
+int trylock_stripes(struct Event* event, uint64_t mask) {
+  if (stripes_owned) return 0;
+  for (uint64_t rest = mask; rest != 0; rest &= rest - 1) {
+    if (pthread_mutex_trylock(&event->stripes[__builtin_ctzll(rest)].mutex) == 0) continue;
+    unlock_stripes(event, mask & ~rest);
+    return 1;
+  }
+  return 0;
+}
+
+void unlock_stripes(struct Event* event, uint64_t mask) {
+  if (stripes_owned) return;
+  for (; mask != 0; mask &= mask - 1) {
+    pthread_mutex_unlock(&event->stripes[__builtin_ctzll(mask)].mutex);
+  }
+}
+
+uint64_t all_stripes(const struct Event* event) {
+  return event->num_stripes == EVENT_MAX_STRIPES ? UINT64_MAX : (1ull << event->num_stripes) - 1;
+}
+
+/// Checks whether any write to the seats of an event is in progress.
+/// @param event Event to check.
+/// @return 1 if a stripe has writes in progress, 0 otherwise.
+static int seat_writes_active(struct Event* event) {
+  for (size_t i = 0; i < event->num_stripes; i++) {
+    if (atomic_load(&event->stripes[i].seq) & SEQ_ACTIVE_MASK) return 1;
+  }
+  return 0;
+}
+
+void lock_event(struct Event* event) {
+  lock_stripes(event, all_stripes(event));
+  // Lock-free claims check the flag after announcing themselves, so either they see it or this sees them
+  atomic_store(&event->locked, 1);
+  while (seat_writes_active(event)) sched_yield();
+}
+
+void unlock_event(struct Event* event) {
+  atomic_store_explicit(&event->locked, 0, memory_order_release);
+  unlock_stripes(event, all_stripes(event));
+}
+
+// Function run by with_event_locked, and what it needs, on the stack of the thread waiting for it
+struct LockedCall {
+  struct Event* event;
+  void (*fn)(struct Event* event, void* arg);
+  void* arg;
+};
+
+/// Runs the function of a with_event_locked call with its event locked.
+/// @param arg Call.
+static void run_locked(void* arg) {
+  struct LockedCall* call = arg;
+  lock_event(call->event);
+  call->fn(call->event, call->arg);
+  unlock_event(call->event);
+}
+
+void with_event_locked(struct Event* event, void (*fn)(struct Event* event, void* arg), void* arg) {
+  struct LockedCall call = {event, fn, arg};
+  // Owned stripes are never locked, so only the owner of the event can keep its writes out
+  if (stripes_owned && owners_route(event->id)) {
+    owners_call(event->id, run_locked, &call);
+  } else {
+    run_locked(&call);
+  }
+}
+
+void begin_seat_writes(struct Event* event, uint64_t mask) {
+  for (uint64_t rest = mask; rest != 0; rest &= rest - 1) {
+    atomic_fetch_add(&event->stripes[__builtin_ctzll(rest)].seq, SEQ_WRITE_STARTED);
+  }
+}
+
+void end_seat_writes(struct Event* event, uint64_t mask) {
+  for (uint64_t rest = mask; rest != 0; rest &= rest - 1) {
+    atomic_fetch_add_explicit(&event->stripes[__builtin_ctzll(rest)].seq, SEQ_WRITE_DONE, memory_order_release);
+  }
+}
+
+void begin_seat_claims(struct Event* event, uint64_t mask) {
+  while (1) {
+    begin_seat_writes(event, mask);
+    if (!atomic_load(&event->locked)) return;
+    end_seat_writes(event, mask);
+    while (atomic_load_explicit(&event->locked, memory_order_acquire)) sched_yield();
+  }
+}
+
+void end_seat_claims(struct Event* event, uint64_t mask) {
+  // A claim is announced as a write in progress, which is what lock_event waits on
+  end_seat_writes(event, mask);
+}
+
+int read_seats_begin(struct Event* event, unsigned long* token) {
+  for (int spins = 0; spins < READ_SEATS_MAX_SPINS; spins++) {
+    // Counters only grow, so their sum only stays the same if none of them changed
+    unsigned long sum = 0;
+    int writing = 0;
+    for (size_t i = 0; i < event->num_stripes; i++) {
+      unsigned long seq = atomic_load_explicit(&event->stripes[i].seq, memory_order_acquire);
+      writing |= (seq & SEQ_ACTIVE_MASK) != 0;
+      sum += seq;
+    }
+    if (!writing) {
+      *token = sum;
+      return 0;
+    }
+    sched_yield();
+  }
+  return 1;
+}
+
+int read_seats_retry(struct Event* event, unsigned long token) {
+  // The seats must be read before the counters are read again
+  atomic_thread_fence(memory_order_acquire);
+  unsigned long sum = 0;
+  for (size_t i = 0; i < event->num_stripes; i++) {
+    sum += atomic_load_explicit(&event->stripes[i].seq, memory_order_relaxed);
+  }
+  return sum != token;
+}
+
+struct Event* create_event(unsigned int event_id, size_t num_rows, size_t num_cols, size_t num_stripes) {
+  void** data = seatgrid_create(num_rows * num_cols);
+  if (!data) return NULL;
+  uint64_t* occupied = arena_alloc(seatmap_size(num_rows * num_cols));
+  if (!occupied) {
+    seatgrid_release(data, 1, num_rows * num_cols);
+    return NULL;
+  }
+
+  struct Event* event = create_event_at(event_id, num_rows, num_cols, data, 1, occupied, num_stripes);
+  if (!event) {
+    seatgrid_release(data, 1, num_rows * num_cols);
+    arena_recycle(occupied, seatmap_size(num_rows * num_cols));
+  }
+  return event;
+}
+
+/// Releases a grid replaced by widen_seats, called by the epoch module once no reader can still see it.
+/// @param arg Retired grid.
+static void release_grid(void* arg) {
+  struct RetiredGrid* retired = arg;
+  seatgrid_release(retired->data, retired->width, retired->num_seats);
+  slab_free(&grid_slab, retired);
+}
+
+int widen_seats(struct Event* event, unsigned int reservation_id) {
+  unsigned int width = seat_width_for(reservation_id);
+  if (width <= event->width) return 0;
+
+  size_t num_seats = event->rows * event->cols;
+  struct RetiredGrid* retired = slab_alloc(&grid_slab);
+  if (!retired) return 1;
+  void** data = seatgrid_widen(event->data, event->width, width, num_seats);
+  if (!data) {
+    slab_free(&grid_slab, retired);
+    return 1;
+  }
+  retired->data = event->data;
+  retired->width = event->width;
+  retired->num_seats = num_seats;
+
+  uint64_t stripes = all_stripes(event);
+  begin_seat_writes(event, stripes);
+  event->data = data;
+  event->width = width;
+  end_seat_writes(event, stripes);
+
+  epoch_retire(&retired->entry, retired, release_grid);
+  return 0;
+}
+
+/// Calculates the size of the availability summaries of an event.
+/// @param num_rows Number of rows.
+/// @return Size of the summaries in bytes.
+static size_t summaries_size(size_t num_rows) { return (num_rows == 0 ? 1 : num_rows) * sizeof(struct RowSummary); }
+
+int build_row_summaries(struct Event* event) {
+  if (atomic_load_explicit(&event->summaries, memory_order_relaxed) != NULL) return 0;
+
+  struct RowSummary* summaries = arena_alloc(summaries_size(event->rows));
+  if (!summaries) return 1;
+  for (size_t row = 0; row < event->rows; row++) {
+    size_t free_seats;
+    size_t longest = seatmap_longest_run(event->occupied, row * event->cols, event->cols, &free_seats);
+    summaries[row].taken = event->cols - free_seats;
+    summaries[row].blocked = event->cols - longest;
+  }
+  atomic_store_explicit(&event->summaries, summaries, memory_order_release);
+  return 0;
+}
+
+void update_row_summaries(struct Event* event, const size_t* rows, size_t count) {
+  struct RowSummary* summaries = atomic_load_explicit(&event->summaries, memory_order_acquire);
+  if (!summaries) return;
+
+  for (size_t i = 0; i < count; i++) {
+    // Reservations usually take seats of the same row, which only need to be measured once
+    if (i > 0 && rows[i] == rows[i - 1]) continue;
+    size_t row = rows[i] - 1;
+    size_t free_seats;
+    size_t longest = seatmap_longest_run(event->occupied, row * event->cols, event->cols, &free_seats);
+    __atomic_store_n(&summaries[row].taken, event->cols - free_seats, __ATOMIC_RELAXED);
+    __atomic_store_n(&summaries[row].blocked, event->cols - longest, __ATOMIC_RELAXED);
+  }
+}
+
+size_t find_free_row(struct Event* event, size_t first_row, size_t length) {
+  struct RowSummary* summaries = atomic_load_explicit(&event->summaries, memory_order_acquire);
+  for (size_t row = first_row; row < event->rows; row++) {
+    if (event->cols - __atomic_load_n(&summaries[row].taken, __ATOMIC_RELAXED) < length) continue;
+    if (event->cols - __atomic_load_n(&summaries[row].blocked, __ATOMIC_RELAXED) >= length) return row;
+  }
+  return event->rows;
+}
+
+/// Calculates the size of the entry of a reservation in a reverse index.
+/// @param num_seats Number of seats of the reservation.
+/// @return Size in bytes.
+static size_t reserved_seats_size(size_t num_seats) {
+  return sizeof(struct ReservedSeats) + num_seats * sizeof(size_t);
+}
+
+/// Frees the entries of a reverse index, and the array that holds them.
+/// @param index Reverse index, left with no entries and no capacity.
+static void clear_reservation_index(struct ReservationIndex* index) {
+  for (size_t id = 0; id < index->capacity; id++) {
+    if (index->by_id[id] != NULL) arena_recycle(index->by_id[id], reserved_seats_size(index->by_id[id]->num_seats));
+  }
+  arena_recycle(index->by_id, index->capacity * sizeof(struct ReservedSeats*));
+  index->by_id = NULL;
+  index->capacity = 0;
+}
+
+/// Makes room in a reverse index for a reservation id.
+/// @note The caller must hold the mutex of the index.
+/// @param index Reverse index.
+/// @param reservation_id Id of the reservation.
+/// @return 0 if the id fits in the index, 1 if it could not grow.
+static int reserve_reservation_id(struct ReservationIndex* index, unsigned int reservation_id) {
+  if (reservation_id < index->capacity) return 0;
+
+  size_t capacity = index->capacity == 0 ? RESERVATIONS_INITIAL_CAPACITY : index->capacity;
+  while (capacity <= reservation_id) capacity *= 2;
+  struct ReservedSeats** by_id = arena_alloc(capacity * sizeof(struct ReservedSeats*));
+  if (!by_id) return 1;
+  if (index->capacity > 0) memcpy(by_id, index->by_id, index->capacity * sizeof(struct ReservedSeats*));
+  arena_recycle(index->by_id, index->capacity * sizeof(struct ReservedSeats*));
+  index->by_id = by_id;
+  index->capacity = capacity;
+  return 0;
+}
+
+int build_reservation_index(struct Event* event) {
+  struct ReservationIndex* index = atomic_load_explicit(&event->reservation_index, memory_order_relaxed);
+  if (index != NULL && !index->stale) return 0;
+
+  int published = index != NULL;
+  if (!published) {
+    index = arena_alloc(sizeof(struct ReservationIndex));
+    if (!index) return 1;
+    if (pthread_mutex_init(&index->mutex, NULL) != 0) {
+      arena_recycle(index, sizeof(struct ReservationIndex));
+      return 1;
+    }
+  }
+
+  // Cancels take entries without any stripe, so the mutex is held while the entries are replaced
+  pthread_mutex_lock(&index->mutex);
+  clear_reservation_index(index);
+  index->stale = 0;
+
+  // Seats are counted per id first, so each reservation is allocated once with its final size
+  size_t num_seats = event->rows * event->cols;
+  unsigned int reservations = atomic_load_explicit(&event->reservations, memory_order_relaxed);
+  size_t* counts = NULL;
+  int error = reserve_reservation_id(index, reservations) != 0 ||
+              (counts = arena_alloc(index->capacity * sizeof(size_t))) == NULL;
+  for (size_t seat = 0; !error && seat < num_seats; seat++) {
+    seat += seatmap_next_set(event->occupied, seat, num_seats - seat);
+    if (seat == num_seats) break;
+    unsigned int id = seatgrid_get(event->data, event->width, seat);
+    if (id < index->capacity) counts[id]++;
+  }
+  for (size_t id = 1; !error && id < index->capacity; id++) {
+    if (counts[id] == 0) continue;
+    index->by_id[id] = arena_alloc(reserved_seats_size(counts[id]));
+    error = index->by_id[id] == NULL;
+  }
+  for (size_t seat = 0; !error && seat < num_seats; seat++) {
+    seat += seatmap_next_set(event->occupied, seat, num_seats - seat);
+    if (seat == num_seats) break;
+    unsigned int id = seatgrid_get(event->data, event->width, seat);
+    if (id == 0 || id >= index->capacity) continue;
+    struct ReservedSeats* entry = index->by_id[id];
+    entry->seats[entry->num_seats++] = seat;
+  }
+  if (counts != NULL) arena_recycle(counts, index->capacity * sizeof(size_t));
+
+  if (error) {
+    clear_reservation_index(index);
+    index->stale = 1;
+  }
+  pthread_mutex_unlock(&index->mutex);
+  // Reservations look for the index once they hold their stripes, so they add to it from then on
+  if (!published) atomic_store_explicit(&event->reservation_index, index, memory_order_release);
+  return error;
+}
+
+void index_reservation(struct Event* event, unsigned int reservation_id, const size_t* seats, size_t count) {
+  struct ReservationIndex* index = atomic_load_explicit(&event->reservation_index, memory_order_acquire);
+  if (!index) return;
+
+  pthread_mutex_lock(&index->mutex);
+  struct ReservedSeats* entry = NULL;
+  if (!index->stale && reserve_reservation_id(index, reservation_id) == 0) {
+    entry = arena_alloc(reserved_seats_size(count));
+  }
+  if (entry != NULL) {
+    entry->num_seats = count;
+    memcpy(entry->seats, seats, count * sizeof(size_t));
+    index->by_id[reservation_id] = entry;
+  } else {
+    // The next cancel rebuilds the index from the seats
+    index->stale = 1;
+  }
+  pthread_mutex_unlock(&index->mutex);
+}
+
+int reservation_index_ready(struct Event* event) {
+  struct ReservationIndex* index = atomic_load_explicit(&event->reservation_index, memory_order_acquire);
+  if (!index) return 0;
+  pthread_mutex_lock(&index->mutex);
+  int ready = !index->stale;
+  pthread_mutex_unlock(&index->mutex);
+  return ready;
+}
+
+int take_reservation(struct Event* event, unsigned int reservation_id, size_t max, size_t* seats, size_t* count) {
+  struct ReservationIndex* index = atomic_load_explicit(&event->reservation_index, memory_order_acquire);
+  if (!index) return 1;
+
+  pthread_mutex_lock(&index->mutex);
+  struct ReservedSeats* entry = !index->stale && reservation_id < index->capacity ? index->by_id[reservation_id] : NULL;
+  int found = entry != NULL && (seats == NULL || entry->num_seats <= max);
+  if (found) {
+    index->by_id[reservation_id] = NULL;
+    if (seats != NULL) memcpy(seats, entry->seats, entry->num_seats * sizeof(size_t));
+    if (count != NULL) *count = entry->num_seats;
+    arena_recycle(entry, reserved_seats_size(entry->num_seats));
+  }
+  pthread_mutex_unlock(&index->mutex);
+  return !found;
+}
+
+int enable_holds(struct Event* event) {
+  if (event->held != NULL) return 0;
+  uint64_t* held = arena_alloc(seatmap_size(event->rows * event->cols));
+  if (!held) return 1;
+  // Holds look for the bitmap before locking the event
+  __atomic_store_n(&event->held, held, __ATOMIC_RELEASE);
+  return 0;
+}
+
+void free_event(struct Event* event) {
+  if (!event) return;
+  arena_recycle(event->held, seatmap_size(event->rows * event->cols));
+  arena_recycle(event->dirty_rows, dirty_rows_size(event->rows));
+  arena_recycle(atomic_load_explicit(&event->summaries, memory_order_relaxed), summaries_size(event->rows));
+  struct ReservationIndex* index = atomic_load_explicit(&event->reservation_index, memory_order_relaxed);
+  if (index != NULL) {
+    clear_reservation_index(index);
+    pthread_mutex_destroy(&index->mutex);
+    arena_recycle(index, sizeof(struct ReservationIndex));
+  }
+  for (size_t i = 0; i < event->num_stripes; i++) pthread_mutex_destroy(&event->stripes[i].mutex);
+  combiner_destroy(&event->combiner);
+  if (event->num_stripes > 1) arena_recycle(event->stripes, event->num_stripes * sizeof(struct EventStripe));
+  slab_free(&event_slab, event);
+}
+
 int append_to_list(struct EventList* list, struct Event* event) {
   if (!list) return 1;
 
-  struct ListNode* new_node = (struct ListNode*)malloc(sizeof(struct ListNode));
+  if (index_reserve(list) != 0 || dense_reserve(list, event->id) != 0 || sorted_reserve(list) != 0) return 1;
+
+  struct ListNode* new_node = slab_alloc(&node_slab);
   if (!new_node) return 1;
 
   new_node->event = event;
   new_node->next = NULL;
+  new_node->prev = list->tail;
+  event->node = new_node;
 
   if (list->head == NULL) {
     list->head = new_node;
@@ -33,43 +706,151 @@ int append_to_list(struct EventList* list, struct Event* event) {
     list->tail = new_node;
   }
 
+  // Ids usually grow, in which case this is an append
+  size_t position = sorted_lower_bound(list, event->id);
+  memmove(&list->sorted_ids[position + 1], &list->sorted_ids[position],
+          (list->index_size - position) * sizeof(unsigned int));
+  list->sorted_ids[position] = event->id;
+
+  index_insert(atomic_load_explicit(&list->index, memory_order_relaxed), event);
+  list->index_size++;
+  list->index_used++;
+
+  struct DenseTable* dense = atomic_load_explicit(&list->dense, memory_order_relaxed);
+  if (dense != NULL && event->id < dense->capacity) {
+    atomic_store_explicit(&dense->entries[event->id], event, memory_order_release);
+  }
+
   return 0;
 }
 
-static void free_event(struct Event* event) {
-  if (!event) return;
-  free(event->data);
-  free(event);
+void remove_from_list(struct EventList* list, struct Event* event) {
+  if (!list || !event) return;
+
+  struct ListNode* node = event->node;
+  if (node->prev != NULL) {
+    node->prev->next = node->next;
+  } else {
+    list->head = node->next;
+  }
+  if (node->next != NULL) {
+    node->next->prev = node->prev;
+  } else {
+    list->tail = node->prev;
+  }
+  // List traversals hold the rwl, so the node can go right away
+  slab_free(&node_slab, node);
+  event->node = NULL;
+
+  struct DenseTable* dense = atomic_load_explicit(&list->dense, memory_order_relaxed);
+  if (dense != NULL && event->id < dense->capacity) {
+    atomic_store_explicit(&dense->entries[event->id], NULL, memory_order_release);
+  }
+
+  struct IndexTable* index = atomic_load_explicit(&list->index, memory_order_relaxed);
+  size_t i = index_slot(event->id, index->capacity);
+  while (atomic_load_explicit(&index->slots[i].event, memory_order_relaxed) != event) {
+    i = (i + 1) & (index->capacity - 1);
+  }
+  atomic_store_explicit(&index->slots[i].event, TOMBSTONE, memory_order_release);
+
+  size_t position = sorted_lower_bound(list, event->id);
+  memmove(&list->sorted_ids[position], &list->sorted_ids[position + 1],
+          (list->index_size - position - 1) * sizeof(unsigned int));
+  list->index_size--;
+
+  // Without the id the next incremental checkpoint could not tell the event is gone, so a full one is needed
+  if (list->num_removed == list->removed_capacity) {
+    size_t capacity = list->removed_capacity == 0 ? REMOVED_INITIAL_CAPACITY : list->removed_capacity * 2;
+    unsigned int* ids = realloc(list->removed_ids, capacity * sizeof(unsigned int));
+    if (!ids) {
+      list->removed_lost++;
+      return;
+    }
+    list->removed_ids = ids;
+    list->removed_capacity = capacity;
+  }
+  list->removed_ids[list->num_removed++] = event->id;
+}
+
+void mark_row_dirty(struct Event* event, size_t row) {
+  // Lock-free claims of the same row may mark it at the same time
+  __atomic_store_n(&event->dirty_rows[row], 1, __ATOMIC_RELAXED);
+}
+
+int row_is_dirty(struct Event* event, size_t row) { return event->dirty_rows[row]; }
+
+void clear_dirty_rows(struct Event* event) { memset(event->dirty_rows, 0, dirty_rows_size(event->rows)); }
+
+void forget_removed(struct EventList* list, size_t count) {
+  if (count > list->num_removed) count = list->num_removed;
+  memmove(list->removed_ids, list->removed_ids + count, (list->num_removed - count) * sizeof(unsigned int));
+  list->num_removed -= count;
+}
+
+/// Releases a retired event, called by the epoch module once no lookup can still see it.
+/// @param arg Event to be released.
+static void release_event(void* arg) {
+  struct Event* event = arg;
+  seatgrid_release(event->data, event->width, event->rows * event->cols);
+  arena_recycle(event->occupied, seatmap_size(event->rows * event->cols));
+  free_event(event);
+}
+
+void retire_event(struct Event* event) {
+  epoch_retire(&event->retired, event, release_event);
 }
 
 void free_list(struct EventList* list) {
   if (!list) return;
 
-  struct ListNode* current = list->head;
-  while (current) {
-    struct ListNode* temp = current;
-    current = current->next;
+  for (struct ListNode* current = list->head; current; current = current->next) {
+    struct Event* event = current->event;
+    for (size_t i = 0; i < event->num_stripes; i++) pthread_mutex_destroy(&event->stripes[i].mutex);
+    combiner_destroy(&event->combiner);
+  }
+
+  // Events and nodes are released in bulk with their slabs
+  slab_release(&event_slab);
+  slab_release(&node_slab);
+  slab_release(&grid_slab);
 
-    free_event(temp->event);
-    free(temp);
+  free(atomic_load_explicit(&list->index, memory_order_relaxed));
+  free(atomic_load_explicit(&list->dense, memory_order_relaxed));
+  free(list->sorted_ids);
+  free(list->removed_ids);
+}
+
+const unsigned int* list_ids(struct EventList* list, unsigned int cursor, size_t* count) {
+  if (!list || list->index_size == 0) {
+    *count = 0;
+    return NULL;
   }
 
-  
+  size_t position = sorted_lower_bound(list, cursor);
+  *count = list->index_size - position;
+  return &list->sorted_ids[position];
 }
 
-struct Event* get_event(struct EventList* list, unsigned int event_id, struct ListNode* from, struct ListNode* to) {
-  if (!list || !from || !to) return NULL;
-  struct ListNode* current = from;
+struct Event* get_event(struct EventList* list, unsigned int event_id) {
+  if (!list) return NULL;
 
-  while (1) {
-    if (current->event->id == event_id) {
-      return current->event;
-    }
+  struct DenseTable* dense = atomic_load_explicit(&list->dense, memory_order_acquire);
+  if (dense != NULL && event_id < dense->capacity) {
+    return atomic_load_explicit(&dense->entries[event_id], memory_order_acquire);
+  }
 
-    if (current == to) {
-      return NULL;
-    }
+  struct IndexTable* index = atomic_load_explicit(&list->index, memory_order_acquire);
+  if (index == NULL) return NULL;
 
-    current = current->next;
+  size_t i = index_slot(event_id, index->capacity);
+  struct Event* event;
+  while ((event = atomic_load_explicit(&index->slots[i].event, memory_order_acquire)) != NULL) {
+    if (event != TOMBSTONE && index->slots[i].id == event_id) {
+      return event;
+    }
+    i = (i + 1) & (index->capacity - 1);
   }
+
+  return NULL;
 }
@@ -2,22 +2,119 @@
 #define SERVER_EVENT_LIST_H
 
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stddef.h>
+#include <stdint.h>
 
+#include "alloc.h"
+#include "combiner.h"
+#include "epoch.h"
+
+#define EVENT_MAX_STRIPES 64       // Most row stripes an event can be split into (one bit each in a stripe mask)
+#define EVENT_ROWS_PER_STRIPE 16   // Rows per stripe when the number of stripes is left to create_event
+
+// Lock of a range of rows of an event. Each stripe has a cache line of its own, so writers of different
+// stripes do not bounce a shared line between them.
+struct EventStripe {
+  _Alignas(CACHE_LINE_SIZE) pthread_mutex_t mutex;  // Held while the seats of the rows are read or written
+  _Atomic unsigned long seq;  // Writes to the seats of the rows, started and completed (see begin_seat_writes)
+};
+
+// Availability of a row, for finding adjacent free seats without reading the seats (see find_free_row).
+// Stored as measured after each change to the row, so lock-free claims racing with a release in the same row may
+// leave it short of the free seats until the next change (see ems_reserve_best).
+struct RowSummary {
+  size_t taken;    // Reserved seats of the row
+  size_t blocked;  // Columns of the row minus its longest run of adjacent free seats
+};
+
+// Seats of a reservation, in the reverse index of its event
+struct ReservedSeats {
+  size_t num_seats;  // Number of seats
+  size_t seats[];    // Indexes of the seats
+};
+
+// Reverse index from the reservation ids of an event to their seats, so a cancel only touches the seats of the
+// reservation (see build_reservation_index)
+struct ReservationIndex {
+  pthread_mutex_t mutex;         // Guards the index, reservations add to it from several stripes at once
+  int stale;                     // Set if a reservation could not be added, so the index must be built again
+  size_t capacity;               // Ids below this value fit in by_id
+  struct ReservedSeats** by_id;  // Seats of each id, NULL for ids with none (cancelled, expired or never used)
+};
+
+// The rows of an event are split into stripes, each with its own lock. The seats of a row (their ids,
+// occupancy bits and dirty flag) are guarded by the stripe of the row, so reservations of rows in
+// different stripes run in parallel. Everything else is guarded by every stripe (see lock_event).
+// Seats can also be read without any lock, as a seqlock: see read_seats_begin. In the lock-free
+// reservation mode seats are also claimed without any lock: see begin_seat_claims.
 struct Event {
-  unsigned int id;            /// Event id
-  unsigned int reservations;  /// Number of reservations for the event.
+  // Read by every request and written rarely, if ever, after the event is created
+  unsigned int id;             /// Event id
+  _Atomic unsigned int width;  // Bytes per seat of data (see seatgrid.h)
 
   size_t cols;  /// Number of columns.
   size_t rows;  /// Number of rows.
 
-  unsigned int* data;     /// Array of size rows * cols with the reservations for each seat.
-  pthread_mutex_t mutex;  // Mutex to protect the event
+  void** _Atomic data;    /// Tiles of the reservations for each seat, width bytes each (see seatgrid.h).
+  uint64_t* occupied;     // Occupancy bitmap of data (see seatmap.h)
+  uint64_t* held;         // Seats held and not confirmed yet (see holds.h), NULL until the first hold
+  int deleted;            // Set (with every stripe held) once the event has been removed from the list
+  _Atomic int locked;     // Set by lock_event, so lock-free claims wait until unlock_event
+  struct ListNode* node;  // Node of the list holding the event
+  uint64_t generation;    // Unique to the event, unlike its id and address, which a later event may reuse
+
+  struct EventStripe* stripes;  // Locks of the stripes, in row order
+  size_t num_stripes;           // Number of stripes, at most EVENT_MAX_STRIPES
+  size_t stripe_rows;           // Rows of each stripe, the last one may have fewer
+
+  struct RowSummary* _Atomic summaries;  // One per row, NULL until needed (see build_row_summaries)
+  struct ReservationIndex* _Atomic reservation_index;  // NULL until the first cancel (see build_reservation_index)
+
+  // Checkpoint state
+  unsigned char* dirty_rows;  // One flag per row, set for rows reserved since the last checkpoint
+  int checkpointed;           // Whether the event is in a checkpoint, events that are not are saved whole
+
+  struct EpochEntry retired;  // Entry of the event once removed (see retire_event)
+
+  // Written by every reservation, whatever its stripe, so they get a line of their own instead of evicting
+  // the fields above from the caches of the other workers
+  _Alignas(CACHE_LINE_SIZE) _Atomic unsigned int reservations;  /// Number of reservations for the event.
+  _Atomic unsigned long version;  // Reservations committed to the seats, bumped between begin/end_seat_writes
+  _Atomic unsigned int contention;  // Reservations in a row that found their stripes taken (see reserve_seats)
+  _Atomic int combining;            // Set while reservations go through the combiner instead of the stripes
+
+  struct EventStripe single_stripe;  // Lock of events with a single stripe, so they need no allocation
+
+  // Reservations of a contended event, posted by every worker, so the list head gets a line of its own
+  _Alignas(CACHE_LINE_SIZE) struct Combiner combiner;
+  unsigned int lone_batches;  // Batches in a row with a single reservation, guarded by the combiner
 };
 
 struct ListNode {
   struct Event* event;
   struct ListNode* next;
+  struct ListNode* prev;
+};
+
+// Slot of the open-addressing event index
+struct IndexSlot {
+  unsigned int id;               // Event id stored in the slot, written before the event is published
+  struct Event* _Atomic event;   // Event with the given id, NULL if the slot is empty, a tombstone if removed
+};
+
+// Open-addressing hash index of the events, replaced as a whole when it grows
+struct IndexTable {
+  size_t capacity;            // Number of slots (power of two)
+  struct EpochEntry retired;  // Entry of the table once replaced
+  struct IndexSlot slots[];
+};
+
+// Direct-indexed table for small and contiguous ids, replaced as a whole when it grows
+struct DenseTable {
+  size_t capacity;                   // Ids below this value are resolved through the table
+  struct EpochEntry retired;         // Entry of the table once replaced
+  struct Event* _Atomic entries[];
 };
 
 // Linked list structure
@@ -26,29 +123,279 @@ struct EventList {
   struct ListNode* tail;  // Tail of the list
   pthread_rwlock_t rwl;   // Mutex to protect the list
   size_t num_events;            // Size of the list
+
+  // The tables below are published through atomic pointers so get_event can run without the rwl.
+  // Writers must hold the rwl for writing; replaced tables are reclaimed through the epoch module.
+  struct IndexTable* _Atomic index;  // Hash index of the events, keyed by id
+  size_t index_size;                 // Number of events in the index
+  size_t index_used;                 // Number of non-empty slots in the index, including tombstones
+  struct DenseTable* _Atomic dense;  // Fast path for small and contiguous ids
+
+  unsigned int* sorted_ids;  // Ids of the events in ascending order, index_size of them
+  size_t sorted_capacity;    // Number of ids that fit in sorted_ids
+
+  unsigned int* removed_ids;  // Ids removed since the last checkpoint, in removal order
+  size_t num_removed;         // Number of ids in removed_ids
+  size_t removed_capacity;    // Number of ids that fit in removed_ids
+  size_t removed_lost;        // Removals that could not be recorded, the next checkpoint must be full if not 0
 };
 
 /// Creates a new event list.
 /// @return Newly created event list, NULL on failure
 struct EventList* create_list();
 
+/// Creates a new event. The event comes from a slab and its seats from the arena of the calling thread.
+/// @note The seats start 1 byte wide, see widen_seats. No tile of seats is allocated until a seat is reserved,
+/// so the cost does not depend on the number of seats beyond the tile directory and the bitmap.
+/// @param event_id Event id.
+/// @param num_rows Number of rows.
+/// @param num_cols Number of columns.
+/// @param num_stripes Number of row stripes, 0 for one per EVENT_ROWS_PER_STRIPE rows. Stripes never share
+/// a word of the occupancy bitmap, so small or narrow events may get fewer.
+/// @return Newly created event with every seat free, NULL on failure.
+struct Event* create_event(unsigned int event_id, size_t num_rows, size_t num_cols, size_t num_stripes);
+
+/// Creates a new event whose seats are already allocated.
+/// @note The tiles and the bitmap are handed to arena_recycle when the event is deleted, so they must be aligned
+/// and padded like arena memory and stay valid until alloc_release_all.
+/// @param event_id Event id.
+/// @param num_rows Number of rows.
+/// @param num_cols Number of columns.
+/// @param data Tile directory of the seats (from seatgrid_create), rows * cols of them.
+/// @param width Bytes per seat of data.
+/// @param occupied Occupancy bitmap of the seats, seatmap_size(rows * cols) bytes.
+/// @param num_stripes Number of row stripes, as in create_event.
+/// @return Newly created event, NULL on failure.
+struct Event* create_event_at(unsigned int event_id, size_t num_rows, size_t num_cols, void** data,
+                              unsigned int width, uint64_t* occupied, size_t num_stripes);
+
+/// Finds the stripes holding a set of rows.
+/// @param event Event.
+/// @param rows Rows, starting at 1, which must exist.
+/// @param count Number of rows.
+/// @return Mask with the bit of each stripe set.
+uint64_t row_stripes(const struct Event* event, const size_t* rows, size_t count);
+
+/// Sets whether the seats of each event are only ever touched by one thread at a time, in which case the stripes are
+/// never locked (see owners.h).
+/// @note Must be called while no other thread uses the events.
+/// @param owned Whether lock_stripes, trylock_stripes and unlock_stripes leave the stripes alone.
+void set_stripes_owned(int owned);
+
+/// Locks a set of stripes of an event. Stripes are always taken in row order, so this cannot deadlock.
+/// @param event Event to be locked.
+/// @param mask Stripes to be locked, from row_stripes.
+void lock_stripes(struct Event* event, uint64_t mask);
+
+/// Locks a set of stripes of an event if none of them is held by another thread, without waiting.
+/// @param event Event to be locked.
+/// @param mask Stripes to be locked, from row_stripes.
+/// @return 0 if the stripes were locked, 1 if one of them was held, in which case none is held on return.
+int trylock_stripes(struct Event* event, uint64_t mask);
+
+/// Unlocks a set of stripes of an event.
+/// @param event Event to be unlocked.
+/// @param mask Stripes to be unlocked.
+void unlock_stripes(struct Event* event, uint64_t mask);
+
+/// Finds every stripe of an event.
+/// @param event Event.
+/// @return Mask with the bit of every stripe set.
+uint64_t all_stripes(const struct Event* event);
+
+/// Locks every stripe of an event, for operations on the whole event.
+/// @note Also waits for the lock-free claims in progress to finish, and holds off new ones.
+/// @param event Event to be locked.
+void lock_event(struct Event* event);
+
+/// Unlocks every stripe of an event.
+/// @param event Event to be unlocked.
+void unlock_event(struct Event* event);
+
+/// Runs a function with an event locked whole (see lock_event). With owned stripes (see set_stripes_owned), locking
+/// keeps no writer out, so the function runs in the owner thread of the event instead.
+/// @note The caller must not hold any stripe of the event.
+/// @param event Event to be locked.
+/// @param fn Function to run, with the event and arg.
+/// @param arg Argument of the function.
+void with_event_locked(struct Event* event, void (*fn)(struct Event* event, void* arg), void* arg);
+
+/// Marks the start of writes to the seats of a set of stripes, so lock-free readers retry.
+/// @note The caller must hold the stripes, and call end_seat_writes with the same mask once done.
+/// @param event Event whose seats are written.
+/// @param mask Stripes whose seats are written.
+void begin_seat_writes(struct Event* event, uint64_t mask);
+
+/// Marks the end of writes to the seats of a set of stripes.
+/// @param event Event whose seats were written.
+/// @param mask Stripes passed to begin_seat_writes.
+void end_seat_writes(struct Event* event, uint64_t mask);
+
+/// Marks the start of lock-free writes to the seats of a set of stripes, waiting while the event is
+/// locked with lock_event. Claims of different writers may overlap, so seats must be written with atomics.
+/// @note The caller must call end_seat_claims with the same mask once done. It may hold stripes of the event, since
+/// lock_event cannot lock the event meanwhile, but must not wait for them between the two calls.
+/// @param event Event whose seats are written.
+/// @param mask Stripes whose seats are written.
+void begin_seat_claims(struct Event* event, uint64_t mask);
+
+/// Marks the end of lock-free writes to the seats of a set of stripes, letting lock_event go on once no claim is
+/// left.
+/// @param event Event whose seats were written.
+/// @param mask Stripes passed to begin_seat_claims.
+void end_seat_claims(struct Event* event, uint64_t mask);
+
+/// Starts a lock-free read of the seats of an event, waiting a bounded time for writes in progress to finish.
+/// The seats may be read with seatgrid_load from data and width once this returns 0, and the copy is only
+/// consistent if read_seats_retry returns 0 afterwards.
+/// @note The caller must be inside an epoch, which keeps grids replaced by widen_seats alive. Writers that
+/// keep overlapping can hold off lock-free reads for good, so a caller that gives up reads with lock_event.
+/// @param event Event to be read.
+/// @param token Where to store the token to be passed to read_seats_retry.
+/// @return 0 if the read can start, 1 if writes were still in progress after every wait.
+int read_seats_begin(struct Event* event, unsigned long* token);
+
+/// Checks whether the seats of an event were written during a lock-free read.
+/// @param event Event that was read.
+/// @param token Token returned by read_seats_begin.
+/// @return 1 if the read must be retried, 0 if what was read is consistent.
+int read_seats_retry(struct Event* event, unsigned long token);
+
+/// Makes sure the seats of an event can store a reservation id, moving them to a wider grid if needed.
+/// @note The caller must hold every stripe. Only the allocated tiles are copied. The previous grid is retired
+/// through the epoch module, since lock-free readers may still be copying it, and is usually freed by the next
+/// expiry tick (see holds_start): until then both grids take memory (see seatgrid_widen).
+/// @param event Event to be widened.
+/// @param reservation_id Reservation id that will be stored.
+/// @return 0 if the id fits, 1 if the wider grid could not be allocated.
+int widen_seats(struct Event* event, unsigned int reservation_id);
+
+/// Builds the availability summaries of an event from its occupancy bitmap, if it has none yet.
+/// @note The caller must hold every stripe (see lock_event). Once built, the summaries are kept up to date by
+/// update_row_summaries, so events that never need them pay nothing.
+/// @param event Event.
+/// @return 0 if the event has summaries, 1 if they could not be allocated.
+int build_row_summaries(struct Event* event);
+
+/// Updates the summaries of the rows of reserved or released seats from the occupancy bitmap, if the event has them.
+/// @note The caller must hold the stripes of the rows, or have claimed the seats (see begin_seat_claims).
+/// @param event Event.
+/// @param rows Rows of the seats, starting at 1 (and may repeat).
+/// @param count Number of seats.
+void update_row_summaries(struct Event* event, const size_t* rows, size_t count);
+
+/// Finds the first row, from the front, that may have a run of adjacent free seats, from its summary.
+/// @note Reads the summaries without any lock, so the run must be confirmed in the bitmap with the stripe of
+/// the row held. The event must have summaries.
+/// @param event Event.
+/// @param first_row First row to consider, starting at 0.
+/// @param length Number of adjacent free seats wanted.
+/// @return Index of the row, starting at 0, or the number of rows if no row has such a run.
+size_t find_free_row(struct Event* event, size_t first_row, size_t length);
+
+/// Builds the reverse index of an event from its seats, if it has none or it is stale.
+/// @note The caller must hold every stripe (see lock_event). Only taken seats are read, through the occupancy
+/// bitmap. Once built, the index is kept up to date by index_reservation, so events that are never cancelled
+/// pay nothing for it.
+/// @param event Event.
+/// @return 0 if the event has an up to date index, 1 if it could not be allocated.
+int build_reservation_index(struct Event* event);
+
+/// Adds a reservation to the reverse index of an event, if it has one.
+/// @note The caller must hold the stripes of the seats, or have claimed them (see begin_seat_claims). If the
+/// reservation cannot be allocated the index is marked stale instead, so the reservation does not fail.
+/// @param event Event.
+/// @param reservation_id Id of the reservation.
+/// @param seats Indexes of the seats.
+/// @param count Number of seats.
+void index_reservation(struct Event* event, unsigned int reservation_id, const size_t* seats, size_t count);
+
+/// Checks whether an event has an up to date reverse index.
+/// @param event Event.
+/// @return 1 if the event has an index that is not stale, 0 otherwise (see build_reservation_index).
+int reservation_index_ready(struct Event* event);
+
+/// Removes a reservation from the reverse index of an event, if it has one.
+/// @param event Event.
+/// @param reservation_id Id of the reservation.
+/// @param max Most seats that fit in seats.
+/// @param seats Where to store the indexes of the seats of the reservation, NULL to only remove it.
+/// @param count Where to store the number of seats, may be NULL.
+/// @return 0 if the reservation was removed, 1 if it is not in the index, the index is stale or the reservation
+/// has more than max seats.
+int take_reservation(struct Event* event, unsigned int reservation_id, size_t max, size_t* seats, size_t* count);
+
+/// Gives an event the bitmap of its held seats, if it has none yet.
+/// @note The caller must hold every stripe (see lock_event). Events that are never held pay nothing.
+/// @param event Event.
+/// @return 0 if the event has the bitmap, 1 if it could not be allocated.
+int enable_holds(struct Event* event);
+
+/// Frees an event that was never appended to a list.
+/// @note The seats stay in the arena until alloc_release_all.
+/// @param event Event to be freed.
+void free_event(struct Event* event);
+
 /// Appends a new node to the list.
 /// @param list Event list to be modified.
 /// @param data Event to be stored in the new node.
 /// @return 0 if the node was appended successfully, 1 otherwise.
 int append_to_list(struct EventList* list, struct Event* data);
 
-/// Removes a node from the list.
+/// Removes an event from the list and from the index, and records its id for the next checkpoint.
+/// @note Concurrent lookups may still hold the event, so it must be released with retire_event.
 /// @param list Event list to be modified.
-/// @return 0 if the node was removed successfully, 1 otherwise.
+/// @param event Event to be removed.
+void remove_from_list(struct EventList* list, struct Event* event);
+
+/// Releases a removed event once no lookup can still be using it.
+/// @note Its seat array is recycled for later events of the same size.
+/// @param event Event to be released.
+void retire_event(struct Event* event);
+
+/// Frees every node and event of the list.
+/// @note Seat arrays are released in bulk by alloc_release_all.
+/// @param list Event list to be freed.
 void free_list(struct EventList* list);
 
+/// Marks a row of an event as changed since the last checkpoint.
+/// @note The caller must hold the stripe of the row.
+/// @param event Event whose row changed.
+/// @param row Index of the row, starting at 0.
+void mark_row_dirty(struct Event* event, size_t row);
+
+/// Checks whether a row of an event changed since the last checkpoint.
+/// @note The caller must hold the stripe of the row.
+/// @param event Event to check.
+/// @param row Index of the row, starting at 0.
+/// @return 1 if the row changed, 0 otherwise.
+int row_is_dirty(struct Event* event, size_t row);
+
+/// Clears the changed rows of an event, once they were saved.
+/// @note The caller must hold every stripe.
+/// @param event Event whose rows were saved.
+void clear_dirty_rows(struct Event* event);
+
+/// Drops the oldest recorded removals, once a checkpoint saved them.
+/// @note The caller must hold the rwl for writing.
+/// @param list Event list whose removals were saved.
+/// @param count Number of removals saved.
+void forget_removed(struct EventList* list, size_t count);
+
+/// Finds the ids of the list, in ascending order, starting at a cursor.
+/// @note The caller must hold the rwl (for reading at least) while it uses the returned ids.
+/// @param list Event list to be searched.
+/// @param cursor Smallest id to be returned.
+/// @param count Set to the number of ids from the cursor to the end of the list.
+/// @return Pointer to the first id not below the cursor (valid only if count is not 0).
+const unsigned int* list_ids(struct EventList* list, unsigned int cursor, size_t* count);
+
 /// Retrieves an event in the list.
+/// @note Uses the dense table or the hash index, so the cost does not depend on the size of the list.
+/// Does not need the rwl, but the caller must be inside an epoch (see epoch.h) while it uses the tables.
 /// @param list Event list to be searched
 /// @param event_id Event id.
-/// @param from First node to be searched.
-/// @param to Last node to be searched.
 /// @return Pointer to the event if found, NULL otherwise.
-struct Event* get_event(struct EventList* list, unsigned int event_id, struct ListNode* from, struct ListNode* to);
+struct Event* get_event(struct EventList* list, unsigned int event_id);
 
 #endif  // SERVER_EVENT_LIST_H
@@ -0,0 +1,224 @@
+#include "holds.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "alloc.h"
+#include "common/io.h"
+#include "epoch.h"
+
+#define HOLDS_MIN_BUCKETS 1024  // Buckets of the table while it is small
+
+static pthread_mutex_t holds_mutex = PTHREAD_MUTEX_INITIALIZER;  // Guards the table and the wheel
+static pthread_cond_t holds_cond;                                // Signaled to stop the expiry thread
+static pthread_t holds_thread;
+static int holds_running = 0;   // Whether the expiry thread was started
+static int holds_stopping = 0;  // Set by holds_stop
+
+static struct Hold** buckets = NULL;  // Chains of the table, num_buckets of them
+static size_t num_buckets = 0;        // Power of two, the table grows to keep it above num_holds
+static size_t num_holds = 0;          // Outstanding holds
+static struct TimerWheel wheel;       // Expiry of the outstanding holds, one tick every HOLDS_TICK_MS
+static struct timespec started;       // Time of tick 0
+static void (*expire_hold)(struct Hold* hold) = NULL;
+
+/// Calculates the size of a hold.
+/// @param num_seats Number of seats of the hold.
+/// @return Size in bytes.
+static size_t hold_size(size_t num_seats) { return sizeof(struct Hold) + num_seats * sizeof(size_t); }
+
+/// Finds the bucket of a hold.
+/// @param event_id Id of the event of the hold.
+/// @param hold_id Id of the hold.
+/// @param count Number of buckets, a power of two.
+/// @return Index of the bucket.
+static size_t bucket_of(unsigned int event_id, unsigned int hold_id, size_t count) {
+  uint64_t key = ((uint64_t)event_id << 32 | hold_id) * 0x9e3779b97f4a7c15ull;
+  return (size_t)(key ^ key >> 32) & (count - 1);
+}
+
+/// Reads the current tick of the wheel.
+/// @return Ticks since the expiry thread started.
+static uint64_t current_tick() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  int64_t ms = (int64_t)(now.tv_sec - started.tv_sec) * 1000 + (now.tv_nsec - started.tv_nsec) / 1000000;
+  return ms < 0 ? 0 : (uint64_t)ms / HOLDS_TICK_MS;
+}
+
+/// Unlinks a hold from its bucket.
+/// @note The caller must hold holds_mutex.
+/// @param hold Outstanding hold.
+static void unlink_hold(struct Hold* hold) {
+  struct Hold** link = &buckets[bucket_of(hold->event_id, hold->hold_id, num_buckets)];
+  while (*link != hold) link = &(*link)->next;
+  *link = hold->next;
+  num_holds--;
+}
+
+/// Doubles the buckets of the table, so chains stay short whatever the number of holds.
+/// @note The caller must hold holds_mutex.
+/// @return 0 if the table grew, 1 otherwise.
+static int grow_table() {
+  size_t count = num_buckets == 0 ? HOLDS_MIN_BUCKETS : num_buckets * 2;
+  struct Hold** grown = arena_alloc(count * sizeof(struct Hold*));
+  if (grown == NULL) return 1;
+
+  for (size_t i = 0; i < num_buckets; i++) {
+    while (buckets[i] != NULL) {
+      struct Hold* hold = buckets[i];
+      buckets[i] = hold->next;
+      size_t bucket = bucket_of(hold->event_id, hold->hold_id, count);
+      hold->next = grown[bucket];
+      grown[bucket] = hold;
+    }
+  }
+  arena_recycle(buckets, num_buckets * sizeof(struct Hold*));
+  buckets = grown;
+  num_buckets = count;
+  return 0;
+}
+
+/// Advances the wheel every HOLDS_TICK_MS, expires the holds whose time ran out and frees the retired memory.
+/// @param arg Unused.
+/// @return NULL.
+static void* holds_thread_function(void* arg) {
+  (void)arg;
+
+  block_sigusr1();
+
+  pthread_mutex_lock(&holds_mutex);
+  while (!holds_stopping) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_nsec += HOLDS_TICK_MS * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000L;
+    }
+    pthread_cond_timedwait(&holds_cond, &holds_mutex, &deadline);
+    if (holds_stopping) break;
+
+    // The expired holds leave the table before the mutex is released, so a confirm either takes a hold first or
+    // does not find it
+    struct TimerEntry* expired = timerwheel_advance(&wheel, current_tick());
+    for (struct TimerEntry* entry = expired; entry != NULL; entry = entry->next) unlink_hold((struct Hold*)entry);
+    pthread_mutex_unlock(&holds_mutex);
+
+    while (expired != NULL) {
+      struct Hold* hold = (struct Hold*)expired;
+      expired = expired->next;
+      expire_hold(hold);
+      hold_free(hold);
+    }
+
+    // Grids widened away by reservations are only retired, so they are freed here rather than waiting for the
+    // next create or delete
+    epoch_reclaim();
+    pthread_mutex_lock(&holds_mutex);
+  }
+  pthread_mutex_unlock(&holds_mutex);
+
+  return NULL;
+}
+
+struct Hold* hold_alloc(size_t num_seats) {
+  struct Hold* hold = arena_alloc(hold_size(num_seats));
+  if (hold != NULL) hold->num_seats = num_seats;
+  return hold;
+}
+
+void hold_free(struct Hold* hold) {
+  if (hold == NULL) return;
+  arena_recycle(hold, hold_size(hold->num_seats));
+}
+
+int holds_start(void (*expire)(struct Hold* hold)) {
+  pthread_condattr_t attr;
+  if (pthread_condattr_init(&attr) != 0) return 1;
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  int failed = pthread_cond_init(&holds_cond, &attr) != 0;
+  pthread_condattr_destroy(&attr);
+  if (failed) return 1;
+
+  pthread_mutex_lock(&holds_mutex);
+  expire_hold = expire;
+  holds_stopping = 0;
+  clock_gettime(CLOCK_MONOTONIC, &started);
+  timerwheel_init(&wheel, 0);
+  failed = num_buckets == 0 && grow_table() != 0;
+  pthread_mutex_unlock(&holds_mutex);
+
+  if (failed || pthread_create(&holds_thread, NULL, holds_thread_function, NULL) != 0) {
+    pthread_cond_destroy(&holds_cond);
+    return 1;
+  }
+  holds_running = 1;
+  return 0;
+}
+
+void holds_stop() {
+  if (!holds_running) return;
+
+  pthread_mutex_lock(&holds_mutex);
+  holds_stopping = 1;
+  pthread_cond_signal(&holds_cond);
+  pthread_mutex_unlock(&holds_mutex);
+  pthread_join(holds_thread, NULL);
+  pthread_cond_destroy(&holds_cond);
+  holds_running = 0;
+
+  // The seats of the holds left are still marked as held, so they are not saved by the last checkpoint
+  for (size_t i = 0; i < num_buckets; i++) {
+    while (buckets[i] != NULL) {
+      struct Hold* hold = buckets[i];
+      buckets[i] = hold->next;
+      hold_free(hold);
+    }
+  }
+  arena_recycle(buckets, num_buckets * sizeof(struct Hold*));
+  buckets = NULL;
+  num_buckets = 0;
+  num_holds = 0;
+}
+
+int holds_add(struct Hold* hold, unsigned int seconds) {
+  pthread_mutex_lock(&holds_mutex);
+  if (num_holds >= num_buckets && grow_table() != 0) {
+    pthread_mutex_unlock(&holds_mutex);
+    return 1;
+  }
+
+  size_t bucket = bucket_of(hold->event_id, hold->hold_id, num_buckets);
+  hold->next = buckets[bucket];
+  buckets[bucket] = hold;
+  num_holds++;
+
+  // Rounded up, and the current tick is partly gone, so a hold never expires early
+  uint64_t ticks = ((uint64_t)seconds * 1000 + HOLDS_TICK_MS - 1) / HOLDS_TICK_MS;
+  timerwheel_add(&wheel, &hold->timer, current_tick() + ticks + 1);
+  pthread_mutex_unlock(&holds_mutex);
+  return 0;
+}
+
+struct Hold* holds_take(unsigned int event_id, uint64_t generation, unsigned int hold_id) {
+  pthread_mutex_lock(&holds_mutex);
+  struct Hold* hold = num_buckets == 0 ? NULL : buckets[bucket_of(event_id, hold_id, num_buckets)];
+  while (hold != NULL && (hold->event_id != event_id || hold->hold_id != hold_id || hold->generation != generation)) {
+    hold = hold->next;
+  }
+  if (hold != NULL) {
+    unlink_hold(hold);
+    timerwheel_remove(&wheel, &hold->timer);
+  }
+  pthread_mutex_unlock(&holds_mutex);
+  return hold;
+}
+
+size_t holds_count() {
+  pthread_mutex_lock(&holds_mutex);
+  size_t count = num_holds;
+  pthread_mutex_unlock(&holds_mutex);
+  return count;
+}
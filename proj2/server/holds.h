@@ -0,0 +1,65 @@
+#ifndef SERVER_HOLDS_H
+#define SERVER_HOLDS_H
+
+#include <stddef.h>
+
+#include "eventlist.h"
+#include "timerwheel.h"
+
+/// Seats held until they are confirmed or their time runs out.
+/// Outstanding holds are kept in a hash table keyed by event and hold id, for confirms, and in a timer wheel
+/// (see timerwheel.h), for expiry. A single thread advances the wheel every HOLDS_TICK_MS and hands the holds
+/// that expired to a callback, so a tick costs O(1) plus the holds that expire on it, however many are
+/// outstanding. Holds only live in memory. Each tick also frees the memory retired since the last one (see
+/// epoch_reclaim), such as the grids left behind when an event is widened.
+
+#define HOLDS_TICK_MS 100  // Resolution of hold expiry
+
+// Seats held by a hold
+struct Hold {
+  struct TimerEntry timer;  // Expiry of the hold
+  struct Hold* next;        // Next hold of the same bucket of the table
+  unsigned int event_id;    // Id of the event of the seats
+  unsigned int hold_id;     // Reservation id written to the held seats
+  uint64_t generation;      // Generation of the event of the seats, to tell it apart from a later event with the same id
+  size_t num_seats;         // Number of seats
+  size_t seats[];           // Indexes of the seats
+};
+
+/// Allocates a hold from the arena of the calling thread.
+/// @param num_seats Number of seats of the hold.
+/// @return Zeroed hold with num_seats set, NULL on failure.
+struct Hold* hold_alloc(size_t num_seats);
+
+/// Gives a hold back to the arenas.
+/// @param hold Hold that is not outstanding, may be NULL.
+void hold_free(struct Hold* hold);
+
+/// Starts the expiry thread.
+/// @param expire Called by the expiry thread with each hold whose time ran out, which is freed afterwards.
+/// @return 0 if the thread was started, 1 otherwise.
+int holds_start(void (*expire)(struct Hold* hold));
+
+/// Stops the expiry thread and frees the outstanding holds, without expiring them.
+void holds_stop();
+
+/// Makes a hold outstanding, so it expires unless it is taken first.
+/// @param hold Hold, with every field but the timer and next set.
+/// @param seconds Seconds until the hold expires.
+/// @return 0 if the hold is outstanding, 1 if the table could not grow (the hold is not added).
+int holds_add(struct Hold* hold, unsigned int seconds);
+
+/// Takes an outstanding hold, so it no longer expires.
+/// @note Holds of a deleted event are not dropped with it, they stay until they expire. The generation keeps them
+/// apart from those of a later event with the same id, whose hold ids start over.
+/// @param event_id Id of the event of the hold.
+/// @param generation Generation of the event of the hold.
+/// @param hold_id Id of the hold.
+/// @return Hold, to be freed by the caller. NULL if there is no such hold, or it expired.
+struct Hold* holds_take(unsigned int event_id, uint64_t generation, unsigned int hold_id);
+
+/// Counts the outstanding holds.
+/// @return Number of outstanding holds.
+size_t holds_count();
+
+#endif  // SERVER_HOLDS_H
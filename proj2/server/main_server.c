@@ -1,4 +1,5 @@
 #include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/types.h>
@@ -15,6 +16,7 @@
 #include "common/constants.h"
 #include "common/io.h"
 #include "operations.h"
+#include "owners.h"
 
 pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
 pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
@@ -92,16 +94,17 @@ int main(int argc, char* argv[]) {
   queue->num_clients = 0;
 
 
-  if (argc < 2 || argc > 3) {
+  if (argc < 2 || argc > 8) {
     lock_printf();
-    fprintf(stderr, "Usage: %s\n <pipe_path> [delay]\n", argv[0]);
+    fprintf(stderr, "Usage: %s\n <pipe_path> [delay] [snapshot_path|-] [wal_path|-] [lock|cas] [small|huge] [owners]\n",
+            argv[0]);
     unlock_printf();
     return 1;
   }
   
   char* endptr;
   unsigned int state_access_delay_us = STATE_ACCESS_DELAY_US;
-  if (argc == 3) {
+  if (argc >= 3) {
     unsigned long int delay = strtoul(argv[2], &endptr, 10);
 
     if (*endptr != '\0' || delay > UINT_MAX) {
@@ -114,7 +117,46 @@ int main(int argc, char* argv[]) {
     state_access_delay_us = (unsigned int)delay;
   }
 
-  if (ems_init(state_access_delay_us)) {
+  // "-" logs changes without keeping snapshots, or keeps snapshots without logging changes
+  char* snapshot_path = argc >= 4 && strcmp(argv[3], "-") != 0 ? argv[3] : NULL;
+  char* wal_path = argc >= 5 && strcmp(argv[4], "-") != 0 ? argv[4] : NULL;
+
+  // "cas" reserves seats with lock-free claims instead of the stripe locks
+  if (argc >= 6) {
+    int cas = strcmp(argv[5], "cas") == 0;
+    if ((!cas && strcmp(argv[5], "lock") != 0) || ems_set_reserve_mode(cas ? RESERVE_CAS : RESERVE_LOCKED) != 0) {
+      lock_printf();
+      fprintf(stderr, "Invalid reservation mode, expected lock or cas\n");
+      unlock_printf();
+      return 1;
+    }
+  }
+
+  // "huge" keeps the seats in transparent huge pages
+  if (argc >= 7) {
+    int huge = strcmp(argv[6], "huge") == 0;
+    if (!huge && strcmp(argv[6], "small") != 0) {
+      lock_printf();
+      fprintf(stderr, "Invalid page size, expected small or huge\n");
+      unlock_printf();
+      return 1;
+    }
+    ems_set_huge_pages(huge);
+  }
+
+  // Number of owner threads the events are shared out to, 0 to run every operation in the sessions
+  if (argc == 8) {
+    unsigned long int owners = strtoul(argv[7], &endptr, 10);
+
+    if (*endptr != '\0' || ems_set_owners((size_t)owners) != 0) {
+      lock_printf();
+      fprintf(stderr, "Invalid number of owner threads, expected at most %d\n", OWNERS_MAX);
+      unlock_printf();
+      return 1;
+    }
+  }
+
+  if (ems_init(state_access_delay_us, snapshot_path, wal_path)) {
     lock_printf();
     fprintf(stderr, "Failed to initialize EMS\n");
     unlock_printf();
@@ -185,6 +227,11 @@ int main(int argc, char* argv[]) {
         fprintf(stderr, "[ERR]: ems_show_all failed: %s\n", strerror(errno));
         unlock_printf();
       }
+      if(ems_show_alloc_stats(STDERR_FILENO)){
+        lock_printf();
+        fprintf(stderr, "[ERR]: ems_show_alloc_stats failed: %s\n", strerror(errno));
+        unlock_printf();
+      }
 
       usr1_signalled = 0;
     }
@@ -352,7 +399,7 @@ void* threads_function(void* arg){
 
     char OP_CODE;
     unsigned int event_id;
-    size_t num_rows, num_cols;
+    size_t num_rows, num_cols, num_stripes;
     size_t num_seats;
     size_t num_events;
     size_t xs[MAX_RESERVATION_SIZE];
@@ -360,14 +407,36 @@ void* threads_function(void* arg){
     int ret;
     void* ret_out;
 
-    size_t buf_create_size = sizeof(unsigned int) + sizeof(size_t) + sizeof(size_t);
+    size_t buf_create_size = sizeof(unsigned int) + 3*sizeof(size_t);
     size_t buf_reserve_size = sizeof(unsigned int) + sizeof(size_t) + 2*sizeof(size_t)*MAX_RESERVATION_SIZE;
     size_t buf_show_size = sizeof(unsigned int);
+    size_t buf_list_page_size = sizeof(unsigned int) + sizeof(size_t);
+    size_t buf_reserve_best_size = sizeof(unsigned int) + sizeof(size_t);
+    size_t buf_best_seats_size = sizeof(int) + 2*sizeof(size_t)*MAX_RESERVATION_SIZE;
+    size_t buf_hold_size = 2*sizeof(unsigned int) + sizeof(size_t) + 2*sizeof(size_t)*MAX_RESERVATION_SIZE;
+    size_t buf_hold_id_size = sizeof(int) + sizeof(unsigned int);
+    size_t buf_confirm_size = 2*sizeof(unsigned int);
+    size_t buf_multi_event_size = sizeof(unsigned int) + sizeof(size_t);
     size_t buf_OP_CODE_size = sizeof(char) + sizeof(int);
 
     char buf_create[buf_create_size];
     char buf_reserve[buf_reserve_size];
     char buf_show[buf_show_size];
+    char buf_list_page[buf_list_page_size];
+    char buf_reserve_best[buf_reserve_best_size];
+    char buf_best_seats[buf_best_seats_size];
+    char buf_hold[buf_hold_size];
+    char buf_hold_id[buf_hold_id_size];
+    char buf_confirm[buf_confirm_size];
+    char buf_multi_event[buf_multi_event_size];
+    unsigned int multi_ids[MAX_MULTI_EVENTS];
+    size_t multi_seats[MAX_MULTI_EVENTS];
+    size_t multi_xs[MAX_MULTI_EVENTS*MAX_RESERVATION_SIZE];
+    size_t multi_ys[MAX_MULTI_EVENTS*MAX_RESERVATION_SIZE];
+    size_t multi_total;
+    unsigned int seconds, hold_id;
+    unsigned int cursor;
+    size_t limit;
     char buf_OP_CODE[buf_OP_CODE_size];
 
 
@@ -422,7 +491,9 @@ void* threads_function(void* arg){
 
           read_data(buf_create + sizeof(unsigned int) + sizeof(size_t), &num_cols, sizeof(size_t));
 
-          ret = ems_create(event_id, num_rows, num_cols);
+          read_data(buf_create + sizeof(unsigned int) + 2*sizeof(size_t), &num_stripes, sizeof(size_t));
+
+          ret = ems_create(event_id, num_rows, num_cols, num_stripes);
 
           if(safe_write(resp_fd, &ret, sizeof(unsigned int)) ==-1){
             lock_printf();
@@ -494,7 +565,7 @@ void* threads_function(void* arg){
           else{ 
             read_data(ret_out + sizeof(int), &num_rows, sizeof(size_t));
             read_data(ret_out + sizeof(int) + sizeof(size_t), &num_cols, sizeof(size_t));
-            if(safe_write(resp_fd, ret_out, sizeof(int) + 2*sizeof(size_t)+ sizeof(unsigned int)*num_rows*num_cols) == -1){ 
+            if(safe_write(resp_fd, ret_out, sizeof(int) + 2*sizeof(size_t) + sizeof(uint64_t) + sizeof(unsigned int)*num_rows*num_cols) == -1){ 
               lock_printf();
               fprintf(stderr, "[ERR]: write to server pipe failed: %s \n", strerror(errno));
               unlock_printf();
@@ -534,6 +605,212 @@ void* threads_function(void* arg){
           }
           free(ret_out);
           break;
+        case '7': //DELETE
+          memset(buf_show, 0, buf_show_size);
+          if(safe_read(req_fd, buf_show, buf_show_size) == -1){
+            lock_printf();
+            fprintf(stderr, "[ERR]: read delete from client failed: %s\n", strerror(errno));
+            unlock_printf();
+            var = 0;
+            break;
+          }
+
+          read_data(buf_show, &event_id, sizeof(unsigned int));
+
+          ret = ems_delete(event_id);
+          if(safe_write(resp_fd, &ret, sizeof(int)) == -1){
+            lock_printf();
+            fprintf(stderr, "[ERR]: write to server pipe failed: %s\n", strerror(errno));
+            unlock_printf();
+            var = 0;
+          }
+          break;
+        case '8': //LIST_PAGE
+          memset(buf_list_page, 0, buf_list_page_size);
+          if(safe_read(req_fd, buf_list_page, buf_list_page_size) == -1){
+            lock_printf();
+            fprintf(stderr, "[ERR]: read list page from client failed: %s\n", strerror(errno));
+            unlock_printf();
+            var = 0;
+            break;
+          }
+
+          read_data(buf_list_page, &cursor, sizeof(unsigned int));
+          read_data(buf_list_page + sizeof(unsigned int), &limit, sizeof(size_t));
+
+          ret_out = ems_list_page(cursor, limit);
+          if(ret_out == NULL){
+            lock_printf();
+            fprintf(stderr, "[ERR]: ems_list_page failed: %s\n", strerror(errno));
+            unlock_printf();
+            var = 0;
+            break;
+          }
+          if(*((int*)ret_out)){
+            if(safe_write(resp_fd, ret_out, sizeof(int)) == -1){
+              lock_printf();
+              fprintf(stderr, "[ERR]: write to server pipe failed: %s \n", strerror(errno));
+              unlock_printf();
+              var = 0;
+            }
+          }
+          else{
+            read_data(ret_out + sizeof(int), &num_events, sizeof(size_t));
+
+            if(safe_write(resp_fd, ret_out, sizeof(int) + sizeof(size_t) + sizeof(int) + sizeof(unsigned int)*num_events) == -1){
+              lock_printf();
+              fprintf(stderr, "[ERR]: write to server pipe failed: %s\n", strerror(errno));
+              unlock_printf();
+              var = 0;
+            }
+          }
+          free(ret_out);
+          break;
+        case '9': //RESERVE_BEST
+          memset(buf_reserve_best, 0, buf_reserve_best_size);
+          if(safe_read(req_fd, buf_reserve_best, buf_reserve_best_size) == -1){
+            lock_printf();
+            fprintf(stderr, "[ERR]: read reserve best from client failed: %s\n", strerror(errno));
+            unlock_printf();
+            var = 0;
+            break;
+          }
+
+          read_data(buf_reserve_best, &event_id, sizeof(unsigned int));
+          read_data(buf_reserve_best + sizeof(unsigned int), &num_seats, sizeof(size_t));
+
+          ret = ems_reserve_best(event_id, num_seats, xs, ys);
+
+          // On success the seats that were reserved follow the result, rows first
+          store_data(buf_best_seats, &ret, sizeof(int));
+          if(ret == 0){
+            store_data(buf_best_seats + sizeof(int), xs, sizeof(size_t)*num_seats);
+            store_data(buf_best_seats + sizeof(int) + sizeof(size_t)*num_seats, ys, sizeof(size_t)*num_seats);
+          }
+          if(safe_write(resp_fd, buf_best_seats, sizeof(int) + (ret == 0 ? 2*sizeof(size_t)*num_seats : 0)) == -1){
+            lock_printf();
+            fprintf(stderr, "[ERR]: write to server pipe failed: %s\n", strerror(errno));
+            unlock_printf();
+            var = 0;
+          }
+          break;
+        case 'A': //HOLD
+          memset(buf_hold, 0, buf_hold_size);
+          if(safe_read(req_fd, buf_hold, buf_hold_size) == -1){
+            lock_printf();
+            fprintf(stderr, "[ERR]: read hold from client failed: %s\n", strerror(errno));
+            unlock_printf();
+            var = 0;
+            break;
+          }
+
+          read_data(buf_hold, &event_id, sizeof(unsigned int));
+          read_data(buf_hold + sizeof(unsigned int), &seconds, sizeof(unsigned int));
+          read_data(buf_hold + 2*sizeof(unsigned int), &num_seats, sizeof(size_t));
+          // Too many seats are rejected by ems_hold, without reading past the coordinates sent
+          if(num_seats <= MAX_RESERVATION_SIZE){
+            read_data(buf_hold + 2*sizeof(unsigned int) + sizeof(size_t), xs, sizeof(size_t)*num_seats);
+            read_data(buf_hold + 2*sizeof(unsigned int) + sizeof(size_t) + sizeof(size_t)*num_seats, ys, sizeof(size_t)*num_seats);
+          }
+
+          hold_id = 0;
+          ret = ems_hold(event_id, seconds, num_seats, xs, ys, &hold_id);
+
+          // On success the id of the hold follows the result
+          store_data(buf_hold_id, &ret, sizeof(int));
+          store_data(buf_hold_id + sizeof(int), &hold_id, sizeof(unsigned int));
+          if(safe_write(resp_fd, buf_hold_id, ret == 0 ? buf_hold_id_size : sizeof(int)) == -1){
+            lock_printf();
+            fprintf(stderr, "[ERR]: write to server pipe failed: %s\n", strerror(errno));
+            unlock_printf();
+            var = 0;
+          }
+          break;
+        case 'B': //CONFIRM
+          memset(buf_confirm, 0, buf_confirm_size);
+          if(safe_read(req_fd, buf_confirm, buf_confirm_size) == -1){
+            lock_printf();
+            fprintf(stderr, "[ERR]: read confirm from client failed: %s\n", strerror(errno));
+            unlock_printf();
+            var = 0;
+            break;
+          }
+
+          read_data(buf_confirm, &event_id, sizeof(unsigned int));
+          read_data(buf_confirm + sizeof(unsigned int), &hold_id, sizeof(unsigned int));
+
+          ret = ems_confirm(event_id, hold_id);
+          if(safe_write(resp_fd, &ret, sizeof(int)) == -1){
+            lock_printf();
+            fprintf(stderr, "[ERR]: write to server pipe failed: %s\n", strerror(errno));
+            unlock_printf();
+            var = 0;
+          }
+          break;
+        case 'C': //CANCEL
+          memset(buf_confirm, 0, buf_confirm_size);
+          if(safe_read(req_fd, buf_confirm, buf_confirm_size) == -1){
+            lock_printf();
+            fprintf(stderr, "[ERR]: read cancel from client failed: %s\n", strerror(errno));
+            unlock_printf();
+            var = 0;
+            break;
+          }
+
+          // Same layout as CONFIRM: the event id, then the reservation id
+          read_data(buf_confirm, &event_id, sizeof(unsigned int));
+          read_data(buf_confirm + sizeof(unsigned int), &hold_id, sizeof(unsigned int));
+
+          ret = ems_cancel(event_id, hold_id);
+          if(safe_write(resp_fd, &ret, sizeof(int)) == -1){
+            lock_printf();
+            fprintf(stderr, "[ERR]: write to server pipe failed: %s\n", strerror(errno));
+            unlock_printf();
+            var = 0;
+          }
+          break;
+        case 'D': //RESERVE_MULTI
+          // The number of events, then for each one its id, its number of seats and only the seats it has, so the
+          // size of the request follows the seats. A malformed request ends the session, since where it ends is unknown.
+          if(safe_read(req_fd, &num_events, sizeof(size_t)) == -1 || num_events == 0 || num_events > MAX_MULTI_EVENTS){
+            lock_printf();
+            fprintf(stderr, "[ERR]: read reserve multi from client failed\n");
+            unlock_printf();
+            var = 0;
+            break;
+          }
+
+          multi_total = 0;
+          for(size_t i = 0; i < num_events && var; i++){
+            if(safe_read(req_fd, buf_multi_event, buf_multi_event_size) == -1){
+              var = 0;
+              break;
+            }
+            read_data(buf_multi_event, &multi_ids[i], sizeof(unsigned int));
+            read_data(buf_multi_event + sizeof(unsigned int), &multi_seats[i], sizeof(size_t));
+            if(multi_seats[i] > MAX_RESERVATION_SIZE ||
+               safe_read(req_fd, multi_xs + multi_total, sizeof(size_t)*multi_seats[i]) == -1 ||
+               safe_read(req_fd, multi_ys + multi_total, sizeof(size_t)*multi_seats[i]) == -1){
+              var = 0;
+              break;
+            }
+            multi_total += multi_seats[i];
+          }
+          if(!var){
+            lock_printf();
+            fprintf(stderr, "[ERR]: read reserve multi from client failed\n");
+            unlock_printf();
+            break;
+          }
+
+          ret = ems_reserve_multi(num_events, multi_ids, multi_seats, multi_xs, multi_ys);
+          if(safe_write(resp_fd, &ret, sizeof(int)) == -1){
+            lock_printf();
+            fprintf(stderr, "[ERR]: write to server pipe failed: %s\n", strerror(errno));
+            unlock_printf();
+            var = 0;
+          }
+          break;
         default:
 
           break;
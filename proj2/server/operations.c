@@ -1,51 +1,1368 @@
+#include <limits.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
 
+#include "alloc.h"
+#include "checkpoint.h"
+#include "combiner.h"
+#include "common/constants.h"
 #include "common/io.h"
+#include "epoch.h"
 #include "eventlist.h"
+#include "holds.h"
+#include "operations.h"
+#include "owners.h"
+#include "seatgrid.h"
+#include "seatmap.h"
+#include "snapshot.h"
+#include "wal.h"
+
+#define SNAPSHOT_INTERVAL_S 5  // Seconds between the checkpoints written in the background
+#define WAL_MAX_BATCH 64       // Maximum number of log records made durable by a single fdatasync
 
 static struct EventList* event_list = NULL;
 static unsigned int state_access_delay_us = 0;
 
+static const char* snapshot_path = NULL;     // Path of the snapshot, NULL if snapshots are disabled
+static struct SnapshotImage snapshot_image;  // Mapping of the snapshot loaded at startup
+static pthread_t snapshot_thread;
+static pthread_mutex_t snapshot_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t snapshot_cond = PTHREAD_COND_INITIALIZER;
+static int snapshot_stop = 0;                       // Set by ems_terminate to stop the snapshotter
+static _Atomic unsigned long state_changes = 0;     // Creates, reservations and deletes so far
+
+static int wal_enabled = 0;  // Whether changes are written to the log before being acknowledged
+
+static enum ReserveMode reserve_mode = RESERVE_LOCKED;  // How ems_reserve guards the seats, see ems_set_reserve_mode
+static int combining_enabled = 1;  // Whether contended events switch to flat combining, see ems_set_combining
+static size_t owner_threads = 0;   // Owner threads started by ems_init, see ems_set_owners
+
+#define COMBINING_THRESHOLD 8  // Contended reservations in a row (or lone batches) that switch combining on (or off)
+
+#define SHOW_MAX_ATTEMPTS 8  // Lock-free copies of the seats SHOW tries before it locks the event
+
+#define SEAT_CLAIMED UINT_MAX  // Id of the seats claimed by a lock-free reservation that is not complete yet
+#define SEAT_SET_SLOTS (2 * MAX_RESERVATION_SIZE)  // Slots of the set of requested seats, a power of two
+
+// Operation run by the owner of its event, or with the owners of its events parked (see owners.h)
+enum OwnedOp {
+  OWNED_CREATE,
+  OWNED_RESERVE,
+  OWNED_RESERVE_MULTI,
+  OWNED_RESERVE_BEST,
+  OWNED_HOLD,
+  OWNED_CONFIRM,
+  OWNED_CANCEL,
+  OWNED_DELETE,
+  OWNED_SHOW,
+  OWNED_SHOW_ALL,
+  OWNED_EXPIRE,
+};
+
+// Arguments and result of an operation handed to the owners, each operation uses the fields of its ems_ function
+struct OwnedCall {
+  enum OwnedOp op;
+  unsigned int event_id;
+  size_t num_rows;
+  size_t num_cols;
+  size_t num_stripes;
+  size_t num_events;
+  unsigned int* event_ids;
+  size_t num_seats;
+  size_t* seat_counts;  // Seats of each event of a RESERVE_MULTI
+  size_t* xs;
+  size_t* ys;
+  unsigned int seconds;
+  unsigned int id;          // Id of a hold or a reservation
+  unsigned int* hold_id;    // Where a HOLD stores its id
+  struct Hold* hold;        // Hold that expired
+  int result;               // Result of the operation
+  void* response;           // Response of a SHOW
+  int logged;               // Whether the operation left the wait for its log record to its caller
+  uint64_t lsn;             // LSN of that record
+};
+
+static _Thread_local struct OwnedCall* owned_call = NULL;  // Operation the thread runs for the owners, if any
+
+static void expire_hold(struct Hold* hold);
+static void run_owned(void* arg);
+
+/// Waits until the log record of a change is durable. For an operation run by the owners, the wait is left to the
+/// thread that handed it to them (see finish_owned), so an owner goes on with its next operation meanwhile and the
+/// records of several of them share a sync.
+/// @param lsn LSN returned by wal_append.
+/// @return 0 once the record is durable or the wait was left to the caller, 1 if it could not be written.
+static int wait_logged(uint64_t lsn) {
+  if (owned_call == NULL) return wal_wait(lsn);
+  owned_call->logged = 1;
+  owned_call->lsn = lsn;
+  return 0;
+}
+
+/// Finishes an operation run by the owners in the thread that handed it to them, waiting for its log record.
+/// @param call Operation, once run.
+/// @return Result of the operation, 1 if its log record could not be written.
+static int finish_owned(const struct OwnedCall* call) {
+  if (call->result != 0 || !call->logged) return call->result;
+  if (wal_wait(call->lsn) != 0) {
+    lock_printf();
+    fprintf(stderr, "Error writing to log\n");
+    unlock_printf();
+    return 1;
+  }
+  return 0;
+}
+
+/// Enters an epoch read-side critical section (see epoch_enter), reporting when it cannot be entered.
+/// @return 0 if the section was entered, 1 otherwise.
+static int enter_epoch() {
+  if (epoch_enter() == 0) return 0;
+  lock_printf();
+  fprintf(stderr, "Error allocating memory for epoch record\n");
+  unlock_printf();
+  return 1;
+}
+
 /// Gets the event with the given ID from the state.
 /// @note Will wait to simulate a real system accessing a costly memory resource.
 /// @param event_id The ID of the event to get.
-/// @param from First node to be searched.
-/// @param to Last node to be searched.
 /// @return Pointer to the event if found, NULL otherwise.
-static struct Event* get_event_with_delay(unsigned int event_id, struct ListNode* from, struct ListNode* to) {
+static struct Event* get_event_with_delay(unsigned int event_id) {
   struct timespec delay = {0, state_access_delay_us * 1000};
   nanosleep(&delay, NULL);  // Should not be removed
 
-  return get_event(event_list, event_id, from, to);
-}
+  return get_event(event_list, event_id);
+}
+
+/// Gets the index of a seat.
+/// @note This function assumes that the seat exists.
+/// @param event Event to get the seat index from.
+/// @param row Row of the seat.
+/// @param col Column of the seat.
+/// @return Index of the seat.
+static size_t seat_index(struct Event* event, size_t row, size_t col) { return (row - 1) * event->cols + col - 1; }
+
+/// Logs the creation of an event.
+/// @note Must be called with the list rwl held for writing.
+/// @return LSN of the record, 0 on failure.
+static uint64_t log_create(const struct Event* event) {
+  struct WalCreate record = {event->id, (uint32_t)event->num_stripes, event->rows, event->cols};
+  return wal_append(WAL_CREATE, &record, sizeof(record));
+}
+
+/// Encodes the payload of a WAL_RESERVE or WAL_CANCEL record.
+/// @param payload Where to store the payload, with room for MAX_RESERVATION_SIZE seats.
+/// @return Size of the payload.
+static size_t encode_seats(char* payload, unsigned int event_id, unsigned int reservation_id, size_t num_seats,
+                           const size_t* xs, const size_t* ys) {
+  struct WalReserve record = {event_id, reservation_id, num_seats};
+  memcpy(payload, &record, sizeof(record));
+  for (size_t i = 0; i < num_seats; i++) {
+    uint64_t row = xs[i];
+    uint64_t col = ys[i];
+    memcpy(payload + sizeof(record) + i * sizeof(uint64_t), &row, sizeof(uint64_t));
+    memcpy(payload + sizeof(record) + (num_seats + i) * sizeof(uint64_t), &col, sizeof(uint64_t));
+  }
+  return sizeof(record) + 2 * sizeof(uint64_t) * num_seats;
+}
+
+/// Logs a reservation or its cancellation.
+/// @note Must be called with the stripes of the rows held (or the seats claimed), so records of the same seats
+/// are in order.
+/// @param type WAL_RESERVE or WAL_CANCEL.
+/// @return LSN of the record, 0 on failure.
+static uint64_t log_seats(uint32_t type, unsigned int event_id, unsigned int reservation_id, size_t num_seats,
+                          const size_t* xs, const size_t* ys) {
+  char payload[sizeof(struct WalReserve) + 2 * sizeof(uint64_t) * MAX_RESERVATION_SIZE];
+  if (num_seats > MAX_RESERVATION_SIZE) return 0;
+
+  size_t size = encode_seats(payload, event_id, reservation_id, num_seats, xs, ys);
+  return wal_append(type, payload, size);
+}
+
+/// Logs the deletion of an event.
+/// @note Must be called with the list rwl held for writing.
+/// @return LSN of the record, 0 on failure.
+static uint64_t log_delete(unsigned int event_id) {
+  struct WalDelete record = {event_id};
+  return wal_append(WAL_DELETE, &record, sizeof(record));
+}
+
+/// Applies the payload of a WAL_RESERVE record during recovery (see replay_record).
+/// @param payload Payload of the record.
+/// @param size Size of the payload.
+static void replay_reserve(const void* payload, size_t size) {
+  if (size < sizeof(struct WalReserve)) return;
+
+  struct WalReserve record;
+  memcpy(&record, payload, sizeof(record));
+  if (record.num_seats > MAX_RESERVATION_SIZE || size != sizeof(record) + 2 * sizeof(uint64_t) * record.num_seats) {
+    return;
+  }
+  struct Event* event = get_event(event_list, record.event_id);
+  if (event == NULL || widen_seats(event, record.reservation_id) != 0) return;
+
+  const char* seats = (const char*)payload + sizeof(record);
+  for (size_t i = 0; i < record.num_seats; i++) {
+    uint64_t row, col;
+    memcpy(&row, seats + i * sizeof(uint64_t), sizeof(uint64_t));
+    memcpy(&col, seats + (record.num_seats + i) * sizeof(uint64_t), sizeof(uint64_t));
+    // A later delete and create of the same id may have changed the size of the event
+    if (row == 0 || row > event->rows || col == 0 || col > event->cols) continue;
+    size_t seat = seat_index(event, row, col);
+    if (seatgrid_materialize(event->data, event->width, event->rows * event->cols, &seat, 1) != 0) return;
+    seatgrid_set(event->data, event->width, seat, record.reservation_id);
+    seatmap_set(event->occupied, seat);
+    mark_row_dirty(event, row - 1);
+  }
+  if (record.reservation_id > event->reservations) event->reservations = record.reservation_id;
+  event->version = event->reservations;
+}
+
+/// Applies a log record during recovery.
+/// @note Records may already be reflected in the loaded snapshot, so applying them again must be harmless:
+/// creates of existing events and deletes of missing ones are skipped and seats are set, not checked.
+/// Runs before the worker threads start, so it takes no locks and has no access delay.
+/// @param type Type of the record.
+/// @param payload Payload of the record.
+/// @param size Size of the payload.
+/// @param arg Unused.
+static void replay_record(uint32_t type, const void* payload, size_t size, void* arg) {
+  (void)arg;
+
+  if (type == WAL_CREATE && size == sizeof(struct WalCreate)) {
+    struct WalCreate record;
+    memcpy(&record, payload, sizeof(record));
+    if (get_event(event_list, record.event_id) != NULL) return;
+
+    struct Event* event = create_event(record.event_id, record.rows, record.cols, record.stripes);
+    if (event == NULL) return;
+    if (append_to_list(event_list, event) != 0) {
+      free_event(event);
+      return;
+    }
+    event_list->num_events++;
+  } else if (type == WAL_RESERVE) {
+    replay_reserve(payload, size);
+  } else if (type == WAL_RESERVE_MULTI && size >= sizeof(uint64_t)) {
+    // Each reservation is as long as its seats, which are read from its header
+    uint64_t num_reservations;
+    memcpy(&num_reservations, payload, sizeof(uint64_t));
+    size_t offset = sizeof(uint64_t);
+    for (uint64_t i = 0; i < num_reservations && offset + sizeof(struct WalReserve) <= size; i++) {
+      struct WalReserve record;
+      memcpy(&record, (const char*)payload + offset, sizeof(record));
+      if (record.num_seats > MAX_RESERVATION_SIZE) return;
+      size_t part = sizeof(record) + 2 * sizeof(uint64_t) * record.num_seats;
+      if (offset + part > size) return;
+      replay_reserve((const char*)payload + offset, part);
+      offset += part;
+    }
+  } else if (type == WAL_CANCEL && size >= sizeof(struct WalReserve)) {
+    struct WalReserve record;
+    memcpy(&record, payload, sizeof(record));
+    if (record.num_seats > MAX_RESERVATION_SIZE || size != sizeof(record) + 2 * sizeof(uint64_t) * record.num_seats) {
+      return;
+    }
+    struct Event* event = get_event(event_list, record.event_id);
+    if (event == NULL) return;
+
+    const char* seats = (const char*)payload + sizeof(record);
+    for (size_t i = 0; i < record.num_seats; i++) {
+      uint64_t row, col;
+      memcpy(&row, seats + i * sizeof(uint64_t), sizeof(uint64_t));
+      memcpy(&col, seats + (record.num_seats + i) * sizeof(uint64_t), sizeof(uint64_t));
+      if (row == 0 || row > event->rows || col == 0 || col > event->cols) continue;
+      // Seats the snapshot already saw freed, or that belong to a later event with the same id, are left alone
+      size_t seat = seat_index(event, row, col);
+      if (seatgrid_get(event->data, event->width, seat) != record.reservation_id) continue;
+      seatgrid_set(event->data, event->width, seat, 0);
+      seatmap_clear(event->occupied, seat);
+      mark_row_dirty(event, row - 1);
+    }
+    event->version++;
+  } else if (type == WAL_DELETE && size == sizeof(struct WalDelete)) {
+    struct WalDelete record;
+    memcpy(&record, payload, sizeof(record));
+    struct Event* event = get_event(event_list, record.event_id);
+    if (event == NULL) return;
+
+    remove_from_list(event_list, event);
+    event_list->num_events--;
+    retire_event(event);
+    epoch_reclaim();
+  }
+}
+
+/// Writes a checkpoint every SNAPSHOT_INTERVAL_S seconds, if the state changed since the last one.
+/// @param arg Unused.
+/// @return NULL.
+static void* snapshot_thread_function(void* arg) {
+  (void)arg;
+
+  block_sigusr1();
+
+  unsigned long saved_changes = atomic_load_explicit(&state_changes, memory_order_relaxed);
+
+  pthread_mutex_lock(&snapshot_mutex);
+  while (!snapshot_stop) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += SNAPSHOT_INTERVAL_S;
+    pthread_cond_timedwait(&snapshot_cond, &snapshot_mutex, &deadline);
+
+    unsigned long changes = atomic_load_explicit(&state_changes, memory_order_relaxed);
+    if (snapshot_stop || changes == saved_changes) continue;
+
+    pthread_mutex_unlock(&snapshot_mutex);
+    // Events are copied one at a time, by their owners if they have them, and written with every owner running
+    if (checkpoint_write(event_list, snapshot_path, wal_enabled ? wal_next_lsn() : 0) != 0) {
+      lock_printf();
+      fprintf(stderr, "Error writing checkpoint\n");
+      unlock_printf();
+    } else {
+      saved_changes = changes;
+    }
+    pthread_mutex_lock(&snapshot_mutex);
+  }
+  pthread_mutex_unlock(&snapshot_mutex);
+
+  return NULL;
+}
+
+int ems_init(unsigned int delay_us, const char* snapshot_file, const char* wal_file) {
+  if (event_list != NULL) {
+    lock_printf();
+    fprintf(stderr, "EMS state has already been initialized\n");
+    unlock_printf();
+    return 1;
+  }
+
+  event_list = create_list();
+  state_access_delay_us = delay_us;
+  if (event_list == NULL) return 1;
+
+  // Seat checks use the widest vector kernels the CPU supports
+  seatmap_select(SEATMAP_AUTO);
+
+  if (snapshot_file != NULL) {
+    // The events of the snapshot are mapped, not rebuilt, so startup does not depend on their seats
+    if (checkpoint_load(event_list, snapshot_file, &snapshot_image) != 0) {
+      lock_printf();
+      fprintf(stderr, "Error loading snapshot\n");
+      unlock_printf();
+      return 1;
+    }
+  }
+
+  if (wal_file != NULL) {
+    // Replays the changes made after the snapshot (or every change, without one)
+    if (wal_open(wal_file, WAL_MAX_BATCH, snapshot_image.wal_lsn, replay_record, NULL) != 0) {
+      lock_printf();
+      fprintf(stderr, "Error opening log\n");
+      unlock_printf();
+      return 1;
+    }
+    wal_enabled = 1;
+  }
+
+  // Replay is over, so the owners are the only threads touching the seats from now on
+  if (owner_threads > 0) {
+    if (reserve_mode == RESERVE_CAS) {
+      lock_printf();
+      fprintf(stderr, "Owner threads need the locked reservation mode\n");
+      unlock_printf();
+      return 1;
+    }
+    set_stripes_owned(1);
+    if (owners_start(owner_threads) != 0) {
+      set_stripes_owned(0);
+      lock_printf();
+      fprintf(stderr, "Error creating owner threads\n");
+      unlock_printf();
+      return 1;
+    }
+  }
+
+  if (holds_start(expire_hold) != 0) {
+    owners_stop();
+    set_stripes_owned(0);
+    lock_printf();
+    fprintf(stderr, "Error creating hold expiry thread\n");
+    unlock_printf();
+    return 1;
+  }
+
+  if (snapshot_file != NULL) {
+    snapshot_path = snapshot_file;
+    snapshot_stop = 0;
+    if (pthread_create(&snapshot_thread, NULL, snapshot_thread_function, NULL) != 0) {
+      lock_printf();
+      fprintf(stderr, "Error creating snapshot thread\n");
+      unlock_printf();
+      snapshot_path = NULL;
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+int ems_terminate() {
+  if (event_list == NULL) {
+    lock_printf();
+    fprintf(stderr, "EMS state must be initialized\n");
+    unlock_printf();
+    return 1;
+  }
+
+  // Outstanding holds are dropped, and their seats are left out of the last checkpoint
+  holds_stop();
+
+  if (snapshot_path != NULL) {
+    pthread_mutex_lock(&snapshot_mutex);
+    snapshot_stop = 1;
+    pthread_cond_signal(&snapshot_cond);
+    pthread_mutex_unlock(&snapshot_mutex);
+    pthread_join(snapshot_thread, NULL);
+  }
+
+  // The expiry and snapshot threads post to the owners, so the owners stop after them
+  owners_stop();
+  set_stripes_owned(0);
+
+  if (snapshot_path != NULL) {
+    if (checkpoint_write(event_list, snapshot_path, wal_enabled ? wal_next_lsn() : 0) != 0) {
+      lock_printf();
+      fprintf(stderr, "Error writing checkpoint\n");
+      unlock_printf();
+    }
+    snapshot_path = NULL;
+  }
+
+  if (wal_enabled) {
+    wal_close();
+    wal_enabled = 0;
+  }
+
+  if (pthread_rwlock_wrlock(&event_list->rwl) != 0) {
+    lock_printf();
+    fprintf(stderr, "Error locking list rwl\n");
+    unlock_printf();
+    return 1;
+  }
+  
+  // Retired events and grids go back to their slabs, so they are released before the slabs are
+  epoch_drain();
+  free_list(event_list);
+  pthread_rwlock_unlock(&event_list->rwl);
+  free(event_list); 
+  alloc_release_all();
+  // Recycled seats may live in the snapshot mapping, so it goes last
+  snapshot_unmap(&snapshot_image);
+  return 0;
+}
+
+int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols, size_t num_stripes) {
+
+  if (event_list == NULL) {
+    lock_printf();
+    fprintf(stderr, "EMS state must be initialized\n");
+    unlock_printf();
+    return 1;
+  }
+
+  if (owners_route(event_id)) {
+    struct OwnedCall call = {.op = OWNED_CREATE, .event_id = event_id, .num_rows = num_rows, .num_cols = num_cols,
+                             .num_stripes = num_stripes};
+    owners_call(event_id, run_owned, &call);
+    return finish_owned(&call);
+  }
+
+  if (pthread_rwlock_wrlock(&event_list->rwl) != 0) {
+    lock_printf();
+    fprintf(stderr, "Error locking list rwl\n");
+    unlock_printf();
+    return 1;
+  }
+
+
+  if (get_event_with_delay(event_id) != NULL) {
+      lock_printf();
+      fprintf(stderr, "Event already exists\n");
+      unlock_printf();
+      pthread_rwlock_unlock(&event_list->rwl);
+    return 1;
+  }
+
+  struct Event* event = create_event(event_id, num_rows, num_cols, num_stripes);
+
+  if (event == NULL) {
+    lock_printf();
+    fprintf(stderr, "Error allocating memory for event\n");
+    unlock_printf();
+    pthread_rwlock_unlock(&event_list->rwl);
+    return 1;
+  }
+
+  if (append_to_list(event_list, event) != 0) {
+    lock_printf();
+    fprintf(stderr, "Error appending event to list\n");
+    unlock_printf();
+    pthread_rwlock_unlock(&event_list->rwl);
+    free_event(event);
+    return 1;
+  }
+;
+  uint64_t lsn = wal_enabled ? log_create(event) : 0;
+  event_list->num_events++;
+  pthread_rwlock_unlock(&event_list->rwl);
+  atomic_fetch_add_explicit(&state_changes, 1, memory_order_relaxed);
+
+  // The client is only answered once the create is durable
+  if (wal_enabled && wait_logged(lsn) != 0) {
+    lock_printf();
+    fprintf(stderr, "Error writing to log\n");
+    unlock_printf();
+    return 1;
+  }
+
+  // Frees the index tables replaced by this create once no lookup can still be using them
+  epoch_reclaim();
+
+  return 0;
+}
+
+int ems_set_reserve_mode(enum ReserveMode mode) {
+  if (mode != RESERVE_LOCKED && mode != RESERVE_CAS) return 1;
+  reserve_mode = mode;
+  return 0;
+}
+
+void ems_set_huge_pages(int enabled) { alloc_set_huge_pages(enabled); }
+
+void ems_set_combining(int enabled) { combining_enabled = enabled; }
+
+int ems_set_owners(size_t count) {
+  if (count > OWNERS_MAX) return 1;
+  owner_threads = count;
+  return 0;
+}
+
+/// Gives an event full-width ids before its first lock-free claim, since a grid being widened cannot be claimed in.
+/// @note The caller must not hold any stripe of the event.
+/// @param event Event to be claimed in.
+/// @return 0 if the event has full-width ids, 1 otherwise.
+static int widen_for_claims(struct Event* event) {
+  if (event->width == SEAT_WIDTH_MAX) return 0;
+
+  lock_event(event);
+  int error = !event->deleted && widen_seats(event, UINT_MAX) != 0;
+  unlock_event(event);
+  if (error) {
+    lock_printf();
+    fprintf(stderr, "Error allocating memory for seats\n");
+    unlock_printf();
+  }
+  return error;
+}
+
+// Seats to be reserved or held, and what came of it
+struct SeatRequest {
+  size_t num_seats;                    // Number of seats
+  size_t* xs;                          // Rows of the seats
+  size_t* ys;                          // Columns of the seats
+  size_t seats[MAX_RESERVATION_SIZE];  // Indexes of the seats
+  int hold;                            // Whether the seats are held (see ems_hold) rather than reserved
+  unsigned int reservation_id;         // Set to the id written to the seats
+  uint64_t lsn;                        // Set to the LSN of the log record, 0 if nothing was logged
+  int conflict;                        // Set if a seat was already taken, which is left to the caller to report
+};
+
+/// Computes the indexes of the requested seats, checking that they are in bounds.
+/// @param event Event of the seats.
+/// @param request Seats, whose indexes are set up to the first seat out of bounds.
+/// @return 1 if every seat is in bounds, 0 otherwise.
+static int index_seats(struct Event* event, struct SeatRequest* request) {
+  for (size_t i = 0; i < request->num_seats; i++) {
+    size_t row = request->xs[i];
+    size_t col = request->ys[i];
+    if (row == 0 || row > event->rows || col == 0 || col > event->cols) return 0;
+    request->seats[i] = seat_index(event, row, col);
+  }
+  return 1;
+}
+
+/// Checks whether a seat is requested more than once, in O(count) and without reading the grid: the seats
+/// are inserted in a hash set on the stack, sized for the largest reservation.
+/// @param seats Indexes of the seats.
+/// @param count Number of seats, at most MAX_RESERVATION_SIZE.
+/// @return 1 if a seat repeats, 0 otherwise.
+static int seats_repeat(const size_t* seats, size_t count) {
+  if (count < 2) return 0;
+
+  // At most half full, and only as many slots as the request needs are cleared. Slots hold the index of the
+  // seat plus one, so a zeroed slot is empty.
+  size_t num_slots = 4;
+  while (num_slots < 2 * count) num_slots *= 2;
+  size_t slots[SEAT_SET_SLOTS];
+  memset(slots, 0, num_slots * sizeof(size_t));
+  for (size_t i = 0; i < count; i++) {
+    size_t slot = (size_t)(((uint64_t)seats[i] * 0x9e3779b97f4a7c15ull) >> 32) & (num_slots - 1);
+    while (slots[slot] != 0) {
+      if (slots[slot] == seats[i] + 1) return 1;
+      slot = (slot + 1) & (num_slots - 1);
+    }
+    slots[slot] = seats[i] + 1;
+  }
+  return 0;
+}
+
+/// Writes the id of a reservation to its seats, once they are known to be free, and records the change.
+/// @note The caller must hold the stripes of the seats within begin/end_seat_writes, or have claimed the seats (see
+/// claim_seats), in which case the bits are set with atomics since claims of other stripes may share their words.
+/// @param event Event to reserve in.
+/// @param request Seats to reserve, whose reservation_id is set.
+/// @param reservation_id Id of the reservation.
+/// @param claimed Whether the seats were claimed rather than locked.
+static void write_reservation(struct Event* event, struct SeatRequest* request, unsigned int reservation_id,
+                              int claimed) {
+  unsigned int width = claimed ? SEAT_WIDTH_MAX : event->width;
+  for (size_t i = 0; i < request->num_seats; i++) {
+    seatgrid_set(event->data, width, request->seats[i], reservation_id);
+    if (claimed) {
+      seatmap_set_atomic(event->occupied, request->seats[i]);
+      if (request->hold) seatmap_set_atomic(event->held, request->seats[i]);
+    } else {
+      seatmap_set(event->occupied, request->seats[i]);
+      if (request->hold) seatmap_set(event->held, request->seats[i]);
+    }
+    mark_row_dirty(event, request->xs[i] - 1);
+  }
+  update_row_summaries(event, request->xs, request->num_seats);
+  index_reservation(event, reservation_id, request->seats, request->num_seats);
+  atomic_fetch_add_explicit(&event->version, 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&state_changes, 1, memory_order_relaxed);
+  request->reservation_id = reservation_id;
+}
+
+/// Reserves seats without taking any stripe: each seat is claimed with a CAS from 0 to SEAT_CLAIMED, and the
+/// seats claimed so far are given back as soon as one of them is taken. The reservation id is only taken
+/// once every seat is claimed, so ids are numbered as with the stripe locks.
+/// @note Must be called inside an epoch, with every seat in bounds and none repeated. Stripes may be held if the event already has
+/// full-width ids (see widen_for_claims).
+/// @param event Event to reserve in.
+/// @param request Seats to reserve.
+/// @return 0 if the seats were reserved, 1 otherwise.
+static int claim_seats(struct Event* event, struct SeatRequest* request) {
+  if (widen_for_claims(event) != 0) return 1;
+
+  // Deletes, snapshots and checkpoints lock the event, which waits for the claims in progress
+  size_t num_seats = request->num_seats;
+  const size_t* seats = request->seats;
+  uint64_t stripes = row_stripes(event, request->xs, num_seats);
+  begin_seat_claims(event, stripes);
+  if (event->deleted) {
+    end_seat_claims(event, stripes);
+    lock_printf();
+    fprintf(stderr, "Event not found\n");
+    unlock_printf();
+    return 1;
+  }
+  if (seatgrid_materialize(event->data, SEAT_WIDTH_MAX, event->rows * event->cols, seats, num_seats) != 0) {
+    end_seat_claims(event, stripes);
+    lock_printf();
+    fprintf(stderr, "Error allocating memory for seats\n");
+    unlock_printf();
+    return 1;
+  }
+
+  // No seat repeats (see seats_repeat), so a seat that is not free was taken by someone else
+  size_t claimed = 0;
+  while (claimed < num_seats && seatgrid_cas(event->data, SEAT_WIDTH_MAX, seats[claimed], 0, SEAT_CLAIMED)) claimed++;
+
+  if (claimed < num_seats) {
+    for (size_t i = 0; i < claimed; i++) seatgrid_set(event->data, SEAT_WIDTH_MAX, seats[i], 0);
+    end_seat_claims(event, stripes);
+    request->conflict = 1;
+    return 1;
+  }
+
+  unsigned int reservation_id = atomic_fetch_add(&event->reservations, 1) + 1;
+  write_reservation(event, request, reservation_id, 1);
+  // Holds are not logged, only their confirmation is
+  request->lsn = wal_enabled && !request->hold
+                     ? log_seats(WAL_RESERVE, event->id, reservation_id, num_seats, request->xs, request->ys)
+                     : 0;
+  end_seat_claims(event, stripes);
+  return 0;
+}
+
+/// Reserves seats in bounds, none repeated, whose stripes are held: checks them, takes the next id and writes it.
+/// @note Widening moves the whole grid, so it needs every stripe: the stripes held may then grow to all of
+/// them, and the checks are redone once they are held. The stripes in *stripes are still held on return.
+/// @param event Event to reserve in.
+/// @param stripes Stripes held, which must include those of the seats.
+/// @param request Seats to reserve.
+/// @return 0 if the seats were reserved, 1 otherwise.
+static int reserve_held(struct Event* event, uint64_t* stripes, struct SeatRequest* request) {
+  size_t num_seats = request->num_seats;
+  const size_t* seats = request->seats;
+  unsigned int reservation_id;
+  while (1) {
+    // The event may have been deleted while this thread waited for its stripes
+    if (event->deleted) {
+      lock_printf();
+      fprintf(stderr, "Event not found\n");
+      unlock_printf();
+      return 1;
+    }
+
+    // Only the bits of the requested seats are read, not the whole grid
+    if (seatmap_any_set(event->occupied, seats, num_seats)) {
+      request->conflict = 1;
+      return 1;
+    }
+
+    // Tiles are allocated before the id is taken, so a failed allocation leaves no gap in the ids
+    if (seatgrid_materialize(event->data, event->width, event->rows * event->cols, seats, num_seats) != 0) {
+      lock_printf();
+      fprintf(stderr, "Error allocating memory for seats\n");
+      unlock_printf();
+      return 1;
+    }
+
+    // Reservations in other stripes take ids too, so the next id is claimed with a CAS
+    unsigned int reservations = atomic_load_explicit(&event->reservations, memory_order_relaxed);
+    reservation_id = reservations + 1;
+    if (seat_width_for(reservation_id) <= event->width) {
+      if (atomic_compare_exchange_weak(&event->reservations, &reservations, reservation_id)) break;
+      continue;
+    }
+
+    if (*stripes != all_stripes(event)) {
+      unlock_stripes(event, *stripes);
+      *stripes = all_stripes(event);
+      lock_stripes(event, *stripes);
+      continue;
+    }
+    if (widen_seats(event, reservation_id) != 0) {
+      lock_printf();
+      fprintf(stderr, "Error allocating memory for seats\n");
+      unlock_printf();
+      return 1;
+    }
+    atomic_store(&event->reservations, reservation_id);
+    break;
+  }
+
+  // SHOW copies the seats without the stripes, and retries if it overlapped these writes
+  begin_seat_writes(event, *stripes);
+  write_reservation(event, request, reservation_id, 0);
+  end_seat_writes(event, *stripes);
+  // Holds are not logged, only their confirmation is
+  request->lsn = wal_enabled && !request->hold
+                     ? log_seats(WAL_RESERVE, event->id, reservation_id, num_seats, request->xs, request->ys)
+                     : 0;
+  return 0;
+}
+
+// Reservation posted to the combiner of a contended event
+struct CombinedReserve {
+  struct SeatRequest* request;  // Seats to reserve
+  int error;                    // Set to what reserve_held returned
+};
+
+/// Applies a batch of reservations posted to the combiner of an event (see combiner_run).
+/// @note Every stripe is taken once for the whole batch, so the grid stays in the cache of this thread and
+/// reserve_held never has to trade its stripes for all of them to widen the seats.
+/// @param ctx Event of the reservations.
+/// @param ops Reservations, as struct CombinedReserve.
+/// @param count Number of reservations.
+static void apply_reserves(void* ctx, void** ops, size_t count) {
+  struct Event* event = ctx;
+  uint64_t stripes = all_stripes(event);
+  lock_stripes(event, stripes);
+  for (size_t i = 0; i < count; i++) {
+    struct CombinedReserve* reserve = ops[i];
+    reserve->error = reserve_held(event, &stripes, reserve->request);
+  }
+  unlock_stripes(event, stripes);
+
+  // Once nobody else posts, the event is no longer contended and goes back to its stripes
+  event->lone_batches = count == 1 ? event->lone_batches + 1 : 0;
+  if (event->lone_batches >= COMBINING_THRESHOLD) {
+    event->lone_batches = 0;
+    atomic_store_explicit(&event->contention, 0, memory_order_relaxed);
+    atomic_store_explicit(&event->combining, 0, memory_order_relaxed);
+  }
+}
+
+/// Reserves the requested seats of an event in the current reservation mode.
+/// @note Must be called inside an epoch. In RESERVE_LOCKED mode, an event whose stripes are found taken by
+/// COMBINING_THRESHOLD reservations in a row switches to flat combining (see combiner.h): its reservations are
+/// posted to its combiner and applied in batches by whichever worker holds it, instead of queueing on the stripes.
+/// @param event Event to reserve in.
+/// @param request Seats to reserve, with the indexes of the seats set if they are in bounds.
+/// @param in_bounds Whether every seat is in bounds, the request fails otherwise.
+/// @return 0 if the seats were reserved, 1 otherwise.
+static int reserve_seats(struct Event* event, struct SeatRequest* request, int in_bounds) {
+  if (reserve_mode == RESERVE_CAS && in_bounds) return claim_seats(event, request);
+
+  if (in_bounds && combining_enabled && atomic_load_explicit(&event->combining, memory_order_relaxed)) {
+    struct CombinedReserve reserve = {request, 0};
+    struct CombinerNode node;
+    combiner_run(&event->combiner, &node, &reserve, apply_reserves, event);
+    return reserve.error;
+  }
+
+  // Only the stripes of the requested rows are locked, so reservations elsewhere in the event carry on.
+  // Any stripe is enough to see whether the event was deleted.
+  uint64_t stripes = in_bounds ? row_stripes(event, request->xs, request->num_seats) : 1;
+  if (trylock_stripes(event, stripes) == 0) {
+    if (atomic_load_explicit(&event->contention, memory_order_relaxed) != 0) {
+      atomic_store_explicit(&event->contention, 0, memory_order_relaxed);
+    }
+  } else {
+    if (combining_enabled && atomic_fetch_add_explicit(&event->contention, 1, memory_order_relaxed) + 1 >= COMBINING_THRESHOLD) {
+      atomic_store_explicit(&event->combining, 1, memory_order_relaxed);
+    }
+    lock_stripes(event, stripes);
+  }
+  int error;
+  if (!in_bounds) {
+    lock_printf();
+    fprintf(stderr, event->deleted ? "Event not found\n" : "Seat out of bounds\n");
+    unlock_printf();
+    error = 1;
+  } else {
+    error = reserve_held(event, &stripes, request);
+  }
+  unlock_stripes(event, stripes);
+  return error;
+}
+
+/// Frees the seats of a reservation or hold that still have its id, so they can be reserved again.
+/// @note Must be called inside an epoch, and only once the reservation can no longer be confirmed or cancelled
+/// by anyone else. Seats that no longer have the id are left alone, and so are the seats of a hold that are no
+/// longer held, which were confirmed.
+/// @param event Event of the seats.
+/// @param reservation_id Reservation id of the seats.
+/// @param num_seats Number of seats.
+/// @param seats Indexes of the seats.
+/// @param lsn Where to store the LSN of the cancellation, logged if the log is enabled and a seat was freed.
+/// NULL for holds, which are not logged and only free seats still marked as held.
+/// @return Number of seats freed.
+static size_t release_seats(struct Event* event, unsigned int reservation_id, size_t num_seats, const size_t* seats,
+                            uint64_t* lsn) {
+  size_t rows[MAX_RESERVATION_SIZE], cols[MAX_RESERVATION_SIZE];
+  for (size_t i = 0; i < num_seats; i++) {
+    rows[i] = seats[i] / event->cols + 1;
+    cols[i] = seats[i] % event->cols + 1;
+  }
+
+  uint64_t stripes = row_stripes(event, rows, num_seats);
+  if (reserve_mode == RESERVE_CAS) {
+    begin_seat_claims(event, stripes);
+  } else {
+    lock_stripes(event, stripes);
+    begin_seat_writes(event, stripes);
+  }
+
+  size_t freed = 0;
+  if (!event->deleted) {
+    uint64_t* held = __atomic_load_n(&event->held, __ATOMIC_ACQUIRE);
+    for (size_t i = 0; i < num_seats; i++) {
+      unsigned int id;
+      seatgrid_load(event->data, event->width, seats[i], 1, &id);
+      if (id != reservation_id || (lsn == NULL && (held == NULL || !seatmap_any_set(held, &seats[i], 1)))) continue;
+      // The bits go first: a lock-free claim may take the seat as soon as it reads as 0, and sets the bit after
+      if (held != NULL) seatmap_clear_atomic(held, seats[i]);
+      seatmap_clear_atomic(event->occupied, seats[i]);
+      seatgrid_set(event->data, event->width, seats[i], 0);
+      mark_row_dirty(event, rows[i] - 1);
+      freed++;
+    }
+    if (freed > 0) {
+      update_row_summaries(event, rows, num_seats);
+      atomic_fetch_add_explicit(&event->version, 1, memory_order_relaxed);
+      atomic_fetch_add_explicit(&state_changes, 1, memory_order_relaxed);
+      if (lsn != NULL && wal_enabled) *lsn = log_seats(WAL_CANCEL, event->id, reservation_id, num_seats, rows, cols);
+    }
+  }
+
+  if (reserve_mode == RESERVE_CAS) {
+    end_seat_claims(event, stripes);
+  } else {
+    end_seat_writes(event, stripes);
+    unlock_stripes(event, stripes);
+  }
+  return freed;
+}
+
+/// Frees the seats of a hold whose time ran out, called by the expiry thread (see holds_start).
+/// @param hold Hold that expired.
+static void expire_hold(struct Hold* hold) {
+  if (owners_route(hold->event_id)) {
+    struct OwnedCall call = {.op = OWNED_EXPIRE, .hold = hold};
+    owners_call(hold->event_id, run_owned, &call);
+    return;
+  }
+
+  // Should the epoch not be entered, the seats stay reserved rather than be freed under a concurrent delete
+  if (enter_epoch()) return;
+  // The event may have been deleted since, and another one created with the same id, even at the same address
+  struct Event* event = get_event(event_list, hold->event_id);
+  if (event != NULL && event->generation == hold->generation) {
+    take_reservation(event, hold->hold_id, 0, NULL, NULL);
+    release_seats(event, hold->hold_id, hold->num_seats, hold->seats, NULL);
+  }
+  epoch_exit();
+}
+
+int ems_reserve(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys) {
+  if (event_list == NULL) {
+    lock_printf();
+    fprintf(stderr, "EMS state must be initialized\n");
+    unlock_printf();
+    return 1;
+  }
+
+  if (owners_route(event_id)) {
+    struct OwnedCall call = {.op = OWNED_RESERVE, .event_id = event_id, .num_seats = num_seats, .xs = xs, .ys = ys};
+    owners_call(event_id, run_owned, &call);
+    return finish_owned(&call);
+  }
+
+  if (num_seats > MAX_RESERVATION_SIZE) {
+    lock_printf();
+    fprintf(stderr, "Too many seats\n");
+    unlock_printf();
+    return 1;
+  }
+
+  // The lookup does not take the list rwl, the epoch keeps the index and the event alive instead
+  if (enter_epoch()) return 1;
+
+  struct Event* event = get_event_with_delay(event_id);
+
+  if (event == NULL) {
+    epoch_exit();
+    lock_printf();
+    fprintf(stderr, "Event not found\n");
+    unlock_printf();
+    return 1;
+  }
+
+  // Rows and columns never change, so the seats are checked before taking any lock
+  struct SeatRequest request = {.num_seats = num_seats, .xs = xs, .ys = ys};
+  int in_bounds = index_seats(event, &request);
+  if (in_bounds && seats_repeat(request.seats, num_seats)) {
+    epoch_exit();
+    lock_printf();
+    fprintf(stderr, "Seat requested twice\n");
+    unlock_printf();
+    return 1;
+  }
+
+  int error = reserve_seats(event, &request, in_bounds);
+  epoch_exit();
+
+  if (request.conflict) {
+    lock_printf();
+    fprintf(stderr, "Seat already reserved\n");
+    unlock_printf();
+  }
+  if (error) return 1;
+
+  // Waits outside the stripes, so reservations of the same event join the same batch
+  if (wal_enabled && wait_logged(request.lsn) != 0) {
+    lock_printf();
+    fprintf(stderr, "Error writing to log\n");
+    unlock_printf();
+    return 1;
+  }
+  return 0;
+}
+
+/// Logs the reservations of a RESERVE_MULTI as a single record, so a crash keeps all of them or none.
+/// @note Must be called with the stripes of every event held (or the seats claimed).
+/// @param events Events of the reservations.
+/// @param requests Seats and ids of the reservations.
+/// @param count Number of reservations, at most MAX_MULTI_EVENTS.
+/// @return LSN of the record, 0 on failure.
+static uint64_t log_multi(struct Event* const* events, const struct SeatRequest* requests, size_t count) {
+  char payload[sizeof(uint64_t) +
+               MAX_MULTI_EVENTS * (sizeof(struct WalReserve) + 2 * sizeof(uint64_t) * MAX_RESERVATION_SIZE)];
+  uint64_t num_reservations = count;
+  memcpy(payload, &num_reservations, sizeof(uint64_t));
+  size_t size = sizeof(uint64_t);
+  for (size_t i = 0; i < count; i++) {
+    size += encode_seats(payload + size, events[i]->id, requests[i].reservation_id, requests[i].num_seats,
+                         requests[i].xs, requests[i].ys);
+  }
+  return wal_append(WAL_RESERVE_MULTI, payload, size);
+}
+
+/// Reserves seats in several events together, with their stripes locked in ascending order of id. Every event is
+/// checked before any id is taken, so a conflict in one of them leaves all of them untouched.
+/// @note Must be called inside an epoch, with every seat in bounds and none repeated. Events whose ids may still
+/// need widening are locked whole, since widening needs every stripe and no other reservation of the event may take
+/// an id between the check and the write.
+/// @param events Events to reserve in, in ascending order of id.
+/// @param requests Seats to reserve in each event.
+/// @param count Number of events.
+/// @param lsn Where to store the LSN of the log record, left alone if nothing was logged.
+/// @return 0 if the seats were reserved, 1 otherwise.
+static int reserve_multi_held(struct Event** events, struct SeatRequest* requests, size_t count, uint64_t* lsn) {
+  uint64_t stripes[MAX_MULTI_EVENTS];
+  for (size_t i = 0; i < count; i++) {
+    stripes[i] = events[i]->width < SEAT_WIDTH_MAX ? all_stripes(events[i])
+                                                   : row_stripes(events[i], requests[i].xs, requests[i].num_seats);
+    lock_stripes(events[i], stripes[i]);
+  }
+
+  int error = 0;
+  for (size_t i = 0; i < count && !error; i++) {
+    struct Event* event = events[i];
+    struct SeatRequest* request = &requests[i];
+    if (event->deleted) {
+      lock_printf();
+      fprintf(stderr, "Event not found\n");
+      unlock_printf();
+      error = 1;
+    } else if (seatmap_any_set(event->occupied, request->seats, request->num_seats)) {
+      request->conflict = 1;
+      error = 1;
+    } else if (seatgrid_materialize(event->data, event->width, event->rows * event->cols, request->seats,
+                                    request->num_seats) != 0 ||
+               widen_seats(event, atomic_load(&event->reservations) + 1) != 0) {
+      lock_printf();
+      fprintf(stderr, "Error allocating memory for seats\n");
+      unlock_printf();
+      error = 1;
+    }
+  }
+
+  // Ids of events locked whole cannot move, and those of the others always fit, so nothing fails from here
+  if (!error) {
+    for (size_t i = 0; i < count; i++) {
+      unsigned int reservation_id = atomic_fetch_add(&events[i]->reservations, 1) + 1;
+      begin_seat_writes(events[i], stripes[i]);
+      write_reservation(events[i], &requests[i], reservation_id, 0);
+      end_seat_writes(events[i], stripes[i]);
+    }
+    if (wal_enabled) *lsn = log_multi(events, requests, count);
+  }
+
+  for (size_t i = count; i-- > 0;) unlock_stripes(events[i], stripes[i]);
+  return error;
+}
+
+/// Reserves seats in several events together without taking any stripe: the seats of each event are claimed in
+/// ascending order of id, as in claim_seats, and every seat claimed so far is given back on a conflict.
+/// @note Must be called inside an epoch, with every seat in bounds and none repeated.
+/// @param events Events to reserve in, in ascending order of id.
+/// @param requests Seats to reserve in each event.
+/// @param count Number of events.
+/// @param lsn Where to store the LSN of the log record, left alone if nothing was logged.
+/// @return 0 if the seats were reserved, 1 otherwise.
+static int claim_multi(struct Event** events, struct SeatRequest* requests, size_t count, uint64_t* lsn) {
+  for (size_t i = 0; i < count; i++) {
+    if (widen_for_claims(events[i]) != 0) return 1;
+  }
+
+  // Claims of an event only wait while it is locked whole, which no bundle does. Those that lock several events
+  // whole (see show_all) lock them in ascending order of id too, so a bundle never waits for one holding an event
+  // it has claimed
+  uint64_t stripes[MAX_MULTI_EVENTS];
+  size_t claimed[MAX_MULTI_EVENTS];
+  size_t entered = 0;
+  int error = 0;
+  while (entered < count && !error) {
+    size_t i = entered++;
+    struct Event* event = events[i];
+    struct SeatRequest* request = &requests[i];
+    stripes[i] = row_stripes(event, request->xs, request->num_seats);
+    claimed[i] = 0;
+    begin_seat_claims(event, stripes[i]);
+    if (event->deleted) {
+      lock_printf();
+      fprintf(stderr, "Event not found\n");
+      unlock_printf();
+      error = 1;
+    } else if (seatgrid_materialize(event->data, SEAT_WIDTH_MAX, event->rows * event->cols, request->seats,
+                                    request->num_seats) != 0) {
+      lock_printf();
+      fprintf(stderr, "Error allocating memory for seats\n");
+      unlock_printf();
+      error = 1;
+    } else {
+      while (claimed[i] < request->num_seats &&
+             seatgrid_cas(event->data, SEAT_WIDTH_MAX, request->seats[claimed[i]], 0, SEAT_CLAIMED)) {
+        claimed[i]++;
+      }
+      request->conflict = claimed[i] < request->num_seats;
+      error = request->conflict;
+    }
+  }
+
+  if (error) {
+    for (size_t i = 0; i < entered; i++) {
+      for (size_t j = 0; j < claimed[i]; j++) seatgrid_set(events[i]->data, SEAT_WIDTH_MAX, requests[i].seats[j], 0);
+    }
+  } else {
+    for (size_t i = 0; i < count; i++) {
+      write_reservation(events[i], &requests[i], atomic_fetch_add(&events[i]->reservations, 1) + 1, 1);
+    }
+    if (wal_enabled) *lsn = log_multi(events, requests, count);
+  }
+
+  for (size_t i = 0; i < entered; i++) end_seat_claims(events[i], stripes[i]);
+  return error;
+}
+
+/// Creates a reservation in each of several events, all of them or none (see ems_reserve_multi).
+/// @note With owner threads, the owners of the events must be parked.
+static int reserve_multi(size_t num_events, unsigned int* event_ids, size_t* num_seats, size_t* xs, size_t* ys) {
+  if (event_list == NULL) {
+    lock_printf();
+    fprintf(stderr, "EMS state must be initialized\n");
+    unlock_printf();
+    return 1;
+  }
+
+  if (num_events == 0 || num_events > MAX_MULTI_EVENTS) {
+    lock_printf();
+    fprintf(stderr, "Invalid number of events\n");
+    unlock_printf();
+    return 1;
+  }
+
+  // The seats of each event follow those of the events before it in the request
+  size_t first_seat[MAX_MULTI_EVENTS];
+  size_t total_seats = 0;
+  for (size_t i = 0; i < num_events; i++) {
+    if (num_seats[i] == 0 || num_seats[i] > MAX_RESERVATION_SIZE) {
+      lock_printf();
+      fprintf(stderr, "Invalid number of seats\n");
+      unlock_printf();
+      return 1;
+    }
+    first_seat[i] = total_seats;
+    total_seats += num_seats[i];
+  }
+
+  // Events are locked in ascending order of id, so bundles sharing events cannot deadlock
+  size_t order[MAX_MULTI_EVENTS];
+  for (size_t i = 0; i < num_events; i++) {
+    size_t j = i;
+    while (j > 0 && event_ids[order[j - 1]] > event_ids[i]) {
+      order[j] = order[j - 1];
+      j--;
+    }
+    order[j] = i;
+  }
+  for (size_t i = 1; i < num_events; i++) {
+    if (event_ids[order[i]] == event_ids[order[i - 1]]) {
+      lock_printf();
+      fprintf(stderr, "Event requested twice\n");
+      unlock_printf();
+      return 1;
+    }
+  }
+
+  if (enter_epoch()) return 1;
+
+  // Rows and columns never change, so every seat set is checked before taking any lock
+  struct Event* events[MAX_MULTI_EVENTS];
+  struct SeatRequest requests[MAX_MULTI_EVENTS];
+  for (size_t k = 0; k < num_events; k++) {
+    size_t i = order[k];
+    events[k] = get_event_with_delay(event_ids[i]);
+    const char* error = NULL;
+    if (events[k] == NULL) {
+      error = "Event not found\n";
+    } else {
+      requests[k] = (struct SeatRequest){.num_seats = num_seats[i], .xs = xs + first_seat[i], .ys = ys + first_seat[i]};
+      if (!index_seats(events[k], &requests[k])) {
+        error = "Seat out of bounds\n";
+      } else if (seats_repeat(requests[k].seats, num_seats[i])) {
+        error = "Seat requested twice\n";
+      }
+    }
+    if (error != NULL) {
+      epoch_exit();
+      lock_printf();
+      fprintf(stderr, "%s", error);
+      unlock_printf();
+      return 1;
+    }
+  }
+
+  uint64_t lsn = 0;
+  int error = reserve_mode == RESERVE_CAS ? claim_multi(events, requests, num_events, &lsn)
+                                          : reserve_multi_held(events, requests, num_events, &lsn);
+  epoch_exit();
+
+  for (size_t k = 0; k < num_events; k++) {
+    if (!requests[k].conflict) continue;
+    lock_printf();
+    fprintf(stderr, "Seat already reserved\n");
+    unlock_printf();
+    break;
+  }
+  if (error) return 1;
+
+  // The reservations share one record, so a single wait makes all of them durable
+  if (wal_enabled && wait_logged(lsn) != 0) {
+    lock_printf();
+    fprintf(stderr, "Error writing to log\n");
+    unlock_printf();
+    return 1;
+  }
+  return 0;
+}
+
+int ems_reserve_multi(size_t num_events, unsigned int* event_ids, size_t* num_seats, size_t* xs, size_t* ys) {
+  // The events may have different owners, so all of them are parked and the bundle is made here
+  struct OwnedCall call = {.op = OWNED_RESERVE_MULTI, .num_events = num_events, .event_ids = event_ids,
+                           .seat_counts = num_seats, .xs = xs, .ys = ys};
+  owners_call_parked(event_ids, num_events <= MAX_MULTI_EVENTS ? num_events : 0, run_owned, &call);
+  return finish_owned(&call);
+}
+
+int ems_reserve_best(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys) {
+  if (event_list == NULL) {
+    lock_printf();
+    fprintf(stderr, "EMS state must be initialized\n");
+    unlock_printf();
+    return 1;
+  }
+
+  if (owners_route(event_id)) {
+    struct OwnedCall call = {.op = OWNED_RESERVE_BEST, .event_id = event_id, .num_seats = num_seats, .xs = xs, .ys = ys};
+    owners_call(event_id, run_owned, &call);
+    return finish_owned(&call);
+  }
+
+  if (num_seats == 0 || num_seats > MAX_RESERVATION_SIZE) {
+    lock_printf();
+    fprintf(stderr, "Invalid number of seats\n");
+    unlock_printf();
+    return 1;
+  }
+
+  if (enter_epoch()) return 1;
 
-/// Gets the index of a seat.
-/// @note This function assumes that the seat exists.
-/// @param event Event to get the seat index from.
-/// @param row Row of the seat.
-/// @param col Column of the seat.
-/// @return Index of the seat.
-static size_t seat_index(struct Event* event, size_t row, size_t col) { return (row - 1) * event->cols + col - 1; }
+  struct Event* event = get_event_with_delay(event_id);
 
-int ems_init(unsigned int delay_us) {
-  if (event_list != NULL) {
+  if (event == NULL) {
+    epoch_exit();
     lock_printf();
-    fprintf(stderr, "EMS state has already been initialized\n");
+    fprintf(stderr, "Event not found\n");
     unlock_printf();
     return 1;
   }
 
-  event_list = create_list();
-  state_access_delay_us = delay_us;
+  // The summaries are built from the bitmap on the first request, and kept up to date by every reservation after
+  if (atomic_load_explicit(&event->summaries, memory_order_acquire) == NULL) {
+    lock_event(event);
+    int error = !event->deleted && build_row_summaries(event) != 0;
+    unlock_event(event);
+    if (error) {
+      epoch_exit();
+      lock_printf();
+      fprintf(stderr, "Error allocating memory for seats\n");
+      unlock_printf();
+      return 1;
+    }
+  }
+
+  if (reserve_mode == RESERVE_CAS && widen_for_claims(event) != 0) {
+    epoch_exit();
+    return 1;
+  }
+
+  struct SeatRequest request = {.num_seats = num_seats, .xs = xs, .ys = ys};
+  int error = 1;
+  int remeasured = 0;
+  size_t row = 0;
+  while (1) {
+    // Front rows first: the summaries rule out the rows without a long enough run without reading their seats
+    row = find_free_row(event, row, num_seats);
+    if (row == event->rows && reserve_mode == RESERVE_CAS && !remeasured && !event->deleted) {
+      // Without the stripes, a claim racing with a release in the same row may have left its summary short of the
+      // free seats, so every row is measured again once before giving up
+      for (size_t stripe = 0; stripe < event->num_stripes; stripe++) {
+        lock_stripes(event, 1ull << stripe);
+        for (size_t r = stripe * event->stripe_rows; r < event->rows && r < (stripe + 1) * event->stripe_rows; r++) {
+          size_t row_number = r + 1;
+          update_row_summaries(event, &row_number, 1);
+        }
+        unlock_stripes(event, 1ull << stripe);
+      }
+      remeasured = 1;
+      row = 0;
+      continue;
+    }
+    if (row == event->rows) {
+      lock_printf();
+      fprintf(stderr, event->deleted ? "Event not found\n" : "No adjacent seats available\n");
+      unlock_printf();
+      break;
+    }
+
+    // The stripe of the row is taken in both modes, so concurrent requests queue up instead of all claiming the
+    // same run. Plain lock-free reservations do not take it, so the seats are still claimed in that mode.
+    uint64_t stripes = 1ull << (row / event->stripe_rows);
+    lock_stripes(event, stripes);
+
+    // Only the row is read, to place the run at its leftmost free seats
+    size_t col = seatmap_find_run(event->occupied, row * event->cols, event->cols, num_seats);
+    if (col == event->cols) {
+      // Another reservation took the run after the summary was read, so the summary is refreshed and the search
+      // goes on past the row
+      size_t row_number = row + 1;
+      update_row_summaries(event, &row_number, 1);
+      unlock_stripes(event, stripes);
+      row++;
+      continue;
+    }
+    for (size_t i = 0; i < num_seats; i++) {
+      xs[i] = row + 1;
+      ys[i] = col + i + 1;
+      request.seats[i] = seat_index(event, xs[i], ys[i]);
+    }
+
+    // A conflict means a concurrent reservation got there first, so the same row is searched again
+    request.conflict = 0;
+    if (reserve_mode == RESERVE_CAS) {
+      error = claim_seats(event, &request);
+    } else {
+      error = reserve_held(event, &stripes, &request);
+    }
+    unlock_stripes(event, stripes);
+    if (!request.conflict) break;
+  }
+  epoch_exit();
+  if (error) return 1;
 
-  return event_list == NULL;
+  if (wal_enabled && wait_logged(request.lsn) != 0) {
+    lock_printf();
+    fprintf(stderr, "Error writing to log\n");
+    unlock_printf();
+    return 1;
+  }
+  return 0;
 }
 
-int ems_terminate() {
+int ems_hold(unsigned int event_id, unsigned int seconds, size_t num_seats, size_t* xs, size_t* ys,
+             unsigned int* hold_id) {
   if (event_list == NULL) {
     lock_printf();
     fprintf(stderr, "EMS state must be initialized\n");
@@ -53,99 +1370,180 @@ int ems_terminate() {
     return 1;
   }
 
-  if (pthread_rwlock_wrlock(&event_list->rwl) != 0) {
+  if (owners_route(event_id)) {
+    struct OwnedCall call = {.op = OWNED_HOLD, .event_id = event_id, .seconds = seconds, .num_seats = num_seats, .xs = xs, .ys = ys, .hold_id = hold_id};
+    owners_call(event_id, run_owned, &call);
+    return finish_owned(&call);
+  }
+
+  if (num_seats == 0 || num_seats > MAX_RESERVATION_SIZE) {
     lock_printf();
-    fprintf(stderr, "Error locking list rwl\n");
+    fprintf(stderr, "Invalid number of seats\n");
     unlock_printf();
     return 1;
   }
-  
-  free_list(event_list);
-  pthread_rwlock_unlock(&event_list->rwl);
-  free(event_list); 
-  return 0;
-}
 
-int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols) {
+  if (seconds == 0 || seconds > MAX_HOLD_SECONDS) {
+    lock_printf();
+    fprintf(stderr, "Invalid hold time\n");
+    unlock_printf();
+    return 1;
+  }
 
-  if (event_list == NULL) {
+  if (enter_epoch()) return 1;
+
+  struct Event* event = get_event_with_delay(event_id);
+
+  if (event == NULL) {
+    epoch_exit();
     lock_printf();
-    fprintf(stderr, "EMS state must be initialized\n");
+    fprintf(stderr, "Event not found\n");
     unlock_printf();
     return 1;
   }
 
-  if (pthread_rwlock_wrlock(&event_list->rwl) != 0) {
+  struct SeatRequest request = {.num_seats = num_seats, .xs = xs, .ys = ys, .hold = 1};
+  int in_bounds = index_seats(event, &request);
+  if (in_bounds && seats_repeat(request.seats, num_seats)) {
+    epoch_exit();
     lock_printf();
-    fprintf(stderr, "Error locking list rwl\n");
+    fprintf(stderr, "Seat requested twice\n");
     unlock_printf();
     return 1;
   }
 
+  // The held seats are marked in a bitmap of their own, built on the first hold of the event
+  struct Hold* hold = hold_alloc(num_seats);
+  int error = hold == NULL;
+  if (!error && __atomic_load_n(&event->held, __ATOMIC_ACQUIRE) == NULL) {
+    lock_event(event);
+    error = !event->deleted && enable_holds(event) != 0;
+    unlock_event(event);
+  }
+  if (error) {
+    epoch_exit();
+    hold_free(hold);
+    lock_printf();
+    fprintf(stderr, "Error allocating memory for hold\n");
+    unlock_printf();
+    return 1;
+  }
 
-  if (get_event_with_delay(event_id, event_list->head, event_list->tail) != NULL) {
+  error = reserve_seats(event, &request, in_bounds);
+  if (!error) {
+    hold->event_id = event_id;
+    hold->hold_id = request.reservation_id;
+    hold->generation = event->generation;
+    memcpy(hold->seats, request.seats, num_seats * sizeof(size_t));
+    // A hold that cannot expire would keep its seats forever, so they are given back
+    if (holds_add(hold, seconds) != 0) {
+      take_reservation(event, hold->hold_id, 0, NULL, NULL);
+      release_seats(event, hold->hold_id, num_seats, hold->seats, NULL);
       lock_printf();
-      fprintf(stderr, "Event already exists\n");
+      fprintf(stderr, "Error allocating memory for hold\n");
       unlock_printf();
-      pthread_rwlock_unlock(&event_list->rwl);
-    return 1;
+      error = 1;
+    }
   }
+  epoch_exit();
 
-  struct Event* event = malloc(sizeof(struct Event));
-
-  if (event == NULL) {
+  if (request.conflict) {
     lock_printf();
-    fprintf(stderr, "Error allocating memory for event\n");
+    fprintf(stderr, "Seat already reserved\n");
     unlock_printf();
-    pthread_rwlock_unlock(&event_list->rwl);
+  }
+  if (error) {
+    hold_free(hold);
     return 1;
   }
+  *hold_id = request.reservation_id;
+  return 0;
+}
 
-
-  event->id = event_id;
-  event->rows = num_rows;
-  event->cols = num_cols;
-  event->reservations = 0;
-  if (pthread_mutex_init(&event->mutex, NULL) != 0) {
-    pthread_rwlock_unlock(&event_list->rwl);
+int ems_confirm(unsigned int event_id, unsigned int hold_id) {
+  if (event_list == NULL) {
     lock_printf();
-    fprintf(stderr, "Error initializing mutex\n");
+    fprintf(stderr, "EMS state must be initialized\n");
     unlock_printf();
-    free(event);
     return 1;
   }
 
+  if (owners_route(event_id)) {
+    struct OwnedCall call = {.op = OWNED_CONFIRM, .event_id = event_id, .id = hold_id};
+    owners_call(event_id, run_owned, &call);
+    return finish_owned(&call);
+  }
+
+  if (enter_epoch()) return 1;
 
-  event->data = calloc(num_rows * num_cols, sizeof(unsigned int));
+  struct Event* event = get_event_with_delay(event_id);
 
-  if (event->data == NULL) {
+  // Taking the hold stops its expiry, or fails if it already expired
+  struct Hold* hold = event == NULL ? NULL : holds_take(event_id, event->generation, hold_id);
+  if (hold == NULL) {
+    epoch_exit();
     lock_printf();
-    fprintf(stderr, "Error allocating memory for event data\n");
+    fprintf(stderr, "Hold not found\n");
     unlock_printf();
-    pthread_rwlock_unlock(&event_list->rwl);
-    free(event);
     return 1;
   }
 
+  // The seats keep the id of the hold, so confirming only clears their held bits and logs the reservation
+  size_t xs[MAX_RESERVATION_SIZE], ys[MAX_RESERVATION_SIZE];
+  for (size_t i = 0; i < hold->num_seats; i++) {
+    xs[i] = hold->seats[i] / event->cols + 1;
+    ys[i] = hold->seats[i] % event->cols + 1;
+  }
 
+  uint64_t stripes = row_stripes(event, xs, hold->num_seats);
+  if (reserve_mode == RESERVE_CAS) {
+    begin_seat_claims(event, stripes);
+  } else {
+    lock_stripes(event, stripes);
+  }
 
-  if (append_to_list(event_list, event) != 0) {
+  uint64_t lsn = 0;
+  int found = !event->deleted;
+  for (size_t i = 0; i < hold->num_seats && found; i++) {
+    unsigned int id;
+    seatgrid_load(event->data, event->width, hold->seats[i], 1, &id);
+    found = id == hold_id && seatmap_any_set(event->held, &hold->seats[i], 1);
+  }
+  if (found) {
+    // The rows are saved again, now that their seats are no longer left out of checkpoints
+    for (size_t i = 0; i < hold->num_seats; i++) {
+      seatmap_clear_atomic(event->held, hold->seats[i]);
+      mark_row_dirty(event, xs[i] - 1);
+    }
+    lsn = wal_enabled ? log_seats(WAL_RESERVE, event->id, hold_id, hold->num_seats, xs, ys) : 0;
+    atomic_fetch_add_explicit(&state_changes, 1, memory_order_relaxed);
+  }
+
+  if (reserve_mode == RESERVE_CAS) {
+    end_seat_claims(event, stripes);
+  } else {
+    unlock_stripes(event, stripes);
+  }
+  epoch_exit();
+  hold_free(hold);
+
+  if (!found) {
     lock_printf();
-    fprintf(stderr, "Error appending event to list\n");
+    fprintf(stderr, "Hold not found\n");
     unlock_printf();
-    pthread_rwlock_unlock(&event_list->rwl);
-    free(event->data);
-    free(event);
     return 1;
   }
-;
-  event_list->num_events++;
-  pthread_rwlock_unlock(&event_list->rwl);
 
+  if (wal_enabled && wait_logged(lsn) != 0) {
+    lock_printf();
+    fprintf(stderr, "Error writing to log\n");
+    unlock_printf();
+    return 1;
+  }
   return 0;
 }
 
-int ems_reserve(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys) {
+int ems_cancel(unsigned int event_id, unsigned int reservation_id) {
   if (event_list == NULL) {
     lock_printf();
     fprintf(stderr, "EMS state must be initialized\n");
@@ -153,71 +1551,139 @@ int ems_reserve(unsigned int event_id, size_t num_seats, size_t* xs, size_t* ys)
     return 1;
   }
 
-  if (pthread_rwlock_rdlock(&event_list->rwl) != 0) {
-    lock_printf();
-    fprintf(stderr, "Error locking list rwl\n");
-    unlock_printf();
-    return 1;
+  if (owners_route(event_id)) {
+    struct OwnedCall call = {.op = OWNED_CANCEL, .event_id = event_id, .id = reservation_id};
+    owners_call(event_id, run_owned, &call);
+    return finish_owned(&call);
   }
 
-  struct Event* event = get_event_with_delay(event_id, event_list->head, event_list->tail);
+  if (enter_epoch()) return 1;
 
-  pthread_rwlock_unlock(&event_list->rwl);
+  struct Event* event = get_event_with_delay(event_id);
 
   if (event == NULL) {
+    epoch_exit();
     lock_printf();
     fprintf(stderr, "Event not found\n");
     unlock_printf();
     return 1;
   }
 
-  if (pthread_mutex_lock(&event->mutex) != 0) {
-    lock_printf();
-    fprintf(stderr, "Error locking mutex\n");
-    unlock_printf();
-    return 1;
-  }
+  // A hold that is taken can no longer expire or be confirmed, and was never logged
+  struct Hold* hold = holds_take(event_id, event->generation, reservation_id);
 
-  for (size_t i = 0; i < num_seats; i++) {
-    if (xs[i] <= 0 || xs[i] > event->rows || ys[i] <= 0 || ys[i] > event->cols) {
+  // The index is built from the seats on the first cancel of the event, and kept up to date by every reservation
+  // after it
+  if (!reservation_index_ready(event)) {
+    lock_event(event);
+    int error = !event->deleted && build_reservation_index(event) != 0;
+    unlock_event(event);
+    if (error) {
+      epoch_exit();
+      hold_free(hold);
       lock_printf();
-      fprintf(stderr, "Seat out of bounds\n");
+      fprintf(stderr, "Error allocating memory for seats\n");
       unlock_printf();
-      pthread_mutex_unlock(&event->mutex);
       return 1;
     }
   }
 
-  for (size_t i = 0; i < event->rows * event->cols; i++) {
-    for (size_t j = 0; j < num_seats; j++) {
-      if (seat_index(event, xs[j], ys[j]) != i) {
-        continue;
-      }
+  uint64_t lsn = 0;
+  size_t freed = 0;
+  size_t num_seats;
+  size_t seats[MAX_RESERVATION_SIZE];
+  int found = take_reservation(event, reservation_id, MAX_RESERVATION_SIZE, seats, &num_seats) == 0;
+  if (hold != NULL) {
+    freed = release_seats(event, reservation_id, hold->num_seats, hold->seats, NULL);
+  } else if (found) {
+    freed = release_seats(event, reservation_id, num_seats, seats, &lsn);
+  }
+  epoch_exit();
+  hold_free(hold);
 
-      if (event->data[i] != 0) {
-        lock_printf();
-        fprintf(stderr, "Seat already reserved\n");
-        unlock_printf();
-        pthread_mutex_unlock(&event->mutex);
-        return 1;
-      }
+  // Seats freed by an expiry or cancel racing with this one do not count
+  if (freed == 0) {
+    lock_printf();
+    fprintf(stderr, "Reservation not found\n");
+    unlock_printf();
+    return 1;
+  }
 
-      break;
-    }
+  if (wal_enabled && wait_logged(lsn) != 0) {
+    lock_printf();
+    fprintf(stderr, "Error writing to log\n");
+    unlock_printf();
+    return 1;
+  }
+  return 0;
+}
+
+int ems_delete(unsigned int event_id) {
+  if (event_list == NULL) {
+    lock_printf();
+    fprintf(stderr, "EMS state must be initialized\n");
+    unlock_printf();
+    return 1;
   }
 
-  unsigned int reservation_id = ++event->reservations;
+  if (owners_route(event_id)) {
+    struct OwnedCall call = {.op = OWNED_DELETE, .event_id = event_id};
+    owners_call(event_id, run_owned, &call);
+    return finish_owned(&call);
+  }
 
-  for (size_t i = 0; i < num_seats; i++) {
-    event->data[seat_index(event, xs[i], ys[i])] = reservation_id;
+  if (pthread_rwlock_wrlock(&event_list->rwl) != 0) {
+    lock_printf();
+    fprintf(stderr, "Error locking list rwl\n");
+    unlock_printf();
+    return 1;
+  }
+
+  struct Event* event = get_event_with_delay(event_id);
+
+  if (event == NULL) {
+    pthread_rwlock_unlock(&event_list->rwl);
+    lock_printf();
+    fprintf(stderr, "Event not found\n");
+    unlock_printf();
+    return 1;
   }
 
+  remove_from_list(event_list, event);
+  event_list->num_events--;
+  uint64_t lsn = wal_enabled ? log_delete(event_id) : 0;
+
+  // Reservations that already found the event fail once they get their stripes
+  lock_event(event);
+  event->deleted = 1;
+  unlock_event(event);
+
+  // Its holds are left to expire: they are of a generation no later event has, so none can free its seats
+
+  pthread_rwlock_unlock(&event_list->rwl);
+  atomic_fetch_add_explicit(&state_changes, 1, memory_order_relaxed);
+
+  // The event is only freed once the reservations and shows that found it have finished
+  retire_event(event);
+  epoch_reclaim();
+
+  if (wal_enabled && wait_logged(lsn) != 0) {
+    lock_printf();
+    fprintf(stderr, "Error writing to log\n");
+    unlock_printf();
+    return 1;
+  }
 
-  pthread_mutex_unlock(&event->mutex);
   return 0;
 }
 
 void* ems_show(unsigned int event_id) {
+  if (owners_route(event_id)) {
+    struct OwnedCall call = {.op = OWNED_SHOW, .event_id = event_id};
+    owners_call(event_id, run_owned, &call);
+    return call.response;
+  }
+
   int* error_return = malloc(sizeof(int));
   if(error_return == NULL){
     lock_printf();
@@ -234,28 +1700,23 @@ void* ems_show(unsigned int event_id) {
     return (void*)error_return;
   }
 
-  if (pthread_rwlock_rdlock(&event_list->rwl) != 0) {
-    lock_printf();
-    fprintf(stderr, "Error locking list rwl\n");
-    unlock_printf();
-    return (void*)error_return;
-  }
-
-  struct Event* event = get_event_with_delay(event_id, event_list->head, event_list->tail);
+  if (enter_epoch()) return (void*)error_return;
 
-  pthread_rwlock_unlock(&event_list->rwl);
+  struct Event* event = get_event_with_delay(event_id);
 
   if (event == NULL) {
+    epoch_exit();
     lock_printf();
     fprintf(stderr, "Event not found\n");
     unlock_printf();
     return (void*)error_return;
   }
-  size_t buf_size = sizeof(int)+2*sizeof(size_t)+sizeof(unsigned int)*event->rows*event->cols;
+  size_t buf_size = sizeof(int)+2*sizeof(size_t)+sizeof(uint64_t)+sizeof(unsigned int)*event->rows*event->cols;
   int default_return = 0;
   
   void* buf = malloc(buf_size);
   if (buf == NULL) {
+    epoch_exit();
     lock_printf();
     fprintf(stderr, "Error reallocating memory for buffer\n");
     unlock_printf();
@@ -265,7 +1726,34 @@ void* ems_show(unsigned int event_id) {
   store_data(buf,&default_return,sizeof(int));
   store_data(buf + sizeof(int), &event->rows, sizeof(size_t));
   store_data(buf + sizeof(int) + sizeof(size_t), &event->cols, sizeof(size_t));
-  store_data(buf + sizeof(int) + 2*sizeof(size_t), event->data, sizeof(unsigned int)*event->rows*event->cols);
+
+  // The seats are copied without any lock and copied again if a reservation or a widening overlapped the
+  // copy, so SHOW does not block reservations. The epoch keeps a grid replaced by a widening alive meanwhile.
+  // Seats always go over the wire as unsigned ints, whatever the width of the grid.
+  unsigned int* seats = (unsigned int*)(buf + sizeof(int) + 2 * sizeof(size_t) + sizeof(uint64_t));
+  uint64_t version = 0;
+  int copied = 0;
+  for (int attempt = 0; attempt < SHOW_MAX_ATTEMPTS && !copied; attempt++) {
+    unsigned long token;
+    if (read_seats_begin(event, &token)) break;
+    // A grid and a width read across a widening do not match, so they are checked before the copy
+    void** data = event->data;
+    unsigned int width = event->width;
+    if (read_seats_retry(event, token)) continue;
+    version = atomic_load_explicit(&event->version, memory_order_relaxed);
+    seatgrid_load(data, width, 0, event->rows * event->cols, seats);
+    copied = !read_seats_retry(event, token);
+  }
+  if (!copied) {
+    // Writers kept overlapping the copies, so the seats are copied with the event locked instead, which they
+    // queue behind
+    lock_event(event);
+    version = atomic_load_explicit(&event->version, memory_order_relaxed);
+    seatgrid_load(event->data, event->width, 0, event->rows * event->cols, seats);
+    unlock_event(event);
+  }
+  store_data(buf + sizeof(int) + 2 * sizeof(size_t), &version, sizeof(uint64_t));
+  epoch_exit();
   
   
   free(error_return);
@@ -295,54 +1783,91 @@ void* ems_list_events(){
     return (void*)error_return;
   }
 
-  struct ListNode* to = event_list->tail;
-  struct ListNode* current = event_list->head;
-  unsigned int* ids = malloc(sizeof(unsigned int) * event_list->num_events);
-  if (ids == NULL) {
+  size_t num_events;
+  const unsigned int* ids = list_ids(event_list, 0, &num_events);
+
+  size_t buf_size = sizeof(int)+sizeof(size_t)+sizeof(unsigned int) * num_events;
+  void* buf = malloc(buf_size);
+  if (buf == NULL) {
+    lock_printf();
+    fprintf(stderr, "Error reallocating memory for buffer\n");
+    unlock_printf();
+    pthread_rwlock_unlock(&event_list->rwl);
+    return (void*)error_return;
+  }
+  int default_return = 0;
+
+  store_data(buf,&default_return,sizeof(int));
+  store_data(buf + sizeof(int), &num_events, sizeof(size_t));
+  if (num_events > 0) {
+    store_data(buf + sizeof(int) + sizeof(size_t), (void*)ids, sizeof(unsigned int) * num_events);
+  }
+  pthread_rwlock_unlock(&event_list->rwl);
+
+  free(error_return);
+  return buf;
+}
+
+void* ems_list_page(unsigned int cursor, size_t limit){
+  int* error_return = malloc(sizeof(int));
+  if(error_return == NULL){
+    lock_printf();
+    fprintf(stderr, "Error allocating memory for error_return\n");
+    unlock_printf();
+    return NULL;
+  }
+  *error_return = 1;
+
+  if (event_list == NULL) {
     lock_printf();
-    fprintf(stderr, "Error allocating memory for ids\n");
+    fprintf(stderr, "EMS state must be initialized\n");
     unlock_printf();
     return (void*)error_return;
   }
 
-  size_t buf_size = sizeof(int)+sizeof(size_t)+sizeof(unsigned int) * event_list->num_events;
+  // The page buffer is bounded no matter how many events there are
+  if (limit == 0 || limit > MAX_LIST_PAGE_SIZE) {
+    limit = MAX_LIST_PAGE_SIZE;
+  }
+  size_t buf_size = sizeof(int) + sizeof(size_t) + sizeof(int) + sizeof(unsigned int) * limit;
   void* buf = malloc(buf_size);
   if (buf == NULL) {
     lock_printf();
-    fprintf(stderr, "Error reallocating memory for buffer\n");
+    fprintf(stderr, "Error allocating memory for buffer\n");
     unlock_printf();
-    free(ids);
     return (void*)error_return;
   }
-  int default_return = 0;
 
-  store_data(buf,&default_return,sizeof(int));
-  store_data(buf + sizeof(int), &event_list->num_events, sizeof(size_t));
-  
-  if(event_list->num_events == 0){
-    free(error_return);
-    free(ids);
-    return buf;
+  if (pthread_rwlock_rdlock(&event_list->rwl) != 0) {
+    lock_printf();
+    fprintf(stderr, "Error locking list rwl\n");
+    unlock_printf();
+    free(buf);
+    return (void*)error_return;
   }
-  int i = 0;
 
-  while (1) {
-    ids[i] = current->event->id;
-    if (current == to) {
-      break;
-    }
-    current = current->next;
-    i++;
+  // The lock is only held to copy one page of ids
+  size_t remaining;
+  const unsigned int* ids = list_ids(event_list, cursor, &remaining);
+  size_t num_events = remaining < limit ? remaining : limit;
+  int more = remaining > limit;
+  if (num_events > 0) {
+    store_data(buf + sizeof(int) + sizeof(size_t) + sizeof(int), (void*)ids, sizeof(unsigned int) * num_events);
   }
-  store_data(buf + sizeof(int) + sizeof(size_t), ids, sizeof(unsigned int) * event_list->num_events);
+  pthread_rwlock_unlock(&event_list->rwl);
+
+  int default_return = 0;
+  store_data(buf, &default_return, sizeof(int));
+  store_data(buf + sizeof(int), &num_events, sizeof(size_t));
+  store_data(buf + sizeof(int) + sizeof(size_t), &more, sizeof(int));
 
   free(error_return);
-  free(ids);
-  pthread_rwlock_unlock(&event_list->rwl);
   return buf;
 }
 
-int ems_show_all(){
+/// Prints all the events (see ems_show_all).
+/// @note With owner threads, every owner must be parked.
+static int show_all(){
   
 
   if (event_list == NULL) {
@@ -356,11 +1881,15 @@ int ems_show_all(){
 
   struct ListNode* to = event_list->tail;
   struct ListNode* current = event_list->head;
-  struct ListNode* temp = event_list->head;
-  while(temp!= NULL){
-    pthread_mutex_lock(&temp->event->mutex);
-    temp = temp->next;  
+  // Events are locked in ascending order of id, as bundles lock them (see reserve_multi), so a dump cannot wait
+  // for a bundle that waits for it
+  if (enter_epoch()) {
+    pthread_rwlock_unlock(&event_list->rwl);
+    return 1;
   }
+  size_t num_ids;
+  const unsigned int* ids = list_ids(event_list, 0, &num_ids);
+  for (size_t i = 0; i < num_ids; i++) lock_event(get_event(event_list, ids[i]));
   // Usamos o lock_printf no decorrer da função de modo a que o print para 
   // o output no caso do SIGUSR1 seja atómico
   lock_printf();
@@ -377,11 +1906,11 @@ int ems_show_all(){
     }
 
     int stop = 0;
-    unsigned int* event_data = current->event->data;
-    for (size_t i = 1; i <= current->event->rows; i++) {
-      for (size_t j = 1; j <= current->event->cols; j++) {
+    struct Event* event = current->event;
+    for (size_t i = 1; i <= event->rows; i++) {
+      for (size_t j = 1; j <= event->cols; j++) {
         char buffer[16];
-        sprintf(buffer, "%u", event_data[seat_index(current->event, i, j)]);
+        sprintf(buffer, "%u", seatgrid_get(event->data, event->width, seat_index(event, i, j)));
 
         if (print_str(STDOUT_FILENO, buffer)) {
           perror("Error writing to file descriptor");          
@@ -389,7 +1918,7 @@ int ems_show_all(){
           break;
         }
 
-        if (j < current->event->cols) {
+        if (j < event->cols) {
           if (print_str(STDOUT_FILENO, " ")) {
             perror("Error writing to file descriptor");  
             stop = 1;
@@ -418,13 +1947,74 @@ int ems_show_all(){
     it++;
   }
   unlock_printf();
-  temp = event_list->head;
-  while(temp != NULL){
-    pthread_mutex_unlock(&temp->event->mutex);
-    temp = temp->next;  
-  }
+  for (size_t i = num_ids; i-- > 0;) unlock_event(get_event(event_list, ids[i]));
+  epoch_exit();
   pthread_rwlock_unlock(&event_list->rwl); 
   
   return 0;
 }
 
+int ems_show_all() {
+  struct OwnedCall call = {.op = OWNED_SHOW_ALL};
+  owners_call_parked(NULL, 0, run_owned, &call);
+  return call.result;
+}
+
+int ems_show_alloc_stats(int out_fd) {
+  struct AllocStats stats;
+  alloc_get_stats(&stats);
+
+  char buf[256];
+  snprintf(buf, sizeof(buf),
+           "Allocations: %lu slab objects from %lu blocks, %lu arena grids from %lu chunks (%zu bytes), %lu recycled grids\n",
+           stats.slab_allocs, stats.slab_blocks, stats.arena_allocs, stats.arena_chunks, stats.arena_bytes,
+           stats.arena_reused);
+
+  lock_printf();
+  int ret = print_str(out_fd, buf);
+  unlock_printf();
+  return ret;
+}
+
+/// Runs an operation handed to the owners (see struct OwnedCall).
+/// @param arg Operation.
+static void run_owned(void* arg) {
+  struct OwnedCall* call = arg;
+  owned_call = call;
+  switch (call->op) {
+    case OWNED_CREATE:
+      call->result = ems_create(call->event_id, call->num_rows, call->num_cols, call->num_stripes);
+      break;
+    case OWNED_RESERVE:
+      call->result = ems_reserve(call->event_id, call->num_seats, call->xs, call->ys);
+      break;
+    case OWNED_RESERVE_MULTI:
+      call->result = reserve_multi(call->num_events, call->event_ids, call->seat_counts, call->xs, call->ys);
+      break;
+    case OWNED_RESERVE_BEST:
+      call->result = ems_reserve_best(call->event_id, call->num_seats, call->xs, call->ys);
+      break;
+    case OWNED_HOLD:
+      call->result = ems_hold(call->event_id, call->seconds, call->num_seats, call->xs, call->ys, call->hold_id);
+      break;
+    case OWNED_CONFIRM:
+      call->result = ems_confirm(call->event_id, call->id);
+      break;
+    case OWNED_CANCEL:
+      call->result = ems_cancel(call->event_id, call->id);
+      break;
+    case OWNED_DELETE:
+      call->result = ems_delete(call->event_id);
+      break;
+    case OWNED_SHOW:
+      call->response = ems_show(call->event_id);
+      break;
+    case OWNED_SHOW_ALL:
+      call->result = show_all();
+      break;
+    case OWNED_EXPIRE:
+      expire_hold(call->hold);
+      break;
+  }
+  owned_call = NULL;
+}
@@ -3,10 +3,49 @@
 
 #include <stddef.h>
 
+// How ems_reserve keeps reservations of the same seats apart
+enum ReserveMode {
+  RESERVE_LOCKED,  // Locks the stripes of the requested rows, then checks and writes the seats
+  RESERVE_CAS,     // Claims each seat with a CAS and gives the claimed seats back on a conflict, without locks
+};
+
 /// Initializes the EMS state.
+/// @note With a snapshot file, the events saved in it and in its incremental checkpoints are loaded, and
+/// checkpoints of the changes are written periodically in the background and on ems_terminate. With a log file, the changes logged after that
+/// snapshot are replayed, and creates, reservations and deletes are only acknowledged once logged.
 /// @param delay_us Delay in microseconds.
+/// @param snapshot_file Path of the snapshot file, NULL to keep the state in memory only.
+/// @param wal_file Path of the write-ahead log, NULL to not log changes.
 /// @return 0 if the EMS state was initialized successfully, 1 otherwise.
-int ems_init(unsigned int delay_us);
+int ems_init(unsigned int delay_us, const char* snapshot_file, const char* wal_file);
+
+/// Sets how reservations are made, RESERVE_LOCKED by default.
+/// @note Must be called before any reservation is made. With RESERVE_CAS every event is widened to
+/// 4-byte ids on its first reservation, since lock-free claims cannot follow a grid being widened.
+/// @param mode Reservation mode.
+/// @return 0 if the mode was set, 1 if it is not valid.
+int ems_set_reserve_mode(enum ReserveMode mode);
+
+/// Sets whether the seats of events are kept in transparent huge pages, off by default.
+/// @note Must be called before ems_init. Large grids then take fewer page faults and TLB entries, at the cost of
+/// at least one huge page per thread that allocates seats (see alloc_set_huge_pages).
+/// @param enabled Whether to use huge pages.
+void ems_set_huge_pages(int enabled);
+
+/// Sets whether contended events switch to flat combining, on by default.
+/// @note Only RESERVE_LOCKED reservations are combined: an event whose stripes keep being found taken has its
+/// reservations applied in batches by one worker at a time, and goes back to its stripes once the batches stay
+/// down to a single reservation (see reserve_seats).
+/// @param enabled Whether to combine reservations of contended events.
+void ems_set_combining(int enabled);
+
+/// Sets how many owner threads the events are shared out to, none by default.
+/// @note Must be called before ems_init, and only with RESERVE_LOCKED. With owners, each event id hashes to one of
+/// them and every operation on the event is run by its owner (see owners.h), so the stripes of the events are never
+/// locked. RESERVE_MULTI, checkpoints and ems_show_all park the owners of the events they touch instead.
+/// @param count Number of owner threads, at most OWNERS_MAX.
+/// @return 0 if the number was set, 1 if it is too large.
+int ems_set_owners(size_t count);
 
 /// Destroys the EMS state.
 int ems_terminate();
@@ -15,8 +54,10 @@ int ems_terminate();
 /// @param event_id Id of the event to be created.
 /// @param num_rows Number of rows of the event to be created.
 /// @param num_cols Number of columns of the event to be created.
+/// @param num_stripes Number of row stripes, which reservations of different stripes run in parallel, 0 for the
+/// default (see create_event). Saved with the event, so it outlives restarts.
 /// @return 0 if the event was created successfully, 1 otherwise.
-int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols);
+int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols, size_t num_stripes);
 
 /// Creates a new reservation for the given event.
 /// @param event_id Id of the event to create a reservation for.
@@ -26,10 +67,69 @@ int ems_create(unsigned int event_id, size_t num_rows, size_t num_cols);
 /// @return 0 if the reservation was created successfully, 1 otherwise.
 int ems_reserve(unsigned int event_id, size_t num_seats, size_t *xs, size_t *ys);
 
-/// Prints the given event.
-/// @param out_fd File descriptor to print the event to.
+/// Creates a reservation in each of several events, all of them or none.
+/// @note The events are locked in ascending order of id, whatever their order in the request, and every seat set
+/// is checked before any is written, so the cost grows with the number of seats and never retries. The
+/// reservations are logged as a single record, so a restart keeps all of them or none.
+/// @param num_events Number of events, at most MAX_MULTI_EVENTS, none repeated.
+/// @param event_ids Array of ids of the events.
+/// @param num_seats Array of numbers of seats to reserve in each event.
+/// @param xs Array of rows of the seats to reserve, those of each event after those of the event before it.
+/// @param ys Array of columns of the seats to reserve, in the same order as xs.
+/// @return 0 if every reservation was created successfully, 1 otherwise.
+int ems_reserve_multi(size_t num_events, unsigned int *event_ids, size_t *num_seats, size_t *xs, size_t *ys);
+
+/// Reserves adjacent seats of the given event wherever they are free, preferring front rows.
+/// @note The seats are the leftmost run of free seats of the first row that has one. Rows are ruled out by
+/// their availability summaries (see find_free_row), so the search reads one summary per row and the seats of
+/// a single row, not the whole grid.
+/// @param event_id Id of the event to create a reservation for.
+/// @param num_seats Number of adjacent seats to reserve.
+/// @param xs Where to store the rows of the reserved seats, num_seats of them.
+/// @param ys Where to store the columns of the reserved seats, num_seats of them.
+/// @return 0 if the reservation was created successfully, 1 otherwise.
+int ems_reserve_best(unsigned int event_id, size_t num_seats, size_t *xs, size_t *ys);
+
+/// Holds seats of the given event for a while, so they are reserved for nobody else until confirmed.
+/// @note The held seats get a reservation id like a reservation, and are marked as held in a bitmap next to the
+/// occupancy bitmap. They are freed by the expiry thread once the time runs out (see holds.h). Holds are not
+/// logged and checkpoints save their seats as free, so a restart frees them too.
+/// @param event_id Id of the event to hold seats of.
+/// @param seconds Seconds until the hold expires, at most MAX_HOLD_SECONDS.
+/// @param num_seats Number of seats to hold.
+/// @param xs Array of rows of the seats to hold.
+/// @param ys Array of columns of the seats to hold.
+/// @param hold_id Where to store the id of the hold, which is the reservation id of the seats.
+/// @return 0 if the seats were held successfully, 1 otherwise.
+int ems_hold(unsigned int event_id, unsigned int seconds, size_t num_seats, size_t *xs, size_t *ys,
+             unsigned int *hold_id);
+
+/// Turns a hold that has not expired into a reservation, with the same id.
+/// @param event_id Id of the event of the hold.
+/// @param hold_id Id of the hold.
+/// @return 0 if the hold was confirmed successfully, 1 otherwise.
+int ems_confirm(unsigned int event_id, unsigned int hold_id);
+
+/// Cancels a reservation, or a hold that has not expired, freeing its seats.
+/// @note Only the seats of the reservation are touched: they are found in a reverse index of the event, built
+/// from its seats on the first cancel and kept up to date by the reservations after it.
+/// @param event_id Id of the event of the reservation.
+/// @param reservation_id Id of the reservation (or of the hold).
+/// @return 0 if the reservation was cancelled successfully, 1 otherwise.
+int ems_cancel(unsigned int event_id, unsigned int reservation_id);
+
+/// Deletes the event with the given id.
+/// @note The event is freed once the concurrent reservations and shows that found it have finished,
+/// and its seats are reused by later events of the same size.
+/// @param event_id Id of the event to delete.
+/// @return 0 if the event was deleted successfully, 1 otherwise.
+int ems_delete(unsigned int event_id);
+
+/// Copies the seats of the given event into a SHOW response.
+/// @note The copy is consistent without blocking reservations (see read_seats_begin).
 /// @param event_id Id of the event to print.
-/// @return 0 if the event was printed successfully, 1 otherwise.
+/// @return Response to be freed by the caller: the int result, then on success the rows and columns
+/// (size_t), the version of the seats (uint64_t) and their reservation ids (unsigned int). NULL on failure.
 void* ems_show(unsigned int event_id);
 
 /// Prints all the events.
@@ -37,7 +137,18 @@ void* ems_show(unsigned int event_id);
 /// @return 0 if the events were printed successfully, 1 otherwise.
 void* ems_list_events();
 
+/// Lists one page of event ids, in ascending order.
+/// @param cursor Smallest id to be listed.
+/// @param limit Maximum number of ids to list, capped (as is 0) at MAX_LIST_PAGE_SIZE.
+/// @return Buffer with the return value, the number of ids, whether more ids follow the page and the ids.
+void* ems_list_page(unsigned int cursor, size_t limit);
+
 int ems_show_all();
 
+/// Prints the allocation counters of the EMS state.
+/// @param out_fd File descriptor to print the counters to.
+/// @return 0 if the counters were printed successfully, 1 otherwise.
+int ems_show_alloc_stats(int out_fd);
+
 
 #endif  // SERVER_OPERATIONS_H
@@ -0,0 +1,218 @@
+#define _GNU_SOURCE  // pthread_setaffinity_np
+
+#include "owners.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "alloc.h"
+#include "common/io.h"
+
+enum OwnerOp {
+  OWNER_CALL,  // Runs a function
+  OWNER_PARK,  // Waits until the thread that parked the owner lets it go on
+  OWNER_STOP,  // Ends the owner thread
+};
+
+// Operation posted to an owner, on the stack of the thread waiting for it
+struct OwnerMessage {
+  struct OwnerMessage* _Atomic next;  // Message posted after this one
+  enum OwnerOp op;
+  void (*fn)(void* arg);  // Function of a call
+  void* arg;              // Argument of the function
+  sem_t done;             // Posted once a call returned, and once a park has started and again once it ended
+  sem_t resume;           // Posted to end a park
+};
+
+// Owner thread and its queue. The producers only write the head, and only the owner reads the tail, so each gets
+// a line of its own.
+struct Owner {
+  _Alignas(CACHE_LINE_SIZE) struct OwnerMessage* _Atomic head;  // Newest message, swapped in by producers
+  _Alignas(CACHE_LINE_SIZE) struct OwnerMessage* tail;          // Oldest message not handled yet, or the stub
+  struct OwnerMessage stub;  // Placeholder that keeps the queue from ever being empty of nodes
+  sem_t pending;             // Posted once per message
+  pthread_t thread;
+};
+
+static struct Owner owners[OWNERS_MAX];
+static size_t num_owners = 0;  // Owner threads running, 0 if operations run in their callers
+
+static _Thread_local struct Owner* current_owner = NULL;  // Owner the calling thread is, if any
+static _Thread_local int parking = 0;  // Whether the calling thread runs a function with owners parked
+
+/// Finds the owner of a key.
+/// @param key Key.
+/// @return Index of the owner of the key.
+static size_t owner_index(unsigned int key) {
+  uint64_t hash = (uint64_t)key * 0x9e3779b97f4a7c15ull;
+  return (hash >> 32) % num_owners;
+}
+
+/// Adds a message to the queue of an owner.
+/// @note The message is linked to the one before it only after the exchange, so the owner may briefly see the
+/// queue as shorter than the count of its semaphore (see pop_message).
+/// @param owner Owner to post to.
+/// @param message Message to post.
+static void push_message(struct Owner* owner, struct OwnerMessage* message) {
+  atomic_store_explicit(&message->next, NULL, memory_order_relaxed);
+  struct OwnerMessage* previous = atomic_exchange_explicit(&owner->head, message, memory_order_acq_rel);
+  atomic_store_explicit(&previous->next, message, memory_order_release);
+  sem_post(&owner->pending);
+}
+
+/// Takes the oldest message of the queue of an owner.
+/// @note Only called by the owner thread.
+/// @param owner Owner of the queue.
+/// @return Oldest message, NULL if none is linked yet.
+static struct OwnerMessage* pop_message(struct Owner* owner) {
+  struct OwnerMessage* tail = owner->tail;
+  struct OwnerMessage* next = atomic_load_explicit(&tail->next, memory_order_acquire);
+  if (tail == &owner->stub) {
+    if (next == NULL) return NULL;
+    owner->tail = next;
+    tail = next;
+    next = atomic_load_explicit(&tail->next, memory_order_acquire);
+  }
+  if (next != NULL) {
+    owner->tail = next;
+    return tail;
+  }
+
+  // The tail is the last message linked: the stub goes behind it, so it can be taken without the queue ever
+  // being left without a node
+  if (tail != atomic_load_explicit(&owner->head, memory_order_acquire)) return NULL;
+  push_message(owner, &owner->stub);
+  sem_wait(&owner->pending);  // The stub is not a message
+  next = atomic_load_explicit(&tail->next, memory_order_acquire);
+  if (next == NULL) return NULL;
+  owner->tail = next;
+  return tail;
+}
+
+/// Runs the messages posted to an owner, in the order they were posted, until it is stopped.
+/// @param arg Owner.
+/// @return NULL.
+static void* owner_thread_function(void* arg) {
+  struct Owner* owner = arg;
+  current_owner = owner;
+
+  block_sigusr1();
+
+  while (1) {
+    sem_wait(&owner->pending);
+    struct OwnerMessage* message;
+    // A producer between its exchange and its link has been counted but cannot be reached yet
+    while ((message = pop_message(owner)) == NULL) sched_yield();
+
+    switch (message->op) {
+      case OWNER_CALL:
+        message->fn(message->arg);
+        sem_post(&message->done);
+        break;
+      case OWNER_PARK:
+        sem_post(&message->done);
+        sem_wait(&message->resume);
+        // The parking thread waits for this before it destroys the message
+        sem_post(&message->done);
+        break;
+      case OWNER_STOP:
+        return NULL;
+    }
+  }
+}
+
+int owners_start(size_t count) {
+  if (count > OWNERS_MAX) return 1;
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+  for (size_t i = 0; i < count; i++) {
+    struct Owner* owner = &owners[i];
+    atomic_init(&owner->stub.next, NULL);
+    atomic_init(&owner->head, &owner->stub);
+    owner->tail = &owner->stub;
+    if (sem_init(&owner->pending, 0, 0) != 0) {
+      num_owners = i;
+      owners_stop();
+      return 1;
+    }
+    if (pthread_create(&owner->thread, NULL, owner_thread_function, owner) != 0) {
+      sem_destroy(&owner->pending);
+      num_owners = i;
+      owners_stop();
+      return 1;
+    }
+
+    // Each owner keeps to one core, so the state of its keys stays in that core's cache
+    if (cpus > 0) {
+      cpu_set_t cpu;
+      CPU_ZERO(&cpu);
+      CPU_SET(i % (size_t)cpus, &cpu);
+      pthread_setaffinity_np(owner->thread, sizeof(cpu), &cpu);
+    }
+  }
+  num_owners = count;
+  return 0;
+}
+
+void owners_stop() {
+  for (size_t i = 0; i < num_owners; i++) {
+    struct OwnerMessage stop = {.op = OWNER_STOP};
+    push_message(&owners[i], &stop);
+    pthread_join(owners[i].thread, NULL);
+    sem_destroy(&owners[i].pending);
+  }
+  num_owners = 0;
+}
+
+int owners_route(unsigned int key) {
+  return num_owners != 0 && !parking && current_owner != &owners[owner_index(key)];
+}
+
+void owners_call(unsigned int key, void (*fn)(void* arg), void* arg) {
+  struct OwnerMessage message = {.op = OWNER_CALL, .fn = fn, .arg = arg};
+  sem_init(&message.done, 0, 0);
+  push_message(&owners[owner_index(key)], &message);
+  while (sem_wait(&message.done) != 0) continue;  // Interrupted by a signal
+  sem_destroy(&message.done);
+}
+
+void owners_call_parked(const unsigned int* keys, size_t count, void (*fn)(void* arg), void* arg) {
+  if (num_owners == 0 || parking) {
+    fn(arg);
+    return;
+  }
+
+  int parked[OWNERS_MAX] = {0};
+  for (size_t i = 0; i < (keys == NULL ? num_owners : count); i++) {
+    size_t index = keys == NULL ? i : owner_index(keys[i]);
+    parked[index] = &owners[index] != current_owner;
+  }
+
+  // In ascending order, and each one parked before the next is asked, so parks of overlapping sets never wait for
+  // each other in a cycle
+  struct OwnerMessage parks[OWNERS_MAX];
+  for (size_t i = 0; i < num_owners; i++) {
+    if (!parked[i]) continue;
+    parks[i].op = OWNER_PARK;
+    sem_init(&parks[i].done, 0, 0);
+    sem_init(&parks[i].resume, 0, 0);
+    push_message(&owners[i], &parks[i]);
+    while (sem_wait(&parks[i].done) != 0) continue;
+  }
+
+  parking = 1;
+  fn(arg);
+  parking = 0;
+
+  for (size_t i = 0; i < num_owners; i++) {
+    if (!parked[i]) continue;
+    sem_post(&parks[i].resume);
+    while (sem_wait(&parks[i].done) != 0) continue;
+    sem_destroy(&parks[i].done);
+    sem_destroy(&parks[i].resume);
+  }
+}
@@ -0,0 +1,46 @@
+#ifndef SERVER_OWNERS_H
+#define SERVER_OWNERS_H
+
+#include <stddef.h>
+
+/// Shard-owned execution.
+/// Each key (an event id) hashes to one of a fixed set of owner threads, and the operations on a key are posted as
+/// calls to the queue of its owner instead of being run by the thread that wants them. Everything a key guards is
+/// then only touched by one thread, without locks, and stays in the cache of that thread's core. Each owner has a
+/// lock-free queue with many producers and one consumer: posting a call is a single atomic exchange.
+/// Operations on several keys (or on all of them) park their owners instead, always in ascending order so two of
+/// them cannot wait for each other, and run in the calling thread while the owners wait.
+
+#define OWNERS_MAX 64  // Most owner threads
+
+/// Starts the owner threads.
+/// @param count Number of owner threads, at most OWNERS_MAX, 0 to run every operation in its caller.
+/// @return 0 if the threads were started, 1 otherwise (in which case none is left running).
+int owners_start(size_t count);
+
+/// Stops the owner threads once every call already posted was run.
+/// @note No call may be posted during or after this one.
+void owners_stop();
+
+/// Checks whether an operation on a key must be posted to its owner.
+/// @param key Key of the operation.
+/// @return 1 if owners are running and the calling thread is neither the owner of the key nor running with it
+/// parked, 0 if the operation can run in the calling thread.
+int owners_route(unsigned int key);
+
+/// Runs a function in the owner thread of a key and waits until it returned.
+/// @param key Key the function operates on.
+/// @param fn Function to run.
+/// @param arg Argument of the function, which must stay valid until this returns.
+void owners_call(unsigned int key, void (*fn)(void* arg), void* arg);
+
+/// Runs a function in the calling thread while the owners of a set of keys wait, once done with the calls posted
+/// before.
+/// @note Without owners the function just runs.
+/// @param keys Keys the function operates on, NULL for every owner.
+/// @param count Number of keys.
+/// @param fn Function to run.
+/// @param arg Argument of the function.
+void owners_call_parked(const unsigned int* keys, size_t count, void (*fn)(void* arg), void* arg);
+
+#endif  // SERVER_OWNERS_H
@@ -0,0 +1,243 @@
+#include "seatgrid.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "alloc.h"
+
+unsigned int seat_width_for(unsigned int reservation_id) {
+  if (reservation_id <= UINT8_MAX) return 1;
+  if (reservation_id <= UINT16_MAX) return 2;
+  return 4;
+}
+
+/// Calculates the number of seats of each tile of a grid.
+/// @param num_seats Number of seats of the grid.
+/// @return Seats per tile, at least 1.
+static size_t tile_seats(size_t num_seats) {
+  if (num_seats == 0) return 1;
+  return num_seats < SEAT_TILE_SEATS ? num_seats : SEAT_TILE_SEATS;
+}
+
+size_t seatgrid_tiles(size_t num_seats) {
+  return num_seats == 0 ? 1 : (num_seats + SEAT_TILE_SEATS - 1) / SEAT_TILE_SEATS;
+}
+
+size_t seatgrid_tile_size(size_t num_seats, unsigned int width) { return tile_seats(num_seats) * width; }
+
+/// Gets the tile of a seat.
+/// @note Tiles may be installed by writers of other stripes at any time, so the pointer is read atomically.
+/// @param grid Directory of the grid.
+/// @param seat Index of the seat.
+/// @return Tile of the seat, NULL if it is not allocated.
+static void* tile_of(void* const* grid, size_t seat) {
+  return __atomic_load_n(&grid[seat / SEAT_TILE_SEATS], __ATOMIC_ACQUIRE);
+}
+
+void** seatgrid_create(size_t num_seats) { return arena_alloc(seatgrid_tiles(num_seats) * sizeof(void*)); }
+
+void seatgrid_release(void** grid, unsigned int width, size_t num_seats) {
+  if (grid == NULL) return;
+  size_t num_tiles = seatgrid_tiles(num_seats);
+  for (size_t i = 0; i < num_tiles; i++) arena_recycle(grid[i], seatgrid_tile_size(num_seats, width));
+  arena_recycle(grid, num_tiles * sizeof(void*));
+}
+
+/// Allocates a tile if it is not allocated yet.
+/// @param grid Directory of the grid.
+/// @param width Bytes per seat.
+/// @param num_seats Number of seats of the grid.
+/// @param tile Index of the tile.
+/// @return The tile, NULL on allocation failure.
+static void* materialize_tile(void** grid, unsigned int width, size_t num_seats, size_t tile) {
+  void* current = __atomic_load_n(&grid[tile], __ATOMIC_ACQUIRE);
+  if (current != NULL) return current;
+
+  // Arena memory is zeroed, which is every seat free
+  void* fresh = arena_alloc(seatgrid_tile_size(num_seats, width));
+  if (fresh == NULL) return NULL;
+  if (__atomic_compare_exchange_n(&grid[tile], &current, fresh, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    return fresh;
+  }
+  arena_recycle(fresh, seatgrid_tile_size(num_seats, width));
+  return current;
+}
+
+int seatgrid_materialize(void** grid, unsigned int width, size_t num_seats, const size_t* seats, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    if (materialize_tile(grid, width, num_seats, seats[i] / SEAT_TILE_SEATS) == NULL) return 1;
+  }
+  return 0;
+}
+
+const void* seatgrid_tile(void* const* grid, size_t tile) { return tile_of(grid, tile * SEAT_TILE_SEATS); }
+
+void seatgrid_attach(void** grid, size_t tile, void* seats) { grid[tile] = seats; }
+
+size_t seatgrid_used_tiles(void* const* grid, size_t num_seats) {
+  size_t used = 0;
+  for (size_t i = 0; i < seatgrid_tiles(num_seats); i++) used += seatgrid_tile(grid, i) != NULL;
+  return used;
+}
+
+unsigned int seatgrid_get(void* const* grid, unsigned int width, size_t seat) {
+  const void* tile = tile_of(grid, seat);
+  if (tile == NULL) return 0;
+  seat %= SEAT_TILE_SEATS;
+  if (width == 1) return ((const uint8_t*)tile)[seat];
+  if (width == 2) return ((const uint16_t*)tile)[seat];
+  return ((const unsigned int*)tile)[seat];
+}
+
+void seatgrid_set(void** grid, unsigned int width, size_t seat, unsigned int reservation_id) {
+  void* tile = tile_of(grid, seat);
+  if (tile == NULL) return;  // Only 0 may be written to a free tile, and it already reads as 0
+  seat %= SEAT_TILE_SEATS;
+
+  // Relaxed stores cost the same as plain ones, and let seatgrid_load read the grid without a lock
+  if (width == 1) {
+    __atomic_store_n((uint8_t*)tile + seat, (uint8_t)reservation_id, __ATOMIC_RELAXED);
+  } else if (width == 2) {
+    __atomic_store_n((uint16_t*)tile + seat, (uint16_t)reservation_id, __ATOMIC_RELAXED);
+  } else {
+    __atomic_store_n((unsigned int*)tile + seat, reservation_id, __ATOMIC_RELAXED);
+  }
+}
+
+int seatgrid_cas(void** grid, unsigned int width, size_t seat, unsigned int expected, unsigned int reservation_id) {
+  void* tile = tile_of(grid, seat);
+  seat %= SEAT_TILE_SEATS;
+  if (width == 1) {
+    uint8_t old = (uint8_t)expected;
+    return __atomic_compare_exchange_n((uint8_t*)tile + seat, &old, (uint8_t)reservation_id, 0, __ATOMIC_ACQ_REL,
+                                       __ATOMIC_RELAXED);
+  }
+  if (width == 2) {
+    uint16_t old = (uint16_t)expected;
+    return __atomic_compare_exchange_n((uint16_t*)tile + seat, &old, (uint16_t)reservation_id, 0, __ATOMIC_ACQ_REL,
+                                       __ATOMIC_RELAXED);
+  }
+  return __atomic_compare_exchange_n((unsigned int*)tile + seat, &expected, reservation_id, 0, __ATOMIC_ACQ_REL,
+                                     __ATOMIC_RELAXED);
+}
+
+/// Reads a range of seats of a single tile.
+static void read_tile(const void* tile, unsigned int width, size_t first, size_t count, unsigned int* ids) {
+  if (width == 1) {
+    const uint8_t* seats = (const uint8_t*)tile + first;
+    for (size_t i = 0; i < count; i++) ids[i] = seats[i];
+  } else if (width == 2) {
+    const uint16_t* seats = (const uint16_t*)tile + first;
+    for (size_t i = 0; i < count; i++) ids[i] = seats[i];
+  } else {
+    memcpy(ids, (const unsigned int*)tile + first, count * sizeof(unsigned int));
+  }
+}
+
+/// Reads a range of seats of a single tile while they may be written.
+static void load_tile(const void* tile, unsigned int width, size_t first, size_t count, unsigned int* ids) {
+  if (width == 1) {
+    const uint8_t* seats = (const uint8_t*)tile + first;
+    for (size_t i = 0; i < count; i++) ids[i] = __atomic_load_n(seats + i, __ATOMIC_RELAXED);
+  } else if (width == 2) {
+    const uint16_t* seats = (const uint16_t*)tile + first;
+    for (size_t i = 0; i < count; i++) ids[i] = __atomic_load_n(seats + i, __ATOMIC_RELAXED);
+  } else {
+    const unsigned int* seats = (const unsigned int*)tile + first;
+    for (size_t i = 0; i < count; i++) ids[i] = __atomic_load_n(seats + i, __ATOMIC_RELAXED);
+  }
+}
+
+/// Writes a range of seats of a single tile.
+static void write_tile(void* tile, unsigned int width, size_t first, size_t count, const unsigned int* ids) {
+  if (width == 1) {
+    uint8_t* seats = (uint8_t*)tile + first;
+    for (size_t i = 0; i < count; i++) seats[i] = (uint8_t)ids[i];
+  } else if (width == 2) {
+    uint16_t* seats = (uint16_t*)tile + first;
+    for (size_t i = 0; i < count; i++) seats[i] = (uint16_t)ids[i];
+  } else {
+    memcpy((unsigned int*)tile + first, ids, count * sizeof(unsigned int));
+  }
+}
+
+/// Calculates how many seats of a range fall in the tile of its first seat.
+/// @param first Index of the first seat of the range.
+/// @param count Number of seats of the range.
+/// @return Seats of the range up to the end of the tile.
+static size_t tile_span(size_t first, size_t count) {
+  size_t rest = SEAT_TILE_SEATS - first % SEAT_TILE_SEATS;
+  return count < rest ? count : rest;
+}
+
+void seatgrid_read(void* const* grid, unsigned int width, size_t first, size_t count, unsigned int* ids) {
+  for (size_t done = 0; done < count;) {
+    size_t span = tile_span(first + done, count - done);
+    const void* tile = tile_of(grid, first + done);
+    if (tile == NULL) {
+      memset(ids + done, 0, span * sizeof(unsigned int));
+    } else {
+      read_tile(tile, width, (first + done) % SEAT_TILE_SEATS, span, ids + done);
+    }
+    done += span;
+  }
+}
+
+void seatgrid_load(void* const* grid, unsigned int width, size_t first, size_t count, unsigned int* ids) {
+  for (size_t done = 0; done < count;) {
+    size_t span = tile_span(first + done, count - done);
+    const void* tile = tile_of(grid, first + done);
+    if (tile == NULL) {
+      memset(ids + done, 0, span * sizeof(unsigned int));
+    } else {
+      load_tile(tile, width, (first + done) % SEAT_TILE_SEATS, span, ids + done);
+    }
+    done += span;
+  }
+}
+
+int seatgrid_write(void** grid, unsigned int width, size_t num_seats, size_t first, size_t count,
+                   const unsigned int* ids) {
+  for (size_t done = 0; done < count;) {
+    size_t span = tile_span(first + done, count - done);
+    void* tile = tile_of(grid, first + done);
+    if (tile == NULL) {
+      // Free seats are left in free tiles, so restoring a sparse grid stays sparse
+      size_t i = 0;
+      while (i < span && ids[done + i] == 0) i++;
+      if (i < span) tile = materialize_tile(grid, width, num_seats, (first + done) / SEAT_TILE_SEATS);
+      if (i < span && tile == NULL) return 1;
+    }
+    if (tile != NULL) write_tile(tile, width, (first + done) % SEAT_TILE_SEATS, span, ids + done);
+    done += span;
+  }
+  return 0;
+}
+
+void** seatgrid_widen(void* const* from, unsigned int from_width, unsigned int to_width, size_t num_seats) {
+  void** to = seatgrid_create(num_seats);
+  if (to == NULL) return NULL;
+
+  size_t seats = tile_seats(num_seats);
+  for (size_t t = 0; t < seatgrid_tiles(num_seats); t++) {
+    const void* tile = seatgrid_tile(from, t);
+    if (tile == NULL) continue;
+    void* wide = arena_alloc(seatgrid_tile_size(num_seats, to_width));
+    if (wide == NULL) {
+      seatgrid_release(to, to_width, num_seats);
+      return NULL;
+    }
+    to[t] = wide;
+
+    if (to_width == from_width) {
+      memcpy(wide, tile, seatgrid_tile_size(num_seats, from_width));
+    } else if (to_width == 2) {
+      for (size_t i = 0; i < seats; i++) ((uint16_t*)wide)[i] = ((const uint8_t*)tile)[i];
+    } else if (from_width == 1) {
+      for (size_t i = 0; i < seats; i++) ((unsigned int*)wide)[i] = ((const uint8_t*)tile)[i];
+    } else {
+      for (size_t i = 0; i < seats; i++) ((unsigned int*)wide)[i] = ((const uint16_t*)tile)[i];
+    }
+  }
+  return to;
+}
@@ -0,0 +1,141 @@
+#ifndef SERVER_SEATGRID_H
+#define SERVER_SEATGRID_H
+
+#include <stddef.h>
+
+/// Seat grids of adaptive width, split into lazily allocated tiles.
+/// A grid stores the reservation id of each seat in 1, 2 or 4 bytes, the fewest that fit every id of its
+/// event: events start with 1-byte ids and are widened (see widen_seats) once their reservations no longer
+/// fit. The seats are split into tiles of SEAT_TILE_SEATS consecutive seats, and the grid itself is a
+/// directory with a pointer to each tile. Tiles are only allocated when a seat of theirs is first reserved:
+/// until then their pointer is NULL, which reads as every seat free. Creating a grid therefore only costs
+/// its directory, and reads of free tiles never allocate them.
+/// Grids are only read and written through the accessors below, which have a loop for each width.
+
+#define SEAT_WIDTH_MAX 4      // Width of an unsigned int, enough for any reservation id
+#define SEAT_TILE_SEATS 4096  // Seats per tile, grids with fewer seats have a single tile of their size
+
+/// Finds the width needed to store a reservation id.
+/// @param reservation_id Reservation id.
+/// @return 1, 2 or 4.
+unsigned int seat_width_for(unsigned int reservation_id);
+
+/// Calculates the number of tiles of a grid.
+/// @param num_seats Number of seats of the grid.
+/// @return Number of tiles, at least 1.
+size_t seatgrid_tiles(size_t num_seats);
+
+/// Calculates the size of each tile of a grid.
+/// @param num_seats Number of seats of the grid.
+/// @param width Bytes per seat.
+/// @return Size of a tile in bytes.
+size_t seatgrid_tile_size(size_t num_seats, unsigned int width);
+
+/// Creates a grid with every seat free. No tile is allocated.
+/// @param num_seats Number of seats.
+/// @return Directory of the grid (from the arena of the calling thread), NULL on failure.
+void** seatgrid_create(size_t num_seats);
+
+/// Gives the tiles and the directory of a grid back to the arenas.
+/// @param grid Directory of the grid, may be NULL.
+/// @param width Bytes per seat.
+/// @param num_seats Number of seats.
+void seatgrid_release(void** grid, unsigned int width, size_t num_seats);
+
+/// Makes sure the tiles of a set of seats are allocated, so ids can be stored in them.
+/// @note Tiles span several rows, so writers of different stripes may allocate the same tile: the first one
+/// to install it wins.
+/// @param grid Directory of the grid.
+/// @param width Bytes per seat.
+/// @param num_seats Number of seats of the grid.
+/// @param seats Indexes of the seats.
+/// @param count Number of seats.
+/// @return 0 if every tile is allocated, 1 on allocation failure.
+int seatgrid_materialize(void** grid, unsigned int width, size_t num_seats, const size_t* seats, size_t count);
+
+/// Gets a tile of a grid.
+/// @param grid Directory of the grid.
+/// @param tile Index of the tile.
+/// @return The tile, NULL if it is not allocated (every seat of it is free).
+const void* seatgrid_tile(void* const* grid, size_t tile);
+
+/// Points a tile of a grid that is not shared yet at memory that already holds its seats.
+/// @note The memory must hold seatgrid_tile_size bytes and is handed to arena_recycle with the grid.
+/// @param grid Directory of the grid.
+/// @param tile Index of the tile.
+/// @param seats Seats of the tile, in the width of the grid.
+void seatgrid_attach(void** grid, size_t tile, void* seats);
+
+/// Counts the allocated tiles of a grid.
+/// @param grid Directory of the grid.
+/// @param num_seats Number of seats of the grid.
+/// @return Number of tiles with memory.
+size_t seatgrid_used_tiles(void* const* grid, size_t num_seats);
+
+/// Reads the reservation id of a seat.
+/// @param grid Directory of the grid.
+/// @param width Bytes per seat.
+/// @param seat Index of the seat.
+/// @return Reservation id of the seat, 0 if it is free.
+unsigned int seatgrid_get(void* const* grid, unsigned int width, size_t seat);
+
+/// Writes the reservation id of a seat.
+/// @note The id must fit in the width of the grid, and the tile of the seat must be allocated unless the id
+/// is 0 (see seatgrid_materialize).
+/// @param grid Directory of the grid.
+/// @param width Bytes per seat.
+/// @param seat Index of the seat.
+/// @param reservation_id Reservation id.
+void seatgrid_set(void** grid, unsigned int width, size_t seat, unsigned int reservation_id);
+
+/// Atomically replaces the reservation id of a seat if it still has the expected one.
+/// @note Both ids must fit in the width of the grid, and the tile of the seat must be allocated.
+/// @param grid Directory of the grid.
+/// @param width Bytes per seat.
+/// @param seat Index of the seat.
+/// @param expected Reservation id the seat must have.
+/// @param reservation_id Reservation id to store.
+/// @return 1 if the id was replaced, 0 if the seat had another one.
+int seatgrid_cas(void** grid, unsigned int width, size_t seat, unsigned int expected, unsigned int reservation_id);
+
+/// Reads the reservation ids of a range of seats as unsigned ints.
+/// @param grid Directory of the grid.
+/// @param width Bytes per seat.
+/// @param first Index of the first seat of the range.
+/// @param count Number of seats of the range.
+/// @param ids Where to store the ids, count of them.
+void seatgrid_read(void* const* grid, unsigned int width, size_t first, size_t count, unsigned int* ids);
+
+/// Reads the reservation ids of a range of seats while they may be written, as seatgrid_read.
+/// @note Every seat is read whole, but the range as a whole is only consistent if no write overlapped the
+/// read (see read_seats_begin). Writes that may overlap must go through seatgrid_set.
+/// @param grid Directory of the grid.
+/// @param width Bytes per seat.
+/// @param first Index of the first seat of the range.
+/// @param count Number of seats of the range.
+/// @param ids Where to store the ids, count of them.
+void seatgrid_load(void* const* grid, unsigned int width, size_t first, size_t count, unsigned int* ids);
+
+/// Writes the reservation ids of a range of seats from unsigned ints, allocating the tiles that get an id.
+/// @note Every id must fit in the width of the grid.
+/// @param grid Directory of the grid.
+/// @param width Bytes per seat.
+/// @param num_seats Number of seats of the grid.
+/// @param first Index of the first seat of the range.
+/// @param count Number of seats of the range.
+/// @param ids Reservation ids, count of them.
+/// @return 0 if the ids were written, 1 on allocation failure.
+int seatgrid_write(void** grid, unsigned int width, size_t num_seats, size_t first, size_t count,
+                   const unsigned int* ids);
+
+/// Copies a grid into a new wider one. Only the allocated tiles are copied.
+/// @note Tiles are only as large as their width needs, so a grid cannot be widened in place. Until the old grid
+/// is released, its allocated tiles cost from 3 bytes per seat (1 to 2 bytes) to 6 (2 to 4 bytes).
+/// @param from Directory of the grid to copy from.
+/// @param from_width Bytes per seat of the grid copied from.
+/// @param to_width Bytes per seat of the new grid, not smaller than from_width.
+/// @param num_seats Number of seats of the grids.
+/// @return Directory of the new grid, NULL on allocation failure.
+void** seatgrid_widen(void* const* from, unsigned int from_width, unsigned int to_width, size_t num_seats);
+
+#endif  // SERVER_SEATGRID_H
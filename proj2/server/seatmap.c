@@ -0,0 +1,319 @@
+#include "seatmap.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define SEATMAP_X86 1
+#else
+#define SEATMAP_X86 0
+#endif
+
+#define SEATMAP_WORD_BITS 64
+#define SEATMAP_BLOCK_BITS 256  // Bitmaps are padded to whole AVX2 registers
+
+static enum SeatmapKernel active = SEATMAP_SCALAR;  // Kernels in use, set by seatmap_select
+
+/// Checks whether every word of an array is 0.
+static int words_zero_scalar(const uint64_t* words, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    if (words[i] != 0) return 0;
+  }
+  return 1;
+}
+
+/// Checks whether every bit of an array of words is 1.
+static int words_ones_scalar(const uint64_t* words, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    if (words[i] != UINT64_MAX) return 0;
+  }
+  return 1;
+}
+
+/// Counts the bits set in an array of words.
+static size_t words_count_scalar(const uint64_t* words, size_t count) {
+  size_t total = 0;
+  for (size_t i = 0; i < count; i++) {
+    total += (size_t)__builtin_popcountll(words[i]);
+  }
+  return total;
+}
+
+/// Checks whether any seat of a list is taken, one seat at a time.
+static int any_set_scalar(const uint64_t* map, const size_t* seats, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    if ((map[seats[i] / SEATMAP_WORD_BITS] >> (seats[i] % SEATMAP_WORD_BITS)) & 1) return 1;
+  }
+  return 0;
+}
+
+#if SEATMAP_X86
+__attribute__((target("sse4.1"))) static int words_zero_sse(const uint64_t* words, size_t count) {
+  size_t i = 0;
+  for (; i + 2 <= count; i += 2) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(words + i));
+    if (!_mm_testz_si128(v, v)) return 0;
+  }
+  return words_zero_scalar(words + i, count - i);
+}
+
+__attribute__((target("sse4.1"))) static int words_ones_sse(const uint64_t* words, size_t count) {
+  const __m128i ones = _mm_set1_epi32(-1);
+  size_t i = 0;
+  for (; i + 2 <= count; i += 2) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(words + i));
+    if (!_mm_testc_si128(v, ones)) return 0;
+  }
+  return words_ones_scalar(words + i, count - i);
+}
+
+/// Counts bits with a nibble lookup table (pshufb) and sums the bytes with psadbw.
+__attribute__((target("sse4.1,ssse3"))) static size_t words_count_sse(const uint64_t* words, size_t count) {
+  const __m128i lut = _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m128i low_nibble = _mm_set1_epi8(0x0f);
+  __m128i total = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 2 <= count; i += 2) {
+    __m128i v = _mm_loadu_si128((const __m128i*)(words + i));
+    __m128i low = _mm_shuffle_epi8(lut, _mm_and_si128(v, low_nibble));
+    __m128i high = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(v, 4), low_nibble));
+    total = _mm_add_epi64(total, _mm_sad_epu8(_mm_add_epi8(low, high), _mm_setzero_si128()));
+  }
+  size_t sum = (size_t)_mm_cvtsi128_si64(total) + (size_t)_mm_extract_epi64(total, 1);
+  return sum + words_count_scalar(words + i, count - i);
+}
+
+__attribute__((target("avx2"))) static int words_zero_avx2(const uint64_t* words, size_t count) {
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)(words + i));
+    if (!_mm256_testz_si256(v, v)) return 0;
+  }
+  return words_zero_scalar(words + i, count - i);
+}
+
+__attribute__((target("avx2"))) static int words_ones_avx2(const uint64_t* words, size_t count) {
+  const __m256i ones = _mm256_set1_epi32(-1);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)(words + i));
+    if (!_mm256_testc_si256(v, ones)) return 0;
+  }
+  return words_ones_scalar(words + i, count - i);
+}
+
+/// Same as words_count_sse, on 256-bit registers.
+__attribute__((target("avx2"))) static size_t words_count_avx2(const uint64_t* words, size_t count) {
+  const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,  //
+                                       0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i low_nibble = _mm256_set1_epi8(0x0f);
+  __m256i total = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m256i v = _mm256_loadu_si256((const __m256i*)(words + i));
+    __m256i low = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, low_nibble));
+    __m256i high = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), low_nibble));
+    total = _mm256_add_epi64(total, _mm256_sad_epu8(_mm256_add_epi8(low, high), _mm256_setzero_si256()));
+  }
+  size_t sum = (size_t)_mm256_extract_epi64(total, 0) + (size_t)_mm256_extract_epi64(total, 1) +
+               (size_t)_mm256_extract_epi64(total, 2) + (size_t)_mm256_extract_epi64(total, 3);
+  return sum + words_count_scalar(words + i, count - i);
+}
+
+/// Gathers the words of four seats at a time and shifts each seat bit down to bit 0.
+__attribute__((target("avx2"))) static int any_set_avx2(const uint64_t* map, const size_t* seats, size_t count) {
+  const __m256i bit_mask = _mm256_set1_epi64x(SEATMAP_WORD_BITS - 1);
+  __m256i taken = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m256i index = _mm256_loadu_si256((const __m256i*)(seats + i));
+    __m256i words = _mm256_i64gather_epi64((const long long*)map, _mm256_srli_epi64(index, 6), 8);
+    taken = _mm256_or_si256(taken, _mm256_srlv_epi64(words, _mm256_and_si256(index, bit_mask)));
+  }
+  if (!_mm256_testz_si256(taken, _mm256_set1_epi64x(1))) return 1;
+  return any_set_scalar(map, seats + i, count - i);
+}
+#endif
+
+static int words_zero(const uint64_t* words, size_t count) {
+#if SEATMAP_X86
+  if (active == SEATMAP_AVX2) return words_zero_avx2(words, count);
+  if (active == SEATMAP_SSE) return words_zero_sse(words, count);
+#endif
+  return words_zero_scalar(words, count);
+}
+
+static int words_ones(const uint64_t* words, size_t count) {
+#if SEATMAP_X86
+  if (active == SEATMAP_AVX2) return words_ones_avx2(words, count);
+  if (active == SEATMAP_SSE) return words_ones_sse(words, count);
+#endif
+  return words_ones_scalar(words, count);
+}
+
+static size_t words_count(const uint64_t* words, size_t count) {
+#if SEATMAP_X86
+  if (active == SEATMAP_AVX2) return words_count_avx2(words, count);
+  if (active == SEATMAP_SSE) return words_count_sse(words, count);
+#endif
+  return words_count_scalar(words, count);
+}
+
+int seatmap_select(enum SeatmapKernel kernel) {
+  int avx2 = 0;
+  int sse = 0;
+#if SEATMAP_X86
+  __builtin_cpu_init();
+  avx2 = __builtin_cpu_supports("avx2");
+  sse = __builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("ssse3");
+#endif
+
+  if (kernel == SEATMAP_AUTO) {
+    kernel = avx2 ? SEATMAP_AVX2 : sse ? SEATMAP_SSE : SEATMAP_SCALAR;
+  }
+  if ((kernel == SEATMAP_AVX2 && !avx2) || (kernel == SEATMAP_SSE && !sse)) return 1;
+  active = kernel;
+  return 0;
+}
+
+size_t seatmap_size(size_t num_seats) {
+  size_t blocks = (num_seats + SEATMAP_BLOCK_BITS - 1) / SEATMAP_BLOCK_BITS;
+  return (blocks == 0 ? 1 : blocks) * (SEATMAP_BLOCK_BITS / 8);
+}
+
+void seatmap_set(uint64_t* map, size_t seat) { map[seat / SEATMAP_WORD_BITS] |= 1ull << (seat % SEATMAP_WORD_BITS); }
+
+void seatmap_set_atomic(uint64_t* map, size_t seat) {
+  __atomic_fetch_or(&map[seat / SEATMAP_WORD_BITS], 1ull << (seat % SEATMAP_WORD_BITS), __ATOMIC_RELAXED);
+}
+
+void seatmap_clear(uint64_t* map, size_t seat) { map[seat / SEATMAP_WORD_BITS] &= ~(1ull << (seat % SEATMAP_WORD_BITS)); }
+
+void seatmap_clear_atomic(uint64_t* map, size_t seat) {
+  __atomic_fetch_and(&map[seat / SEATMAP_WORD_BITS], ~(1ull << (seat % SEATMAP_WORD_BITS)), __ATOMIC_RELAXED);
+}
+
+void seatmap_fill(uint64_t* map, size_t first, const unsigned int* ids, size_t count) {
+  for (size_t seat = first; seat < first + count; seat++) {
+    uint64_t bit = 1ull << (seat % SEATMAP_WORD_BITS);
+    if (ids[seat - first] != 0) {
+      map[seat / SEATMAP_WORD_BITS] |= bit;
+    } else {
+      map[seat / SEATMAP_WORD_BITS] &= ~bit;
+    }
+  }
+}
+
+int seatmap_any_set(const uint64_t* map, const size_t* seats, size_t count) {
+#if SEATMAP_X86
+  // SSE has no gather, so only AVX2 vectorizes scattered seats
+  if (active == SEATMAP_AVX2) return any_set_avx2(map, seats, count);
+#endif
+  return any_set_scalar(map, seats, count);
+}
+
+int seatmap_range_free(const uint64_t* map, size_t first, size_t count) {
+  if (count == 0) return 1;
+
+  size_t last = first + count - 1;
+  size_t first_word = first / SEATMAP_WORD_BITS;
+  size_t last_word = last / SEATMAP_WORD_BITS;
+  uint64_t head = UINT64_MAX << (first % SEATMAP_WORD_BITS);
+  uint64_t tail = UINT64_MAX >> (SEATMAP_WORD_BITS - 1 - last % SEATMAP_WORD_BITS);
+
+  if (first_word == last_word) return (map[first_word] & head & tail) == 0;
+  if ((map[first_word] & head) != 0 || (map[last_word] & tail) != 0) return 0;
+  return words_zero(map + first_word + 1, last_word - first_word - 1);
+}
+
+/// Walks the runs of free seats of a range a word at a time, skipping whole runs of free or taken seats with ctz.
+/// @param map Bitmap of the grid.
+/// @param first Index of the first seat of the range.
+/// @param count Number of seats of the range.
+/// @param length Length of the run to stop at, 0 to walk the whole range.
+/// @param longest Where to store the longest run of the part walked.
+/// @param free_seats Where to store the number of free seats of the part walked, may be NULL.
+/// @return Offset from first of the first run of length seats, count if there is none.
+static size_t walk_runs(const uint64_t* map, size_t first, size_t count, size_t length, size_t* longest,
+                        size_t* free_seats) {
+  size_t best = 0;
+  size_t run = 0;
+  size_t start = 0;
+  size_t free_total = 0;
+  size_t found = count;
+
+  for (size_t done = 0; done < count && found == count;) {
+    size_t seat = first + done;
+    size_t shift = seat % SEATMAP_WORD_BITS;
+    size_t bits = SEATMAP_WORD_BITS - shift;
+    if (bits > count - done) bits = count - done;
+
+    // Seats past the range count as taken, which also covers the zeros shifted in
+    uint64_t taken = __atomic_load_n(&map[seat / SEATMAP_WORD_BITS], __ATOMIC_RELAXED) >> shift;
+    if (bits < SEATMAP_WORD_BITS) taken |= UINT64_MAX << bits;
+    free_total += SEATMAP_WORD_BITS - (size_t)__builtin_popcountll(taken);
+
+    for (size_t i = 0; i < bits;) {
+      uint64_t rest = taken >> i;
+      if (rest & 1) {
+        i += ~rest == 0 ? SEATMAP_WORD_BITS - i : (size_t)__builtin_ctzll(~rest);
+        run = 0;
+        continue;
+      }
+
+      size_t zeros = rest == 0 ? SEATMAP_WORD_BITS - i : (size_t)__builtin_ctzll(rest);
+      if (run == 0) start = done + i;
+      run += zeros;
+      i += zeros;
+      if (run > best) best = run;
+      if (length != 0 && run >= length) {
+        found = start;
+        break;
+      }
+    }
+    done += bits;
+  }
+
+  *longest = best;
+  if (free_seats != NULL) *free_seats = free_total;
+  return found;
+}
+
+size_t seatmap_find_run(const uint64_t* map, size_t first, size_t count, size_t length) {
+  if (length == 0) return 0;
+  size_t longest;
+  return walk_runs(map, first, count, length, &longest, NULL);
+}
+
+size_t seatmap_longest_run(const uint64_t* map, size_t first, size_t count, size_t* free_seats) {
+  size_t longest;
+  walk_runs(map, first, count, 0, &longest, free_seats);
+  return longest;
+}
+
+size_t seatmap_next_set(const uint64_t* map, size_t first, size_t count) {
+  for (size_t done = 0; done < count;) {
+    size_t seat = first + done;
+    size_t shift = seat % SEATMAP_WORD_BITS;
+    uint64_t word = map[seat / SEATMAP_WORD_BITS] >> shift;
+    if (word != 0) {
+      size_t offset = done + (size_t)__builtin_ctzll(word);
+      return offset < count ? offset : count;
+    }
+    done += SEATMAP_WORD_BITS - shift;
+  }
+  return count;
+}
+
+size_t seatmap_count(const uint64_t* map, size_t num_seats) {
+  // Bits past the last seat are 0, so the last word can be counted whole
+  return words_count(map, (num_seats + SEATMAP_WORD_BITS - 1) / SEATMAP_WORD_BITS);
+}
+
+int seatmap_full(const uint64_t* map, size_t num_seats) {
+  size_t full_words = num_seats / SEATMAP_WORD_BITS;
+  size_t rest = num_seats % SEATMAP_WORD_BITS;
+  if (!words_ones(map, full_words)) return 0;
+  if (rest == 0) return 1;
+
+  uint64_t mask = (1ull << rest) - 1;
+  return (map[full_words] & mask) == mask;
+}
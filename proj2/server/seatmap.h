@@ -0,0 +1,108 @@
+#ifndef SERVER_SEATMAP_H
+#define SERVER_SEATMAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Occupancy bitmaps of seat grids: one bit per seat, set once the seat is reserved.
+/// The bitmap sits next to the grid of reservation ids, so checks that only need to know whether seats are
+/// taken read one bit per seat instead of an unsigned int. The checks run as AVX2 or SSE kernels when the
+/// CPU has them and as scalar loops otherwise. Bits past the last seat are always 0.
+
+// Kernels the checks can run on
+enum SeatmapKernel {
+  SEATMAP_AUTO,    // Best kernel the CPU supports
+  SEATMAP_SCALAR,  // Portable 64-bit loops
+  SEATMAP_SSE,     // 128-bit kernels (SSE4.1, and SSSE3 for counting)
+  SEATMAP_AVX2,    // 256-bit kernels, with gathers for scattered seats
+};
+
+/// Picks the kernels used by the checks.
+/// @note Must be called before other threads use the bitmaps, the scalar kernels are used until then.
+/// @param kernel Kernels to use, SEATMAP_AUTO for the best ones the CPU supports.
+/// @return 0 if the CPU supports the kernels, 1 otherwise (the current ones are kept).
+int seatmap_select(enum SeatmapKernel kernel);
+
+/// Calculates the size of the bitmap of a grid.
+/// @param num_seats Number of seats of the grid.
+/// @return Size of the bitmap in bytes, a non-zero multiple of 32.
+size_t seatmap_size(size_t num_seats);
+
+/// Marks a seat as taken.
+/// @param map Bitmap of the grid.
+/// @param seat Index of the seat.
+void seatmap_set(uint64_t* map, size_t seat);
+
+/// Marks a seat as taken with an atomic or, for bitmaps written by several threads at once.
+/// @param map Bitmap of the grid.
+/// @param seat Index of the seat.
+void seatmap_set_atomic(uint64_t* map, size_t seat);
+
+/// Marks a seat as free.
+/// @param map Bitmap of the grid.
+/// @param seat Index of the seat.
+void seatmap_clear(uint64_t* map, size_t seat);
+
+/// Marks a seat as free with an atomic and, for bitmaps written by several threads at once.
+/// @param map Bitmap of the grid.
+/// @param seat Index of the seat.
+void seatmap_clear_atomic(uint64_t* map, size_t seat);
+
+/// Sets the bits of a range of seats from their reservation ids.
+/// @param map Bitmap of the grid.
+/// @param first Index of the first seat of the range.
+/// @param ids Reservation ids of the seats of the range.
+/// @param count Number of seats of the range.
+void seatmap_fill(uint64_t* map, size_t first, const unsigned int* ids, size_t count);
+
+/// Checks whether any seat of a list is taken.
+/// @param map Bitmap of the grid.
+/// @param seats Indexes of the seats, which must exist (and may repeat).
+/// @param count Number of seats.
+/// @return 1 if at least one of the seats is taken, 0 otherwise.
+int seatmap_any_set(const uint64_t* map, const size_t* seats, size_t count);
+
+/// Checks whether every seat of a range is free.
+/// @param map Bitmap of the grid.
+/// @param first Index of the first seat of the range.
+/// @param count Number of seats of the range, which must exist.
+/// @return 1 if every seat of the range is free, 0 otherwise.
+int seatmap_range_free(const uint64_t* map, size_t first, size_t count);
+
+/// Finds the first run of free seats of a given length in a range.
+/// @note Words are read with relaxed atomics, so it may run while lock-free claims set bits.
+/// @param map Bitmap of the grid.
+/// @param first Index of the first seat of the range.
+/// @param count Number of seats of the range, which must exist.
+/// @param length Number of adjacent free seats wanted.
+/// @return Offset from first of the first seat of the run, count if the range has no such run.
+size_t seatmap_find_run(const uint64_t* map, size_t first, size_t count, size_t length);
+
+/// Measures the longest run of free seats of a range, as seatmap_find_run.
+/// @param map Bitmap of the grid.
+/// @param first Index of the first seat of the range.
+/// @param count Number of seats of the range, which must exist.
+/// @param free_seats Where to store the number of free seats of the range, may be NULL.
+/// @return Length of the longest run of adjacent free seats.
+size_t seatmap_longest_run(const uint64_t* map, size_t first, size_t count, size_t* free_seats);
+
+/// Finds the first taken seat of a range.
+/// @param map Bitmap of the grid.
+/// @param first Index of the first seat of the range.
+/// @param count Number of seats of the range, which must exist.
+/// @return Offset from first of the first taken seat, count if every seat of the range is free.
+size_t seatmap_next_set(const uint64_t* map, size_t first, size_t count);
+
+/// Counts the taken seats of a grid.
+/// @param map Bitmap of the grid.
+/// @param num_seats Number of seats of the grid.
+/// @return Number of taken seats.
+size_t seatmap_count(const uint64_t* map, size_t num_seats);
+
+/// Checks whether every seat of a grid is taken.
+/// @param map Bitmap of the grid.
+/// @param num_seats Number of seats of the grid.
+/// @return 1 if the grid is full, 0 otherwise.
+int seatmap_full(const uint64_t* map, size_t num_seats);
+
+#endif  // SERVER_SEATMAP_H
@@ -0,0 +1,299 @@
+#include "snapshot.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "alloc.h"
+#include "epoch.h"
+#include "seatgrid.h"
+#include "seatmap.h"
+
+#define SNAPSHOT_ALIGNMENT 16        // Same as the arenas, so mapped grids can be recycled like arena ones
+#define SNAPSHOT_TMP_SUFFIX ".tmp"  // Suffix of the file a snapshot is written to before being renamed
+
+/// Rounds a size up to the snapshot alignment.
+/// @param size Size to be rounded.
+/// @return Rounded size.
+static size_t snapshot_align(size_t size) { return (size + SNAPSHOT_ALIGNMENT - 1) & ~(size_t)(SNAPSHOT_ALIGNMENT - 1); }
+
+/// Calculates the space taken by the tile offsets and the bitmap of an event in a snapshot.
+/// @param num_seats Number of seats of the event.
+/// @return Size of the offsets followed by the bitmap, padded to the snapshot alignment.
+static size_t event_header_size(size_t num_seats) {
+  return snapshot_align(seatgrid_tiles(num_seats) * sizeof(uint64_t)) + seatmap_size(num_seats);
+}
+
+/// Calculates the space taken by a tile in a snapshot.
+/// @param num_seats Number of seats of the event.
+/// @param width Bytes per seat.
+/// @return Size of the tile, padded to the snapshot alignment (and never 0).
+static size_t tile_size(size_t num_seats, unsigned int width) {
+  size_t size = snapshot_align(seatgrid_tile_size(num_seats, width));
+  return size == 0 ? SNAPSHOT_ALIGNMENT : size;
+}
+
+/// Points a new grid at the tiles of an event in the mapping of a snapshot.
+/// @param base Start of the mapping.
+/// @param size Size of the mapping.
+/// @param entry Entry of the event, whose offsets were checked to be in the mapping.
+/// @return Directory of the grid, NULL if an offset is invalid or on allocation failure.
+static void** map_tiles(char* base, size_t size, const struct SnapshotEvent* entry) {
+  size_t num_seats = entry->rows * entry->cols;
+  void** data = seatgrid_create(num_seats);
+  if (data == NULL) return NULL;
+
+  const uint64_t* offsets = (const uint64_t*)(base + entry->data_offset);
+  size_t first_tile = entry->data_offset + event_header_size(num_seats);
+  size_t tile_bytes = tile_size(num_seats, entry->width);
+  for (size_t i = 0; i < seatgrid_tiles(num_seats); i++) {
+    if (offsets[i] == 0) continue;
+    if (offsets[i] < first_tile || offsets[i] % SNAPSHOT_ALIGNMENT != 0 || offsets[i] > size ||
+        tile_bytes > size - offsets[i]) {
+      // The tiles attached so far belong to the mapping, so only the directory goes back
+      arena_recycle(data, seatgrid_tiles(num_seats) * sizeof(void*));
+      return NULL;
+    }
+    seatgrid_attach(data, i, base + offsets[i]);
+  }
+  return data;
+}
+
+int snapshot_load(struct EventList* list, const char* path, struct SnapshotImage* image) {
+  image->base = NULL;
+  image->size = 0;
+  image->wal_lsn = 0;
+  image->generation = 0;
+
+  int fd = open(path, O_RDONLY);
+  if (fd == -1) return errno != ENOENT;
+
+  struct stat st;
+  if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(struct SnapshotHeader)) {
+    close(fd);
+    return 1;
+  }
+
+  // Private mapping: reservations made after loading never reach the file, only later snapshots
+  size_t size = (size_t)st.st_size;
+  void* base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) return 1;
+  image->base = base;
+  image->size = size;
+
+  const struct SnapshotHeader* header = base;
+  if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 || header->version != SNAPSHOT_VERSION ||
+      header->num_events > (size - sizeof(struct SnapshotHeader)) / sizeof(struct SnapshotEvent)) {
+    return 1;
+  }
+  image->wal_lsn = header->wal_lsn;
+  image->generation = header->generation;
+
+  const struct SnapshotEvent* table = (const struct SnapshotEvent*)(header + 1);
+  size_t table_end = sizeof(struct SnapshotHeader) + header->num_events * sizeof(struct SnapshotEvent);
+
+  size_t loaded = 0;
+  pthread_rwlock_wrlock(&list->rwl);
+  for (size_t i = 0; i < header->num_events; i++) {
+    const struct SnapshotEvent* entry = &table[i];
+    if (entry->rows != 0 && entry->cols > SIZE_MAX / sizeof(unsigned int) / entry->rows) break;
+    if ((entry->width != 1 && entry->width != 2 && entry->width != SEAT_WIDTH_MAX) ||
+        entry->width < seat_width_for(entry->reservations)) {
+      break;
+    }
+    if (entry->data_offset < table_end || entry->data_offset % SNAPSHOT_ALIGNMENT != 0 ||
+        entry->data_offset > size || event_header_size(entry->rows * entry->cols) > size - entry->data_offset) {
+      break;
+    }
+    if (get_event(list, entry->id) != NULL) break;
+
+    size_t num_seats = entry->rows * entry->cols;
+    void** data = map_tiles(base, size, entry);
+    if (data == NULL) break;
+    uint64_t* occupied = (uint64_t*)((char*)base + entry->data_offset +
+                                     snapshot_align(seatgrid_tiles(num_seats) * sizeof(uint64_t)));
+    struct Event* event = create_event_at(entry->id, entry->rows, entry->cols, data, entry->width, occupied, entry->stripes);
+    if (event == NULL) {
+      arena_recycle(data, seatgrid_tiles(num_seats) * sizeof(void*));
+      break;
+    }
+    event->reservations = entry->reservations;
+    event->version = entry->reservations;
+    event->checkpointed = 1;
+
+    if (append_to_list(list, event) != 0) {
+      free_event(event);
+      break;
+    }
+    list->num_events++;
+    loaded++;
+  }
+  pthread_rwlock_unlock(&list->rwl);
+
+  return loaded != header->num_events;
+}
+
+// Copy of an event made by copy_event, to be written to a snapshot once the event is unlocked
+struct EventCopy {
+  char* grid;                 // Buffer that fits the widest grid of the event
+  size_t data_offset;         // Offset of the event in the snapshot
+  size_t size;                // Bytes copied to the buffer, 0 if the event was deleted
+  unsigned int width;         // Bytes per seat of the copied grid
+  unsigned int reservations;  // Number of reservations of the event
+};
+
+/// Copies the bitmap and the allocated tiles of an event, each after the tile offsets, and marks it as checkpointed.
+/// @note Run with the event locked, see with_event_locked.
+/// @param event Event to be copied.
+/// @param arg Copy (see struct EventCopy).
+static void copy_event(struct Event* event, void* arg) {
+  struct EventCopy* copy = arg;
+  if (event->deleted) return;
+
+  char* grid = copy->grid;
+  size_t num_seats = event->rows * event->cols;
+  unsigned int width = event->width;
+  size_t size = event_header_size(num_seats);
+  memset(grid, 0, size);
+  uint64_t* offsets = (uint64_t*)grid;
+  memcpy(grid + size - seatmap_size(num_seats), event->occupied, seatmap_size(num_seats));
+  for (size_t t = 0; t < seatgrid_tiles(num_seats); t++) {
+    const void* tile = seatgrid_tile(event->data, t);
+    if (tile == NULL) continue;
+    offsets[t] = copy->data_offset + size;
+    memset(grid + size, 0, tile_size(num_seats, width));
+    memcpy(grid + size, tile, seatgrid_tile_size(num_seats, width));
+    size += tile_size(num_seats, width);
+  }
+  // Held seats are not reservations yet, so they are saved as free (see holds.h)
+  if (event->held != NULL) {
+    uint64_t* occupied = (uint64_t*)(grid + event_header_size(num_seats) - seatmap_size(num_seats));
+    for (size_t seat = seatmap_next_set(event->held, 0, num_seats); seat < num_seats;
+         seat += 1 + seatmap_next_set(event->held, seat + 1, num_seats - seat - 1)) {
+      seatmap_clear(occupied, seat);
+      size_t tile = (size_t)(offsets[seat / SEAT_TILE_SEATS] - copy->data_offset);
+      memset(grid + tile + (seat % SEAT_TILE_SEATS) * width, 0, width);
+    }
+  }
+  copy->size = size;
+  copy->width = width;
+  copy->reservations = event->reservations;
+  event->checkpointed = 1;
+  clear_dirty_rows(event);
+}
+
+int snapshot_write(struct EventList* list, const char* path, uint64_t wal_lsn, uint32_t generation) {
+  char* tmp_path = malloc(strlen(path) + sizeof(SNAPSHOT_TMP_SUFFIX));
+  if (tmp_path == NULL) return 1;
+  strcpy(tmp_path, path);
+  strcat(tmp_path, SNAPSHOT_TMP_SUFFIX);
+
+  // The epoch keeps events deleted while the snapshot is written alive until it is done with them
+  if (epoch_enter() != 0) {
+    free(tmp_path);
+    return 1;
+  }
+
+  pthread_rwlock_rdlock(&list->rwl);
+  size_t num_events = list->num_events;
+  struct Event** events = malloc(sizeof(struct Event*) * (num_events == 0 ? 1 : num_events));
+  if (events == NULL) {
+    pthread_rwlock_unlock(&list->rwl);
+    epoch_exit();
+    free(tmp_path);
+    return 1;
+  }
+  size_t collected = 0;
+  for (struct ListNode* current = list->head; current != NULL; current = current->next) {
+    events[collected++] = current->event;
+  }
+  // Removals recorded so far are reflected in the snapshot, later ones are left for the next checkpoint
+  size_t num_removed = list->num_removed;
+  size_t removed_lost = list->removed_lost;
+  pthread_rwlock_unlock(&list->rwl);
+
+  struct SnapshotEvent* table = calloc(num_events == 0 ? 1 : num_events, sizeof(struct SnapshotEvent));
+  FILE* file = fopen(tmp_path, "w");
+  size_t data_offset = snapshot_align(sizeof(struct SnapshotHeader) + num_events * sizeof(struct SnapshotEvent));
+  int failed = table == NULL || file == NULL || fseek(file, (long)data_offset, SEEK_SET) != 0;
+
+  // Each grid is copied with its event locked (by its owner, if it has one) and written after unlocking it
+  char* grid = NULL;
+  size_t grid_capacity = 0;
+  size_t written = 0;
+  for (size_t i = 0; i < collected && !failed; i++) {
+    struct Event* event = events[i];
+    // The width may grow and tiles be allocated until the event is locked, so the buffer fits the widest grid
+    size_t num_seats = event->rows * event->cols;
+    size_t capacity = event_header_size(num_seats) + seatgrid_tiles(num_seats) * tile_size(num_seats, SEAT_WIDTH_MAX);
+    if (capacity > grid_capacity) {
+      char* temp = realloc(grid, capacity);
+      if (temp == NULL) {
+        failed = 1;
+        break;
+      }
+      grid = temp;
+      grid_capacity = capacity;
+    }
+
+    struct EventCopy copy = {.grid = grid, .data_offset = data_offset};
+    with_event_locked(event, copy_event, &copy);
+    if (copy.size == 0) continue;
+
+    if (fwrite(grid, 1, copy.size, file) != copy.size) {
+      failed = 1;
+      break;
+    }
+    table[written++] =
+        (struct SnapshotEvent){event->id, copy.reservations, event->rows, event->cols, data_offset, copy.width,
+                               (uint32_t)event->num_stripes};
+    data_offset += copy.size;
+  }
+  epoch_exit();
+  free(grid);
+  free(events);
+
+  struct SnapshotHeader header = {SNAPSHOT_MAGIC, SNAPSHOT_VERSION, generation, written, wal_lsn};
+  if (!failed) {
+    failed = fseek(file, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, file) != 1 ||
+             (written > 0 && fwrite(table, sizeof(struct SnapshotEvent), written, file) != written);
+  }
+  // The snapshot only replaces the previous one once it is complete on disk
+  if (!failed) {
+    failed = fflush(file) != 0 || fsync(fileno(file)) != 0;
+  }
+  if (file != NULL && fclose(file) != 0) failed = 1;
+  if (!failed) {
+    failed = rename(tmp_path, path) != 0;
+  } else if (file != NULL) {
+    unlink(tmp_path);
+  }
+
+  if (!failed) {
+    pthread_rwlock_wrlock(&list->rwl);
+    forget_removed(list, num_removed);
+    list->removed_lost -= removed_lost;
+    pthread_rwlock_unlock(&list->rwl);
+  }
+
+  free(table);
+  free(tmp_path);
+  return failed;
+}
+
+void snapshot_unmap(struct SnapshotImage* image) {
+  if (image->base != NULL) {
+    munmap(image->base, image->size);
+  }
+  image->base = NULL;
+  image->size = 0;
+  image->wal_lsn = 0;
+  image->generation = 0;
+}
@@ -0,0 +1,70 @@
+#ifndef SERVER_SNAPSHOT_H
+#define SERVER_SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "eventlist.h"
+
+/// Snapshots of the event list, laid out so they can be mapped instead of parsed.
+/// A snapshot is a header, a table of events and the seats of those events: for each event, the file offset
+/// of each tile of its grid (0 for tiles with every seat free), its occupancy bitmap and its allocated tiles.
+/// Loading maps the file privately and points the events at their tiles and bitmaps in the mapping, so seats
+/// are only read from disk when they are first touched, and free tiles take no space in the file.
+
+#define SNAPSHOT_MAGIC "EMSSNAP"
+#define SNAPSHOT_VERSION 6
+
+// Header at the start of a snapshot file
+struct SnapshotHeader {
+  char magic[8];        // SNAPSHOT_MAGIC, NUL-terminated
+  uint32_t version;     // SNAPSHOT_VERSION
+  uint32_t generation;  // Number of the snapshot, which incremental checkpoints refer to
+  uint64_t num_events;  // Number of entries of the event table that follows the header
+  uint64_t wal_lsn;     // First log record that may not be reflected in the snapshot
+};
+
+// Entry of the event table
+struct SnapshotEvent {
+  uint32_t id;            // Event id
+  uint32_t reservations;  // Number of reservations of the event
+  uint64_t rows;          // Number of rows
+  uint64_t cols;          // Number of columns
+  uint64_t data_offset;   // Offset of the tile offsets of the event (and the bitmap after them) in the file
+  uint32_t width;         // Bytes per seat of the grid
+  uint32_t stripes;       // Number of row stripes, 0 in snapshots written before it was saved (the default)
+};
+
+// Mapping of a loaded snapshot, which must outlive every event loaded from it
+struct SnapshotImage {
+  void* base;           // Start of the mapping, NULL if nothing was mapped
+  size_t size;          // Size of the mapping
+  uint64_t wal_lsn;     // First log record to replay on top of the snapshot
+  uint32_t generation;  // Number of the loaded snapshot
+};
+
+/// Loads the events of a snapshot into an empty list.
+/// @note A missing file is not an error, the list is just left empty.
+/// @param list Event list to be filled.
+/// @param path Path of the snapshot.
+/// @param image Set to the mapping of the snapshot (and its log position), to be released with snapshot_unmap.
+/// @return 0 if the snapshot was loaded successfully (or does not exist), 1 otherwise.
+int snapshot_load(struct EventList* list, const char* path, struct SnapshotImage* image);
+
+/// Writes a snapshot of the list to a temporary file and renames it over the given path.
+/// @note Takes the list rwl for reading only while it collects the events, and the stripes of each event only
+/// while it copies that event (see with_event_locked), so reservations carry on while the snapshot is written.
+/// The saved events are marked as checkpointed and their dirty rows cleared, even if writing fails.
+/// @param list Event list to be saved.
+/// @param path Path of the snapshot.
+/// @param wal_lsn Next log sequence number, read before calling so every earlier record is reflected.
+/// @param generation Number of the snapshot.
+/// @return 0 if the snapshot was written successfully, 1 otherwise.
+int snapshot_write(struct EventList* list, const char* path, uint64_t wal_lsn, uint32_t generation);
+
+/// Unmaps a loaded snapshot.
+/// @note Must only be called once no event uses the seat grids of the snapshot.
+/// @param image Mapping to be released.
+void snapshot_unmap(struct SnapshotImage* image);
+
+#endif  // SERVER_SNAPSHOT_H
@@ -0,0 +1,82 @@
+#include "timerwheel.h"
+
+#include <string.h>
+
+/// Puts a timer in the slot that comes up at or before its expiry, on the lowest level whose span covers it.
+/// @param wheel Wheel to add to.
+/// @param entry Timer, expiring between base and base + TIMERWHEEL_SPAN - 1.
+/// @param base Next tick to be processed.
+static void place(struct TimerWheel* wheel, struct TimerEntry* entry, uint64_t base) {
+  uint64_t delta = entry->expires - base;
+  unsigned int level = 0;
+  while (level + 1 < TIMERWHEEL_LEVELS && delta >= 1ull << (TIMERWHEEL_BITS * (level + 1))) level++;
+
+  struct TimerEntry** slot =
+      &wheel->slots[level][(entry->expires >> (TIMERWHEEL_BITS * level)) & (TIMERWHEEL_SLOTS - 1)];
+  entry->prev = NULL;
+  entry->next = *slot;
+  if (*slot != NULL) (*slot)->prev = entry;
+  *slot = entry;
+  entry->slot = slot;
+}
+
+void timerwheel_init(struct TimerWheel* wheel, uint64_t now) {
+  memset(wheel, 0, sizeof(*wheel));
+  wheel->now = now;
+}
+
+void timerwheel_add(struct TimerWheel* wheel, struct TimerEntry* entry, uint64_t expires) {
+  uint64_t base = wheel->now + 1;
+  if (expires < base) expires = base;
+  if (expires - base >= TIMERWHEEL_SPAN) expires = base + TIMERWHEEL_SPAN - 1;
+  entry->expires = expires;
+  place(wheel, entry, base);
+  wheel->count++;
+}
+
+void timerwheel_remove(struct TimerWheel* wheel, struct TimerEntry* entry) {
+  if (entry->prev != NULL) {
+    entry->prev->next = entry->next;
+  } else {
+    *entry->slot = entry->next;
+  }
+  if (entry->next != NULL) entry->next->prev = entry->prev;
+  entry->slot = NULL;
+  wheel->count--;
+}
+
+struct TimerEntry* timerwheel_advance(struct TimerWheel* wheel, uint64_t now) {
+  struct TimerEntry* expired = NULL;
+
+  // An empty wheel has nothing to move, so a long idle stretch is skipped at once
+  if (wheel->count == 0 && now > wheel->now) wheel->now = now;
+
+  while (wheel->now < now) {
+    uint64_t tick = ++wheel->now;
+
+    // Each level whose slot comes up hands its timers down, lowest level first, until one is mid-revolution
+    for (unsigned int level = 1; level < TIMERWHEEL_LEVELS; level++) {
+      if ((tick & ((1ull << (TIMERWHEEL_BITS * level)) - 1)) != 0) break;
+      struct TimerEntry** slot = &wheel->slots[level][(tick >> (TIMERWHEEL_BITS * level)) & (TIMERWHEEL_SLOTS - 1)];
+      struct TimerEntry* entry = *slot;
+      *slot = NULL;
+      while (entry != NULL) {
+        struct TimerEntry* next = entry->next;
+        place(wheel, entry, tick);
+        entry = next;
+      }
+    }
+
+    // Every timer in the slot of the first level expires on this tick
+    struct TimerEntry** slot = &wheel->slots[0][tick & (TIMERWHEEL_SLOTS - 1)];
+    while (*slot != NULL) {
+      struct TimerEntry* entry = *slot;
+      *slot = entry->next;
+      entry->slot = NULL;
+      entry->next = expired;
+      expired = entry;
+      wheel->count--;
+    }
+  }
+  return expired;
+}
@@ -0,0 +1,57 @@
+#ifndef SERVER_TIMERWHEEL_H
+#define SERVER_TIMERWHEEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Hierarchical timer wheel: timers are kept in TIMERWHEEL_LEVELS wheels of TIMERWHEEL_SLOTS slots each, the
+/// slots of each level spanning TIMERWHEEL_SLOTS times the ticks of the slots of the level below. A timer goes
+/// to the level whose span covers its delay, and moves one level down each time the slot it is in comes up,
+/// so it is moved at most TIMERWHEEL_LEVELS - 1 times and a tick only touches the slots that come up, whatever
+/// the number of timers. Adding and removing a timer are O(1).
+/// @note The wheel takes no locks, callers must serialize every call on the same wheel.
+
+#define TIMERWHEEL_BITS 6                              // Bits of a tick resolved by each level
+#define TIMERWHEEL_SLOTS (1u << TIMERWHEEL_BITS)       // Slots of each level
+#define TIMERWHEEL_LEVELS 4                            // Levels of the wheel
+#define TIMERWHEEL_SPAN (1ull << (TIMERWHEEL_BITS * TIMERWHEEL_LEVELS))  // Ticks covered by the wheel
+
+// Timer, embedded in the object it times
+struct TimerEntry {
+  struct TimerEntry* next;  // Next timer of the slot, or of the list returned by timerwheel_advance
+  struct TimerEntry* prev;  // Previous timer of the slot, NULL for the first one
+  struct TimerEntry** slot;  // Slot holding the timer, NULL if the timer is not in the wheel
+  uint64_t expires;         // Tick at which the timer expires
+};
+
+struct TimerWheel {
+  uint64_t now;                                                       // Last tick processed
+  size_t count;                                                       // Timers in the wheel
+  struct TimerEntry* slots[TIMERWHEEL_LEVELS][TIMERWHEEL_SLOTS];  // Timers of each slot, unordered
+};
+
+/// Initializes an empty wheel.
+/// @param wheel Wheel to initialize.
+/// @param now Current tick.
+void timerwheel_init(struct TimerWheel* wheel, uint64_t now);
+
+/// Adds a timer to a wheel.
+/// @note Delays past TIMERWHEEL_SPAN - 1 ticks are cut to it, and timers that already expired expire on the
+/// next tick.
+/// @param wheel Wheel to add to.
+/// @param entry Timer, which must not be in a wheel.
+/// @param expires Tick at which the timer expires.
+void timerwheel_add(struct TimerWheel* wheel, struct TimerEntry* entry, uint64_t expires);
+
+/// Removes a timer from its wheel before it expires.
+/// @param wheel Wheel holding the timer.
+/// @param entry Timer, which must be in the wheel.
+void timerwheel_remove(struct TimerWheel* wheel, struct TimerEntry* entry);
+
+/// Advances a wheel to a tick, collecting the timers that expire up to it.
+/// @param wheel Wheel to advance.
+/// @param now Current tick, not before the last one.
+/// @return Expired timers, linked through next and no longer in the wheel. NULL if none expired.
+struct TimerEntry* timerwheel_advance(struct TimerWheel* wheel, uint64_t now);
+
+#endif  // SERVER_TIMERWHEEL_H
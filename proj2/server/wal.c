@@ -0,0 +1,277 @@
+#include "wal.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common/io.h"
+
+#define WAL_INITIAL_BUFFER 4096  // Initial size of the append and flush buffers
+
+static int wal_fd = -1;
+static size_t wal_max_batch = 1;
+
+static pthread_t flusher;
+static pthread_mutex_t wal_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t flush_cond = PTHREAD_COND_INITIALIZER;    // Signalled when records are appended
+static pthread_cond_t durable_cond = PTHREAD_COND_INITIALIZER;  // Broadcast when a batch is durable
+
+// Records appended but not yet handed to the flusher, all guarded by wal_mutex
+static char* buffer = NULL;
+static size_t buffer_used = 0;
+static size_t buffer_capacity = 0;
+static size_t buffered_records = 0;
+
+static uint64_t next_lsn = 1;
+static uint64_t durable_lsn = 0;  // Every record up to this LSN is on disk
+static int failed = 0;            // Set once a batch could not be written, every later wait fails
+static int closing = 0;
+
+static unsigned long records_written = 0;
+static unsigned long flushes = 0;
+
+/// Calculates the checksum of a record (FNV-1a).
+/// @param header Header of the record, its checksum field is ignored.
+/// @param payload Payload of the record.
+/// @return Checksum of the record.
+static uint32_t record_checksum(const struct WalRecordHeader* header, const void* payload) {
+  uint32_t fields[4] = {header->type, header->size, (uint32_t)header->lsn, (uint32_t)(header->lsn >> 32)};
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < sizeof(fields); i++) {
+    hash = (hash ^ ((const unsigned char*)fields)[i]) * 16777619u;
+  }
+  for (size_t i = 0; i < header->size; i++) {
+    hash = (hash ^ ((const unsigned char*)payload)[i]) * 16777619u;
+  }
+  return hash;
+}
+
+/// Writes a whole buffer to the log file.
+/// @param data Buffer to write.
+/// @param size Size of the buffer.
+/// @return 0 if the buffer was written, 1 otherwise.
+static int write_all(const char* data, size_t size) {
+  while (size > 0) {
+    ssize_t written = write(wal_fd, data, size);
+    if (written == -1) return 1;
+    data += written;
+    size -= (size_t)written;
+  }
+  return 0;
+}
+
+/// Replays the valid records of the log file and finds where they end.
+/// @param from_lsn Records with a smaller LSN are skipped.
+/// @param apply Function called for each replayed record.
+/// @param arg Argument given to apply.
+/// @param valid_size Set to the size of the valid prefix of the file.
+/// @return 0 on success, 1 if the file could not be read.
+static int replay(uint64_t from_lsn, wal_apply_fn apply, void* arg, off_t* valid_size) {
+  struct stat st;
+  if (fstat(wal_fd, &st) == -1) return 1;
+
+  size_t size = (size_t)st.st_size;
+  char* data = malloc(size == 0 ? 1 : size);
+  if (data == NULL) return 1;
+  for (size_t done = 0; done < size;) {
+    ssize_t n = pread(wal_fd, data + done, size - done, (off_t)done);
+    if (n <= 0) {
+      free(data);
+      return 1;
+    }
+    done += (size_t)n;
+  }
+
+  size_t offset = 0;
+  uint64_t expected_lsn = 0;
+  while (size - offset >= sizeof(struct WalRecordHeader)) {
+    struct WalRecordHeader header;
+    memcpy(&header, data + offset, sizeof(header));
+    const char* payload = data + offset + sizeof(header);
+    if (header.size > size - offset - sizeof(header)) break;
+    if (expected_lsn != 0 && header.lsn != expected_lsn) break;
+    if (header.checksum != record_checksum(&header, payload)) break;
+
+    if (header.lsn >= from_lsn) {
+      apply(header.type, payload, header.size, arg);
+    }
+    expected_lsn = header.lsn + 1;
+    offset += sizeof(header) + header.size;
+  }
+  free(data);
+
+  if (expected_lsn > next_lsn) next_lsn = expected_lsn;
+  *valid_size = (off_t)offset;
+  return 0;
+}
+
+/// Writes the appended records in batches until the log is closed.
+/// @param arg Unused.
+/// @return NULL.
+static void* flusher_function(void* arg) {
+  (void)arg;
+
+  block_sigusr1();
+
+  char* batch = NULL;
+  size_t batch_capacity = 0;
+
+  pthread_mutex_lock(&wal_mutex);
+  while (1) {
+    while (buffered_records == 0 && !closing) {
+      pthread_cond_wait(&flush_cond, &wal_mutex);
+    }
+    if (buffered_records == 0) break;
+
+    // Takes up to wal_max_batch records from the front of the buffer
+    size_t records = 0;
+    size_t size = 0;
+    while (records < buffered_records && records < wal_max_batch) {
+      struct WalRecordHeader header;
+      memcpy(&header, buffer + size, sizeof(header));
+      size += sizeof(header) + header.size;
+      records++;
+    }
+    if (size > batch_capacity) {
+      char* temp = realloc(batch, size);
+      if (temp == NULL) {
+        failed = 1;
+        pthread_cond_broadcast(&durable_cond);
+        break;
+      }
+      batch = temp;
+      batch_capacity = size;
+    }
+    memcpy(batch, buffer, size);
+    memmove(buffer, buffer + size, buffer_used - size);
+    buffer_used -= size;
+    buffered_records -= records;
+    uint64_t batch_lsn = durable_lsn + records;
+    pthread_mutex_unlock(&wal_mutex);
+
+    // Requests keep appending to the buffer while the batch is written
+    int error = write_all(batch, size) != 0 || fdatasync(wal_fd) != 0;
+
+    pthread_mutex_lock(&wal_mutex);
+    if (error) {
+      failed = 1;
+    } else {
+      durable_lsn = batch_lsn;
+      records_written += records;
+      flushes++;
+    }
+    pthread_cond_broadcast(&durable_cond);
+    if (failed) break;
+  }
+  pthread_mutex_unlock(&wal_mutex);
+
+  free(batch);
+  return NULL;
+}
+
+int wal_open(const char* path, size_t max_batch, uint64_t from_lsn, wal_apply_fn apply, void* arg) {
+  wal_fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (wal_fd == -1) return 1;
+
+  // Records the state already reflects are never written again
+  next_lsn = from_lsn > 0 ? from_lsn : 1;
+
+  off_t valid_size;
+  if (replay(from_lsn, apply, arg, &valid_size) != 0 || ftruncate(wal_fd, valid_size) != 0 ||
+      lseek(wal_fd, valid_size, SEEK_SET) == -1) {
+    close(wal_fd);
+    wal_fd = -1;
+    return 1;
+  }
+
+  wal_max_batch = max_batch == 0 ? 1 : max_batch;
+  durable_lsn = next_lsn - 1;
+  failed = 0;
+  closing = 0;
+  if (pthread_create(&flusher, NULL, flusher_function, NULL) != 0) {
+    close(wal_fd);
+    wal_fd = -1;
+    return 1;
+  }
+  return 0;
+}
+
+uint64_t wal_append(uint32_t type, const void* payload, size_t size) {
+  size_t record_size = sizeof(struct WalRecordHeader) + size;
+
+  pthread_mutex_lock(&wal_mutex);
+  if (failed || wal_fd == -1) {
+    pthread_mutex_unlock(&wal_mutex);
+    return 0;
+  }
+  if (buffer_used + record_size > buffer_capacity) {
+    size_t capacity = buffer_capacity == 0 ? WAL_INITIAL_BUFFER : buffer_capacity;
+    while (buffer_used + record_size > capacity) capacity *= 2;
+    char* temp = realloc(buffer, capacity);
+    if (temp == NULL) {
+      pthread_mutex_unlock(&wal_mutex);
+      return 0;
+    }
+    buffer = temp;
+    buffer_capacity = capacity;
+  }
+
+  struct WalRecordHeader header = {type, (uint32_t)size, next_lsn++, 0, 0};
+  header.checksum = record_checksum(&header, payload);
+  memcpy(buffer + buffer_used, &header, sizeof(header));
+  memcpy(buffer + buffer_used + sizeof(header), payload, size);
+  buffer_used += record_size;
+  buffered_records++;
+
+  pthread_cond_signal(&flush_cond);
+  pthread_mutex_unlock(&wal_mutex);
+  return header.lsn;
+}
+
+int wal_wait(uint64_t lsn) {
+  if (lsn == 0) return 1;
+
+  pthread_mutex_lock(&wal_mutex);
+  while (durable_lsn < lsn && !failed) {
+    pthread_cond_wait(&durable_cond, &wal_mutex);
+  }
+  int durable = durable_lsn >= lsn;
+  pthread_mutex_unlock(&wal_mutex);
+
+  return !durable;
+}
+
+uint64_t wal_next_lsn() {
+  pthread_mutex_lock(&wal_mutex);
+  uint64_t lsn = next_lsn;
+  pthread_mutex_unlock(&wal_mutex);
+  return lsn;
+}
+
+void wal_close() {
+  if (wal_fd == -1) return;
+
+  pthread_mutex_lock(&wal_mutex);
+  closing = 1;
+  pthread_cond_signal(&flush_cond);
+  pthread_mutex_unlock(&wal_mutex);
+  pthread_join(flusher, NULL);
+
+  close(wal_fd);
+  wal_fd = -1;
+  free(buffer);
+  buffer = NULL;
+  buffer_used = 0;
+  buffer_capacity = 0;
+  buffered_records = 0;
+}
+
+void wal_get_stats(struct WalStats* stats) {
+  pthread_mutex_lock(&wal_mutex);
+  stats->records = records_written;
+  stats->flushes = flushes;
+  pthread_mutex_unlock(&wal_mutex);
+}
@@ -0,0 +1,92 @@
+#ifndef SERVER_WAL_H
+#define SERVER_WAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Write-ahead log of the changes to the EMS state.
+/// Records are appended to an in-memory buffer and numbered with consecutive log sequence numbers (LSNs).
+/// A flusher thread writes the buffered records in batches, with one write and one fdatasync per batch
+/// (group commit), so concurrent requests share the cost of making their records durable.
+
+#define WAL_CREATE 1   // Payload: struct WalCreate
+#define WAL_RESERVE 2  // Payload: struct WalReserve, followed by num_seats rows and num_seats columns (uint64_t)
+#define WAL_DELETE 3   // Payload: struct WalDelete
+#define WAL_CANCEL 4   // Payload: as WAL_RESERVE, with the id and seats of the cancelled reservation
+#define WAL_RESERVE_MULTI 5  // Payload: number of reservations (uint64_t), then the payload of a WAL_RESERVE for each
+
+// Header of every record in the log file
+struct WalRecordHeader {
+  uint32_t type;      // Type of the record
+  uint32_t size;      // Size of the payload that follows the header
+  uint64_t lsn;       // Log sequence number of the record
+  uint32_t checksum;  // Checksum of the other header fields and the payload
+  uint32_t reserved;  // Always 0
+};
+
+struct WalCreate {
+  uint32_t event_id;
+  uint32_t stripes;  // Number of row stripes of the event, 0 in logs written before it was saved (the default)
+  uint64_t rows;
+  uint64_t cols;
+};
+
+struct WalReserve {
+  uint32_t event_id;
+  uint32_t reservation_id;  // Id the reservation got, written to every reserved seat
+  uint64_t num_seats;
+};
+
+struct WalDelete {
+  uint32_t event_id;
+};
+
+// Counters of the log, used to measure the batching
+struct WalStats {
+  unsigned long records;  // Records written to the file
+  unsigned long flushes;  // Batches written (and fdatasync'ed)
+};
+
+/// Applies a record of the log to the state during recovery.
+/// @param type Type of the record.
+/// @param payload Payload of the record.
+/// @param size Size of the payload.
+/// @param arg Argument given to wal_open.
+typedef void (*wal_apply_fn)(uint32_t type, const void* payload, size_t size, void* arg);
+
+/// Opens the log, replays it and starts the flusher thread.
+/// @note A torn or corrupted tail, left by a crash in the middle of a write, is cut off.
+/// @param path Path of the log file, created if it does not exist.
+/// @param max_batch Maximum number of records written per batch.
+/// @param from_lsn Records with a smaller LSN are already reflected in the state and are not replayed.
+/// @param apply Function called for each record that is replayed.
+/// @param arg Argument given to apply.
+/// @return 0 if the log was opened successfully, 1 otherwise.
+int wal_open(const char* path, size_t max_batch, uint64_t from_lsn, wal_apply_fn apply, void* arg);
+
+/// Appends a record to the log buffer.
+/// @note Records must be appended while holding the lock that orders the change they describe,
+/// so the log order matches the order in which the changes were applied.
+/// @param type Type of the record.
+/// @param payload Payload of the record.
+/// @param size Size of the payload.
+/// @return LSN of the record, 0 on failure.
+uint64_t wal_append(uint32_t type, const void* payload, size_t size);
+
+/// Waits until a record is durable.
+/// @param lsn LSN returned by wal_append.
+/// @return 0 once the record is durable, 1 if it could not be written.
+int wal_wait(uint64_t lsn);
+
+/// Gets the LSN the next appended record will get.
+/// @return Next LSN.
+uint64_t wal_next_lsn();
+
+/// Writes the buffered records, stops the flusher thread and closes the log.
+void wal_close();
+
+/// Gets the log counters.
+/// @param stats Where to store the counters.
+void wal_get_stats(struct WalStats* stats);
+
+#endif  // SERVER_WAL_H